@@ -53,17 +53,6 @@
 
 
 
-// ************************************************************************
-// CRC lookup table
-// ************************************************************************
-//
-static const PROGMEM uint32_t crc_table[16] = {
-    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac,
-    0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
-    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
-    0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c
-};
-
 #ifdef USE_SIMPLE_LOG
 // ************************************************************************
 // logger for debug/control output
@@ -79,13 +68,27 @@ static SimpleLog Logger;
 //
 unsigned long dsEeprom::crc( int startPos, int length )
 {
-  unsigned long crc = ~0L;
+  uint32_t crc = EEPROM_CRC_INIT;
+  unsigned char buffer[EEPROM_READ_CHUNK];
+  int chunk;
 
-  for (int index = startPos; index < (startPos + length); ++index) 
+  EE_READ_BEGIN
+  crc = EEPROM_CRC_INIT;
+
+  //
+  // read in chunks to let the device use sequential reads
+  //
+  for (int index = startPos; index < (startPos + length); index += chunk) 
   {
-    crc = crc_table[(crc ^ EEPROM.read(index)) & 0x0f] ^ (crc >> 4);
-    crc = crc_table[((crc ^ EEPROM.read(index)) >> 4) & 0x0f] ^ (crc >> 4);
-    crc = ~crc;
+    chunk = (startPos + length) - index;
+    if( chunk > EEPROM_READ_CHUNK )
+    {
+      chunk = EEPROM_READ_CHUNK;
+    }
+
+    readBlock( index, buffer, chunk );
+
+    crc = dsEepromCrcUpdate( crc, buffer, chunk );
   }
 
 #ifdef USE_SIMPLE_LOG
@@ -97,6 +100,8 @@ unsigned long dsEeprom::crc( int startPos, int length )
 #endif // DEBUG
 #endif // USE_SIMPLE_LOG
 
+  EE_READ_END;
+
   return crc;
 }
 //
@@ -105,10 +110,44 @@ unsigned long dsEeprom::crc( int startPos, int length )
 // ************************************************************************
 //
 
+//
+// onchip EEPROM is the default device. Constructed on first use: a
+// global dsEeprom of a sketch may be constructed before the globals of
+// this file.
+//
+static dsEepromDevice* onchipDevice( void )
+{
+  static dsEepromOnchip device;
+
+  return( &device );
+}
+
 dsEeprom::dsEeprom( unsigned int newBlockSize, unsigned char newMagic, int newLogLevel )
 {
 
   status = 0;
+  device = onchipDevice();
+  base = 0;
+  readThrough = true;
+  schemaVersion = 0;
+  eccRegions = 0;
+  generation = 0;
+  journalDevice = NULL;
+  journal = 0;
+  journalLength = 0;
+  autoIdle = 0;
+  autoDeadline = 0;
+  autoPending = false;
+  secretKey = NULL;
+  secretDevice = NULL;
+  secretCounter = 0;
+  scrubSlice = EEPROM_SCRUB_SLICE;
+  scrubReset();
+#ifdef DSEEPROM_THREADSAFE
+  sequence = 0;
+  writeDepth = 0;
+  commitPending = false;
+#endif // DSEEPROM_THREADSAFE
 
   if( newLogLevel < LOGLEVEL_QUIET || newLogLevel > LOGLEVEL_INFO )
   {
@@ -124,17 +163,13 @@ dsEeprom::dsEeprom( unsigned int newBlockSize, unsigned char newMagic, int newLo
 #endif // USE_SIMPLE_LOG
 
 
-  if( newBlockSize <= 0 || newBlockSize > EEPROM_MAX_SIZE )
+  if( newBlockSize <= 0 || newBlockSize > device->capacity() ||
+      device->begin(newBlockSize) != E_SUCCESS )
   {
     status |= EE_STATUS_INVALID_SIZE;
   }
   else
   {
-#ifdef ESP8266
-    EEPROM.begin(newBlockSize);
-#else
-    EEPROM.begin();
-#endif // ESP8266
     blockSize = newBlockSize;
     status &= ~EE_STATUS_INVALID_SIZE;
   }
@@ -150,6 +185,39 @@ dsEeprom::dsEeprom( unsigned int newBlockSize, unsigned char newMagic, int newLo
 
 }
 
+//
+// use another device than the onchip EEPROM
+//
+dsEeprom::dsEeprom( dsEepromDevice& newDevice, unsigned int newBlockSize, unsigned char newMagic, int newLogLevel )
+{
+  device = &newDevice;
+  base = 0;
+  readThrough = true;
+  schemaVersion = 0;
+  eccRegions = 0;
+  generation = 0;
+  journalDevice = NULL;
+  journal = 0;
+  journalLength = 0;
+  autoIdle = 0;
+  autoDeadline = 0;
+  autoPending = false;
+  secretKey = NULL;
+  secretDevice = NULL;
+  secretCounter = 0;
+  scrubSlice = EEPROM_SCRUB_SLICE;
+  scrubReset();
+#ifdef DSEEPROM_THREADSAFE
+  sequence = 0;
+  writeDepth = 0;
+  commitPending = false;
+#endif // DSEEPROM_THREADSAFE
+  blockSize = 0;
+  magic = 0x00;
+
+  init( newBlockSize, newMagic, newLogLevel );
+}
+
 dsEeprom::~dsEeprom()
 {
 }
@@ -161,9 +229,40 @@ dsEeprom::~dsEeprom()
 //
 
 int dsEeprom::init( unsigned int newBlockSize, unsigned char newMagic, int newLogLevel )
+{
+  int retVal;
+
+  retVal = initPartition( 0, newBlockSize, newMagic, newLogLevel );
+  readThrough = true;
+
+  return( retVal );
+}
+
+int dsEeprom::init( dsEepromDevice& newDevice, unsigned int newBlockSize, unsigned char newMagic, int newLogLevel )
+{
+  device = &newDevice;
+
+  return( init( newBlockSize, newMagic, newLogLevel ) );
+}
+
+//
+// ************************************************************************
+// partitions
+// ************************************************************************
+//
+// an instance may cover a part of the device only. All positions
+// (header, data fields, crc range) are relative to the base of the
+// partition, so every partition has its own magic and checksum and
+// validate() of one partition does not touch the others.
+//
+
+int dsEeprom::initPartition( unsigned int newBase, unsigned int newLength, unsigned char newMagic, int newLogLevel )
 {
 
   status = EE_STATUS_OK_AND_READY;
+  eccRegions = 0;
+  readThrough = false;
+  scrubReset();
 
   if( newLogLevel < LOGLEVEL_QUIET || newLogLevel > LOGLEVEL_INFO )
   {
@@ -178,18 +277,15 @@ int dsEeprom::init( unsigned int newBlockSize, unsigned char newMagic, int newLo
   Logger.Init(logLevel, &Serial);
 #endif // USE_SIMPLE_LOG
 
-  if( newBlockSize <= 0 || newBlockSize > EEPROM_MAX_SIZE )
+  if( newLength <= 0 || newBase + newLength > device->capacity() ||
+      device->begin(newBase + newLength) != E_SUCCESS )
   {
     status |= EE_STATUS_INVALID_SIZE;
   }
   else
   {
-#ifdef ESP8266
-    EEPROM.begin(newBlockSize);
-#else
-    EEPROM.begin();
-#endif // ESP8266
-    blockSize = newBlockSize;
+    base = newBase;
+    blockSize = newLength;
     status &= ~EE_STATUS_INVALID_SIZE;
   }
 
@@ -205,6 +301,267 @@ int dsEeprom::init( unsigned int newBlockSize, unsigned char newMagic, int newLo
   return( status );
 }
 
+int dsEeprom::initPartition( dsEepromDevice& newDevice, unsigned int newBase, unsigned int newLength, unsigned char newMagic, int newLogLevel )
+{
+  device = &newDevice;
+
+  return( initPartition( newBase, newLength, newMagic, newLogLevel ) );
+}
+
+//
+// byte access within the partition
+// bytes beyond the end of a partition read as zero (as on an ESP8266
+// beyond the size passed to EEPROM.begin()), writes beyond the end are
+// dropped
+//
+unsigned char dsEeprom::readByte( int pos )
+{
+  unsigned char data[EEPROM_ECC_BLOCK];
+  unsigned char check;
+  int region;
+  int block;
+  bool isParity;
+
+  if( pos < 0 || pos >= blockSize )
+  {
+    return( readPast( pos ) );
+  }
+
+  if( eccRegions > 0 && (region = eccLocate( pos, &block, &isParity )) >= 0 )
+  {
+    eccBlock( region, block, data, &check, false );
+    return( isParity ? check : data[(pos - eccRegion[region].begin) % EEPROM_ECC_BLOCK] );
+  }
+
+  return( device->read( base + pos ) );
+}
+
+void dsEeprom::writeByte( int pos, unsigned char value )
+{
+  unsigned char data[EEPROM_ECC_BLOCK];
+  unsigned char check;
+  unsigned char newCheck;
+  int region = -1;
+  int block;
+  bool isParity;
+
+  if( pos < 0 || pos >= blockSize )
+  {
+    return;
+  }
+
+  //
+  // check bytes follow the data, they are not written from outside.
+  // The block is repaired first, else the new check byte would make a
+  // bit error permanent; a block that can't be repaired keeps its check
+  // byte, so the error stays visible - the write is refused (status
+  // EE_STATUS_ECC_FAILED)
+  //
+  if( eccRegions > 0 && (region = eccLocate( pos, &block, &isParity )) >= 0 &&
+      (isParity || eccBlock( region, block, data, &check, true ) == EEPROM_ECC_UNCORRECTABLE) )
+  {
+    return;
+  }
+
+  //
+  // the stored checksum is not up to date until validate()
+  //
+  status |= EE_STATUS_MODIFIED;
+  status &= ~EE_STATUS_COMMITED;
+  generation++;
+
+  if( region >= 0 )
+  {
+    data[(pos - eccRegion[region].begin) % EEPROM_ECC_BLOCK] = value;
+    device->write( base + pos, value );
+
+    if( (newCheck = dsEepromEccEncode( data )) != check )
+    {
+      device->write( base + eccRegion[region].parity + block, newCheck );
+    }
+
+    return;
+  }
+
+  device->write( base + pos, value );
+}
+
+void dsEeprom::readBlock( int pos, unsigned char* data, int len )
+{
+  int valid = 0;
+
+  if( pos >= 0 && pos < blockSize )
+  {
+    valid = blockSize - pos < len ? blockSize - pos : len;
+    if( device->readBlock( base + pos, data, valid ) < valid )
+    {
+      status |= EE_STATUS_DEVICE_ERROR;
+    }
+
+    if( eccRegions > 0 )
+    {
+      eccPatch( pos, data, valid );
+    }
+  }
+
+  for( int i = valid; i < len; i++ )
+  {
+    data[i] = readPast( pos + i );
+  }
+}
+
+//
+// a byte behind the image: an instance over the whole device (init())
+// reads it from the device as the versions before partitions did, so
+// the checksums of images in the field stay the same
+//
+unsigned char dsEeprom::readPast( int pos )
+{
+  if( !readThrough || pos < blockSize )
+  {
+    return( 0 );
+  }
+
+#ifdef __AVR__
+  //
+  // the address register of the onchip EEPROM wraps around
+  //
+  return( device->read( pos % device->capacity() ) );
+#else
+  return( (unsigned int) pos < device->capacity() ? device->read( pos ) : 0 );
+#endif // __AVR__
+}
+
+//
+// commit now or, inside a change, when it ends - so a reader on a
+// device behind a bus never waits for a commit it does not need
+//
+int dsEeprom::commitDevice( void )
+{
+#ifdef DSEEPROM_THREADSAFE
+  if( writeDepth > 0 )
+  {
+    commitPending = true;
+    return( E_SUCCESS );
+  }
+#endif // DSEEPROM_THREADSAFE
+
+  return( commitTo( device ) );
+}
+
+//
+// a failed commit - or a failed write or read of a device that
+// reports it with its next commit (24Cxx) - sets EE_STATUS_DEVICE_ERROR.
+// It stays set like the error correction bits: a store may be lost, a
+// later commit does not bring it back.
+//
+int dsEeprom::commitTo( dsEepromDevice* target )
+{
+  int retVal = target->commit();
+
+  if( retVal != E_SUCCESS )
+  {
+    status |= EE_STATUS_DEVICE_ERROR;
+  }
+
+  return( retVal );
+}
+
+#ifdef DSEEPROM_THREADSAFE
+//
+// ************************************************************************
+// thread safe mode
+// ************************************************************************
+//
+
+//
+// a change begins: the sequence gets odd on the outermost level
+//
+void dsEeprom::writeBegin( void )
+{
+  writeLock.lock();
+
+  if( writeDepth++ == 0 )
+  {
+    sequence.store( sequence.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+    std::atomic_thread_fence( std::memory_order_release );
+  }
+}
+
+void dsEeprom::writeEnd( void )
+{
+  if( --writeDepth == 0 )
+  {
+    sequence.store( sequence.load( std::memory_order_relaxed ) + 1, std::memory_order_release );
+
+    if( commitPending )
+    {
+      commitPending = false;
+      commitTo( device );
+    }
+  }
+
+  writeLock.unlock();
+}
+
+//
+// a device that does not allow concurrent reads (bus transfer) is
+// read under the lock, as is a read within a change of the same thread
+//
+#define EE_READ_LOCKED  (~0UL)
+//
+// yields before a reader blocks on the lock to wait for a writer
+//
+#define EE_READ_SPINS     8
+
+unsigned long dsEeprom::readBegin( void )
+{
+  unsigned long readSequence;
+  unsigned int spins = 0;
+
+  if( !device->concurrentReads() || writeLock.heldByMe() )
+  {
+    writeLock.lock();
+    return( EE_READ_LOCKED );
+  }
+
+  //
+  // a yield does not help a writer of lower priority on the same core,
+  // so a reader that still sees the change going on blocks on the lock
+  // the writer holds
+  //
+  while( (readSequence = sequence.load( std::memory_order_acquire )) & 1 )
+  {
+    if( spins++ < EE_READ_SPINS )
+    {
+      dsEepromLock::relax();
+    }
+    else
+    {
+      writeLock.wait();
+    }
+  }
+
+  return( readSequence );
+}
+
+//
+// true if a change ran during the read - the caller reads again
+//
+bool dsEeprom::readRetry( unsigned long readSequence )
+{
+  if( readSequence == EE_READ_LOCKED )
+  {
+    writeLock.unlock();
+    return( false );
+  }
+
+  std::atomic_thread_fence( std::memory_order_acquire );
+
+  return( sequence.load( std::memory_order_relaxed ) != readSequence );
+}
+#endif // DSEEPROM_THREADSAFE
+
 
 //
 // tell status of dsEeprom-instance
@@ -219,17 +576,17 @@ short dsEeprom::getStatus( void )
 //
 void dsEeprom::wipe( void )
 {
-  if( blockSize > 0 && blockSize <= EEPROM_MAX_SIZE )
+  EE_WRITE_GUARD;
+
+  if( blockSize > 0 && base + blockSize <= device->capacity() )
   {
     for( int index = 0; index < blockSize; index++ )
     {
-      EEPROM.write( index, '\0' );
+      writeByte( index, '\0' );
     }
 
-#ifdef ESP8266
-    EEPROM.commit();
-#endif // ESP8266
- 
+    commitDevice();
+
   }
   else
   {
@@ -246,6 +603,7 @@ int dsEeprom::storeFieldLength( char* len, int dataIndex )
 {
   int retVal = 0;
 
+  EE_WRITE_GUARD;
 
   if( status & EE_STATUS_INVALID_SIZE )
   {
@@ -259,6 +617,10 @@ int dsEeprom::storeFieldLength( char* len, int dataIndex )
 #endif // USE_SIMPLE_LOG
 
   }
+  else if( !stageRoom( dataIndex, EEPROM_LEADING_LENGTH ) )
+  {
+    retVal = E_BAD_TXN;
+  }
   else
   {
 #ifdef USE_SIMPLE_LOG
@@ -270,7 +632,7 @@ int dsEeprom::storeFieldLength( char* len, int dataIndex )
 #endif // DEBUG
 #endif // USE_SIMPLE_LOG
   
-    EEPROM.write(dataIndex, len[0]);
+    writeByte( dataIndex, len[0]);
 
 #ifdef USE_SIMPLE_LOG
 #ifdef DEBUG
@@ -281,7 +643,7 @@ int dsEeprom::storeFieldLength( char* len, int dataIndex )
 #endif // DEBUG
 #endif // USE_SIMPLE_LOG
   
-    EEPROM.write(dataIndex+1, len[1]);
+    writeByte( dataIndex+1, len[1]);
 
   }
 
@@ -295,6 +657,8 @@ int dsEeprom::restoreFieldLength( char* len, int dataIndex )
 {
   int retVal = 0;
 
+  EE_READ_BEGIN
+
   if( status & EE_STATUS_INVALID_SIZE )
   {
 #ifdef USE_SIMPLE_LOG
@@ -308,7 +672,7 @@ int dsEeprom::restoreFieldLength( char* len, int dataIndex )
   }
   else
   {
-    len[0] = EEPROM.read(dataIndex);
+    len[0] = readByte( dataIndex);
 
 #ifdef USE_SIMPLE_LOG
 #ifdef DEBUG
@@ -319,7 +683,7 @@ int dsEeprom::restoreFieldLength( char* len, int dataIndex )
 #endif // DEBUG
 #endif // USE_SIMPLE_LOG
 
-    len[1] = EEPROM.read(dataIndex+1);
+    len[1] = readByte( dataIndex+1);
 
 #ifdef USE_SIMPLE_LOG
 #ifdef DEBUG
@@ -331,6 +695,8 @@ int dsEeprom::restoreFieldLength( char* len, int dataIndex )
 #endif // USE_SIMPLE_LOG
   }
 
+  EE_READ_END;
+
   return(retVal);
 }
 
@@ -342,6 +708,8 @@ int dsEeprom::storeBoolean(  char* data, int dataIndex )
     int retVal = 0;
     short len = EEPROM_MAXLEN_BOOLEAN;
 
+    EE_WRITE_GUARD;
+
     if( status & EE_STATUS_INVALID_SIZE )
     {
 #ifdef USE_SIMPLE_LOG
@@ -353,6 +721,10 @@ int dsEeprom::storeBoolean(  char* data, int dataIndex )
 #endif // DEBUG
 #endif // USE_SIMPLE_LOG
     }
+    else if( !stageRoom( dataIndex, EEPROM_LEADING_LENGTH + len ) )
+    {
+      retVal = E_BAD_TXN;
+    }
     else
     {
 #ifdef USE_SIMPLE_LOG
@@ -377,7 +749,7 @@ int dsEeprom::storeBoolean(  char* data, int dataIndex )
     
             for (int i = 0; i < len; ++i)
             {
-                EEPROM.write(dataIndex + EEPROM_LEADING_LENGTH + i, data[i]);
+                writeByte( dataIndex + EEPROM_LEADING_LENGTH + i, data[i]);
 #ifdef USE_SIMPLE_LOG
 #ifdef DEBUG
                 if( DOLOG )
@@ -408,6 +780,9 @@ int dsEeprom::restoreBoolean( char *data, int dataIndex )
     int retVal = 0;
     char rdValue;
 
+    EE_READ_BEGIN
+    retVal = 0;
+
     if( status & EE_STATUS_INVALID_SIZE )
     {
 #ifdef USE_SIMPLE_LOG
@@ -430,7 +805,7 @@ int dsEeprom::restoreBoolean( char *data, int dataIndex )
 #endif // DEBUG
 #endif // USE_SIMPLE_LOG
 
-        rdValue = EEPROM.read(dataIndex+ EEPROM_LEADING_LENGTH);
+        rdValue = readByte( dataIndex+ EEPROM_LEADING_LENGTH);
 
         if( rdValue == 0 )
         {
@@ -449,6 +824,8 @@ int dsEeprom::restoreBoolean( char *data, int dataIndex )
         }
     }
 
+    EE_READ_END;
+
     return(retVal);
 }
 //
@@ -459,6 +836,8 @@ int dsEeprom::storeRaw( const char* data, short len, int dataIndex )
 {
     int retVal = 0;
 
+    EE_WRITE_GUARD;
+
     if( status & EE_STATUS_INVALID_SIZE )
     {
 #ifdef USE_SIMPLE_LOG
@@ -470,6 +849,10 @@ int dsEeprom::storeRaw( const char* data, short len, int dataIndex )
 #endif // DEBUG
 #endif // USE_SIMPLE_LOG
     }
+    else if( !stageRoom( dataIndex, len ) )
+    {
+      retVal = E_BAD_TXN;
+    }
     else
     {
 #ifdef USE_SIMPLE_LOG
@@ -493,7 +876,7 @@ int dsEeprom::storeRaw( const char* data, short len, int dataIndex )
 
         for (int i = 0; i < len; ++i)
         {
-            EEPROM.write(dataIndex+i, data[i]);
+            writeByte( dataIndex+i, data[i]);
 
 #ifdef USE_SIMPLE_LOG
 #ifdef DEBUG
@@ -525,8 +908,9 @@ int dsEeprom::storeRaw( const char* data, short len, int dataIndex )
 int dsEeprom::restoreRaw( char* data, int dataIndex, int len, int maxLen)
 {
   int retVal = 0;
-  char c;
   
+  EE_READ_BEGIN
+
   if( status & EE_STATUS_INVALID_SIZE )
   {
 #ifdef USE_SIMPLE_LOG
@@ -552,19 +936,24 @@ int dsEeprom::restoreRaw( char* data, int dataIndex, int len, int maxLen)
 
     if( len > 0 )
     {
-      for( int i=0; i < len && i < maxLen; i++ )
+      if( len > maxLen )
       {
-        c = EEPROM.read(dataIndex + i);
+        len = maxLen;
+      }
+
+      readBlock( dataIndex, (unsigned char*) data, len );
+
 #ifdef USE_SIMPLE_LOG
 #ifdef DEBUG
+      for( int i=0; i < len; i++ )
+      {
         if( DOLOG )
         {
-          Logger.Log(LOGLEVEL_DEBUG, (const char*) "rd[%d] <- %x\n", i, c);
+          Logger.Log(LOGLEVEL_DEBUG, (const char*) "rd[%d] <- %x\n", i, data[i]);
         }
+      }
 #endif // DEBUG
 #endif // USE_SIMPLE_LOG
-        *data++ = c;
-      }
     }
 
 #ifdef USE_SIMPLE_LOG
@@ -577,6 +966,8 @@ int dsEeprom::restoreRaw( char* data, int dataIndex, int len, int maxLen)
 #endif // USE_SIMPLE_LOG
   }
 
+  EE_READ_END;
+
   return(retVal);
 }
 
@@ -587,6 +978,8 @@ int dsEeprom::storeBytes( const char* data, short len, int dataIndex )
 {
     int retVal = 0;
 
+    EE_WRITE_GUARD;
+
     if( status & EE_STATUS_INVALID_SIZE )
     {
 #ifdef USE_SIMPLE_LOG
@@ -598,6 +991,10 @@ int dsEeprom::storeBytes( const char* data, short len, int dataIndex )
 #endif // DEBUG
 #endif // USE_SIMPLE_LOG
     }
+    else if( !stageRoom( dataIndex, EEPROM_LEADING_LENGTH + len ) )
+    {
+      retVal = E_BAD_TXN;
+    }
     else
     {
 #ifdef USE_SIMPLE_LOG
@@ -624,7 +1021,7 @@ int dsEeprom::storeBytes( const char* data, short len, int dataIndex )
 
             for (int i = 0; i < len; ++i)
             {
-                EEPROM.write(dataIndex + EEPROM_LEADING_LENGTH + i, data[i]);
+                writeByte( dataIndex + EEPROM_LEADING_LENGTH + i, data[i]);
 
 #ifdef USE_SIMPLE_LOG
 #ifdef DEBUG
@@ -656,8 +1053,12 @@ int dsEeprom::storeBytes( const char* data, short len, int dataIndex )
 int dsEeprom::restoreBytes( String& data, int dataIndex, int len, int maxLen)
 {
   int retVal = 0;
+  unsigned char buffer[EEPROM_READ_CHUNK];
+  int chunk;
   char c;
   
+  EE_READ_BEGIN
+
   if( status & EE_STATUS_INVALID_SIZE )
   {
 #ifdef USE_SIMPLE_LOG
@@ -684,18 +1085,34 @@ int dsEeprom::restoreBytes( String& data, int dataIndex, int len, int maxLen)
     if( len > 0 )
     {
       data = "";
-      for( int i=0; i < len && i < maxLen; i++ )
+      if( len > maxLen )
       {
-        c = EEPROM.read(dataIndex + EEPROM_LEADING_LENGTH + i);
-#ifdef USE_SIMPLE_LOG
-#ifdef DEBUG
-        if( DOLOG )
+        len = maxLen;
+      }
+
+      for( int i=0; i < len; i += chunk )
+      {
+        chunk = len - i;
+        if( chunk > EEPROM_READ_CHUNK )
         {
-          Logger.Log(LOGLEVEL_DEBUG, (const char*) "rd <- %c", c);
+          chunk = EEPROM_READ_CHUNK;
         }
+
+        readBlock( dataIndex + EEPROM_LEADING_LENGTH + i, buffer, chunk );
+
+        for( int j = 0; j < chunk; j++ )
+        {
+          c = buffer[j];
+#ifdef USE_SIMPLE_LOG
+#ifdef DEBUG
+          if( DOLOG )
+          {
+            Logger.Log(LOGLEVEL_DEBUG, (const char*) "rd <- %c", c);
+          }
 #endif // DEBUG
 #endif // USE_SIMPLE_LOG
-        data += c;
+          data += c;
+        }
       }
     }
 
@@ -709,6 +1126,8 @@ int dsEeprom::restoreBytes( String& data, int dataIndex, int len, int maxLen)
 #endif // USE_SIMPLE_LOG
   }
 
+  EE_READ_END;
+
   return(retVal);
 }
 
@@ -720,6 +1139,8 @@ int dsEeprom::storeString( String data, int maxLen, int dataIndex )
   int retVal = 0;
   short wrLen;
 
+  EE_WRITE_GUARD;
+
   if( status & EE_STATUS_INVALID_SIZE )
   {
 #ifdef USE_SIMPLE_LOG
@@ -757,6 +1178,8 @@ int dsEeprom::restoreString( String& data, int dataIndex, int maxLen )
   int retVal = 0;
   short len = 0;
   
+  EE_READ_BEGIN
+
   if( status & EE_STATUS_INVALID_SIZE )
   {
 #ifdef USE_SIMPLE_LOG
@@ -784,67 +1207,565 @@ int dsEeprom::restoreString( String& data, int dataIndex, int maxLen )
     }
   }
 
+  EE_READ_END;
+
   return(retVal);
 }
 
 //
-// check whether first byte in EEPROM is "magic"
+// ************************************************************************
+// zero copy views
+// ************************************************************************
 //
-bool dsEeprom::isValid()
+
+//
+// view of len bytes at pos if the device holds them in RAM and no
+// error correction or open transaction stands between
+//
+int dsEeprom::viewRaw( dsEepromView& view, int dataIndex, int len )
 {
-  bool retVal = true;
-  unsigned char rdMagic;
+  int retVal = E_NO_VIEW;
+  const unsigned char *memory;
+  int block;
+  bool isParity;
+
+  view.data = NULL;
+  view.length = 0;
 
-  if( magic == 0 || (rdMagic = EEPROM.read( EEPROM_POS_MAGIC )) !=  magic )
+  EE_READ_BEGIN
+  retVal = E_NO_VIEW;
+
+  if( !(status & EE_STATUS_INVALID_SIZE) && dataIndex >= 0 && len >= 0 &&
+      dataIndex + len <= blockSize &&
+      (memory = device->memory( base + dataIndex, len )) != NULL )
   {
-    retVal = false;
-#ifdef USE_SIMPLE_LOG
-#ifdef DEBUG
-    if( DOLOG )
+    retVal = E_SUCCESS;
+
+    for( int pos = dataIndex; pos < dataIndex + len && retVal == E_SUCCESS; pos++ )
     {
-      Logger.Log(LOGLEVEL_DEBUG, (const char*) "wrong magic: %x should be %x\n", rdMagic, magic);
+      if( eccRegions > 0 && eccLocate( pos, &block, &isParity ) >= 0 )
+      {
+        retVal = E_NO_VIEW;
+      }
+    }
+
+    if( retVal == E_SUCCESS )
+    {
+      view.data = (const char*) memory;
+      view.length = len;
+      view.position = dataIndex;
+      view.generation = generation;
     }
-#endif // DEBUG
-#endif // USE_SIMPLE_LOG
   }
-  else
+
+  EE_READ_END;
+
+#ifdef USE_SIMPLE_LOG
+#ifdef DEBUG
+  if( DOLOG && retVal != E_SUCCESS )
   {
-    magic = rdMagic;
+    Logger.Log(LOGLEVEL_DEBUG, (const char*) "no view of %d bytes at %d\n", len, dataIndex);
   }
+#endif // DEBUG
+#endif // USE_SIMPLE_LOG
 
-  return(retVal);
+  return( retVal );
 }
 
 //
-// place a "magic" to the first byte in EEPROM
+// view of a field with a leading length like restoreString() returns
+// it - E_NO_VIEW if the device has no RAM copy, use restoreString() then
 //
-bool dsEeprom::validate()
+int dsEeprom::viewString( dsEepromView& view, int dataIndex, int maxLen )
 {
-    bool retVal = true;
-
-    if( blockSize > 0 && blockSize <= EEPROM_MAX_SIZE )
-    {
-        EEPROM.write( EEPROM_POS_MAGIC, magic );
-        this->crc32Old = crc( EEPROM_STD_DATA_BEGIN, this->blockSize );
-        this->crc32New = this->crc32Old;
-        storeRaw( (char*) &this->crc32Old, EEPROM_MAXLEN_CRC32, EEPROM_POS_CRC32 );
+  int retVal = E_NO_VIEW;
+  short len = 0;
 
-#ifdef ESP8266
-    EEPROM.commit();
-#endif // ESP8266
+  EE_READ_BEGIN
 
+  if( (retVal = restoreFieldLength( (char*) &len, dataIndex )) == E_SUCCESS )
+  {
+    if( len < 0 )
+    {
+      len = 0;
     }
-    else
+
+    if( len > maxLen )
     {
-        status |= EE_STATUS_INVALID_SIZE;
+      len = maxLen;
     }
 
-    return(retVal);
+    retVal = viewRaw( view, dataIndex + EEPROM_LEADING_LENGTH, len );
+  }
+
+  EE_READ_END;
+
+  return( retVal );
+}
+
+//
+// false if the bytes of the view may have changed since it was taken
+//
+bool dsEeprom::isCurrent( const dsEepromView& view )
+{
+  bool retVal = false;
+
+  EE_READ_BEGIN
+
+  retVal = view.data != NULL && view.generation == generation &&
+           device->memory( base + view.position, view.length ) == (const unsigned char*) view.data;
+
+  EE_READ_END;
+
+  return( retVal );
+}
+
+//
+// ************************************************************************
+// secret fields (see dsEepromCipher.h)
+// ************************************************************************
+//
+
+//
+// key for storeSecret() and restoreSecret(), 32 bytes that stay owned
+// by the caller and must not change while used. NULL: no key.
+//
+void dsEeprom::setSecretKey( const unsigned char* key )
+{
+  EE_WRITE_GUARD;
+
+  secretKey = key;
+}
+
+//
+// EEPROM_CIPHER_COUNTER_SIZE bytes of the device at address (outside
+// of the partition) for the counter of storeSecret(). It only grows:
+// wipe(), rollback(), importImage() or applyPatch() may put an older
+// field back, but not its counter. A device that commits whole can lose
+// it together with the image, use setSecretCounter() with another
+// device there.
+//
+int dsEeprom::setSecretCounter( unsigned int address )
+{
+  return( setSecretCounter( *device, address ) );
+}
+
+int dsEeprom::setSecretCounter( dsEepromDevice& counterDevice, unsigned int address )
+{
+  EE_WRITE_GUARD;
+
+  if( (status & EE_STATUS_INVALID_SIZE) || device == &stage || &counterDevice == &stage )
+  {
+    return( E_BAD_TXN );
+  }
+
+  if( (&counterDevice == device &&
+       (device->commitsWhole() ||
+        (address < base + blockSize && address + EEPROM_CIPHER_COUNTER_SIZE > base))) ||
+      address + EEPROM_CIPHER_COUNTER_SIZE > counterDevice.capacity() ||
+      counterDevice.begin( address + EEPROM_CIPHER_COUNTER_SIZE ) != E_SUCCESS )
+  {
+    return( E_BAD_REGION );
+  }
+
+  secretDevice = &counterDevice;
+  secretCounter = address;
+
+  return( E_SUCCESS );
+}
+
+void dsEeprom::secretNonce( unsigned char* nonce, int dataIndex, uint32_t counter )
+{
+  uint32_t address = base + dataIndex;
+
+  for( int i = 0; i < 4; i++ )
+  {
+    nonce[i] = (address >> (8 * i)) & 0xff;
+    nonce[4 + i] = (counter >> (8 * i)) & 0xff;
+  }
+
+  nonce[8] = 'd';
+  nonce[9] = 's';
+  nonce[10] = 'E';
+  nonce[11] = 'E';
+}
+
+//
+// store data encrypted and authenticated, maxLen is the max. length of
+// the plain text, the field needs EEPROM_SECRET_OVERHEAD bytes more.
+// E_BAD_SECRET without a key or without setSecretCounter().
+//
+int dsEeprom::storeSecret( String data, int maxLen, int dataIndex )
+{
+  int retVal = 0;
+  dsEepromCipher cipher;
+  unsigned char nonce[EEPROM_CIPHER_NONCE_SIZE];
+  unsigned char tag[EEPROM_CIPHER_TAG_SIZE];
+  unsigned char stored[EEPROM_CIPHER_COUNTER_SIZE];
+  const char *text = data.c_str();
+  uint32_t counter;
+  uint32_t last;
+  short len;
+  int pos;
+
+  EE_WRITE_GUARD;
+
+  if( status & EE_STATUS_INVALID_SIZE )
+  {
+#ifdef USE_SIMPLE_LOG
+#ifdef DEBUG
+    if( DOLOG )
+    {
+      Logger.Log(LOGLEVEL_DEBUG, (const char*) "eeprom has status EE_STATUS_INVALID_SIZE\n");
+    }
+#endif // DEBUG
+#endif // USE_SIMPLE_LOG
+  }
+  else if( secretKey == NULL || secretDevice == NULL || maxLen < 0 )
+  {
+    retVal = E_BAD_SECRET;
+  }
+  else if( !stageRoom( dataIndex, EEPROM_LEADING_LENGTH + EEPROM_CIPHER_COUNTER_SIZE +
+                      (data.length() <= (unsigned int) maxLen ? data.length() : maxLen) +
+                      EEPROM_CIPHER_TAG_SIZE ) )
+  {
+    retVal = E_BAD_TXN;
+  }
+  else
+  {
+    len = data.length() <= (unsigned int) maxLen ? data.length() : maxLen;
+    pos = dataIndex + EEPROM_LEADING_LENGTH;
+
+    //
+    // the next counter is above the one of the device and the one of
+    // the field (stored before there was a device counter); erased
+    // bytes count as 0
+    //
+    readBlock( pos, stored, EEPROM_CIPHER_COUNTER_SIZE );
+    counter = (uint32_t) stored[0] | ((uint32_t) stored[1] << 8) |
+              ((uint32_t) stored[2] << 16) | ((uint32_t) stored[3] << 24);
+    for( int i = 0; i < EEPROM_CIPHER_COUNTER_SIZE; i++ )
+    {
+      stored[i] = secretDevice->read( secretCounter + i );
+    }
+    last = (uint32_t) stored[0] | ((uint32_t) stored[1] << 8) |
+           ((uint32_t) stored[2] << 16) | ((uint32_t) stored[3] << 24);
+    if( counter == 0xffffffffUL )
+    {
+      counter = 0;
+    }
+    if( last != 0xffffffffUL && last > counter )
+    {
+      counter = last;
+    }
+    counter++;
+
+    //
+    // the new counter first, on the device at once and outside of any
+    // transaction - a key stream is not used twice even if the power
+    // fails during the store. The high byte goes first, so a counter
+    // cut in between is still above all used ones.
+    //
+    for( int i = EEPROM_CIPHER_COUNTER_SIZE - 1; i >= 0; i-- )
+    {
+      secretDevice->write( secretCounter + i, (counter >> (8 * i)) & 0xff );
+    }
+
+    //
+    // no store with a counter that did not reach the device
+    //
+    if( (retVal = commitTo( secretDevice )) == E_SUCCESS )
+    {
+      storeFieldLength( (char*) &len, dataIndex );
+      for( int i = 0; i < EEPROM_CIPHER_COUNTER_SIZE; i++ )
+      {
+        writeByte( pos + i, (counter >> (8 * i)) & 0xff );
+      }
+      stepCommit();
+
+      secretNonce( nonce, dataIndex, counter );
+      dsEepromCipherInit( &cipher, secretKey, nonce, (const uint8_t*) &len, EEPROM_LEADING_LENGTH );
+
+      pos += EEPROM_CIPHER_COUNTER_SIZE;
+      for( int i = 0; i < len; i++ )
+      {
+        writeByte( pos + i, dsEepromCipherEncrypt( &cipher, text[i] ) );
+      }
+
+      dsEepromCipherTag( &cipher, tag );
+      for( int i = 0; i < EEPROM_CIPHER_TAG_SIZE; i++ )
+      {
+        writeByte( pos + len + i, tag[i] );
+      }
+
+      dsEepromCipherWipe( &cipher );
+    }
+
+#ifdef USE_SIMPLE_LOG
+#ifdef DEBUG
+    if( DOLOG )
+    {
+      Logger.Log(LOGLEVEL_DEBUG, (const char*) "stored secret of %d bytes at %d, counter %lu\n",
+                 len, dataIndex, (unsigned long) counter);
+    }
+#endif // DEBUG
+#endif // USE_SIMPLE_LOG
+  }
+
+  return(retVal);
+}
+
+//
+// decrypt a secret on the way into data, E_BAD_SECRET and an empty
+// data if there is no key or the field is not authentic. The whole
+// field is checked, data gets at most maxLen bytes of it as with
+// restoreString()
+//
+int dsEeprom::restoreSecret( String& data, int dataIndex, int maxLen )
+{
+  int retVal = 0;
+  dsEepromCipher cipher;
+  unsigned char buffer[EEPROM_READ_CHUNK];
+  unsigned char nonce[EEPROM_CIPHER_NONCE_SIZE];
+  unsigned char tag[EEPROM_CIPHER_TAG_SIZE];
+  unsigned char stored[EEPROM_CIPHER_TAG_SIZE];
+  short len = 0;
+  int chunk;
+  int pos;
+
+  EE_READ_BEGIN
+  retVal = 0;
+  data = "";
+
+  if( status & EE_STATUS_INVALID_SIZE )
+  {
+#ifdef USE_SIMPLE_LOG
+#ifdef DEBUG
+    if( DOLOG )
+    {
+      Logger.Log(LOGLEVEL_DEBUG, (const char*) "eeprom has status EE_STATUS_INVALID_SIZE\n");
+    }
+#endif // DEBUG
+#endif // USE_SIMPLE_LOG
+  }
+  else if( secretKey == NULL || restoreFieldLength( (char*) &len, dataIndex ) != 0 ||
+           len < 0 || maxLen < 0 ||
+           dataIndex + EEPROM_LEADING_LENGTH + EEPROM_SECRET_OVERHEAD + len > blockSize )
+  {
+    retVal = E_BAD_SECRET;
+  }
+  else
+  {
+    pos = dataIndex + EEPROM_LEADING_LENGTH;
+    readBlock( pos, stored, EEPROM_CIPHER_COUNTER_SIZE );
+    secretNonce( nonce, dataIndex, (uint32_t) stored[0] | ((uint32_t) stored[1] << 8) |
+                 ((uint32_t) stored[2] << 16) | ((uint32_t) stored[3] << 24) );
+    dsEepromCipherInit( &cipher, secretKey, nonce, (const uint8_t*) &len, EEPROM_LEADING_LENGTH );
+
+    pos += EEPROM_CIPHER_COUNTER_SIZE;
+    for( int i = 0; i < len; i += chunk )
+    {
+      chunk = len - i < EEPROM_READ_CHUNK ? len - i : EEPROM_READ_CHUNK;
+      readBlock( pos + i, buffer, chunk );
+
+      for( int j = 0; j < chunk; j++ )
+      {
+        buffer[j] = dsEepromCipherDecrypt( &cipher, buffer[j] );
+        if( i + j < maxLen )
+        {
+          data += (char) buffer[j];
+        }
+      }
+    }
+
+    dsEepromCipherTag( &cipher, tag );
+    readBlock( pos + len, stored, EEPROM_CIPHER_TAG_SIZE );
+
+    if( !dsEepromCipherTagEqual( tag, stored ) )
+    {
+      data = "";
+      retVal = E_BAD_SECRET;
+#ifdef USE_SIMPLE_LOG
+#ifdef DEBUG
+      if( DOLOG )
+      {
+        Logger.Log(LOGLEVEL_DEBUG, (const char*) "secret at %d is not authentic\n", dataIndex);
+      }
+#endif // DEBUG
+#endif // USE_SIMPLE_LOG
+    }
+
+    dsEepromCipherWipe( &cipher );
+    memset( buffer, 0, sizeof(buffer) );
+  }
+
+  EE_READ_END;
+
+  return(retVal);
+}
+
+//
+// check whether first byte in EEPROM is "magic"
+//
+bool dsEeprom::isValid()
+{
+  bool retVal = true;
+  unsigned char rdMagic;
+
+  EE_READ_BEGIN
+  retVal = true;
+
+  if( magic == 0 || (rdMagic = readByte( EEPROM_POS_MAGIC )) !=  magic ||
+      (readVersion() & (EEPROM_VERSION_MIGRATING | EEPROM_VERSION_FINISHING)) )
+  {
+    retVal = false;
+#ifdef USE_SIMPLE_LOG
+#ifdef DEBUG
+    if( DOLOG )
+    {
+      Logger.Log(LOGLEVEL_DEBUG, (const char*) "wrong magic: %x should be %x\n", rdMagic, magic);
+    }
+#endif // DEBUG
+#endif // USE_SIMPLE_LOG
+  }
+
+  EE_READ_END;
+
+  return(retVal);
+}
+
+//
+// place a "magic" to the first byte in EEPROM
+// with auto commit (see setAutoCommit()) this is done by autoCommit()
+// or flush() later on
+//
+bool dsEeprom::validate()
+{
+    EE_WRITE_GUARD;
+
+    if( (autoIdle > 0 || autoDeadline > 0) && !(status & EE_STATUS_INVALID_SIZE) )
+    {
+        status |= EE_STATUS_MODIFIED;
+        status &= ~EE_STATUS_COMMITED;
+        return( true );
+    }
+
+    return( validateNow() );
+}
+
+bool dsEeprom::validateNow( void )
+{
+    bool retVal = true;
+
+    EE_WRITE_GUARD;
+
+    if( blockSize > 0 && base + blockSize <= device->capacity() )
+    {
+        writeByte( EEPROM_POS_MAGIC, magic );
+        writeVersion( schemaVersion );
+        this->crc32Old = crc( EEPROM_STD_DATA_BEGIN, this->blockSize );
+        this->crc32New = this->crc32Old;
+        storeRaw( (char*) &this->crc32Old, EEPROM_MAXLEN_CRC32, EEPROM_POS_CRC32 );
+
+        if( commitDevice() != E_SUCCESS )
+        {
+            retVal = false;
+        }
+        status &= ~EE_STATUS_MODIFIED;
+        status |= EE_STATUS_COMMITED;
+    }
+    else
+    {
+        status |= EE_STATUS_INVALID_SIZE;
+    }
+
+    return(retVal);
+}
+
+//
+// ************************************************************************
+// auto commit
+// ************************************************************************
+//
+// Changes are committed when no store came for idle ms or at the
+// latest deadline ms after the first change, whichever comes first.
+// So a burst of stores ends up in one commit (one sector write on an
+// ESP8266). Zero turns a limit off, both zero turn auto commit off.
+// Changes that are pending when auto commit is turned off are stored
+// by the next validate() or flush().
+//
+void dsEeprom::setAutoCommit( unsigned long idle, unsigned long deadline )
+{
+  EE_WRITE_GUARD;
+
+  autoIdle = idle;
+  autoDeadline = deadline;
+  autoPending = false;
+}
+
+//
+// to be called from loop(): stores the checksum and commits if a limit
+// is reached. The clock runs from the first call that sees a change.
+//
+int dsEeprom::autoCommit( void )
+{
+  unsigned long now;
+
+  EE_WRITE_GUARD;
+
+  if( !(status & EE_STATUS_MODIFIED) || (autoIdle == 0 && autoDeadline == 0) ||
+      device == &stage )
+  {
+    autoPending = false;
+    return( E_SUCCESS );
+  }
+
+  now = millis();
+
+  if( !autoPending )
+  {
+    autoPending = true;
+    autoFirst = now;
+    autoLast = now;
+    autoGeneration = generation;
+    return( E_SUCCESS );
+  }
+
+  if( autoGeneration != generation )
+  {
+    autoGeneration = generation;
+    autoLast = now;
+  }
+
+  if( (autoIdle > 0 && now - autoLast >= autoIdle) ||
+      (autoDeadline > 0 && now - autoFirst >= autoDeadline) )
+  {
+    return( flush() ? E_SUCCESS : E_DEVICE_IO );
+  }
+
+  return( E_SUCCESS );
+}
+
+//
+// store and commit pending changes now, e.g. before a shutdown
+//
+bool dsEeprom::flush( void )
+{
+  EE_WRITE_GUARD;
+
+  autoPending = false;
+
+  if( !(status & EE_STATUS_MODIFIED) )
+  {
+    return( true );
+  }
+
+  return( validateNow() );
 }
 
 void dsEeprom::setBlocksize( unsigned int newSize )
 {
-  if( newSize > 0 && newSize <= EEPROM_MAX_SIZE )
+  if( newSize > 0 && base + newSize <= device->capacity() )
   {
     blockSize = newSize;
   }
@@ -913,6 +1834,916 @@ unsigned char dsEeprom::version2Magic( void )
   return( EEPROM_MAGIC_BYTE );
 }
 
+//
+// ************************************************************************
+// schema versions and migration
+// ************************************************************************
+//
+// A migration has to survive a power loss at any byte written, so
+// every update of its state changes exactly one byte:
+//
+// - the source version goes to the first half of the crc field and a
+//   counter of the operations done (gray coded, so one bit changes per
+//   operation) to the second half, then EEPROM_VERSION_MIGRATING is set
+//   in the high byte of the version
+// - copying a chunk of a field and finishing a field (fill, length)
+//   are operations. An operation interrupted by a power loss is simply
+//   done again - a chunk is never larger than the distance of source
+//   and destination, so its source is still intact
+// - when all operations are done, the target version is written and
+//   marked with EEPROM_VERSION_FINISHING, then the crc is written and
+//   at last the flags are cleared
+//
 
+//
+// version of the layout this firmware writes - stored by validate()
+//
+void dsEeprom::setSchemaVersion( unsigned short version )
+{
+  schemaVersion = version & EEPROM_VERSION_MASK;
+}
 
+//
+// version of the stored content
+//
+unsigned short dsEeprom::getSchemaVersion( void )
+{
+  return( readVersion() & EEPROM_VERSION_MASK );
+}
 
+unsigned short dsEeprom::readVersion( void )
+{
+  unsigned short version;
+
+  version = readByte( EEPROM_POS_VERSION ) | (readByte( EEPROM_POS_VERSION + 1 ) << 8);
+
+  if( version == EEPROM_VERSION_NONE )
+  {
+    version = 0;
+  }
+
+  return( version );
+}
+
+void dsEeprom::writeVersion( unsigned short version )
+{
+  updateByte( EEPROM_POS_VERSION, version & 0xff );
+  updateByte( EEPROM_POS_VERSION + 1, (version >> 8) & 0xff );
+}
+
+//
+// write a byte only if it differs from the stored one
+//
+void dsEeprom::updateByte( int pos, unsigned char value )
+{
+  if( readByte( pos ) != value )
+  {
+    writeByte( pos, value );
+  }
+}
+
+//
+// make progress persistent - pointless if the device rewrites its
+// whole image on commit anyway
+//
+void dsEeprom::stepCommit( void )
+{
+  if( !device->commitsWhole() )
+  {
+    commitTo( device );
+  }
+}
+
+static unsigned short toGray( unsigned short value )
+{
+  return( value ^ (value >> 1) );
+}
+
+static unsigned short fromGray( unsigned short gray )
+{
+  for( unsigned short shift = gray >> 1; shift != 0; shift >>= 1 )
+  {
+    gray ^= shift;
+  }
+
+  return( gray );
+}
+
+void dsEeprom::writeProgress( unsigned short operations )
+{
+  unsigned short gray = toGray( operations );
+
+  //
+  // the moved bytes first, a buffered device may program the bytes of
+  // one commit in any order
+  //
+  stepCommit();
+  updateByte( EEPROM_POS_CRC32 + 2, gray & 0xff );
+  updateByte( EEPROM_POS_CRC32 + 3, (gray >> 8) & 0xff );
+  stepCommit();
+}
+
+int dsEeprom::findStep( const dsEepromMigration* steps, int count, unsigned short version )
+{
+  for( int i = 0; i < count; i++ )
+  {
+    if( steps[i].fromVersion == version )
+    {
+      return( i );
+    }
+  }
+
+  return( -1 );
+}
+
+//
+// run the steps from version source up to the schema version, the
+// first startOp operations are done already
+//
+void dsEeprom::runMigration( const dsEepromMigration* steps, int count,
+                             unsigned short source, unsigned short startOp )
+{
+  const dsEepromFieldMove *mv;
+  unsigned short operation = 0;
+  unsigned short version;
+  unsigned short length;
+  unsigned short distance;
+  unsigned short chunk;
+  unsigned short done;
+  short fieldLen;
+  int step;
+  int i;
+
+  for( version = source; version != schemaVersion; version = steps[step].toVersion )
+  {
+    step = findStep( steps, count, version );
+
+    for( int move = 0; move < steps[step].count; move++ )
+    {
+      mv = &steps[step].moves[move];
+      length = mv->oldLen < mv->newLen ? mv->oldLen : mv->newLen;
+      distance = mv->to > mv->from ? mv->to - mv->from : mv->from - mv->to;
+
+      for( done = 0; distance > 0 && done < length; done += chunk, operation++ )
+      {
+        chunk = distance < EEPROM_MIGRATE_CHUNK ? distance : EEPROM_MIGRATE_CHUNK;
+        if( chunk > length - done )
+        {
+          chunk = length - done;
+        }
+
+        if( operation < startOp )
+        {
+          continue;
+        }
+
+        if( mv->to < mv->from )
+        {
+          for( i = done; i < done + chunk; i++ )
+          {
+            updateByte( mv->to + i, readByte( mv->from + i ) );
+          }
+        }
+        else
+        {
+          for( i = length - done - 1; i >= length - done - chunk; i-- )
+          {
+            updateByte( mv->to + i, readByte( mv->from + i ) );
+          }
+        }
+
+        writeProgress( operation + 1 );
+      }
+
+      if( operation >= startOp )
+      {
+        for( i = length; i < mv->newLen; i++ )
+        {
+          updateByte( mv->to + i, 0 );
+        }
+
+        if( (mv->flags & EE_MOVE_PREFIXED) && mv->newLen >= EEPROM_LEADING_LENGTH )
+        {
+          fieldLen = readByte( mv->to ) | (readByte( mv->to + 1 ) << 8);
+          if( fieldLen > mv->newLen - EEPROM_LEADING_LENGTH )
+          {
+            fieldLen = mv->newLen - EEPROM_LEADING_LENGTH;
+            updateByte( mv->to, fieldLen & 0xff );
+            updateByte( mv->to + 1, (fieldLen >> 8) & 0xff );
+          }
+        }
+
+        writeProgress( operation + 1 );
+      }
+
+      operation++;
+    }
+  }
+}
+
+//
+// store the checksum over the migrated data, then clear the flags
+// A device that commits whole has the whole migration in this commit,
+// the migrated image goes to the journal first: a power loss before
+// the journal is done leaves the old image (the migration starts
+// over), one after it is completed by setJournal() on the next boot.
+//
+int dsEeprom::finishMigration( void )
+{
+  bool whole = device->commitsWhole() && journalLength > 0;
+
+  this->crc32Old = crc( EEPROM_STD_DATA_BEGIN, this->blockSize );
+  this->crc32New = this->crc32Old;
+
+  for( int i = 0; i < EEPROM_MAXLEN_CRC32; i++ )
+  {
+    updateByte( EEPROM_POS_CRC32 + i, (this->crc32Old >> (8 * i)) & 0xff );
+  }
+  stepCommit();
+
+  updateByte( EEPROM_POS_VERSION + 1, (schemaVersion >> 8) & 0xff );
+
+  if( whole )
+  {
+    //
+    // an empty stage reads the image of the device
+    //
+    stage.open( device, base );
+    if( writeJournal( NULL, 0, true, this->crc32Old, this->crc32Old ) != E_SUCCESS )
+    {
+      return( E_DEVICE_IO );
+    }
+  }
+
+  if( commitTo( device ) != E_SUCCESS )
+  {
+    return( E_DEVICE_IO );
+  }
+
+  if( whole )
+  {
+    journalByte( EEPATCH_POS_MAGIC, 0 );
+    commitTo( journalDevice );
+  }
+
+  status &= ~EE_STATUS_MODIFIED;
+
+  return( E_SUCCESS );
+}
+
+//
+// migrate stored content step by step up to the schema version set by
+// setSchemaVersion(). Only bytes that change are written. An
+// interrupted migration is continued on the next call.
+//
+int dsEeprom::migrate( const dsEepromMigration* steps, int count )
+{
+  unsigned short stored;
+  unsigned short source;
+  unsigned short startOp = 0;
+  int step = 0;
+  int hops = 0;
+
+  EE_WRITE_GUARD;
+
+  if( status & EE_STATUS_INVALID_SIZE )
+  {
+    return( E_NO_MIGRATION );
+  }
+
+  stored = readVersion();
+
+  if( stored & EEPROM_VERSION_FINISHING )
+  {
+    if( (stored & EEPROM_VERSION_MASK) != schemaVersion )
+    {
+      return( E_NO_MIGRATION );
+    }
+
+    return( finishMigration() );
+  }
+
+  if( stored & EEPROM_VERSION_MIGRATING )
+  {
+    source = readByte( EEPROM_POS_CRC32 ) | (readByte( EEPROM_POS_CRC32 + 1 ) << 8);
+    startOp = fromGray( readByte( EEPROM_POS_CRC32 + 2 ) | (readByte( EEPROM_POS_CRC32 + 3 ) << 8) );
+  }
+  else
+  {
+    source = stored & EEPROM_VERSION_MASK;
+
+    if( source == schemaVersion )
+    {
+      return( E_SUCCESS );
+    }
+  }
+
+  //
+  // don't touch anything unless there is a way to the target - and a
+  // journal, if the device programs the migration in one commit
+  //
+  if( device->commitsWhole() && (journalLength == 0 || device == &stage) )
+  {
+    return( E_NO_MIGRATION );
+  }
+
+  for( unsigned short version = source; version != schemaVersion; version = steps[step].toVersion )
+  {
+    if( (step = findStep( steps, count, version )) < 0 || hops++ >= count )
+    {
+      return( E_NO_MIGRATION );
+    }
+  }
+
+  if( !(stored & EEPROM_VERSION_MIGRATING) )
+  {
+    updateByte( EEPROM_POS_CRC32, source & 0xff );
+    updateByte( EEPROM_POS_CRC32 + 1, (source >> 8) & 0xff );
+    writeProgress( 0 );
+    updateByte( EEPROM_POS_VERSION + 1, ((stored >> 8) & 0xff) | (EEPROM_VERSION_MIGRATING >> 8) );
+    stepCommit();
+  }
+
+  runMigration( steps, count, source, startOp );
+
+  updateByte( EEPROM_POS_VERSION, schemaVersion & 0xff );
+  stepCommit();
+  updateByte( EEPROM_POS_VERSION + 1, ((schemaVersion >> 8) & 0xff) |
+              ((EEPROM_VERSION_MIGRATING | EEPROM_VERSION_FINISHING) >> 8) );
+  stepCommit();
+
+  return( finishMigration() );
+}
+
+//
+// ************************************************************************
+// differential update
+// ************************************************************************
+//
+
+static unsigned long getPatchLong( const unsigned char* data )
+{
+  return( (unsigned long) data[0] | ((unsigned long) data[1] << 8) |
+          ((unsigned long) data[2] << 16) | ((unsigned long) data[3] << 24) );
+}
+
+//
+// apply a patch (see dsEepromPatch.h) to the image
+// The first pass checks the runs and computes the new checksum from
+// the changed bytes alone - nothing is written unless it matches the
+// target checksum of the patch. The second pass writes the bytes that
+// differ, then the checksum, and commits once.
+//
+int dsEeprom::applyPatch( const unsigned char* patch, unsigned int len )
+{
+  unsigned char stored[EEPROM_MAXLEN_CRC32];
+  unsigned long baseCrc;
+  unsigned long targetCrc;
+  unsigned long current;
+  uint32_t delta = 0;
+  unsigned int pos;
+  unsigned int offset;
+  unsigned int runLen;
+  unsigned int previous;
+  unsigned char diff;
+  int pass;
+
+  EE_WRITE_GUARD;
+
+  if( (status & EE_STATUS_INVALID_SIZE) || len < EEPATCH_HEADER_SIZE ||
+      patch[EEPATCH_POS_MAGIC] != EEPATCH_MAGIC_0 ||
+      patch[EEPATCH_POS_MAGIC + 1] != EEPATCH_MAGIC_1 ||
+      patch[EEPATCH_POS_VERSION] != EEPATCH_VERSION ||
+      (patch[EEPATCH_POS_SIZE] | (patch[EEPATCH_POS_SIZE + 1] << 8)) != blockSize )
+  {
+    return( E_BAD_PATCH );
+  }
+
+  baseCrc = getPatchLong( &patch[EEPATCH_POS_BASE_CRC] );
+  targetCrc = getPatchLong( &patch[EEPATCH_POS_TARGET_CRC] );
+
+  //
+  // after stores without validate() the stored checksum does not
+  // describe the image, the image itself has to be the base then
+  //
+  if( status & EE_STATUS_MODIFIED )
+  {
+    current = crc( EEPROM_STD_DATA_BEGIN, blockSize ) & 0xffffffffUL;
+  }
+  else
+  {
+    readBlock( EEPROM_POS_CRC32, stored, EEPROM_MAXLEN_CRC32 );
+    current = getPatchLong( stored );
+  }
+
+  if( current != baseCrc )
+  {
+    return( E_BAD_CRC );
+  }
+
+  for( pass = 0; pass < 2; pass++ )
+  {
+    previous = EEPROM_STD_DATA_BEGIN;
+
+    for( pos = EEPATCH_HEADER_SIZE; pos < len; pos += EEPATCH_RUN_HEADER + runLen )
+    {
+      if( pos + EEPATCH_RUN_HEADER > len )
+      {
+        return( E_BAD_PATCH );
+      }
+
+      offset = patch[pos] | (patch[pos + 1] << 8);
+      runLen = patch[pos + 2] | (patch[pos + 3] << 8);
+
+      if( offset < previous || offset + runLen > (unsigned int) blockSize ||
+          pos + EEPATCH_RUN_HEADER + runLen > len )
+      {
+        return( E_BAD_PATCH );
+      }
+
+      if( pass == 0 )
+      {
+        delta = dsEepromCrcShift( delta, offset - previous );
+        for( unsigned int i = 0; i < runLen; i++ )
+        {
+          diff = readByte( offset + i ) ^ patch[pos + EEPATCH_RUN_HEADER + i];
+          delta = dsEepromCrcRaw( delta, &diff, 1 );
+        }
+      }
+      else
+      {
+        for( unsigned int i = 0; i < runLen; i++ )
+        {
+          updateByte( offset + i, patch[pos + EEPATCH_RUN_HEADER + i] );
+        }
+      }
+
+      previous = offset + runLen;
+    }
+
+    if( pass == 0 )
+    {
+      //
+      // the checksum range is blockSize bytes from EEPROM_STD_DATA_BEGIN
+      //
+      delta = dsEepromCrcShift( delta, EEPROM_STD_DATA_BEGIN + blockSize - previous );
+
+      if( ((baseCrc ^ delta) & 0xffffffffUL) != targetCrc )
+      {
+        return( E_BAD_CRC );
+      }
+    }
+  }
+
+  this->crc32Old = targetCrc;
+  this->crc32New = targetCrc;
+
+  for( int i = 0; i < EEPROM_MAXLEN_CRC32; i++ )
+  {
+    updateByte( EEPROM_POS_CRC32 + i, (targetCrc >> (8 * i)) & 0xff );
+  }
+
+  commitDevice();
+  status &= ~EE_STATUS_MODIFIED;
+  status |= EE_STATUS_COMMITED;
+
+  return( E_SUCCESS );
+}
+
+//
+// ************************************************************************
+// error correction
+// ************************************************************************
+//
+
+//
+// protect length bytes from begin with check bytes at parity (see
+// EEPROM_ECC_PARITY_LEN()). Reads of the region are corrected, writes
+// update the check bytes. The check bytes of an image that has been
+// written without them are built by rebuildEcc().
+//
+int dsEeprom::addEccRegion( int begin, int length, int parity )
+{
+  int parityLen = EEPROM_ECC_PARITY_LEN( length );
+  int otherParityLen;
+
+  EE_WRITE_GUARD;
+
+  if( eccRegions >= EEPROM_ECC_MAX_REGIONS || length <= 0 ||
+      begin < EEPROM_STD_DATA_BEGIN || begin + length > blockSize ||
+      parity < EEPROM_STD_DATA_BEGIN || parity + parityLen > blockSize ||
+      (parity < begin + length && begin < parity + parityLen) )
+  {
+    return( E_BAD_REGION );
+  }
+
+  for( int i = 0; i < eccRegions; i++ )
+  {
+    otherParityLen = EEPROM_ECC_PARITY_LEN( eccRegion[i].length );
+
+    if( (begin < eccRegion[i].begin + eccRegion[i].length && eccRegion[i].begin < begin + length) ||
+        (begin < eccRegion[i].parity + otherParityLen && eccRegion[i].parity < begin + length) ||
+        (parity < eccRegion[i].begin + eccRegion[i].length && eccRegion[i].begin < parity + parityLen) ||
+        (parity < eccRegion[i].parity + otherParityLen && eccRegion[i].parity < parity + parityLen) )
+    {
+      return( E_BAD_REGION );
+    }
+  }
+
+  eccRegion[eccRegions].begin = begin;
+  eccRegion[eccRegions].length = length;
+  eccRegion[eccRegions].parity = parity;
+  eccRegions++;
+
+  return( E_SUCCESS );
+}
+
+//
+// region and block of a position, -1 if it is not protected
+//
+int dsEeprom::eccLocate( int pos, int* block, bool* isParity )
+{
+  for( int i = 0; i < eccRegions; i++ )
+  {
+    if( pos >= eccRegion[i].begin && pos < eccRegion[i].begin + eccRegion[i].length )
+    {
+      *block = (pos - eccRegion[i].begin) / EEPROM_ECC_BLOCK;
+      *isParity = false;
+      return( i );
+    }
+
+    if( pos >= eccRegion[i].parity &&
+        pos < eccRegion[i].parity + EEPROM_ECC_PARITY_LEN( eccRegion[i].length ) )
+    {
+      *block = pos - eccRegion[i].parity;
+      *isParity = true;
+      return( i );
+    }
+  }
+
+  return( -1 );
+}
+
+//
+// read and check a block, the last block of a region may be short and
+// is filled up with zeros. With repair corrected bytes are written back.
+//
+int dsEeprom::eccBlock( int region, int block, unsigned char* data, unsigned char* check, bool repair )
+{
+  unsigned char original[EEPROM_ECC_BLOCK];
+  unsigned char originalCheck;
+  int pos = eccRegion[region].begin + block * EEPROM_ECC_BLOCK;
+  int len = eccRegion[region].begin + eccRegion[region].length - pos;
+  int retVal;
+
+  if( len > EEPROM_ECC_BLOCK )
+  {
+    len = EEPROM_ECC_BLOCK;
+  }
+
+  memset( data, 0, EEPROM_ECC_BLOCK );
+  device->readBlock( base + pos, data, len );
+  *check = device->read( base + eccRegion[region].parity + block );
+
+  memcpy( original, data, EEPROM_ECC_BLOCK );
+  originalCheck = *check;
+
+  retVal = dsEepromEccCorrect( data, check );
+
+  for( int i = len; i < EEPROM_ECC_BLOCK && retVal == EEPROM_ECC_CORRECTED; i++ )
+  {
+    if( data[i] != 0 )
+    {
+      //
+      // a "correction" of the filling - more than one bit is wrong
+      //
+      memcpy( data, original, EEPROM_ECC_BLOCK );
+      *check = originalCheck;
+      retVal = EEPROM_ECC_UNCORRECTABLE;
+    }
+  }
+
+  if( retVal == EEPROM_ECC_CORRECTED )
+  {
+    status |= EE_STATUS_ECC_CORRECTED;
+
+    if( repair )
+    {
+      for( int i = 0; i < len; i++ )
+      {
+        if( data[i] != original[i] )
+        {
+          device->write( base + pos + i, data[i] );
+        }
+      }
+
+      if( *check != originalCheck )
+      {
+        device->write( base + eccRegion[region].parity + block, *check );
+      }
+    }
+  }
+  else if( retVal == EEPROM_ECC_UNCORRECTABLE )
+  {
+    status |= EE_STATUS_ECC_FAILED;
+  }
+
+  return( retVal );
+}
+
+//
+// correct the protected bytes of a block read from the device
+//
+void dsEeprom::eccPatch( int pos, unsigned char* data, int len )
+{
+  unsigned char block[EEPROM_ECC_BLOCK];
+  unsigned char check = 0;
+  int lastRegion = -1;
+  int lastBlock = -1;
+  int region;
+  int index;
+  bool isParity;
+
+  for( int i = 0; i < len; i++ )
+  {
+    if( (region = eccLocate( pos + i, &index, &isParity )) < 0 )
+    {
+      continue;
+    }
+
+    //
+    // a block is checked once, no matter how many of its bytes
+    // (and its check byte) are read
+    //
+    if( region != lastRegion || index != lastBlock )
+    {
+      eccBlock( region, index, block, &check, false );
+      lastRegion = region;
+      lastBlock = index;
+    }
+
+    data[i] = isParity ? check : block[(pos + i - eccRegion[region].begin) % EEPROM_ECC_BLOCK];
+
+    //
+    // data and check byte of a block are not near each other, check
+    // the block again when the other part is reached
+    //
+    if( isParity )
+    {
+      lastBlock = -1;
+    }
+  }
+}
+
+//
+// compute all check bytes from the content as it is
+//
+int dsEeprom::rebuildEcc( void )
+{
+  unsigned char data[EEPROM_ECC_BLOCK];
+  unsigned char check;
+  int pos;
+  int len;
+
+  EE_WRITE_GUARD;
+
+  for( int region = 0; region < eccRegions; region++ )
+  {
+    for( int block = 0; block < EEPROM_ECC_PARITY_LEN( eccRegion[region].length ); block++ )
+    {
+      pos = eccRegion[region].begin + block * EEPROM_ECC_BLOCK;
+      len = eccRegion[region].begin + eccRegion[region].length - pos;
+
+      memset( data, 0, EEPROM_ECC_BLOCK );
+      device->readBlock( base + pos, data, len < EEPROM_ECC_BLOCK ? len : EEPROM_ECC_BLOCK );
+
+      check = dsEepromEccEncode( data );
+      if( device->read( base + eccRegion[region].parity + block ) != check )
+      {
+        device->write( base + eccRegion[region].parity + block, check );
+      }
+    }
+  }
+
+  commitDevice();
+
+  return( E_SUCCESS );
+}
+
+//
+// check all protected blocks and write back what has been corrected,
+// returns the number of corrected blocks or E_BAD_ECC
+//
+int dsEeprom::scrubEcc( void )
+{
+  unsigned char data[EEPROM_ECC_BLOCK];
+  unsigned char check;
+  int corrected = 0;
+  bool failed = false;
+  int result;
+
+  EE_WRITE_GUARD;
+
+  for( int region = 0; region < eccRegions; region++ )
+  {
+    for( int block = 0; block < EEPROM_ECC_PARITY_LEN( eccRegion[region].length ); block++ )
+    {
+      if( (result = eccBlock( region, block, data, &check, true )) == EEPROM_ECC_CORRECTED )
+      {
+        corrected++;
+      }
+      else if( result == EEPROM_ECC_UNCORRECTABLE )
+      {
+        failed = true;
+      }
+    }
+  }
+
+  if( corrected > 0 )
+  {
+    commitDevice();
+  }
+
+  return( failed ? E_BAD_ECC : corrected );
+}
+
+//
+// ************************************************************************
+// background scrubber
+// ************************************************************************
+//
+
+void dsEeprom::scrubReset( void )
+{
+  scrubInfo.lastFullPass = 0;
+  scrubInfo.passes = 0;
+  scrubInfo.bytesPerSecond = 0;
+  scrubInfo.position = 0;
+  scrubInfo.corrected = 0;
+  scrubInfo.mismatches = 0;
+  scrubCrc = EEPROM_CRC_INIT;
+  scrubGeneration = 0;
+  scrubStart = 0;
+}
+
+void dsEeprom::setScrubSlice( unsigned int bytes )
+{
+  scrubSlice = bytes > 0 ? bytes : EEPROM_SCRUB_SLICE;
+}
+
+void dsEeprom::getScrubInfo( dsEepromScrubInfo* info )
+{
+  EE_READ_BEGIN
+
+  *info = scrubInfo;
+
+  EE_READ_END;
+}
+
+//
+// write back the corrected blocks of a range, returns the number of
+// repaired blocks or E_BAD_ECC
+//
+int dsEeprom::eccRepair( int pos, int len )
+{
+  unsigned char data[EEPROM_ECC_BLOCK];
+  unsigned char check;
+  int lastRegion = -1;
+  int lastBlock = -1;
+  int corrected = 0;
+  bool failed = false;
+  int region;
+  int block;
+  int result;
+  bool isParity;
+
+  for( int i = pos; i < pos + len; i++ )
+  {
+    if( (region = eccLocate( i, &block, &isParity )) < 0 ||
+        (region == lastRegion && block == lastBlock) )
+    {
+      continue;
+    }
+
+    if( (result = eccBlock( region, block, data, &check, true )) == EEPROM_ECC_CORRECTED )
+    {
+      corrected++;
+    }
+    else if( result == EEPROM_ECC_UNCORRECTABLE )
+    {
+      failed = true;
+    }
+
+    lastRegion = region;
+    lastBlock = block;
+  }
+
+  return( failed ? E_BAD_ECC : corrected );
+}
+
+//
+// to be called from loop(): checks the next slice of the image, so
+// the checksum is verified piece by piece without a stall. Protected
+// regions are repaired on the way. A pass that sees a write starts
+// over, a pass while the checksum is not yet stored is not judged.
+// Returns E_BAD_CRC at the end of a pass with a wrong checksum,
+// E_BAD_ECC for an uncorrectable block, else E_SUCCESS.
+//
+int dsEeprom::scrubStep( void )
+{
+  unsigned char buffer[EEPROM_READ_CHUNK];
+  unsigned char stored[EEPROM_MAXLEN_CRC32];
+  unsigned long elapsed;
+  unsigned int end;
+  int chunk;
+  int retVal = E_SUCCESS;
+
+  EE_WRITE_GUARD;
+
+  //
+  // the stage would mix staged changes into the check
+  //
+  if( (status & EE_STATUS_INVALID_SIZE) || device == &stage )
+  {
+    return( E_SUCCESS );
+  }
+
+  if( scrubInfo.position < EEPROM_STD_DATA_BEGIN || scrubGeneration != generation )
+  {
+    scrubInfo.position = EEPROM_STD_DATA_BEGIN;
+    scrubCrc = EEPROM_CRC_INIT;
+    scrubGeneration = generation;
+    scrubStart = millis();
+  }
+
+  end = scrubInfo.position + scrubSlice;
+  if( end > (unsigned int) blockSize )
+  {
+    end = blockSize;
+  }
+
+  if( eccRegions > 0 )
+  {
+    if( (chunk = eccRepair( scrubInfo.position, end - scrubInfo.position )) == E_BAD_ECC )
+    {
+      status &= ~EE_STATUS_SCRUB_PASSED;
+      retVal = E_BAD_ECC;
+    }
+    else if( chunk > 0 )
+    {
+      scrubInfo.corrected += chunk;
+      commitDevice();
+    }
+  }
+
+  for( ; scrubInfo.position < end; scrubInfo.position += chunk )
+  {
+    chunk = end - scrubInfo.position < EEPROM_READ_CHUNK ? end - scrubInfo.position : EEPROM_READ_CHUNK;
+    readBlock( scrubInfo.position, buffer, chunk );
+    scrubCrc = dsEepromCrcUpdate( scrubCrc, buffer, chunk );
+  }
+
+  if( scrubInfo.position < (unsigned int) blockSize )
+  {
+    return( retVal );
+  }
+
+  //
+  // pass complete - the checksum range ends EEPROM_STD_DATA_BEGIN bytes
+  // behind the image (see crc() and readPast())
+  //
+  scrubInfo.position = 0;
+
+  if( status & EE_STATUS_MODIFIED )
+  {
+    return( retVal );
+  }
+
+  readBlock( blockSize, buffer, EEPROM_STD_DATA_BEGIN );
+  scrubCrc = dsEepromCrcUpdate( scrubCrc, buffer, EEPROM_STD_DATA_BEGIN );
+  readBlock( EEPROM_POS_CRC32, stored, EEPROM_MAXLEN_CRC32 );
+
+  if( scrubCrc != ((uint32_t) stored[0] | ((uint32_t) stored[1] << 8) |
+                   ((uint32_t) stored[2] << 16) | ((uint32_t) stored[3] << 24)) )
+  {
+    status |= EE_STATUS_INVALID_CRC;
+    status &= ~EE_STATUS_SCRUB_PASSED;
+    scrubInfo.mismatches++;
+    retVal = E_BAD_CRC;
+  }
+  else
+  {
+    status &= ~EE_STATUS_INVALID_CRC;
+    if( retVal == E_SUCCESS )
+    {
+      status |= EE_STATUS_SCRUB_PASSED;
+    }
+  }
+
+  elapsed = millis() - scrubStart;
+  scrubInfo.bytesPerSecond = elapsed > 0 ? (unsigned long) blockSize * 1000UL / elapsed : 0;
+  scrubInfo.lastFullPass = millis();
+  scrubInfo.passes++;
+
+  return( retVal );
+}
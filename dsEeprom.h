@@ -20,7 +20,7 @@
 // ************************************************************************
 //
 //   A library to provide simplified access to the onchip EEPROM of an
-//   Arduino or ESP8266.
+//   Arduino or ESP8266 or to an external EEPROM (see dsEepromDevice.h).
 //   This includes a checksum over the whole content, that is 
 //   automatically stored and checked on EEPROM access, a mgic byte, 
 //   that signals a valid content and provides information regarding 
@@ -45,6 +45,15 @@
 #include <inttypes.h>
 #include <stdarg.h>
 #include <EEPROM.h>
+#include <dsEepromLayout.h>
+#include <dsEepromDevice.h>
+#include <dsEepromCrc.h>
+#include <dsEepromPatch.h>
+#include <dsEepromTransfer.h>
+#include <dsEepromEcc.h>
+#include <dsEepromCipher.h>
+#include <dsEepromLock.h>
+#include <dsEepromTxn.h>
 
 #ifdef USE_SIMPLE_LOG
 #include <SimpleLog.h>
@@ -71,7 +80,7 @@ extern "C" {
 //   512 bytes on ATmega168 and ATmega8, 
 //  1024 bytes on ATmega328  
 //  4096 bytes on ATmega1280 and ATmega2560
-//  up to 4096 bytes on ESP8266
+//  up to 4096 bytes on ESP8266 and ESP32 (emulated in flash)
 //
 #if defined (__AVR_ATmega8__) || defined (__AVR_ATmega168__)
 #define EEPROM_MAX_SIZE                   512
@@ -85,9 +94,15 @@ extern "C" {
 #define EEPROM_MAX_SIZE                  4096
 #endif
 //
-#ifdef ESP8266
+#if defined (ESP8266) || defined (ESP32)
 #define EEPROM_MAX_SIZE                  4096
-#endif // ESP8266
+#endif // ESP8266 || ESP32
+//
+// Linux hosts use the layout of an ESP8266 (see dsEepromFile.h)
+//
+#if defined (__linux__) && !defined (EEPROM_MAX_SIZE)
+#define EEPROM_MAX_SIZE                  4096
+#endif // __linux__
 //
 //
 // minimal error codes
@@ -95,77 +110,146 @@ extern "C" {
 #define E_SUCCESS        0
 #define E_BAD_CRC       -3
 #define E_INVALID_MAGIC -2
+#define E_DEVICE_IO     -4
+#define E_DEVICE_TIMEOUT -5
+#define E_NO_MIGRATION  -6
+#define E_BAD_PATCH     -7
+#define E_BAD_FRAME     -8
+#define E_BAD_ECC       -9
+#define E_BAD_REGION   -10
+#define E_BAD_TXN      -11
+#define E_NO_VIEW      -12
+#define E_BAD_SECRET   -13
 //
-// The member function version2Magic() has no real funtionality at this time.
-// It simply returns the defined value of EEPROM_MAGIC_BYTE
-// in a later version this may be replaced by a real calculation or
-// mapping 
-//
-#define EEPROM_MAGIC_BYTE              0x7e
-//
-#define EEPROM_LEADING_LENGTH             2  // means two byte representing 
-//                                           // the real length of the data field
-#define EEPROM_MAXLEN_MAGIC               1
-#define EEPROM_MAXLEN_CRC32               4
-//
-#define EEPROM_MAXLEN_BOOLEAN             1
-#define EEPROM_MAXLEN_LONG                4
-#define EEPROM_MAXLEN_SHORT               2
-#define EEPROM_MAXLEN_CHAR                1
+// ----- the above region is reserved for standard values
 //
-#define EEPROM_MAXLEN_WLAN_SSID          32  // max. length a SSID may have
-#define EEPROM_MAXLEN_WLAN_PASSPHRASE    64  // max. length of a WLAN passphrase
-#define EEPROM_MAXLEN_SERVER_IP          19  // max. length for the server IP
-#define EEPROM_MAXLEN_SERVER_PORT         4  // max. length for the server port
-#define EEPROM_MAXLEN_NODENAME           32  // max. lenght of the (generated) nodename
-#define EEPROM_MAXLEN_ADMIN_PASSWORD     32  // max. length for admin password
+// EEPROM status byte may be a combination of the following values
 //
+// ----- non failure/error indicator
 //
-// predefined standard layout of the eeprom:
+#define EE_STATUS_OK_AND_READY   0
+#define EE_STATUS_MODIFIED       1
+#define EE_STATUS_COMMITED       2
 //
-#define EEPROM_HEADER_BEGIN         0
+// ----- failure/error indicators
 //
-#define EEPROM_POS_MAGIC            0
+#define EE_STATUS_INVALID_CRC    4
+#define EE_STATUS_INVALID_MAGIC  8
+#define EE_STATUS_INVALID_SIZE  16
+#define EE_STATUS_ECC_CORRECTED 32  // a bit error has been corrected
+#define EE_STATUS_ECC_FAILED    64  // an error was not correctable
+#define EE_STATUS_SCRUB_PASSED 128  // last full scrub pass found no error
+#define EE_STATUS_DEVICE_ERROR 256  // a commit failed or a read came short
+
 //
-#define EEPROM_POS_CRC32            (EEPROM_POS_MAGIC + EEPROM_MAXLEN_MAGIC)
+// bytes read at once from the device e.g. for crc()
 //
-#define EEPROM_HEADER_END           (EEPROM_POS_CRC32 + EEPROM_MAXLEN_CRC32 + EEPROM_LEADING_LENGTH)
+#define EEPROM_READ_CHUNK       16
+
 //
-// data area begins here
+// schema migration
 //
-#define EEPROM_STD_DATA_BEGIN       EEPROM_HEADER_END       
+// while a migration runs, EEPROM_VERSION_MIGRATING is set in the
+// version and the crc field holds the source version and the progress,
+// so the migration continues after a power loss. The crc is written
+// when all fields are moved (EEPROM_VERSION_FINISHING).
+// A device that commits whole (ESP8266, ESP32) keeps the migration in
+// RAM and programs it with one commit - it needs the journal of
+// setJournal() on another device, which gets the migrated image first.
+// Without one migrate() refuses with E_NO_MIGRATION.
+// (the version flags are defined in dsEepromLayout.h)
 //
-#define EEPROM_POS_WLAN_SSID        EEPROM_STD_DATA_BEGIN
+#define EEPROM_MIGRATE_CHUNK           32  // max. bytes copied between progress updates
 //
-#define EEPROM_POS_WLAN_PASSPHRASE  (EEPROM_POS_WLAN_SSID + EEPROM_MAXLEN_WLAN_SSID + EEPROM_LEADING_LENGTH)
+// flags of a field move
 //
-#define EEPROM_POS_SERVER_IP        (EEPROM_POS_WLAN_PASSPHRASE + EEPROM_MAXLEN_WLAN_PASSPHRASE + EEPROM_LEADING_LENGTH)
+#define EE_MOVE_PREFIXED             0x01  // field has a leading length
 //
-#define EEPROM_POS_SERVER_PORT      (EEPROM_POS_SERVER_IP + EEPROM_MAXLEN_SERVER_IP + EEPROM_LEADING_LENGTH)
+// a field of the old layout (size incl. leading length) moves to a new
+// position and/or gets a new size. If it grows, the new bytes are zero,
+// if it shrinks, the data is cut (and with EE_MOVE_PREFIXED the length).
+// Moves are done in the given order, so a field must be moved away
+// before another field is moved over it.
 //
-#define EEPROM_POS_NODENAME         (EEPROM_POS_SERVER_PORT + EEPROM_MAXLEN_SERVER_PORT + EEPROM_LEADING_LENGTH)
+struct dsEepromFieldMove {
+  unsigned short from;
+  unsigned short to;
+  unsigned short oldLen;
+  unsigned short newLen;
+  unsigned char flags;
+};
 //
-#define EEPROM_POS_ADMIN_PASSWORD   (EEPROM_POS_NODENAME + EEPROM_MAXLEN_NODENAME + EEPROM_LEADING_LENGTH)
+// one migration step from a schema version to the next
 //
-#define EEPROM_STD_DATA_END         (EEPROM_POS_ADMIN_PASSWORD + EEPROM_MAXLEN_ADMIN_PASSWORD + EEPROM_LEADING_LENGTH)
+struct dsEepromMigration {
+  unsigned short fromVersion;
+  unsigned short toVersion;
+  const dsEepromFieldMove *moves;
+  unsigned char count;
+};
+
 //
-#define EEPROM_EXT_DATA_BEGIN       EEPROM_STD_DATA_END
+// error correction of regions of the image (see addEccRegion())
 //
-// ----- the above region is reserved for standard values
+#define EEPROM_ECC_MAX_REGIONS      2
+
+struct dsEepromEccRegion {
+  unsigned short begin;
+  unsigned short length;
+  unsigned short parity;
+};
+
 //
-// EEPROM status byte may be a combination of the following values
+// background scrubber (see scrubStep())
 //
-// ----- non failure/error indicator
+#define EEPROM_SCRUB_SLICE         32  // default bytes checked per step
+
+struct dsEepromScrubInfo {
+  unsigned long lastFullPass;    // millis() at the end of the last full pass, 0 if none
+  unsigned long passes;          // full passes done
+  unsigned long bytesPerSecond;  // scan rate of the last full pass
+  unsigned int position;         // next position to check
+  unsigned int corrected;        // blocks repaired by error correction
+  unsigned int mismatches;       // full passes with a wrong checksum
+};
+
 //
-#define EE_STATUS_OK_AND_READY   0
-#define EE_STATUS_MODIFIED       1
-#define EE_STATUS_COMMITED       2
+// read only view of stored bytes in the RAM copy of the device (see
+// viewString()), not terminated. It is stale after the next store or
+// a begin() of the device, check isCurrent() after use.
 //
-// ----- failure/error indicators
+struct dsEepromView {
+  const char *data;
+  unsigned int length;
+  unsigned int position;
+  unsigned short generation;
+};
+
 //
-#define EE_STATUS_INVALID_CRC    4
-#define EE_STATUS_INVALID_MAGIC  8
-#define EE_STATUS_INVALID_SIZE  16
+// thread safe mode
+//
+// With DSEEPROM_THREADSAFE defined (ESP32 with FreeRTOS, Linux), stores
+// and other changes of an instance are serialized by a mutex. Reads
+// take no lock: a sequence counter is odd while a change is going on,
+// a read that saw it change is repeated (seqlock). So readers never
+// wait for a commit, the commit is done when the change is complete.
+// A reader that finds a change going on yields a few times and then
+// waits on the mutex, which lends a writer of lower priority the
+// priority of the reader.
+// An open transaction (begin()) holds no lock, only its stores and
+// the write-out in commit() do.
+// Devices behind a bus (24Cxx) can't be read while written, readers
+// take the mutex there (see dsEepromDevice::concurrentReads()).
+//
+#ifdef DSEEPROM_THREADSAFE
+#define EE_WRITE_GUARD  dsEepromWriteGuard writeGuard( this )
+#define EE_READ_BEGIN   unsigned long readSequence; do { readSequence = readBegin();
+#define EE_READ_END     } while( readRetry( readSequence ) )
+#else
+#define EE_WRITE_GUARD
+#define EE_READ_BEGIN
+#define EE_READ_END
+#endif // DSEEPROM_THREADSAFE
 
 // macro to check whether log output is done
 //
@@ -173,18 +257,109 @@ extern "C" {
 
 class dsEeprom {
 
+#ifdef DSEEPROM_THREADSAFE
+  friend class dsEepromWriteGuard;
+#endif // DSEEPROM_THREADSAFE
+
   private:
     short logLevel;
+#ifdef DSEEPROM_THREADSAFE
+    std::atomic<short> status;     // readers set the error correction bits
+#else
     short status;
+#endif // DSEEPROM_THREADSAFE
     unsigned char magic;
     int blockSize;
     unsigned int reSized;
     unsigned long crc32Old;
     unsigned long crc32New;
+    dsEepromDevice *device;
+    unsigned int base;
+    bool readThrough;
+    unsigned short schemaVersion;
+    dsEepromEccRegion eccRegion[EEPROM_ECC_MAX_REGIONS];
+    unsigned char eccRegions;
+    unsigned short generation;
+    unsigned int scrubSlice;
+    uint32_t scrubCrc;
+    unsigned short scrubGeneration;
+    unsigned long scrubStart;
+    dsEepromScrubInfo scrubInfo;
+    dsEepromStage stage;
+    short txnStatus;
+    dsEepromDevice *journalDevice;
+    unsigned int journal;
+    unsigned int journalLength;
+    unsigned long autoIdle;
+    unsigned long autoDeadline;
+    unsigned long autoFirst;
+    unsigned long autoLast;
+    unsigned short autoGeneration;
+    bool autoPending;
+    const unsigned char *secretKey;
+    dsEepromDevice *secretDevice;
+    unsigned int secretCounter;
+#ifdef DSEEPROM_THREADSAFE
+    dsEepromLock writeLock;
+    std::atomic<unsigned long> sequence;
+    unsigned char writeDepth;
+    bool commitPending;
+
+    void writeBegin( void );
+    void writeEnd( void );
+    unsigned long readBegin( void );
+    bool readRetry( unsigned long readSequence );
+#endif // DSEEPROM_THREADSAFE
+
+    unsigned char readByte( int pos );
+    void writeByte( int pos, unsigned char value );
+    void readBlock( int pos, unsigned char* data, int len );
+    unsigned char readPast( int pos );
+    void updateByte( int pos, unsigned char value );
+    unsigned short readVersion( void );
+    void writeVersion( unsigned short version );
+    void writeProgress( unsigned short operations );
+    void stepCommit( void );
+    int findStep( const dsEepromMigration* steps, int count, unsigned short version );
+    void runMigration( const dsEepromMigration* steps, int count, unsigned short source, unsigned short startOp );
+    int finishMigration( void );
+    uint32_t imageChecksum( void );
+    int eccLocate( int pos, int* block, bool* isParity );
+    int eccBlock( int region, int block, unsigned char* data, unsigned char* check, bool repair );
+    void eccPatch( int pos, unsigned char* data, int len );
+    int eccRepair( int pos, int len );
+    void scrubReset( void );
+    int commitDevice( void );
+    int commitTo( dsEepromDevice* target );
+    void closeTxn( void );
+    bool stageRoom( int pos, int len );
+    bool stageFits( void );
+    int writeStage( unsigned long baseCrc, unsigned long targetCrc );
+    void journalByte( unsigned int pos, unsigned char value );
+    unsigned int journalWord( unsigned int pos );
+    void journalHeader( unsigned long baseCrc, unsigned long targetCrc );
+    int journalDone( unsigned int used );
+    int writeJournal( const unsigned char* runs, unsigned int used, bool whole,
+                       unsigned long baseCrc, unsigned long targetCrc );
+    bool journalMatches( unsigned long targetCrc );
+    void writeRuns( const unsigned char* runs, unsigned int used, unsigned long checksum );
+    int replayJournal( void );
+    int applyJournal( unsigned long targetCrc );
+    bool journalTakesImage( void );
+    void journalImage( void );
+    uint32_t journalChecksum( void );
+    int finishJournal( void );
+    bool validateNow( void );
+    int handleFrame( Stream& port, unsigned char* frame, int len, unsigned char& route );
+    void secretNonce( unsigned char* nonce, int dataIndex, uint32_t counter );
 
   public:
     dsEeprom( unsigned int blockSize = 0, unsigned char magic = 0x00, int logLevel = LOGLEVEL_QUIET );
+    dsEeprom( dsEepromDevice& device, unsigned int blockSize = 0, unsigned char magic = 0x00, int logLevel = LOGLEVEL_QUIET );
     int init( unsigned int blockSize = 0, unsigned char magic = 0x00, int logLevel = LOGLEVEL_QUIET );
+    int init( dsEepromDevice& device, unsigned int blockSize = 0, unsigned char magic = 0x00, int logLevel = LOGLEVEL_QUIET );
+    int initPartition( unsigned int base, unsigned int length, unsigned char magic = 0x00, int logLevel = LOGLEVEL_QUIET );
+    int initPartition( dsEepromDevice& device, unsigned int base, unsigned int length, unsigned char magic = 0x00, int logLevel = LOGLEVEL_QUIET );
     virtual ~dsEeprom();
     short getStatus( void );
     void setBlocksize( unsigned int newSize );
@@ -206,10 +381,55 @@ class dsEeprom {
     int restoreBytes( String& data, int dataIndex, int len, int maxLen);
     int storeString( String data, int maxLen, int dataIndex );
     int restoreString( String& data, int dataIndex, int maxLen );
+    int viewString( dsEepromView& view, int dataIndex, int maxLen );
+    int viewRaw( dsEepromView& view, int dataIndex, int len );
+    bool isCurrent( const dsEepromView& view );
+    void setSecretKey( const unsigned char* key );
+    int setSecretCounter( unsigned int address );
+    int setSecretCounter( dsEepromDevice& counterDevice, unsigned int address );
+    int storeSecret( String data, int maxLen, int dataIndex );
+    int restoreSecret( String& data, int dataIndex, int maxLen );
     bool isValid();
     bool validate();
+    void setSchemaVersion( unsigned short version );
+    unsigned short getSchemaVersion( void );
+    int migrate( const dsEepromMigration* steps, int count );
+    int applyPatch( const unsigned char* patch, unsigned int len );
+    int exportImage( Stream& port, unsigned int offset = 0 );
+    int importImage( Stream& port, unsigned long timeout = EEXFER_TIMEOUT );
+    int serveTransfer( Stream& port );
+    int addEccRegion( int begin, int length, int parity );
+    int rebuildEcc( void );
+    int scrubEcc( void );
+    void setScrubSlice( unsigned int bytes );
+    int scrubStep( void );
+    void getScrubInfo( dsEepromScrubInfo* info );
+    int setStage( unsigned char* buffer, unsigned int size );
+    int begin( void );
+    int commit( void );
+    int rollback( void );
+    int setJournal( unsigned int address, unsigned int length );
+    int setJournal( dsEepromDevice& journalDevice, unsigned int address, unsigned int length );
+    void setAutoCommit( unsigned long idle, unsigned long deadline );
+    int autoCommit( void );
+    bool flush( void );
 };
 
 
 
+#ifdef DSEEPROM_THREADSAFE
+//
+// a change of the instance, from construction to the end of the scope
+//
+class dsEepromWriteGuard {
+
+  private:
+    dsEeprom *eeprom;
+
+  public:
+    dsEepromWriteGuard( dsEeprom* instance ) { eeprom = instance; eeprom->writeBegin(); }
+    ~dsEepromWriteGuard() { eeprom->writeEnd(); }
+};
+#endif // DSEEPROM_THREADSAFE
+
 #endif // _DSEEPROM_H_
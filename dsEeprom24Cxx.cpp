@@ -0,0 +1,367 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   dsEeprom device for external I2C EEPROMs of the 24Cxx family.
+//   Please refer to dsEeprom24Cxx.h for a description.
+//
+// ************************************************************************
+//
+//
+//-------- History --------------------------------------------------------
+//
+// 2016/10/28: initial version
+//
+//
+// ************************************************************************
+//
+
+#include <Arduino.h>
+#include <dsEeprom24Cxx.h>
+
+dsEeprom24Cxx::dsEeprom24Cxx( TwoWire& newWire, unsigned int newCapacity,
+                              unsigned char newPageSize, unsigned char newAddress )
+{
+  wire = &newWire;
+  i2cAddress = newAddress;
+  deviceSize = newCapacity;
+
+  if( newPageSize == 0 || newPageSize > EE24CXX_MAX_PAGESIZE )
+  {
+    pageSize = EE24CXX_MAX_PAGESIZE;
+  }
+  else
+  {
+    pageSize = newPageSize;
+  }
+
+  //
+  // up to 24C16 the upper address bits are part of the device address
+  //
+  if( deviceSize <= EE24C16_CAPACITY )
+  {
+    addressBytes = 1;
+  }
+  else
+  {
+    addressBytes = 2;
+  }
+
+  writeCycle = false;
+  deviceError = E_SUCCESS;
+  pageBase = 0;
+  pendingLow = 1;
+  pendingHigh = 0;
+}
+
+dsEeprom24Cxx::~dsEeprom24Cxx()
+{
+}
+
+//
+// ************************************************************************
+// bus access
+// ************************************************************************
+//
+
+int dsEeprom24Cxx::busWrite( unsigned char device, const unsigned char* data, int len )
+{
+  wire->beginTransmission( device );
+  wire->write( data, len );
+
+  return( wire->endTransmission() == 0 ? E_SUCCESS : E_DEVICE_IO );
+}
+
+int dsEeprom24Cxx::busRead( unsigned char device, unsigned char* data, int len )
+{
+  int got;
+
+  got = wire->requestFrom( device, (uint8_t) len );
+
+  for( int i = 0; i < got; i++ )
+  {
+    data[i] = wire->read();
+  }
+
+  return( got );
+}
+
+//
+// a device in its internal write cycle does not ACK its address
+//
+bool dsEeprom24Cxx::busProbe( unsigned char device )
+{
+  wire->beginTransmission( device );
+
+  return( wire->endTransmission() == 0 );
+}
+
+//
+// ************************************************************************
+// helpers
+// ************************************************************************
+//
+
+unsigned char dsEeprom24Cxx::deviceAddress( int address )
+{
+  if( addressBytes == 1 )
+  {
+    return( i2cAddress | ((address >> 8) & 0x07) );
+  }
+
+  return( i2cAddress );
+}
+
+//
+// wait for the end of a write cycle by polling for ACK
+//
+int dsEeprom24Cxx::waitReady( void )
+{
+  unsigned long start;
+
+  if( !writeCycle )
+  {
+    return( E_SUCCESS );
+  }
+
+  start = millis();
+
+  while( !busProbe( i2cAddress ) )
+  {
+    if( millis() - start > EE24CXX_WRITE_TIMEOUT )
+    {
+      writeCycle = false;
+      return( E_DEVICE_TIMEOUT );
+    }
+  }
+
+  writeCycle = false;
+
+  return( E_SUCCESS );
+}
+
+//
+// write the pending range of the page buffer to the device
+// a transfer is limited by the Wire buffer, so a page may need more
+// than one write cycle on small MCUs
+//
+int dsEeprom24Cxx::flushPage( void )
+{
+  int retVal = E_SUCCESS;
+  unsigned char buffer[EE24CXX_WIRE_BUFFER];
+  int maxChunk = EE24CXX_WIRE_BUFFER - addressBytes;
+  int offset;
+  int chunk;
+  int address;
+  int pos;
+
+  for( offset = pendingLow; offset <= pendingHigh && retVal == E_SUCCESS; offset += chunk )
+  {
+    chunk = pendingHigh - offset + 1;
+    if( chunk > maxChunk )
+    {
+      chunk = maxChunk;
+    }
+
+    address = pageBase + offset;
+    pos = 0;
+
+    if( addressBytes == 2 )
+    {
+      buffer[pos++] = (address >> 8) & 0xff;
+    }
+    buffer[pos++] = address & 0xff;
+
+    memcpy( &buffer[pos], &page[offset], chunk );
+
+    if( (retVal = waitReady()) == E_SUCCESS )
+    {
+      retVal = busWrite( deviceAddress( address ), buffer, pos + chunk );
+      writeCycle = true;
+    }
+  }
+
+  pendingLow = 1;
+  pendingHigh = 0;
+
+  return( retVal );
+}
+
+//
+// ************************************************************************
+// device interface
+// ************************************************************************
+//
+
+int dsEeprom24Cxx::begin( unsigned int size )
+{
+  wire->begin();
+
+  return( size <= deviceSize ? E_SUCCESS : E_DEVICE_IO );
+}
+
+unsigned int dsEeprom24Cxx::capacity( void )
+{
+  return( deviceSize );
+}
+
+unsigned char dsEeprom24Cxx::read( int address )
+{
+  unsigned char value = 0;
+
+  readBlock( address, &value, 1 );
+
+  return( value );
+}
+
+//
+// collect consecutive writes within a page
+//
+void dsEeprom24Cxx::write( int address, unsigned char value )
+{
+  int base = address - (address % pageSize);
+  short offset = address - base;
+  int retVal;
+
+  if( pendingLow <= pendingHigh )
+  {
+    if( base != pageBase || offset < pendingLow - 1 || offset > pendingHigh + 1 )
+    {
+      if( (retVal = flushPage()) != E_SUCCESS )
+      {
+        deviceError = retVal;
+      }
+    }
+  }
+
+  if( pendingLow > pendingHigh )
+  {
+    pageBase = base;
+    pendingLow = offset;
+    pendingHigh = offset;
+  }
+  else
+  {
+    if( offset < pendingLow )
+    {
+      pendingLow = offset;
+    }
+    if( offset > pendingHigh )
+    {
+      pendingHigh = offset;
+    }
+  }
+
+  page[offset] = value;
+}
+
+//
+// sequential read, bytes still in the page buffer are taken from there
+//
+int dsEeprom24Cxx::readBlock( int address, unsigned char* data, int len )
+{
+  unsigned char buffer[2];
+  int done = 0;
+  int chunk;
+  int got;
+  int pos;
+  int current;
+
+  while( done < len )
+  {
+    current = address + done;
+    chunk = len - done;
+
+    if( chunk > EE24CXX_WIRE_BUFFER )
+    {
+      chunk = EE24CXX_WIRE_BUFFER;
+    }
+
+    //
+    // one byte addressing: don't cross the block of a device address
+    //
+    if( addressBytes == 1 && (current & 0xff) + chunk > 0x100 )
+    {
+      chunk = 0x100 - (current & 0xff);
+    }
+
+    if( waitReady() != E_SUCCESS )
+    {
+      break;
+    }
+
+    pos = 0;
+    if( addressBytes == 2 )
+    {
+      buffer[pos++] = (current >> 8) & 0xff;
+    }
+    buffer[pos++] = current & 0xff;
+
+    if( busWrite( deviceAddress( current ), buffer, pos ) != E_SUCCESS )
+    {
+      break;
+    }
+
+    if( (got = busRead( deviceAddress( current ), &data[done], chunk )) <= 0 )
+    {
+      break;
+    }
+
+    done += got;
+  }
+
+  if( done < len )
+  {
+    deviceError = E_DEVICE_IO;
+    memset( &data[done], 0, len - done );
+  }
+
+  if( pendingLow <= pendingHigh )
+  {
+    for( int offset = pendingLow; offset <= pendingHigh; offset++ )
+    {
+      pos = pageBase + offset - address;
+      if( pos >= 0 && pos < len )
+      {
+        data[pos] = page[offset];
+      }
+    }
+  }
+
+  return( done );
+}
+
+int dsEeprom24Cxx::commit( void )
+{
+  int retVal;
+
+  if( (retVal = flushPage()) == E_SUCCESS )
+  {
+    retVal = waitReady();
+  }
+
+  if( retVal == E_SUCCESS )
+  {
+    retVal = deviceError;
+  }
+  deviceError = E_SUCCESS;
+
+  return( retVal );
+}
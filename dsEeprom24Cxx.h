@@ -0,0 +1,129 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   dsEeprom device for external I2C EEPROMs of the 24Cxx family
+//   (24C01 ... 24C16 with one address byte, 24C32 ... 24C512 with two).
+//   Consecutive byte writes are collected in a page buffer and written
+//   as one page write when the page changes, a read hits the device or
+//   commit() is called. Reads are done as sequential reads.
+//   Instead of a fixed delay after each write cycle the device is
+//   polled for ACK.
+//   write() and readBlock() have no way to report a failed transfer at
+//   once: the error is kept and returned by the next commit(), the
+//   missing bytes of a short read are 0.
+//   All bus access is done by the protected bus*() members, so the
+//   device may be replaced by a model for tests on a host.
+//
+// ************************************************************************
+//
+//
+//-------- History --------------------------------------------------------
+//
+// 2016/10/28: initial version
+//
+//
+// ************************************************************************
+
+#ifndef _DSEEPROM24CXX_H_
+#define _DSEEPROM24CXX_H_
+
+#include <dsEeprom.h>
+#include <Wire.h>
+
+//
+// largest page size supported (24C512 has 128 bytes per page)
+//
+#ifndef EE24CXX_MAX_PAGESIZE
+#define EE24CXX_MAX_PAGESIZE           128
+#endif // EE24CXX_MAX_PAGESIZE
+//
+// size of the Wire buffer - one transfer may not exceed this
+//
+#ifndef EE24CXX_WIRE_BUFFER
+#ifdef BUFFER_LENGTH
+#define EE24CXX_WIRE_BUFFER            BUFFER_LENGTH
+#else
+#define EE24CXX_WIRE_BUFFER            32
+#endif // BUFFER_LENGTH
+#endif // EE24CXX_WIRE_BUFFER
+//
+// max. time in ms a write cycle may take before ACK polling gives up
+//
+#ifndef EE24CXX_WRITE_TIMEOUT
+#define EE24CXX_WRITE_TIMEOUT           20
+#endif // EE24CXX_WRITE_TIMEOUT
+//
+#define EE24CXX_DEFAULT_ADDRESS       0x50
+//
+// some common parts
+//
+#define EE24C02_CAPACITY               256
+#define EE24C02_PAGESIZE                 8
+#define EE24C16_CAPACITY              2048
+#define EE24C16_PAGESIZE                16
+#define EE24C32_CAPACITY              4096
+#define EE24C32_PAGESIZE                32
+#define EE24C256_CAPACITY            32768
+#define EE24C256_PAGESIZE               64
+
+class dsEeprom24Cxx : public dsEepromDevice {
+
+  protected:
+    TwoWire *wire;
+    unsigned char i2cAddress;
+    unsigned char addressBytes;
+    unsigned char pageSize;
+    unsigned int deviceSize;
+    bool writeCycle;
+    int deviceError;              // failed transfer since the last commit()
+    //
+    // page buffer for coalescing writes
+    //
+    int pageBase;
+    short pendingLow;
+    short pendingHigh;
+    unsigned char page[EE24CXX_MAX_PAGESIZE];
+
+    unsigned char deviceAddress( int address );
+    int waitReady( void );
+    int flushPage( void );
+    //
+    // bus access - overwrite to run against a model of the device
+    //
+    virtual int busWrite( unsigned char device, const unsigned char* data, int len );
+    virtual int busRead( unsigned char device, unsigned char* data, int len );
+    virtual bool busProbe( unsigned char device );
+
+  public:
+    dsEeprom24Cxx( TwoWire& wire, unsigned int capacity = EE24C256_CAPACITY,
+                   unsigned char pageSize = EE24C256_PAGESIZE,
+                   unsigned char i2cAddress = EE24CXX_DEFAULT_ADDRESS );
+    virtual ~dsEeprom24Cxx();
+    int begin( unsigned int size );
+    unsigned int capacity( void );
+    unsigned char read( int address );
+    void write( int address, unsigned char value );
+    int readBlock( int address, unsigned char* data, int len );
+    int commit( void );
+};
+
+
+#endif // _DSEEPROM24CXX_H_
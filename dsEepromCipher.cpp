@@ -0,0 +1,316 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   Authenticated encryption of secret fields.
+//   Please refer to dsEepromCipher.h for a description.
+//
+// ************************************************************************
+//
+//
+//-------- History --------------------------------------------------------
+//
+// 2016/10/28: initial version
+//
+//
+// ************************************************************************
+//
+
+#include <string.h>
+
+#include <dsEepromCipher.h>
+
+static uint32_t getLe32( const uint8_t* data )
+{
+  return( (uint32_t) data[0] | ((uint32_t) data[1] << 8) |
+          ((uint32_t) data[2] << 16) | ((uint32_t) data[3] << 24) );
+}
+
+static void putLe32( uint8_t* data, uint32_t value )
+{
+  data[0] = value & 0xff;
+  data[1] = (value >> 8) & 0xff;
+  data[2] = (value >> 16) & 0xff;
+  data[3] = (value >> 24) & 0xff;
+}
+
+// ************************************************************************
+// ChaCha20
+// ************************************************************************
+
+#define ROTL32(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+
+#define QUARTERROUND(a, b, c, d)                  \
+  x[a] += x[b]; x[d] = ROTL32( x[d] ^ x[a], 16 ); \
+  x[c] += x[d]; x[b] = ROTL32( x[b] ^ x[c], 12 ); \
+  x[a] += x[b]; x[d] = ROTL32( x[d] ^ x[a], 8 );  \
+  x[c] += x[d]; x[b] = ROTL32( x[b] ^ x[c], 7 )
+
+//
+// key stream of the block in input[12], counts it up
+//
+static void chachaBlock( dsEepromCipher* cipher )
+{
+  uint32_t x[16];
+
+  memcpy( x, cipher->input, sizeof(x) );
+
+  for( int i = 0; i < 10; i++ )
+  {
+    QUARTERROUND( 0, 4,  8, 12 );
+    QUARTERROUND( 1, 5,  9, 13 );
+    QUARTERROUND( 2, 6, 10, 14 );
+    QUARTERROUND( 3, 7, 11, 15 );
+    QUARTERROUND( 0, 5, 10, 15 );
+    QUARTERROUND( 1, 6, 11, 12 );
+    QUARTERROUND( 2, 7,  8, 13 );
+    QUARTERROUND( 3, 4,  9, 14 );
+  }
+
+  for( int i = 0; i < 16; i++ )
+  {
+    putLe32( &cipher->stream[4 * i], x[i] + cipher->input[i] );
+  }
+
+  cipher->input[12]++;
+  cipher->streamUsed = 0;
+}
+
+// ************************************************************************
+// Poly1305, 26 bit limbs
+// ************************************************************************
+
+static void polyBlock( dsEepromCipher* cipher, const uint8_t* data )
+{
+  uint32_t r0 = cipher->r[0], r1 = cipher->r[1], r2 = cipher->r[2], r3 = cipher->r[3], r4 = cipher->r[4];
+  uint32_t s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+  uint32_t h0, h1, h2, h3, h4;
+  uint64_t d0, d1, d2, d3, d4;
+  uint32_t c;
+
+  h0 = cipher->h[0] + (getLe32( &data[0] ) & 0x3ffffff);
+  h1 = cipher->h[1] + ((getLe32( &data[3] ) >> 2) & 0x3ffffff);
+  h2 = cipher->h[2] + ((getLe32( &data[6] ) >> 4) & 0x3ffffff);
+  h3 = cipher->h[3] + ((getLe32( &data[9] ) >> 6) & 0x3ffffff);
+  h4 = cipher->h[4] + ((getLe32( &data[12] ) >> 8) | (1UL << 24));
+
+  d0 = (uint64_t) h0 * r0 + (uint64_t) h1 * s4 + (uint64_t) h2 * s3 + (uint64_t) h3 * s2 + (uint64_t) h4 * s1;
+  d1 = (uint64_t) h0 * r1 + (uint64_t) h1 * r0 + (uint64_t) h2 * s4 + (uint64_t) h3 * s3 + (uint64_t) h4 * s2;
+  d2 = (uint64_t) h0 * r2 + (uint64_t) h1 * r1 + (uint64_t) h2 * r0 + (uint64_t) h3 * s4 + (uint64_t) h4 * s3;
+  d3 = (uint64_t) h0 * r3 + (uint64_t) h1 * r2 + (uint64_t) h2 * r1 + (uint64_t) h3 * r0 + (uint64_t) h4 * s4;
+  d4 = (uint64_t) h0 * r4 + (uint64_t) h1 * r3 + (uint64_t) h2 * r2 + (uint64_t) h3 * r1 + (uint64_t) h4 * r0;
+
+  c = (uint32_t) (d0 >> 26); h0 = (uint32_t) d0 & 0x3ffffff;
+  d1 += c; c = (uint32_t) (d1 >> 26); h1 = (uint32_t) d1 & 0x3ffffff;
+  d2 += c; c = (uint32_t) (d2 >> 26); h2 = (uint32_t) d2 & 0x3ffffff;
+  d3 += c; c = (uint32_t) (d3 >> 26); h3 = (uint32_t) d3 & 0x3ffffff;
+  d4 += c; c = (uint32_t) (d4 >> 26); h4 = (uint32_t) d4 & 0x3ffffff;
+  h0 += c * 5; c = h0 >> 26; h0 &= 0x3ffffff;
+  h1 += c;
+
+  cipher->h[0] = h0;
+  cipher->h[1] = h1;
+  cipher->h[2] = h2;
+  cipher->h[3] = h3;
+  cipher->h[4] = h4;
+}
+
+static void polyByte( dsEepromCipher* cipher, uint8_t value )
+{
+  cipher->block[cipher->blockUsed++] = value;
+
+  if( cipher->blockUsed == sizeof(cipher->block) )
+  {
+    polyBlock( cipher, cipher->block );
+    cipher->blockUsed = 0;
+  }
+}
+
+//
+// aad and text are padded to whole blocks with zeros
+//
+static void polyPad( dsEepromCipher* cipher )
+{
+  while( cipher->blockUsed != 0 )
+  {
+    polyByte( cipher, 0 );
+  }
+}
+
+// ************************************************************************
+// AEAD
+// ************************************************************************
+
+void dsEepromCipherInit( dsEepromCipher* cipher, const uint8_t* key, const uint8_t* nonce,
+                         const uint8_t* aad, unsigned int aadLen )
+{
+  static const uint8_t sigma[16] = { 'e', 'x', 'p', 'a', 'n', 'd', ' ', '3',
+                                     '2', '-', 'b', 'y', 't', 'e', ' ', 'k' };
+
+  for( int i = 0; i < 4; i++ )
+  {
+    cipher->input[i] = getLe32( &sigma[4 * i] );
+  }
+
+  for( int i = 0; i < 8; i++ )
+  {
+    cipher->input[4 + i] = getLe32( &key[4 * i] );
+  }
+
+  cipher->input[12] = 0;
+  for( int i = 0; i < 3; i++ )
+  {
+    cipher->input[13 + i] = getLe32( &nonce[4 * i] );
+  }
+
+  //
+  // block 0 is the one time key of Poly1305, the text starts with 1
+  //
+  chachaBlock( cipher );
+
+  cipher->r[0] = getLe32( &cipher->stream[0] ) & 0x3ffffff;
+  cipher->r[1] = (getLe32( &cipher->stream[3] ) >> 2) & 0x3ffff03;
+  cipher->r[2] = (getLe32( &cipher->stream[6] ) >> 4) & 0x3ffc0ff;
+  cipher->r[3] = (getLe32( &cipher->stream[9] ) >> 6) & 0x3f03fff;
+  cipher->r[4] = (getLe32( &cipher->stream[12] ) >> 8) & 0x00fffff;
+
+  for( int i = 0; i < 4; i++ )
+  {
+    cipher->pad[i] = getLe32( &cipher->stream[16 + 4 * i] );
+  }
+
+  memset( cipher->h, 0, sizeof(cipher->h) );
+  cipher->blockUsed = 0;
+  cipher->streamUsed = sizeof(cipher->stream);
+  cipher->textLength = 0;
+  cipher->aadLength = aadLen;
+
+  for( unsigned int i = 0; i < aadLen; i++ )
+  {
+    polyByte( cipher, aad[i] );
+  }
+
+  polyPad( cipher );
+}
+
+uint8_t dsEepromCipherEncrypt( dsEepromCipher* cipher, uint8_t plain )
+{
+  uint8_t encrypted;
+
+  if( cipher->streamUsed == sizeof(cipher->stream) )
+  {
+    chachaBlock( cipher );
+  }
+
+  encrypted = plain ^ cipher->stream[cipher->streamUsed++];
+  polyByte( cipher, encrypted );
+  cipher->textLength++;
+
+  return( encrypted );
+}
+
+uint8_t dsEepromCipherDecrypt( dsEepromCipher* cipher, uint8_t encrypted )
+{
+  if( cipher->streamUsed == sizeof(cipher->stream) )
+  {
+    chachaBlock( cipher );
+  }
+
+  polyByte( cipher, encrypted );
+  cipher->textLength++;
+
+  return( encrypted ^ cipher->stream[cipher->streamUsed++] );
+}
+
+void dsEepromCipherTag( dsEepromCipher* cipher, uint8_t* tag )
+{
+  uint32_t h0, h1, h2, h3, h4;
+  uint32_t g0, g1, g2, g3, g4;
+  uint32_t c, mask;
+  uint64_t f;
+  uint8_t lengths[16];
+
+  polyPad( cipher );
+
+  memset( lengths, 0, sizeof(lengths) );
+  putLe32( &lengths[0], cipher->aadLength );
+  putLe32( &lengths[8], cipher->textLength );
+  polyBlock( cipher, lengths );
+
+  h0 = cipher->h[0]; h1 = cipher->h[1]; h2 = cipher->h[2]; h3 = cipher->h[3]; h4 = cipher->h[4];
+
+  //
+  // full carry, then h - p if h >= p = 2^130 - 5
+  //
+  c = h1 >> 26; h1 &= 0x3ffffff;
+  h2 += c; c = h2 >> 26; h2 &= 0x3ffffff;
+  h3 += c; c = h3 >> 26; h3 &= 0x3ffffff;
+  h4 += c; c = h4 >> 26; h4 &= 0x3ffffff;
+  h0 += c * 5; c = h0 >> 26; h0 &= 0x3ffffff;
+  h1 += c;
+
+  g0 = h0 + 5; c = g0 >> 26; g0 &= 0x3ffffff;
+  g1 = h1 + c; c = g1 >> 26; g1 &= 0x3ffffff;
+  g2 = h2 + c; c = g2 >> 26; g2 &= 0x3ffffff;
+  g3 = h3 + c; c = g3 >> 26; g3 &= 0x3ffffff;
+  g4 = h4 + c - (1UL << 26);
+
+  mask = (g4 >> 31) - 1;
+  h0 = (h0 & ~mask) | (g0 & mask);
+  h1 = (h1 & ~mask) | (g1 & mask);
+  h2 = (h2 & ~mask) | (g2 & mask);
+  h3 = (h3 & ~mask) | (g3 & mask);
+  h4 = (h4 & ~mask) | (g4 & mask);
+
+  //
+  // h + s mod 2^128
+  //
+  h0 = h0 | (h1 << 26);
+  h1 = (h1 >> 6) | (h2 << 20);
+  h2 = (h2 >> 12) | (h3 << 14);
+  h3 = (h3 >> 18) | (h4 << 8);
+
+  f = (uint64_t) h0 + cipher->pad[0];             putLe32( &tag[0], (uint32_t) f );
+  f = (uint64_t) h1 + cipher->pad[1] + (f >> 32); putLe32( &tag[4], (uint32_t) f );
+  f = (uint64_t) h2 + cipher->pad[2] + (f >> 32); putLe32( &tag[8], (uint32_t) f );
+  f = (uint64_t) h3 + cipher->pad[3] + (f >> 32); putLe32( &tag[12], (uint32_t) f );
+}
+
+bool dsEepromCipherTagEqual( const uint8_t* tag, const uint8_t* other )
+{
+  uint8_t diff = 0;
+
+  for( int i = 0; i < EEPROM_CIPHER_TAG_SIZE; i++ )
+  {
+    diff |= tag[i] ^ other[i];
+  }
+
+  return( diff == 0 );
+}
+
+void dsEepromCipherWipe( dsEepromCipher* cipher )
+{
+  volatile uint8_t *data = (volatile uint8_t*) cipher;
+
+  for( unsigned int i = 0; i < sizeof(*cipher); i++ )
+  {
+    data[i] = 0;
+  }
+}
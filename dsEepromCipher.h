@@ -0,0 +1,106 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   Authenticated encryption of secret fields: ChaCha20-Poly1305 as in
+//   RFC 8439, one byte at a time so the store and restore loops
+//   encrypt and decrypt on the way without a buffer for the field.
+//   The context holds one block of key stream and one block of the
+//   authenticator.
+//
+//   A secret field (see storeSecret() in dsEeprom.h):
+//
+//     length (2)    length of the plain text, authenticated
+//     counter (4)   the counter of the store
+//     cipher text   length bytes
+//     tag (16)      Poly1305 over length and cipher text
+//
+//   The nonce is the address of the field on the device, the counter
+//   and "dsEE". The counter comes from a counter of the device outside
+//   of the partition (setSecretCounter()) that only grows: wipe(),
+//   rollback(), importImage() or applyPatch() put older fields back,
+//   but never an older counter, so the stores of one device do not
+//   share a key stream. This holds per device - give every device its
+//   own key. A secret moved by migrate() has to be stored again.
+//
+//   The file does not depend on Arduino, the host tools use it, too.
+//
+// ************************************************************************
+//
+//
+//-------- History --------------------------------------------------------
+//
+// 2016/10/28: initial version
+//
+//
+// ************************************************************************
+
+#ifndef _DSEEPROMCIPHER_H_
+#define _DSEEPROMCIPHER_H_
+
+#include <inttypes.h>
+
+#define EEPROM_CIPHER_KEY_SIZE     32
+#define EEPROM_CIPHER_NONCE_SIZE   12
+#define EEPROM_CIPHER_TAG_SIZE     16
+#define EEPROM_CIPHER_COUNTER_SIZE  4
+//
+// bytes a secret field needs beyond the leading length and the text,
+// so a field of the standard layout holds
+// EEPROM_SECRET_MAXLEN(EEPROM_MAXLEN_...) bytes of plain text
+//
+#define EEPROM_SECRET_OVERHEAD     (EEPROM_CIPHER_COUNTER_SIZE + EEPROM_CIPHER_TAG_SIZE)
+#define EEPROM_SECRET_MAXLEN(len)  ((len) - EEPROM_SECRET_OVERHEAD)
+
+struct dsEepromCipher {
+  uint32_t input[16];        // ChaCha20 state, word 12 is the block counter
+  uint8_t stream[64];        // key stream of the current block
+  uint8_t streamUsed;
+  uint32_t r[5];             // Poly1305 key and accumulator, 26 bit limbs
+  uint32_t h[5];
+  uint32_t pad[4];
+  uint8_t block[16];         // bytes not yet authenticated
+  uint8_t blockUsed;
+  uint32_t aadLength;
+  uint32_t textLength;
+};
+
+//
+// start with a key and a nonce, aad bytes are authenticated but not
+// encrypted and must come first
+//
+void dsEepromCipherInit( dsEepromCipher* cipher, const uint8_t* key, const uint8_t* nonce,
+                         const uint8_t* aad, unsigned int aadLen );
+uint8_t dsEepromCipherEncrypt( dsEepromCipher* cipher, uint8_t plain );
+uint8_t dsEepromCipherDecrypt( dsEepromCipher* cipher, uint8_t encrypted );
+//
+// end of the text, returns the tag
+//
+void dsEepromCipherTag( dsEepromCipher* cipher, uint8_t* tag );
+//
+// compare tags in constant time
+//
+bool dsEepromCipherTagEqual( const uint8_t* tag, const uint8_t* other );
+//
+// clear key material of the context
+//
+void dsEepromCipherWipe( dsEepromCipher* cipher );
+
+#endif // _DSEEPROMCIPHER_H_
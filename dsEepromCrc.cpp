@@ -0,0 +1,347 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   Checksum of the dsEeprom image.
+//   Please refer to dsEepromCrc.h for a description.
+//
+// ************************************************************************
+//
+//
+//-------- History --------------------------------------------------------
+//
+// 2016/10/28: initial version
+//
+//
+// ************************************************************************
+//
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#define PROGMEM
+#define pgm_read_dword(addr) (*(const uint32_t*)(addr))
+#endif // ARDUINO
+
+#include <string.h>
+
+#include <dsEepromCrc.h>
+
+#if !defined(ARDUINO) || defined(DSEEPROM_CRC_SLICING)
+#define CRC_SLICING
+#endif
+
+#if !defined(__AVR__) || defined(DSEEPROM_CRC_BYTE_TABLE) || defined(CRC_SLICING)
+#define CRC_BYTE_TABLE
+#endif
+
+// ************************************************************************
+// CRC lookup table
+// ************************************************************************
+//
+static const PROGMEM uint32_t crc_table[16] = {
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac,
+    0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+    0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c
+};
+
+#ifdef CRC_BYTE_TABLE
+//
+// both nibble steps of crcStep() at once, index is bits 0..3 of
+// crc ^ data and bits 8..11 of crc ^ bits 4..7 of data (crcByteIndex())
+//
+static const PROGMEM uint32_t crc_byte_table[256] = {
+    0x00000000, 0x4c69105e, 0x98d220bc, 0xd4bb30e2,
+    0xf762575d, 0xbb0b4703, 0x6fb077e1, 0x23d967bf,
+    0x35b5a8fa, 0x79dcb8a4, 0xad678846, 0xe10e9818,
+    0xc2d7ffa7, 0x8ebeeff9, 0x5a05df1b, 0x166ccf45,
+    0x1db71064, 0x51de003a, 0x856530d8, 0xc90c2086,
+    0xead54739, 0xa6bc5767, 0x72076785, 0x3e6e77db,
+    0x2802b89e, 0x646ba8c0, 0xb0d09822, 0xfcb9887c,
+    0xdf60efc3, 0x9309ff9d, 0x47b2cf7f, 0x0bdbdf21,
+    0x3b6e20c8, 0x77073096, 0xa3bc0074, 0xefd5102a,
+    0xcc0c7795, 0x806567cb, 0x54de5729, 0x18b74777,
+    0x0edb8832, 0x42b2986c, 0x9609a88e, 0xda60b8d0,
+    0xf9b9df6f, 0xb5d0cf31, 0x616bffd3, 0x2d02ef8d,
+    0x26d930ac, 0x6ab020f2, 0xbe0b1010, 0xf262004e,
+    0xd1bb67f1, 0x9dd277af, 0x4969474d, 0x05005713,
+    0x136c9856, 0x5f058808, 0x8bbeb8ea, 0xc7d7a8b4,
+    0xe40ecf0b, 0xa867df55, 0x7cdcefb7, 0x30b5ffe9,
+    0x76dc4190, 0x3ab551ce, 0xee0e612c, 0xa2677172,
+    0x81be16cd, 0xcdd70693, 0x196c3671, 0x5505262f,
+    0x4369e96a, 0x0f00f934, 0xdbbbc9d6, 0x97d2d988,
+    0xb40bbe37, 0xf862ae69, 0x2cd99e8b, 0x60b08ed5,
+    0x6b6b51f4, 0x270241aa, 0xf3b97148, 0xbfd06116,
+    0x9c0906a9, 0xd06016f7, 0x04db2615, 0x48b2364b,
+    0x5edef90e, 0x12b7e950, 0xc60cd9b2, 0x8a65c9ec,
+    0xa9bcae53, 0xe5d5be0d, 0x316e8eef, 0x7d079eb1,
+    0x4db26158, 0x01db7106, 0xd56041e4, 0x990951ba,
+    0xbad03605, 0xf6b9265b, 0x220216b9, 0x6e6b06e7,
+    0x7807c9a2, 0x346ed9fc, 0xe0d5e91e, 0xacbcf940,
+    0x8f659eff, 0xc30c8ea1, 0x17b7be43, 0x5bdeae1d,
+    0x5005713c, 0x1c6c6162, 0xc8d75180, 0x84be41de,
+    0xa7672661, 0xeb0e363f, 0x3fb506dd, 0x73dc1683,
+    0x65b0d9c6, 0x29d9c998, 0xfd62f97a, 0xb10be924,
+    0x92d28e9b, 0xdebb9ec5, 0x0a00ae27, 0x4669be79,
+    0xedb88320, 0xa1d1937e, 0x756aa39c, 0x3903b3c2,
+    0x1adad47d, 0x56b3c423, 0x8208f4c1, 0xce61e49f,
+    0xd80d2bda, 0x94643b84, 0x40df0b66, 0x0cb61b38,
+    0x2f6f7c87, 0x63066cd9, 0xb7bd5c3b, 0xfbd44c65,
+    0xf00f9344, 0xbc66831a, 0x68ddb3f8, 0x24b4a3a6,
+    0x076dc419, 0x4b04d447, 0x9fbfe4a5, 0xd3d6f4fb,
+    0xc5ba3bbe, 0x89d32be0, 0x5d681b02, 0x11010b5c,
+    0x32d86ce3, 0x7eb17cbd, 0xaa0a4c5f, 0xe6635c01,
+    0xd6d6a3e8, 0x9abfb3b6, 0x4e048354, 0x026d930a,
+    0x21b4f4b5, 0x6ddde4eb, 0xb966d409, 0xf50fc457,
+    0xe3630b12, 0xaf0a1b4c, 0x7bb12bae, 0x37d83bf0,
+    0x14015c4f, 0x58684c11, 0x8cd37cf3, 0xc0ba6cad,
+    0xcb61b38c, 0x8708a3d2, 0x53b39330, 0x1fda836e,
+    0x3c03e4d1, 0x706af48f, 0xa4d1c46d, 0xe8b8d433,
+    0xfed41b76, 0xb2bd0b28, 0x66063bca, 0x2a6f2b94,
+    0x09b64c2b, 0x45df5c75, 0x91646c97, 0xdd0d7cc9,
+    0x9b64c2b0, 0xd70dd2ee, 0x03b6e20c, 0x4fdff252,
+    0x6c0695ed, 0x206f85b3, 0xf4d4b551, 0xb8bda50f,
+    0xaed16a4a, 0xe2b87a14, 0x36034af6, 0x7a6a5aa8,
+    0x59b33d17, 0x15da2d49, 0xc1611dab, 0x8d080df5,
+    0x86d3d2d4, 0xcabac28a, 0x1e01f268, 0x5268e236,
+    0x71b18589, 0x3dd895d7, 0xe963a535, 0xa50ab56b,
+    0xb3667a2e, 0xff0f6a70, 0x2bb45a92, 0x67dd4acc,
+    0x44042d73, 0x086d3d2d, 0xdcd60dcf, 0x90bf1d91,
+    0xa00ae278, 0xec63f226, 0x38d8c2c4, 0x74b1d29a,
+    0x5768b525, 0x1b01a57b, 0xcfba9599, 0x83d385c7,
+    0x95bf4a82, 0xd9d65adc, 0x0d6d6a3e, 0x41047a60,
+    0x62dd1ddf, 0x2eb40d81, 0xfa0f3d63, 0xb6662d3d,
+    0xbdbdf21c, 0xf1d4e242, 0x256fd2a0, 0x6906c2fe,
+    0x4adfa541, 0x06b6b51f, 0xd20d85fd, 0x9e6495a3,
+    0x88085ae6, 0xc4614ab8, 0x10da7a5a, 0x5cb36a04,
+    0x7f6a0dbb, 0x33031de5, 0xe7b82d07, 0xabd13d59
+};
+
+#define crcByteIndex(crc, data) ((((crc) ^ (data)) & 0x0f) | ((((crc) >> 4) ^ (data)) & 0xf0))
+#endif // CRC_BYTE_TABLE
+
+#ifdef CRC_SLICING
+//
+// the register after 8 raw steps is linear in the register before and
+// the 8 data bytes: a table per byte of the register and of the data
+//
+#define CRC_SLICE               8
+
+static uint32_t sliceRegister[4][256];
+static uint32_t sliceData[CRC_SLICE][256];
+static uint32_t sliceInvert;       // what the inversion after every byte adds
+static bool sliceReady = false;
+#endif // CRC_SLICING
+
+#if defined(CRC_SLICING)
+static int crcMethod = EEPROM_CRC_SLICE8;
+#elif defined(CRC_BYTE_TABLE)
+static int crcMethod = EEPROM_CRC_BYTE;
+#else
+static int crcMethod = EEPROM_CRC_NIBBLE;
+#endif
+
+//
+// one byte into the register, no inversion
+//
+static inline uint32_t crcStep( uint32_t crc, unsigned char data )
+{
+  crc = pgm_read_dword( &crc_table[(crc ^ data) & 0x0f] ) ^ (crc >> 4);
+  crc = pgm_read_dword( &crc_table[((crc ^ data) >> 4) & 0x0f] ) ^ (crc >> 4);
+
+  return( crc );
+}
+
+#ifdef CRC_BYTE_TABLE
+static uint32_t runByte( uint32_t crc, const unsigned char* data, unsigned int len, uint32_t invert )
+{
+  unsigned char value = 0;
+
+  for( unsigned int i = 0; i < len; i++ )
+  {
+    if( data != NULL )
+    {
+      value = data[i];
+    }
+
+    crc = (pgm_read_dword( &crc_byte_table[crcByteIndex( crc, value )] ) ^ (crc >> 8)) ^ invert;
+  }
+
+  return( crc );
+}
+#endif // CRC_BYTE_TABLE
+
+#ifdef CRC_SLICING
+static void buildSlices( void )
+{
+  unsigned char block[CRC_SLICE];
+
+  memset( block, 0, sizeof(block) );
+
+  for( int value = 0; value < 256; value++ )
+  {
+    for( int i = 0; i < 4; i++ )
+    {
+      sliceRegister[i][value] = runByte( (uint32_t) value << (8 * i), block, CRC_SLICE, 0 );
+    }
+
+    for( int i = 0; i < CRC_SLICE; i++ )
+    {
+      block[i] = value;
+      sliceData[i][value] = runByte( 0, block, CRC_SLICE, 0 );
+      block[i] = 0;
+    }
+  }
+
+  sliceInvert = runByte( 0, block, CRC_SLICE, 0xffffffffUL );
+  sliceReady = true;
+}
+
+static uint32_t runSlices( uint32_t crc, const unsigned char* data, unsigned int len, uint32_t invert )
+{
+  uint32_t add = invert ? sliceInvert : 0;
+
+  for( ; len >= CRC_SLICE; len -= CRC_SLICE )
+  {
+    crc = sliceRegister[0][crc & 0xff] ^ sliceRegister[1][(crc >> 8) & 0xff] ^
+          sliceRegister[2][(crc >> 16) & 0xff] ^ sliceRegister[3][crc >> 24] ^ add;
+
+    if( data != NULL )
+    {
+      crc ^= sliceData[0][data[0]] ^ sliceData[1][data[1]] ^
+             sliceData[2][data[2]] ^ sliceData[3][data[3]] ^
+             sliceData[4][data[4]] ^ sliceData[5][data[5]] ^
+             sliceData[6][data[6]] ^ sliceData[7][data[7]];
+      data += CRC_SLICE;
+    }
+  }
+
+  return( runByte( crc, data, len, invert ) );
+}
+
+//
+// hosts start with the slices
+//
+static struct crcSlicesAtStart {
+  crcSlicesAtStart() { buildSlices(); }
+} crcSlicesAtStart;
+#endif // CRC_SLICING
+
+//
+// len bytes (zeros if data is NULL), invert is xor'ed after each byte
+//
+static uint32_t crcRun( uint32_t crc, const unsigned char* data, unsigned int len, uint32_t invert )
+{
+  unsigned char value = 0;
+
+#ifdef CRC_SLICING
+  if( crcMethod == EEPROM_CRC_SLICE8 && sliceReady )
+  {
+    return( runSlices( crc, data, len, invert ) );
+  }
+#endif // CRC_SLICING
+
+#ifdef CRC_BYTE_TABLE
+  if( crcMethod != EEPROM_CRC_NIBBLE )
+  {
+    return( runByte( crc, data, len, invert ) );
+  }
+#endif // CRC_BYTE_TABLE
+
+  for( unsigned int i = 0; i < len; i++ )
+  {
+    if( data != NULL )
+    {
+      value = data[i];
+    }
+
+    crc = crcStep( crc, value ) ^ invert;
+  }
+
+  return( crc );
+}
+
+uint32_t dsEepromCrcUpdate( uint32_t crc, const unsigned char* data, unsigned int len )
+{
+  return( crcRun( crc, data, len, 0xffffffffUL ) );
+}
+
+uint32_t dsEepromCrcZeros( uint32_t crc, unsigned int len )
+{
+  return( crcRun( crc, NULL, len, 0xffffffffUL ) );
+}
+
+//
+// without inversion the register is linear in the data: the change of
+// the checksum is the register run over the changed bits alone
+//
+uint32_t dsEepromCrcRaw( uint32_t crc, const unsigned char* data, unsigned int len )
+{
+  return( crcRun( crc, data, len, 0 ) );
+}
+
+uint32_t dsEepromCrcShift( uint32_t crc, unsigned int len )
+{
+  return( crcRun( crc, NULL, len, 0 ) );
+}
+
+bool dsEepromCrcAvailable( int method )
+{
+  switch( method )
+  {
+    case EEPROM_CRC_NIBBLE:
+      return( true );
+#ifdef CRC_BYTE_TABLE
+    case EEPROM_CRC_BYTE:
+      return( true );
+#endif // CRC_BYTE_TABLE
+#ifdef CRC_SLICING
+    case EEPROM_CRC_SLICE8:
+      return( true );
+#endif // CRC_SLICING
+    default:
+      return( false );
+  }
+}
+
+bool dsEepromCrcSelect( int method )
+{
+  if( !dsEepromCrcAvailable( method ) )
+  {
+    return( false );
+  }
+
+#ifdef CRC_SLICING
+  if( method == EEPROM_CRC_SLICE8 && !sliceReady )
+  {
+    buildSlices();
+  }
+#endif // CRC_SLICING
+
+  crcMethod = method;
+
+  return( true );
+}
+
+int dsEepromCrcMethod( void )
+{
+  return( crcMethod );
+}
@@ -0,0 +1,109 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   Checksum of the dsEeprom image.
+//   This is built like the CRC32 of the Arduino examples (reflected,
+//   polynom 0xedb88320, a nibble table), but the step for the high
+//   nibble uses bits 4..7 of the register instead of bits 0..3 and the
+//   register is inverted after every byte. So it is not the usual CRC32 value -
+//   always use these functions to build or check an image, on the MCU
+//   as well as on a host.
+//   The file does not depend on Arduino, the host tools use it, too.
+//
+//   Without the inversion the register is linear in the data. If bytes
+//   of an image are xor'ed with a delta, the checksum changes by the
+//   raw register run over the delta and shifted over the bytes that
+//   follow up to the end of the checksum range:
+//
+//     crc = 0
+//     for every changed range (ascending):
+//       crc = dsEepromCrcShift( crc, gap to the previous range )
+//       crc = dsEepromCrcRaw( crc, delta, length )
+//     crc = dsEepromCrcShift( crc, rest up to the end )
+//     new checksum = old checksum ^ crc
+//
+//   So a checksum is updated without reading the unchanged bytes.
+//
+//   Implementations (all give the same value, dsEepromCrcSelect()):
+//
+//     EEPROM_CRC_NIBBLE   the 16 entry table above, two steps per byte
+//     EEPROM_CRC_BYTE     one step per byte with a 256 entry table
+//                         (1 KB flash), not on AVR unless
+//                         DSEEPROM_CRC_BYTE_TABLE is defined
+//     EEPROM_CRC_SLICE8   8 bytes per step, 12 tables built in RAM
+//                         (12 KB), default on hosts, on the MCU with
+//                         DSEEPROM_CRC_SLICING
+//
+//   The fastest one compiled in is selected at start.
+//   The byte table is possible because a step only uses bits 0..3 and
+//   8..11 of the register, bits 4..7 are shifted out unused. Hardware
+//   CRC32 (ESP32 ROM crc32_le, SSE4.2, carry-less multiply) can't be
+//   used: it computes the usual CRC32, and the dropped bits make the
+//   step here no multiplication modulo a polynom.
+//
+// ************************************************************************
+//
+//
+//-------- History --------------------------------------------------------
+//
+// 2016/10/28: initial version
+//
+//
+// ************************************************************************
+
+#ifndef _DSEEPROMCRC_H_
+#define _DSEEPROMCRC_H_
+
+#include <inttypes.h>
+
+#define EEPROM_CRC_INIT         0xffffffffUL
+#define EEPROM_CRC_POLYNOM      0xedb88320UL
+
+#define EEPROM_CRC_NIBBLE       0
+#define EEPROM_CRC_BYTE         1
+#define EEPROM_CRC_SLICE8       2
+#define EEPROM_CRC_METHODS      3
+
+//
+// continue a checksum over len more bytes
+//
+uint32_t dsEepromCrcUpdate( uint32_t crc, const unsigned char* data, unsigned int len );
+//
+// continue a checksum over len zero bytes
+//
+uint32_t dsEepromCrcZeros( uint32_t crc, unsigned int len );
+//
+// raw register (no inversion) over len bytes of a delta
+//
+uint32_t dsEepromCrcRaw( uint32_t crc, const unsigned char* data, unsigned int len );
+//
+// raw register over len bytes of no change
+//
+uint32_t dsEepromCrcShift( uint32_t crc, unsigned int len );
+//
+// use an implementation from now on, false if it is not compiled in.
+// Not while another thread computes a checksum.
+//
+bool dsEepromCrcSelect( int method );
+int dsEepromCrcMethod( void );
+bool dsEepromCrcAvailable( int method );
+
+#endif // _DSEEPROMCRC_H_
@@ -0,0 +1,192 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   Storage devices for dsEeprom - common part and onchip EEPROM.
+//
+// ************************************************************************
+//
+//
+//-------- History --------------------------------------------------------
+//
+// 2016/10/28: initial version
+//
+//
+// ************************************************************************
+//
+
+#include <Arduino.h>
+#include <dsEeprom.h>
+
+//
+// ************************************************************************
+// common part of all devices
+// ************************************************************************
+//
+
+dsEepromDevice::~dsEepromDevice()
+{
+}
+
+//
+// default for devices without sequential read: byte by byte
+//
+int dsEepromDevice::readBlock( int address, unsigned char* data, int len )
+{
+  for( int i = 0; i < len; i++ )
+  {
+    data[i] = read( address + i );
+  }
+
+  return( len );
+}
+
+//
+// default for devices that write through
+//
+int dsEepromDevice::commit( void )
+{
+  return( E_SUCCESS );
+}
+
+bool dsEepromDevice::commitsWhole( void )
+{
+  return( false );
+}
+
+//
+// default for devices behind a bus
+//
+bool dsEepromDevice::concurrentReads( void )
+{
+  return( false );
+}
+
+//
+// default for devices without a RAM copy
+//
+const unsigned char* dsEepromDevice::memory( int address, int len )
+{
+  (void) address;
+  (void) len;
+
+  return( NULL );
+}
+
+//
+// ************************************************************************
+// onchip EEPROM
+// ************************************************************************
+//
+
+dsEepromOnchip::dsEepromOnchip()
+{
+  beginSize = 0;
+}
+
+int dsEepromOnchip::begin( unsigned int size )
+{
+  if( size <= beginSize )
+  {
+    return( E_SUCCESS );
+  }
+
+#if defined(ESP32)
+  if( !EEPROM.begin(size) )
+  {
+    return( E_DEVICE_IO );
+  }
+#elif defined(ESP8266)
+  EEPROM.begin(size);
+#else
+  EEPROM.begin();
+#endif // ESP32
+
+  beginSize = size;
+
+  return( E_SUCCESS );
+}
+
+unsigned int dsEepromOnchip::capacity( void )
+{
+  return( EEPROM_MAX_SIZE );
+}
+
+unsigned char dsEepromOnchip::read( int address )
+{
+  return( EEPROM.read( address ) );
+}
+
+void dsEepromOnchip::write( int address, unsigned char value )
+{
+  EEPROM.write( address, value );
+}
+
+int dsEepromOnchip::commit( void )
+{
+#if defined(ESP8266) || defined(ESP32)
+  if( !EEPROM.commit() )
+  {
+    return( E_DEVICE_IO );
+  }
+#endif // ESP8266 || ESP32
+
+  return( E_SUCCESS );
+}
+
+bool dsEepromOnchip::commitsWhole( void )
+{
+#if defined(ESP8266) || defined(ESP32)
+  return( true );
+#else
+  return( false );
+#endif // ESP8266 || ESP32
+}
+
+//
+// ESP8266 and ESP32 read from the RAM copy of the flash sector
+//
+bool dsEepromOnchip::concurrentReads( void )
+{
+#if defined(ESP8266) || defined(ESP32)
+  return( true );
+#else
+  return( false );
+#endif // ESP8266 || ESP32
+}
+
+//
+// ESP8266 and ESP32 keep the content in RAM from begin() on
+//
+const unsigned char* dsEepromOnchip::memory( int address, int len )
+{
+  if( address < 0 || len < 0 || (unsigned int) (address + len) > beginSize )
+  {
+    return( NULL );
+  }
+
+#if defined(ESP8266)
+  return( EEPROM.getConstDataPtr() + address );
+#elif defined(ESP32)
+  return( EEPROM.getDataPtr() + address );
+#else
+  return( NULL );
+#endif // ESP8266
+}
@@ -0,0 +1,109 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   Storage devices for dsEeprom.
+//   A dsEeprom instance does not access the EEPROM class directly but
+//   through a dsEepromDevice. By default this is the onchip EEPROM,
+//   other devices (e.g. an external 24Cxx) may be passed to the
+//   constructor or to init().
+//   A device only has to provide byte access. Devices that are able
+//   to do better than byte by byte (sequential reads, page writes)
+//   overwrite readBlock() and buffer writes until commit().
+//
+// ************************************************************************
+//
+//
+//-------- History --------------------------------------------------------
+//
+// 2016/10/28: initial version
+//
+//
+// ************************************************************************
+
+#ifndef _DSEEPROMDEVICE_H_
+#define _DSEEPROMDEVICE_H_
+
+#include <inttypes.h>
+
+class dsEepromDevice {
+
+  public:
+    virtual ~dsEepromDevice();
+    //
+    // prepare the device for use of (at least) size bytes
+    // partitions sharing a device call this once each, so a device
+    // must not lose its content if it is already prepared for size
+    //
+    virtual int begin( unsigned int size ) = 0;
+    //
+    // max. number of bytes the device is able to hold
+    //
+    virtual unsigned int capacity( void ) = 0;
+    virtual unsigned char read( int address ) = 0;
+    virtual void write( int address, unsigned char value ) = 0;
+    //
+    // read len bytes starting at address, returns the number of bytes read
+    //
+    virtual int readBlock( int address, unsigned char* data, int len );
+    //
+    // make all pending writes persistent
+    //
+    virtual int commit( void );
+    //
+    // true if commit() writes the whole image at once (ESP8266, ESP32), for
+    // such a device intermediate commits add wear but no safety
+    //
+    virtual bool commitsWhole( void );
+    //
+    // true if read() may run while another thread writes, because the
+    // device reads from memory (see DSEEPROM_THREADSAFE in dsEeprom.h)
+    //
+    virtual bool concurrentReads( void );
+    //
+    // the RAM copy of len bytes at address, NULL if the device holds
+    // none (see dsEeprom::viewString()), valid until the next begin()
+    //
+    virtual const unsigned char* memory( int address, int len );
+};
+
+//
+// the onchip EEPROM of an Arduino, ESP8266 or ESP32 (the EEPROM class
+// of the core, a RAM copy of flash on the ESP)
+//
+class dsEepromOnchip : public dsEepromDevice {
+
+  private:
+    unsigned int beginSize;
+
+  public:
+    dsEepromOnchip();
+    int begin( unsigned int size );
+    unsigned int capacity( void );
+    unsigned char read( int address );
+    void write( int address, unsigned char value );
+    int commit( void );
+    bool commitsWhole( void );
+    bool concurrentReads( void );
+    const unsigned char* memory( int address, int len );
+};
+
+
+#endif // _DSEEPROMDEVICE_H_
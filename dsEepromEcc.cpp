@@ -0,0 +1,158 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   Error correction for dsEeprom images.
+//   Please refer to dsEepromEcc.h for a description.
+//
+// ************************************************************************
+//
+//
+//-------- History --------------------------------------------------------
+//
+// 2016/10/28: initial version
+//
+//
+// ************************************************************************
+//
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const unsigned char*)(addr))
+#endif // ARDUINO
+
+#include <dsEepromEcc.h>
+
+// ************************************************************************
+// Hamming positions of the 64 data bits, xor'ed per nibble: entry
+// [n][v] is the xor of the positions of the set bits of value v in
+// nibble n of the block
+// ************************************************************************
+//
+static const PROGMEM unsigned char ecc_nibble[16][16] = {
+    { 0x00, 0x03, 0x05, 0x06, 0x06, 0x05, 0x03, 0x00, 0x07, 0x04, 0x02, 0x01, 0x01, 0x02, 0x04, 0x07 },
+    { 0x00, 0x09, 0x0a, 0x03, 0x0b, 0x02, 0x01, 0x08, 0x0c, 0x05, 0x06, 0x0f, 0x07, 0x0e, 0x0d, 0x04 },
+    { 0x00, 0x0d, 0x0e, 0x03, 0x0f, 0x02, 0x01, 0x0c, 0x11, 0x1c, 0x1f, 0x12, 0x1e, 0x13, 0x10, 0x1d },
+    { 0x00, 0x12, 0x13, 0x01, 0x14, 0x06, 0x07, 0x15, 0x15, 0x07, 0x06, 0x14, 0x01, 0x13, 0x12, 0x00 },
+    { 0x00, 0x16, 0x17, 0x01, 0x18, 0x0e, 0x0f, 0x19, 0x19, 0x0f, 0x0e, 0x18, 0x01, 0x17, 0x16, 0x00 },
+    { 0x00, 0x1a, 0x1b, 0x01, 0x1c, 0x06, 0x07, 0x1d, 0x1d, 0x07, 0x06, 0x1c, 0x01, 0x1b, 0x1a, 0x00 },
+    { 0x00, 0x1e, 0x1f, 0x01, 0x21, 0x3f, 0x3e, 0x20, 0x22, 0x3c, 0x3d, 0x23, 0x03, 0x1d, 0x1c, 0x02 },
+    { 0x00, 0x23, 0x24, 0x07, 0x25, 0x06, 0x01, 0x22, 0x26, 0x05, 0x02, 0x21, 0x03, 0x20, 0x27, 0x04 },
+    { 0x00, 0x27, 0x28, 0x0f, 0x29, 0x0e, 0x01, 0x26, 0x2a, 0x0d, 0x02, 0x25, 0x03, 0x24, 0x2b, 0x0c },
+    { 0x00, 0x2b, 0x2c, 0x07, 0x2d, 0x06, 0x01, 0x2a, 0x2e, 0x05, 0x02, 0x29, 0x03, 0x28, 0x2f, 0x04 },
+    { 0x00, 0x2f, 0x30, 0x1f, 0x31, 0x1e, 0x01, 0x2e, 0x32, 0x1d, 0x02, 0x2d, 0x03, 0x2c, 0x33, 0x1c },
+    { 0x00, 0x33, 0x34, 0x07, 0x35, 0x06, 0x01, 0x32, 0x36, 0x05, 0x02, 0x31, 0x03, 0x30, 0x37, 0x04 },
+    { 0x00, 0x37, 0x38, 0x0f, 0x39, 0x0e, 0x01, 0x36, 0x3a, 0x0d, 0x02, 0x35, 0x03, 0x34, 0x3b, 0x0c },
+    { 0x00, 0x3b, 0x3c, 0x07, 0x3d, 0x06, 0x01, 0x3a, 0x3e, 0x05, 0x02, 0x39, 0x03, 0x38, 0x3f, 0x04 },
+    { 0x00, 0x3f, 0x41, 0x7e, 0x42, 0x7d, 0x03, 0x3c, 0x43, 0x7c, 0x02, 0x3d, 0x01, 0x3e, 0x40, 0x7f },
+    { 0x00, 0x44, 0x45, 0x01, 0x46, 0x02, 0x03, 0x47, 0x47, 0x03, 0x02, 0x46, 0x01, 0x45, 0x44, 0x00 }
+};
+
+static unsigned char parity( unsigned char value )
+{
+  value ^= value >> 4;
+  value ^= value >> 2;
+  value ^= value >> 1;
+
+  return( value & 1 );
+}
+
+//
+// xor of the positions of the set bits and the parity of all bits
+//
+static unsigned char syndrome( const unsigned char* data, unsigned char* bits )
+{
+  unsigned char result = 0;
+  unsigned char all = 0;
+  unsigned char value;
+
+  for( int i = 0; i < EEPROM_ECC_BLOCK; i++ )
+  {
+    value = data[i];
+    all ^= value;
+    result ^= pgm_read_byte( &ecc_nibble[2 * i][value & 0x0f] ) ^
+              pgm_read_byte( &ecc_nibble[2 * i + 1][value >> 4] );
+  }
+
+  *bits = parity( all );
+
+  return( result );
+}
+
+unsigned char dsEepromEccEncode( const unsigned char* data )
+{
+  unsigned char bits;
+  unsigned char check;
+
+  check = syndrome( data, &bits );
+
+  return( check | ((bits ^ parity( check )) << 7) );
+}
+
+int dsEepromEccCorrect( unsigned char* data, unsigned char* check )
+{
+  unsigned char bits;
+  unsigned char position;
+  unsigned char log2;
+  int index;
+
+  position = syndrome( data, &bits ) ^ (*check & 0x7f);
+  bits ^= parity( *check );
+
+  if( bits == 0 )
+  {
+    return( position == 0 ? EEPROM_ECC_CLEAN : EEPROM_ECC_UNCORRECTABLE );
+  }
+
+  //
+  // a single bit: overall parity, a check bit or a data bit
+  //
+  if( position == 0 )
+  {
+    *check ^= 0x80;
+    return( EEPROM_ECC_CORRECTED );
+  }
+
+  if( (position & (position - 1)) == 0 )
+  {
+    *check ^= position;
+    return( EEPROM_ECC_CORRECTED );
+  }
+
+  for( log2 = 0; (position >> (log2 + 1)) != 0; log2++ )
+  {
+  }
+
+  //
+  // the position skips the powers of two up to it
+  //
+  index = position - log2 - 2;
+
+  if( index >= EEPROM_ECC_BLOCK * 8 )
+  {
+    return( EEPROM_ECC_UNCORRECTABLE );
+  }
+
+  data[index / 8] ^= 1 << (index % 8);
+
+  return( EEPROM_ECC_CORRECTED );
+}
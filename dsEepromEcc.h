@@ -0,0 +1,72 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   Error correction for dsEeprom images: an extended Hamming code
+//   (SECDED 72,64) over blocks of 8 bytes with one check byte each.
+//   A single bit error in a block (data or check byte) is corrected,
+//   two bit errors are detected.
+//
+//   Bit i of a block (bit i%8 of byte i/8) has the i-th number that
+//   is not a power of two as its Hamming position, the low 7 bits of
+//   the check byte are the xor of the positions of all set bits, bit 7
+//   makes the parity of data and check byte even. So the syndrome of
+//   a single data bit error is its position.
+//
+//   The file does not depend on Arduino, the host tools use it, too.
+//
+// ************************************************************************
+//
+//
+//-------- History --------------------------------------------------------
+//
+// 2016/10/28: initial version
+//
+//
+// ************************************************************************
+
+#ifndef _DSEEPROMECC_H_
+#define _DSEEPROMECC_H_
+
+#include <inttypes.h>
+
+#define EEPROM_ECC_BLOCK            8  // data bytes per check byte
+//
+// check bytes needed for a region of len bytes
+//
+#define EEPROM_ECC_PARITY_LEN(len) (((len) + EEPROM_ECC_BLOCK - 1) / EEPROM_ECC_BLOCK)
+//
+// results of dsEepromEccCorrect()
+//
+#define EEPROM_ECC_CLEAN            0
+#define EEPROM_ECC_CORRECTED        1
+#define EEPROM_ECC_UNCORRECTABLE   -1
+
+//
+// check byte of a block
+//
+unsigned char dsEepromEccEncode( const unsigned char* data );
+//
+// check a block and its check byte, a single bit error is corrected
+// in place (data or check)
+//
+int dsEepromEccCorrect( unsigned char* data, unsigned char* check );
+
+#endif // _DSEEPROMECC_H_
@@ -0,0 +1,321 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   dsEeprom device for Linux hosts, image kept in a mapped file.
+//   Please refer to dsEepromFile.h for a description.
+//
+// ************************************************************************
+//
+//
+//-------- History --------------------------------------------------------
+//
+// 2016/10/28: initial version
+//
+//
+// ************************************************************************
+//
+
+#ifdef __linux__
+
+#include <Arduino.h>
+#include <dsEepromFile.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+dsEepromFile::dsEepromFile( const char* path )
+{
+  snprintf( imagePath, sizeof(imagePath), "%s", path );
+  snprintf( tempPath, sizeof(tempPath), "%s%s", imagePath, EEFILE_TEMP_SUFFIX );
+
+  image = NULL;
+  imageSize = 0;
+  dirty = false;
+}
+
+dsEepromFile::~dsEepromFile()
+{
+  if( image != NULL )
+  {
+    fileUnmap( image, imageSize );
+  }
+}
+
+//
+// ************************************************************************
+// file access
+// ************************************************************************
+//
+
+//
+// size bytes of the image file, the bytes past its end are 0. A file
+// big enough is mapped, a smaller one (or none) is read into anonymous
+// memory - the file itself is not touched before commit()
+//
+unsigned char* dsEepromFile::fileMap( unsigned int size )
+{
+  struct stat st;
+  void *mapping = MAP_FAILED;
+  int fd;
+
+  if( (fd = open( imagePath, O_RDONLY )) < 0 )
+  {
+    mapping = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+  }
+  else
+  {
+    if( fstat( fd, &st ) == 0 )
+    {
+      if( st.st_size >= (off_t) size )
+      {
+        mapping = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 );
+      }
+      else
+      {
+        mapping = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+        if( mapping != MAP_FAILED && pread( fd, mapping, st.st_size, 0 ) != st.st_size )
+        {
+          munmap( mapping, size );
+          mapping = MAP_FAILED;
+        }
+      }
+    }
+    ::close( fd );
+  }
+
+  return( mapping == MAP_FAILED ? NULL : (unsigned char*) mapping );
+}
+
+void dsEepromFile::fileUnmap( unsigned char* mapping, unsigned int size )
+{
+  munmap( mapping, size );
+}
+
+//
+// a new file with data, on disk when the call returns
+//
+int dsEepromFile::fileStore( const char* path, const unsigned char* data, unsigned int len )
+{
+  int fd;
+
+  if( (fd = open( path, O_WRONLY | O_CREAT | O_TRUNC, 0644 )) < 0 )
+  {
+    return( E_DEVICE_IO );
+  }
+
+  if( ::write( fd, data, len ) != (ssize_t) len || fdatasync( fd ) != 0 )
+  {
+    ::close( fd );
+    unlink( path );
+    return( E_DEVICE_IO );
+  }
+
+  ::close( fd );
+
+  return( E_SUCCESS );
+}
+
+//
+// rename from to to and make the rename itself durable
+//
+int dsEepromFile::fileRename( const char* from, const char* to )
+{
+  char dirPath[EEFILE_MAX_PATH];
+  char *slash;
+  int dfd;
+
+  if( rename( from, to ) != 0 )
+  {
+    unlink( from );
+    return( E_DEVICE_IO );
+  }
+
+  snprintf( dirPath, sizeof(dirPath), "%s", to );
+  if( (slash = strrchr( dirPath, '/' )) != NULL )
+  {
+    *slash = '\0';
+  }
+  else
+  {
+    snprintf( dirPath, sizeof(dirPath), "." );
+  }
+
+  if( (dfd = open( dirPath[0] ? dirPath : "/", O_RDONLY | O_DIRECTORY )) >= 0 )
+  {
+    fsync( dfd );
+    ::close( dfd );
+  }
+
+  return( E_SUCCESS );
+}
+
+//
+// ************************************************************************
+// device interface
+// ************************************************************************
+//
+
+int dsEepromFile::begin( unsigned int size )
+{
+  unsigned char *mapping;
+
+  if( size == 0 || size > EEFILE_MAX_SIZE )
+  {
+    return( E_DEVICE_IO );
+  }
+
+  if( image != NULL && size <= imageSize )
+  {
+    return( E_SUCCESS );
+  }
+
+  //
+  // the new mapping comes from the file - pending writes go there first
+  //
+  if( image != NULL && commit() != E_SUCCESS )
+  {
+    return( E_DEVICE_IO );
+  }
+
+  if( (mapping = fileMap( size )) == NULL )
+  {
+    return( E_DEVICE_IO );
+  }
+
+  if( image != NULL )
+  {
+    fileUnmap( image, imageSize );
+  }
+
+  image = mapping;
+  imageSize = size;
+  dirty = false;
+
+  return( E_SUCCESS );
+}
+
+unsigned int dsEepromFile::capacity( void )
+{
+  return( EEFILE_MAX_SIZE );
+}
+
+unsigned char dsEepromFile::read( int address )
+{
+  if( image == NULL || address < 0 || (unsigned int) address >= imageSize )
+  {
+    return( 0 );
+  }
+
+  return( image[address] );
+}
+
+void dsEepromFile::write( int address, unsigned char value )
+{
+  if( image != NULL && address >= 0 && (unsigned int) address < imageSize &&
+      image[address] != value )
+  {
+    image[address] = value;
+    dirty = true;
+  }
+}
+
+int dsEepromFile::readBlock( int address, unsigned char* data, int len )
+{
+  int chunk = 0;
+
+  if( image != NULL && address >= 0 && (unsigned int) address < imageSize )
+  {
+    chunk = len;
+
+    if( (unsigned int) (address + chunk) > imageSize )
+    {
+      chunk = imageSize - address;
+    }
+
+    memcpy( data, &image[address], chunk );
+  }
+
+  for( int i = chunk; i < len; i++ )
+  {
+    data[i] = 0;
+  }
+
+  return( len );
+}
+
+//
+// the whole image to the temporary file, then the rename - the commit
+// point
+//
+int dsEepromFile::commit( void )
+{
+  int retVal;
+
+  if( image == NULL )
+  {
+    return( E_DEVICE_IO );
+  }
+
+  if( !dirty )
+  {
+    return( E_SUCCESS );
+  }
+
+  if( (retVal = fileStore( tempPath, image, imageSize )) == E_SUCCESS &&
+      (retVal = fileRename( tempPath, imagePath )) == E_SUCCESS )
+  {
+    dirty = false;
+  }
+
+  return( retVal );
+}
+
+//
+// every commit() writes the whole image
+//
+bool dsEepromFile::commitsWhole( void )
+{
+  return( true );
+}
+
+//
+// reads come from the mapping
+//
+bool dsEepromFile::concurrentReads( void )
+{
+  return( true );
+}
+
+const unsigned char* dsEepromFile::memory( int address, int len )
+{
+  if( image == NULL || address < 0 || len < 0 || (unsigned int) (address + len) > imageSize )
+  {
+    return( NULL );
+  }
+
+  return( &image[address] );
+}
+
+#endif // __linux__
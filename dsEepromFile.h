@@ -0,0 +1,90 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   dsEeprom device for Linux hosts (e.g. a Raspberry Pi gateway) that
+//   keeps the EEPROM image in a file.
+//   The image file is mapped privately, writes go to the mapping and
+//   never reach the file on their own. commit() writes the whole image
+//   to a temporary file, syncs it and renames it over the image file,
+//   then syncs the directory. So the file holds the image of the last
+//   commit or of the one before, never a mix - validate() is crash
+//   safe. A temporary file left by a crash is overwritten by the next
+//   commit().
+//   All file access is done by the protected file*() members, so the
+//   file system may be replaced by a model for tests on a host.
+//
+// ************************************************************************
+//
+//
+//-------- History --------------------------------------------------------
+//
+// 2016/10/28: initial version
+//
+//
+// ************************************************************************
+
+#ifndef _DSEEPROMFILE_H_
+#define _DSEEPROMFILE_H_
+
+#ifdef __linux__
+
+#include <dsEeprom.h>
+
+#ifndef EEFILE_MAX_SIZE
+#define EEFILE_MAX_SIZE          0x100000    // 1 MB
+#endif // EEFILE_MAX_SIZE
+#define EEFILE_MAX_PATH               256
+#define EEFILE_TEMP_SUFFIX         ".tmp"
+
+class dsEepromFile : public dsEepromDevice {
+
+  protected:
+    char imagePath[EEFILE_MAX_PATH];
+    char tempPath[EEFILE_MAX_PATH + sizeof(EEFILE_TEMP_SUFFIX)];
+    unsigned char *image;
+    unsigned int imageSize;
+    bool dirty;
+
+    //
+    // file access - overwrite to run against a model of the file system
+    //
+    virtual unsigned char* fileMap( unsigned int size );
+    virtual void fileUnmap( unsigned char* mapping, unsigned int size );
+    virtual int fileStore( const char* path, const unsigned char* data, unsigned int len );
+    virtual int fileRename( const char* from, const char* to );
+
+  public:
+    dsEepromFile( const char* path );
+    virtual ~dsEepromFile();
+    int begin( unsigned int size );
+    unsigned int capacity( void );
+    unsigned char read( int address );
+    void write( int address, unsigned char value );
+    int readBlock( int address, unsigned char* data, int len );
+    int commit( void );
+    bool commitsWhole( void );
+    bool concurrentReads( void );
+    const unsigned char* memory( int address, int len );
+};
+
+#endif // __linux__
+
+#endif // _DSEEPROMFILE_H_
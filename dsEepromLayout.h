@@ -0,0 +1,111 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   Layout of a dsEeprom image: header, standard fields and the
+//   begin of the extended data area.
+//   The file does not depend on Arduino, so the host tools build and
+//   decode images with the very same positions as the library.
+//
+// ************************************************************************
+//
+//
+//-------- History --------------------------------------------------------
+//
+// 2016/10/28: initial version
+//
+//
+// ************************************************************************
+
+#ifndef _DSEEPROMLAYOUT_H_
+#define _DSEEPROMLAYOUT_H_
+
+//
+// The member function version2Magic() simply returns the defined value
+// of EEPROM_MAGIC_BYTE. The version of the layout (schema) is kept
+// in the header beside the magic, see setSchemaVersion() and migrate().
+//
+#define EEPROM_MAGIC_BYTE              0x7e
+//
+#define EEPROM_LEADING_LENGTH             2  // means two byte representing 
+//                                           // the real length of the data field
+#define EEPROM_MAXLEN_MAGIC               1
+#define EEPROM_MAXLEN_CRC32               4
+#define EEPROM_MAXLEN_VERSION             2
+//
+#define EEPROM_MAXLEN_BOOLEAN             1
+#define EEPROM_MAXLEN_LONG                4
+#define EEPROM_MAXLEN_SHORT               2
+#define EEPROM_MAXLEN_CHAR                1
+//
+#define EEPROM_MAXLEN_WLAN_SSID          32  // max. length a SSID may have
+#define EEPROM_MAXLEN_WLAN_PASSPHRASE    64  // max. length of a WLAN passphrase
+#define EEPROM_MAXLEN_SERVER_IP          19  // max. length for the server IP
+#define EEPROM_MAXLEN_SERVER_PORT         4  // max. length for the server port
+#define EEPROM_MAXLEN_NODENAME           32  // max. lenght of the (generated) nodename
+#define EEPROM_MAXLEN_ADMIN_PASSWORD     32  // max. length for admin password
+//
+//
+// predefined standard layout of the eeprom
+// all positions are relative to the base of the partition (see
+// initPartition()), for an instance covering the whole device the
+// base is zero:
+//
+#define EEPROM_HEADER_BEGIN         0
+//
+#define EEPROM_POS_MAGIC            0
+//
+#define EEPROM_POS_CRC32            (EEPROM_POS_MAGIC + EEPROM_MAXLEN_MAGIC)
+//
+// the schema version uses the two bytes that have been reserved
+// at the end of the header, unversioned content has 0 (or 0xffff)
+//
+#define EEPROM_POS_VERSION          (EEPROM_POS_CRC32 + EEPROM_MAXLEN_CRC32)
+//
+#define EEPROM_HEADER_END           (EEPROM_POS_VERSION + EEPROM_MAXLEN_VERSION)
+//
+// data area begins here
+//
+#define EEPROM_STD_DATA_BEGIN       EEPROM_HEADER_END       
+//
+#define EEPROM_POS_WLAN_SSID        EEPROM_STD_DATA_BEGIN
+//
+#define EEPROM_POS_WLAN_PASSPHRASE  (EEPROM_POS_WLAN_SSID + EEPROM_MAXLEN_WLAN_SSID + EEPROM_LEADING_LENGTH)
+//
+#define EEPROM_POS_SERVER_IP        (EEPROM_POS_WLAN_PASSPHRASE + EEPROM_MAXLEN_WLAN_PASSPHRASE + EEPROM_LEADING_LENGTH)
+//
+#define EEPROM_POS_SERVER_PORT      (EEPROM_POS_SERVER_IP + EEPROM_MAXLEN_SERVER_IP + EEPROM_LEADING_LENGTH)
+//
+#define EEPROM_POS_NODENAME         (EEPROM_POS_SERVER_PORT + EEPROM_MAXLEN_SERVER_PORT + EEPROM_LEADING_LENGTH)
+//
+#define EEPROM_POS_ADMIN_PASSWORD   (EEPROM_POS_NODENAME + EEPROM_MAXLEN_NODENAME + EEPROM_LEADING_LENGTH)
+//
+#define EEPROM_STD_DATA_END         (EEPROM_POS_ADMIN_PASSWORD + EEPROM_MAXLEN_ADMIN_PASSWORD + EEPROM_LEADING_LENGTH)
+//
+#define EEPROM_EXT_DATA_BEGIN       EEPROM_STD_DATA_END
+//
+// flags and limits of the schema version (see dsEeprom::migrate())
+//
+#define EEPROM_VERSION_MIGRATING   0x8000
+#define EEPROM_VERSION_FINISHING   0x4000
+#define EEPROM_VERSION_MASK        0x3fff
+#define EEPROM_VERSION_NONE        0xffff
+
+#endif // _DSEEPROMLAYOUT_H_
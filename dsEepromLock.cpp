@@ -0,0 +1,138 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   Recursive lock for the thread safe mode of dsEeprom.
+//   Please refer to dsEepromLock.h for a description.
+//
+// ************************************************************************
+//
+//
+//-------- History --------------------------------------------------------
+//
+// 2016/10/28: initial version
+//
+//
+// ************************************************************************
+//
+
+#ifdef DSEEPROM_THREADSAFE
+
+#include <dsEepromLock.h>
+
+#if defined(ESP32)
+
+static inline dsEepromThread currentThread( void )
+{
+  return( xTaskGetCurrentTaskHandle() );
+}
+
+dsEepromLock::dsEepromLock()
+{
+  mutex = xSemaphoreCreateRecursiveMutex();
+  owned = false;
+  depth = 0;
+}
+
+dsEepromLock::~dsEepromLock()
+{
+  vSemaphoreDelete( mutex );
+}
+
+void dsEepromLock::lock( void )
+{
+  xSemaphoreTakeRecursive( mutex, portMAX_DELAY );
+  owner = currentThread();
+  owned = true;
+  depth++;
+}
+
+void dsEepromLock::relax( void )
+{
+  taskYIELD();
+}
+
+#else
+
+#include <sched.h>
+
+static inline dsEepromThread currentThread( void )
+{
+  return( pthread_self() );
+}
+
+dsEepromLock::dsEepromLock()
+{
+  pthread_mutexattr_t attr;
+
+  pthread_mutexattr_init( &attr );
+  pthread_mutexattr_settype( &attr, PTHREAD_MUTEX_RECURSIVE );
+  pthread_mutex_init( &mutex, &attr );
+  pthread_mutexattr_destroy( &attr );
+  owned = false;
+  depth = 0;
+}
+
+dsEepromLock::~dsEepromLock()
+{
+  pthread_mutex_destroy( &mutex );
+}
+
+void dsEepromLock::lock( void )
+{
+  pthread_mutex_lock( &mutex );
+  owner = currentThread();
+  owned = true;
+  depth++;
+}
+
+void dsEepromLock::relax( void )
+{
+  sched_yield();
+}
+
+#endif // ESP32
+
+void dsEepromLock::unlock( void )
+{
+  if( --depth == 0 )
+  {
+    owned = false;
+  }
+
+#if defined(ESP32)
+  xSemaphoreGiveRecursive( mutex );
+#else
+  pthread_mutex_unlock( &mutex );
+#endif
+}
+
+void dsEepromLock::wait( void )
+{
+  lock();
+  unlock();
+}
+
+bool dsEepromLock::heldByMe( void )
+{
+  return( owned && owner == currentThread() );
+}
+
+#endif // DSEEPROM_THREADSAFE
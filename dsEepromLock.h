@@ -0,0 +1,90 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   Recursive lock for the thread safe mode of dsEeprom
+//   (DSEEPROM_THREADSAFE), a FreeRTOS mutex on an ESP32 and a pthread
+//   mutex on a Linux host.
+//   The lock knows its owner, so a reader that already holds it (e.g.
+//   crc() called by validate()) does not wait for itself.
+//
+// ************************************************************************
+//
+//
+//-------- History --------------------------------------------------------
+//
+// 2016/10/28: initial version
+//
+//
+// ************************************************************************
+
+#ifndef _DSEEPROMLOCK_H_
+#define _DSEEPROMLOCK_H_
+
+#ifdef DSEEPROM_THREADSAFE
+
+#include <atomic>
+
+#if defined(ESP32)
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+typedef TaskHandle_t dsEepromThread;
+#elif defined(__linux__)
+#include <pthread.h>
+typedef pthread_t dsEepromThread;
+#else
+#error "DSEEPROM_THREADSAFE needs FreeRTOS (ESP32) or pthreads (Linux)"
+#endif
+
+class dsEepromLock {
+
+  private:
+#if defined(ESP32)
+    SemaphoreHandle_t mutex;
+#else
+    pthread_mutex_t mutex;
+#endif
+    std::atomic<dsEepromThread> owner;
+    std::atomic<bool> owned;
+    unsigned int depth;
+
+  public:
+    dsEepromLock();
+    ~dsEepromLock();
+    void lock( void );
+    void unlock( void );
+    bool heldByMe( void );
+    //
+    // give the cpu away while waiting for a writer, yields to tasks of
+    // the same or a higher priority only
+    //
+    static void relax( void );
+    //
+    // block until the owner releases the lock - on an ESP32 the owner
+    // runs with the priority of the waiter meanwhile (the FreeRTOS mutex
+    // inherits priorities), so a low priority writer is not starved
+    //
+    void wait( void );
+};
+
+#endif // DSEEPROM_THREADSAFE
+
+#endif // _DSEEPROMLOCK_H_
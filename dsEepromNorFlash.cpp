@@ -0,0 +1,757 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   dsEeprom device for SPI NOR flash.
+//   Please refer to dsEepromNorFlash.h for a description of the layout.
+//
+// ************************************************************************
+//
+//
+//-------- History --------------------------------------------------------
+//
+// 2016/10/28: initial version
+//
+//
+// ************************************************************************
+//
+
+#include <Arduino.h>
+#include <dsEepromNorFlash.h>
+#include <dsEepromCrc.h>
+
+static unsigned long getLong( const unsigned char* data )
+{
+  return( (unsigned long) data[0] | ((unsigned long) data[1] << 8) |
+          ((unsigned long) data[2] << 16) | ((unsigned long) data[3] << 24) );
+}
+
+static void putLong( unsigned char* data, unsigned long value )
+{
+  data[0] = value & 0xff;
+  data[1] = (value >> 8) & 0xff;
+  data[2] = (value >> 16) & 0xff;
+  data[3] = (value >> 24) & 0xff;
+}
+
+dsEepromNorFlash::dsEepromNorFlash( SPIClass& newSpi, unsigned char newCsPin,
+                                    unsigned long newFlashBase, unsigned char newSectors )
+{
+  spi = &newSpi;
+  csPin = newCsPin;
+  flashBase = newFlashBase;
+
+  if( newSectors > EENOR_MAX_SECTORS )
+  {
+    sectorCount = EENOR_MAX_SECTORS;
+  }
+  else
+  {
+    sectorCount = newSectors;
+  }
+
+  image = NULL;
+  dirty = NULL;
+  imageSize = 0;
+  snapshotSectors = 0;
+  needSnapshot = true;
+  lastSeq = 0;
+  activeSector = EENOR_NO_SECTOR;
+  writePos = 0;
+}
+
+dsEepromNorFlash::~dsEepromNorFlash()
+{
+  delete[] image;
+  delete[] dirty;
+}
+
+//
+// ************************************************************************
+// flash access
+// ************************************************************************
+//
+
+void dsEepromNorFlash::select( void )
+{
+  spi->beginTransaction( SPISettings( EENOR_SPI_CLOCK, MSBFIRST, SPI_MODE0 ) );
+  digitalWrite( csPin, LOW );
+}
+
+void dsEepromNorFlash::deselect( void )
+{
+  digitalWrite( csPin, HIGH );
+  spi->endTransaction();
+}
+
+int dsEepromNorFlash::waitReady( unsigned long timeout )
+{
+  int retVal = E_SUCCESS;
+  unsigned long start = millis();
+
+  select();
+  spi->transfer( EENOR_CMD_READ_STATUS );
+
+  while( spi->transfer( 0 ) & EENOR_STATUS_BUSY )
+  {
+    if( millis() - start > timeout )
+    {
+      retVal = E_DEVICE_TIMEOUT;
+      break;
+    }
+    yield();
+  }
+
+  deselect();
+
+  return( retVal );
+}
+
+int dsEepromNorFlash::flashRead( unsigned long address, unsigned char* data, int len )
+{
+  select();
+  spi->transfer( EENOR_CMD_READ );
+  spi->transfer( (address >> 16) & 0xff );
+  spi->transfer( (address >> 8) & 0xff );
+  spi->transfer( address & 0xff );
+
+  for( int i = 0; i < len; i++ )
+  {
+    data[i] = spi->transfer( 0 );
+  }
+
+  deselect();
+
+  return( E_SUCCESS );
+}
+
+//
+// program data, a program command may not cross a flash page
+//
+int dsEepromNorFlash::flashProgram( unsigned long address, const unsigned char* data, int len )
+{
+  int retVal = E_SUCCESS;
+  int chunk;
+
+  for( int done = 0; done < len && retVal == E_SUCCESS; done += chunk )
+  {
+    chunk = EENOR_PAGE_SIZE - ((address + done) % EENOR_PAGE_SIZE);
+    if( chunk > len - done )
+    {
+      chunk = len - done;
+    }
+
+    select();
+    spi->transfer( EENOR_CMD_WRITE_ENABLE );
+    deselect();
+
+    select();
+    spi->transfer( EENOR_CMD_PAGE_PROGRAM );
+    spi->transfer( ((address + done) >> 16) & 0xff );
+    spi->transfer( ((address + done) >> 8) & 0xff );
+    spi->transfer( (address + done) & 0xff );
+    for( int i = 0; i < chunk; i++ )
+    {
+      spi->transfer( data[done + i] );
+    }
+    deselect();
+
+    retVal = waitReady( EENOR_PROGRAM_TIMEOUT );
+  }
+
+  return( retVal );
+}
+
+int dsEepromNorFlash::flashErase( unsigned long address )
+{
+  select();
+  spi->transfer( EENOR_CMD_WRITE_ENABLE );
+  deselect();
+
+  select();
+  spi->transfer( EENOR_CMD_SECTOR_ERASE );
+  spi->transfer( (address >> 16) & 0xff );
+  spi->transfer( (address >> 8) & 0xff );
+  spi->transfer( address & 0xff );
+  deselect();
+
+  return( waitReady( EENOR_ERASE_TIMEOUT ) );
+}
+
+//
+// ************************************************************************
+// log handling
+// ************************************************************************
+//
+
+unsigned long dsEepromNorFlash::sectorAddress( int sector )
+{
+  return( flashBase + (unsigned long) sector * EENOR_SECTOR_SIZE );
+}
+
+//
+// number of sectors a snapshot of size bytes occupies
+//
+unsigned char dsEepromNorFlash::sectorsFor( unsigned int size )
+{
+  unsigned int perSector = ((EENOR_SECTOR_SIZE - EENOR_HEADER_SIZE) /
+                  (EENOR_MAX_RECORD_DATA + EENOR_RECORD_OVERHEAD)) * EENOR_MAX_RECORD_DATA;
+
+  //
+  // the end record of the snapshot has to fit as well
+  //
+  return( (size + EENOR_RECORD_OVERHEAD + perSector - 1) / perSector );
+}
+
+int dsEepromNorFlash::freeSectors( void )
+{
+  int count = 0;
+
+  for( int i = 0; i < sectorCount; i++ )
+  {
+    if( !sectorLive[i] )
+    {
+      count++;
+    }
+  }
+
+  return( count );
+}
+
+//
+// erase the next free sector in ring order and make it the active one
+//
+int dsEepromNorFlash::openSector( unsigned char type )
+{
+  int retVal;
+  int sector = EENOR_NO_SECTOR;
+  unsigned char header[EENOR_HEADER_SIZE];
+
+  for( int i = 1; i <= sectorCount; i++ )
+  {
+    int candidate = (activeSector + i + sectorCount) % sectorCount;
+
+    if( !sectorLive[candidate] )
+    {
+      sector = candidate;
+      break;
+    }
+  }
+
+  if( sector == EENOR_NO_SECTOR )
+  {
+    return( E_DEVICE_IO );
+  }
+
+  if( (retVal = flashErase( sectorAddress( sector ) )) != E_SUCCESS )
+  {
+    return( retVal );
+  }
+
+  memset( header, 0xff, sizeof(header) );
+  putLong( &header[0], EENOR_SECTOR_MAGIC );
+  putLong( &header[4], ++lastSeq );
+  header[8] = type;
+  putLong( &header[EENOR_POS_HEADER_CRC], dsEepromCrcUpdate( EEPROM_CRC_INIT, header, EENOR_POS_HEADER_CRC ) );
+
+  if( (retVal = flashProgram( sectorAddress( sector ), header, sizeof(header) )) == E_SUCCESS )
+  {
+    sectorSeq[sector] = lastSeq;
+    sectorLive[sector] = true;
+    activeSector = sector;
+    writePos = EENOR_HEADER_SIZE;
+  }
+
+  return( retVal );
+}
+
+//
+// write one record to the active sector, data is taken from the image
+//
+int dsEepromNorFlash::appendRecord( unsigned char tag, unsigned int address, unsigned char len )
+{
+  unsigned char record[EENOR_MAX_RECORD_DATA + EENOR_RECORD_OVERHEAD];
+  int retVal;
+
+  record[0] = tag;
+  record[1] = address & 0xff;
+  record[2] = (address >> 8) & 0xff;
+  record[3] = len;
+  memcpy( &record[4], &image[address], len );
+  putLong( &record[4 + len], dsEepromCrcUpdate( EEPROM_CRC_INIT, record, 4 + len ) );
+
+  retVal = flashProgram( sectorAddress( activeSector ) + writePos, record, len + EENOR_RECORD_OVERHEAD );
+  writePos += len + EENOR_RECORD_OVERHEAD;
+
+  return( retVal );
+}
+
+//
+// garbage collection: write the whole image to free sectors
+// the old log stays valid until the end record is written
+//
+int dsEepromNorFlash::writeSnapshot( void )
+{
+  bool oldLive[EENOR_MAX_SECTORS];
+  int retVal;
+  unsigned char len;
+
+  memcpy( oldLive, sectorLive, sizeof(oldLive) );
+
+  retVal = openSector( EENOR_TYPE_SNAPSHOT );
+
+  for( unsigned int address = 0; address < imageSize && retVal == E_SUCCESS; address += len )
+  {
+    len = imageSize - address > EENOR_MAX_RECORD_DATA ? EENOR_MAX_RECORD_DATA : imageSize - address;
+
+    if( writePos + len + EENOR_RECORD_OVERHEAD > EENOR_SECTOR_SIZE )
+    {
+      if( (retVal = openSector( EENOR_TYPE_LOG )) != E_SUCCESS )
+      {
+        break;
+      }
+    }
+
+    retVal = appendRecord( EENOR_TAG_DATA, address, len );
+  }
+
+  if( retVal == E_SUCCESS )
+  {
+    if( writePos + EENOR_RECORD_OVERHEAD > EENOR_SECTOR_SIZE )
+    {
+      retVal = openSector( EENOR_TYPE_LOG );
+    }
+
+    if( retVal == E_SUCCESS &&
+        (retVal = appendRecord( EENOR_TAG_SNAPSHOT_END, 0, 0 )) == E_SUCCESS )
+    {
+      for( int i = 0; i < sectorCount; i++ )
+      {
+        if( oldLive[i] )
+        {
+          sectorLive[i] = false;
+        }
+      }
+
+      memset( dirty, 0, (imageSize + 7) / 8 );
+      needSnapshot = false;
+    }
+  }
+
+  return( retVal );
+}
+
+//
+// true if the sector reads erased from pos to its end
+//
+bool dsEepromNorFlash::erasedFrom( int sector, unsigned int pos )
+{
+  unsigned char buffer[EENOR_MAX_RECORD_DATA];
+  int chunk;
+
+  for( ; pos < EENOR_SECTOR_SIZE; pos += chunk )
+  {
+    chunk = EENOR_SECTOR_SIZE - pos > sizeof(buffer) ? sizeof(buffer) : EENOR_SECTOR_SIZE - pos;
+    flashRead( sectorAddress( sector ) + pos, buffer, chunk );
+
+    for( int i = 0; i < chunk; i++ )
+    {
+      if( buffer[i] != 0xff )
+      {
+        return( false );
+      }
+    }
+  }
+
+  return( true );
+}
+
+//
+// replay the log beginning with the snapshot in sector with startSeq
+// returns true if the snapshot was complete
+//
+bool dsEepromNorFlash::replay( unsigned long startSeq, int *lastSector,
+                               unsigned int *lastPos, unsigned long *endSeq )
+{
+  unsigned char record[EENOR_MAX_RECORD_DATA + EENOR_RECORD_OVERHEAD];
+  unsigned char header[EENOR_HEADER_SIZE];
+  bool complete = false;
+  unsigned long seq;
+  unsigned int pos;
+  unsigned int address;
+  unsigned char len;
+  int sector;
+
+  memset( image, 0xff, imageSize );
+
+  for( seq = startSeq; ; seq++ )
+  {
+    sector = EENOR_NO_SECTOR;
+
+    for( int i = 0; i < sectorCount; i++ )
+    {
+      if( sectorSeq[i] == seq )
+      {
+        sector = i;
+        break;
+      }
+    }
+
+    if( sector == EENOR_NO_SECTOR )
+    {
+      break;
+    }
+
+    //
+    // the next snapshot ends this log
+    //
+    flashRead( sectorAddress( sector ), header, EENOR_HEADER_SIZE );
+    if( seq != startSeq && header[8] == EENOR_TYPE_SNAPSHOT )
+    {
+      break;
+    }
+
+    for( pos = EENOR_HEADER_SIZE; pos + EENOR_RECORD_OVERHEAD <= EENOR_SECTOR_SIZE; )
+    {
+      flashRead( sectorAddress( sector ) + pos, record, 4 );
+
+      //
+      // bits of a cut program behind the last record close the sector
+      //
+      if( record[0] == EENOR_TAG_FREE )
+      {
+        if( !erasedFrom( sector, pos ) )
+        {
+          pos = EENOR_SECTOR_SIZE;
+        }
+        break;
+      }
+
+      address = record[1] | (record[2] << 8);
+      len = record[3];
+
+      if( len > EENOR_MAX_RECORD_DATA || pos + len + EENOR_RECORD_OVERHEAD > EENOR_SECTOR_SIZE )
+      {
+        pos = EENOR_SECTOR_SIZE;
+        break;
+      }
+
+      flashRead( sectorAddress( sector ) + pos + 4, &record[4], len + 4 );
+
+      //
+      // a torn record closes the sector for further appends
+      //
+      if( dsEepromCrcUpdate( EEPROM_CRC_INIT, record, 4 + len ) != getLong( &record[4 + len] ) )
+      {
+        pos = EENOR_SECTOR_SIZE;
+        break;
+      }
+
+      if( record[0] == EENOR_TAG_DATA && address + len <= imageSize )
+      {
+        memcpy( &image[address], &record[4], len );
+      }
+
+      if( record[0] == EENOR_TAG_SNAPSHOT_END )
+      {
+        complete = true;
+      }
+
+      pos += len + EENOR_RECORD_OVERHEAD;
+    }
+
+    *lastSector = sector;
+    *lastPos = pos;
+    *endSeq = seq;
+  }
+
+  return( complete );
+}
+
+//
+// ************************************************************************
+// device interface
+// ************************************************************************
+//
+
+int dsEepromNorFlash::begin( unsigned int size )
+{
+  unsigned char header[EENOR_HEADER_SIZE];
+  unsigned char type[EENOR_MAX_SECTORS];
+  unsigned long tried = ~0UL;
+  unsigned long endSeq = 0;
+  unsigned long candidate;
+  int lastSector = EENOR_NO_SECTOR;
+  unsigned int lastPos = 0;
+  bool found = false;
+
+  if( image != NULL && size <= imageSize )
+  {
+    return( E_SUCCESS );
+  }
+
+  snapshotSectors = sectorsFor( size );
+
+  if( size == 0 || sectorCount < 2 * snapshotSectors + 1 )
+  {
+    return( E_DEVICE_IO );
+  }
+
+  if( image == NULL || size > imageSize )
+  {
+    delete[] image;
+    delete[] dirty;
+    image = new unsigned char[size];
+    dirty = new unsigned char[(size + 7) / 8];
+    imageSize = size;
+  }
+
+  memset( dirty, 0, (imageSize + 7) / 8 );
+
+  pinMode( csPin, OUTPUT );
+  digitalWrite( csPin, HIGH );
+  spi->begin();
+
+  lastSeq = 0;
+
+  for( int i = 0; i < sectorCount; i++ )
+  {
+    flashRead( sectorAddress( i ), header, EENOR_HEADER_SIZE );
+
+    //
+    // a header cut during its program may have any bits left
+    //
+    if( getLong( &header[0] ) == EENOR_SECTOR_MAGIC &&
+        getLong( &header[EENOR_POS_HEADER_CRC] ) ==
+          dsEepromCrcUpdate( EEPROM_CRC_INIT, header, EENOR_POS_HEADER_CRC ) )
+    {
+      sectorSeq[i] = getLong( &header[4] );
+      type[i] = header[8];
+      if( sectorSeq[i] > lastSeq )
+      {
+        lastSeq = sectorSeq[i];
+      }
+    }
+    else
+    {
+      sectorSeq[i] = 0;
+      type[i] = 0;
+    }
+    sectorLive[i] = false;
+  }
+
+  //
+  // newest complete snapshot wins
+  //
+  while( !found )
+  {
+    candidate = 0;
+
+    for( int i = 0; i < sectorCount; i++ )
+    {
+      if( type[i] == EENOR_TYPE_SNAPSHOT && sectorSeq[i] < tried && sectorSeq[i] > candidate )
+      {
+        candidate = sectorSeq[i];
+      }
+    }
+
+    if( candidate == 0 )
+    {
+      break;
+    }
+
+    found = replay( candidate, &lastSector, &lastPos, &endSeq );
+    tried = candidate;
+  }
+
+  if( found )
+  {
+    for( int i = 0; i < sectorCount; i++ )
+    {
+      if( sectorSeq[i] >= tried && sectorSeq[i] <= endSeq )
+      {
+        sectorLive[i] = true;
+      }
+      else
+      {
+        //
+        // leftovers of an incomplete snapshot must not get in the way
+        // of the sequence numbers we hand out next
+        //
+        if( sectorSeq[i] > endSeq )
+        {
+          flashErase( sectorAddress( i ) );
+        }
+        sectorSeq[i] = 0;
+      }
+    }
+
+    lastSeq = endSeq;
+    activeSector = lastSector;
+    writePos = lastPos;
+    needSnapshot = false;
+  }
+  else
+  {
+    memset( image, 0xff, imageSize );
+    activeSector = EENOR_NO_SECTOR;
+    writePos = EENOR_SECTOR_SIZE;
+    needSnapshot = true;
+  }
+
+  return( E_SUCCESS );
+}
+
+//
+// largest image that leaves room for the log
+//
+unsigned int dsEepromNorFlash::capacity( void )
+{
+  unsigned int perSector = ((EENOR_SECTOR_SIZE - EENOR_HEADER_SIZE) /
+                  (EENOR_MAX_RECORD_DATA + EENOR_RECORD_OVERHEAD)) * EENOR_MAX_RECORD_DATA;
+
+  if( sectorCount < 3 )
+  {
+    return( 0 );
+  }
+
+  return( ((sectorCount - 1) / 2) * perSector - EENOR_RECORD_OVERHEAD );
+}
+
+unsigned char dsEepromNorFlash::read( int address )
+{
+  if( address < 0 || (unsigned int) address >= imageSize )
+  {
+    return( 0 );
+  }
+
+  return( image[address] );
+}
+
+void dsEepromNorFlash::write( int address, unsigned char value )
+{
+  if( address >= 0 && (unsigned int) address < imageSize && image[address] != value )
+  {
+    image[address] = value;
+    dirty[address / 8] |= 1 << (address % 8);
+  }
+}
+
+int dsEepromNorFlash::readBlock( int address, unsigned char* data, int len )
+{
+  for( int i = 0; i < len; i++ )
+  {
+    data[i] = read( address + i );
+  }
+
+  return( len );
+}
+
+//
+// append one record per changed range, ranges with small gaps are
+// merged because a record header costs more than a few unchanged bytes
+//
+int dsEepromNorFlash::commit( void )
+{
+  int retVal = E_SUCCESS;
+  unsigned int start;
+  unsigned int end;
+  unsigned int pos;
+  unsigned char len;
+
+  if( image == NULL )
+  {
+    return( E_DEVICE_IO );
+  }
+
+  if( needSnapshot )
+  {
+    return( writeSnapshot() );
+  }
+
+  for( start = 0; start < imageSize && retVal == E_SUCCESS; start = end + 1 )
+  {
+    if( !(dirty[start / 8] & (1 << (start % 8))) )
+    {
+      end = start;
+      continue;
+    }
+
+    end = start;
+    for( pos = start + 1; pos < imageSize && pos - start < EENOR_MAX_RECORD_DATA &&
+                          pos - end <= EENOR_RECORD_OVERHEAD; pos++ )
+    {
+      if( dirty[pos / 8] & (1 << (pos % 8)) )
+      {
+        end = pos;
+      }
+    }
+
+    len = end - start + 1;
+
+    if( writePos + len + EENOR_RECORD_OVERHEAD > EENOR_SECTOR_SIZE )
+    {
+      //
+      // keep enough free sectors for the next snapshot
+      //
+      if( freeSectors() - 1 >= snapshotSectors )
+      {
+        retVal = openSector( EENOR_TYPE_LOG );
+      }
+      else
+      {
+        //
+        // the snapshot contains all pending changes
+        //
+        return( writeSnapshot() );
+      }
+    }
+
+    if( retVal == E_SUCCESS )
+    {
+      retVal = appendRecord( EENOR_TAG_DATA, start, len );
+    }
+  }
+
+  if( retVal == E_SUCCESS )
+  {
+    memset( dirty, 0, (imageSize + 7) / 8 );
+  }
+
+  return( retVal );
+}
+
+//
+// reads come from the image in RAM
+//
+bool dsEepromNorFlash::concurrentReads( void )
+{
+  return( true );
+}
+
+const unsigned char* dsEepromNorFlash::memory( int address, int len )
+{
+  if( image == NULL || address < 0 || len < 0 || (unsigned int) (address + len) > imageSize )
+  {
+    return( NULL );
+  }
+
+  return( &image[address] );
+}
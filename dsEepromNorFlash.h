@@ -0,0 +1,162 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   dsEeprom device for SPI NOR flash (W25Qxx and compatibles).
+//   NOR flash can only clear bits when programming and has to erase a
+//   whole sector (4k) to set them again. So the EEPROM image is kept in
+//   RAM and stored as a log in a ring of sectors:
+//
+//   - every sector starts with a header (magic, sequence number, type
+//     and a CRC32 over them)
+//   - commit() appends one record per changed range to the active
+//     sector, a record is tag, address, length, data and a CRC32
+//   - if there are not enough free sectors left, the whole image is
+//     written as a snapshot to free sectors (garbage collection). The
+//     sectors of the old log are reused (erased) later on.
+//   - on begin() the newest complete snapshot and the log behind it
+//     are replayed. A snapshot is complete if its end record exists,
+//     so a power loss during garbage collection keeps the old log.
+//   - a power loss during a program may leave bits anywhere in the
+//     page, so the log is appended behind the last record only if the
+//     rest of the sector reads erased, else the next record opens a
+//     new sector.
+//
+//   A sector is erased right before it is opened, so erase time is
+//   spent once per 4k of log and not per update.
+//   The ring needs at least 2 * (sectors per snapshot) + 1 sectors.
+//   All flash access is done by the protected flash*() members, so the
+//   device may be replaced by a model for tests on a host.
+//
+// ************************************************************************
+//
+//
+//-------- History --------------------------------------------------------
+//
+// 2016/10/28: initial version
+//
+//
+// ************************************************************************
+
+#ifndef _DSEEPROMNORFLASH_H_
+#define _DSEEPROMNORFLASH_H_
+
+#include <dsEeprom.h>
+#include <SPI.h>
+
+#define EENOR_SECTOR_SIZE            4096
+#define EENOR_PAGE_SIZE               256
+#ifndef EENOR_MAX_SECTORS
+#define EENOR_MAX_SECTORS              16
+#endif // EENOR_MAX_SECTORS
+#ifndef EENOR_SPI_CLOCK
+#define EENOR_SPI_CLOCK          20000000
+#endif // EENOR_SPI_CLOCK
+//
+// timeouts in ms
+//
+#define EENOR_PROGRAM_TIMEOUT          10
+#define EENOR_ERASE_TIMEOUT           500
+//
+// flash commands
+//
+#define EENOR_CMD_WRITE_ENABLE       0x06
+#define EENOR_CMD_READ_STATUS        0x05
+#define EENOR_CMD_READ               0x03
+#define EENOR_CMD_PAGE_PROGRAM       0x02
+#define EENOR_CMD_SECTOR_ERASE       0x20
+#define EENOR_STATUS_BUSY            0x01
+//
+// sector header
+//
+#define EENOR_SECTOR_MAGIC     0x324c7364UL   // "dsL2", records with CRC32
+#define EENOR_HEADER_SIZE              16
+#define EENOR_POS_HEADER_CRC           12
+#define EENOR_TYPE_SNAPSHOT          0x01
+#define EENOR_TYPE_LOG               0x02
+//
+// log records
+//
+#define EENOR_TAG_FREE               0xff
+#define EENOR_TAG_DATA               0xa5
+#define EENOR_TAG_SNAPSHOT_END       0x5a
+#define EENOR_RECORD_OVERHEAD           8     // tag, address(2), length, crc32
+#define EENOR_MAX_RECORD_DATA          64
+//
+#define EENOR_NO_SECTOR                -1
+
+class dsEepromNorFlash : public dsEepromDevice {
+
+  protected:
+    SPIClass *spi;
+    unsigned char csPin;
+    unsigned long flashBase;
+    unsigned char sectorCount;
+    //
+    // image in RAM and one bit per byte for changes not yet in the log
+    //
+    unsigned char *image;
+    unsigned char *dirty;
+    unsigned int imageSize;
+    unsigned char snapshotSectors;
+    bool needSnapshot;
+    //
+    // state of the ring
+    //
+    unsigned long sectorSeq[EENOR_MAX_SECTORS];
+    bool sectorLive[EENOR_MAX_SECTORS];
+    unsigned long lastSeq;
+    int activeSector;
+    unsigned int writePos;
+
+    unsigned long sectorAddress( int sector );
+    unsigned char sectorsFor( unsigned int size );
+    int freeSectors( void );
+    int openSector( unsigned char type );
+    int appendRecord( unsigned char tag, unsigned int address, unsigned char len );
+    int writeSnapshot( void );
+    bool erasedFrom( int sector, unsigned int pos );
+    bool replay( unsigned long startSeq, int *lastSector, unsigned int *lastPos, unsigned long *endSeq );
+    //
+    // flash access - overwrite to run against a model of the device
+    //
+    void select( void );
+    void deselect( void );
+    int waitReady( unsigned long timeout );
+    virtual int flashRead( unsigned long address, unsigned char* data, int len );
+    virtual int flashProgram( unsigned long address, const unsigned char* data, int len );
+    virtual int flashErase( unsigned long address );
+
+  public:
+    dsEepromNorFlash( SPIClass& spi, unsigned char csPin, unsigned long flashBase = 0,
+                      unsigned char sectors = 4 );
+    virtual ~dsEepromNorFlash();
+    int begin( unsigned int size );
+    unsigned int capacity( void );
+    unsigned char read( int address );
+    void write( int address, unsigned char value );
+    int readBlock( int address, unsigned char* data, int len );
+    int commit( void );
+    bool concurrentReads( void );
+    const unsigned char* memory( int address, int len );
+};
+
+
+#endif // _DSEEPROMNORFLASH_H_
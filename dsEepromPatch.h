@@ -0,0 +1,67 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   Format of a binary patch of a dsEeprom image, as applied by
+//   dsEeprom::applyPatch() and generated by the host tool
+//   (extras/dseetool diff). All numbers are little endian.
+//
+//   header:
+//     'd' 'P'        magic
+//     version        EEPATCH_VERSION
+//     flags          0
+//     size (2)       block size of the image
+//     base crc (4)   checksum the image must have before
+//     target crc (4) checksum the image has after the patch
+//   runs (ascending, not overlapping, in the data area):
+//     offset (2)     position in the image
+//     length (2)     number of bytes
+//     data           the new bytes
+//
+//   The file does not depend on Arduino, the host tools use it, too.
+//
+// ************************************************************************
+//
+//
+//-------- History --------------------------------------------------------
+//
+// 2016/10/28: initial version
+//
+//
+// ************************************************************************
+
+#ifndef _DSEEPROMPATCH_H_
+#define _DSEEPROMPATCH_H_
+
+#define EEPATCH_MAGIC_0               'd'
+#define EEPATCH_MAGIC_1               'P'
+#define EEPATCH_VERSION                 1
+//
+#define EEPATCH_POS_MAGIC               0
+#define EEPATCH_POS_VERSION             2
+#define EEPATCH_POS_FLAGS               3
+#define EEPATCH_POS_SIZE                4
+#define EEPATCH_POS_BASE_CRC            6
+#define EEPATCH_POS_TARGET_CRC         10
+#define EEPATCH_HEADER_SIZE            14
+//
+#define EEPATCH_RUN_HEADER              4  // offset and length
+
+#endif // _DSEEPROMPATCH_H_
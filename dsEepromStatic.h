@@ -0,0 +1,404 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   A small variant of dsEeprom for targets with little RAM and flash
+//   (ATmega8 and the like). Header only, nothing is virtual: the
+//   storage backend is a template parameter and derives from
+//   dsEepromStatic (CRTP), so all calls are resolved at compile time
+//   and inline down to the backend. Size, magic and features are
+//   template parameters as well, the instance has no data members.
+//
+//   The image has the layout of dsEepromLayout.h, so it can be read by
+//   dsEeprom and by the host tools. Strings are plain C strings here.
+//
+//   backends:
+//     dsEepromStaticOnchip   the EEPROM class (all targets)
+//     dsEepromStaticAvr      EEPROM registers of an AVR, no EEPROM class
+//   a backend of its own provides begin(), read(), write() and
+//   commit(), see dsEepromStaticOnchip. begin() is called from setup()
+//   before the first access - a global instance may be constructed
+//   before the EEPROM class of the core.
+//
+//   features (or'ed):
+//     EESTATIC_CRC      validate() stores the checksum and isValid()
+//                       checks it
+//     EESTATIC_CHECKS   positions and lengths are checked against the
+//                       size, without it the caller has to get them right
+//
+//   example:
+//     dsEepromStaticAvr< 512, 0x7e, EESTATIC_MINIMAL > eeprom;
+//
+//     eeprom.begin();
+//     eeprom.storeString( ssid, EEPROM_MAXLEN_WLAN_SSID, EEPROM_POS_WLAN_SSID );
+//     eeprom.validate();
+//
+// ************************************************************************
+//
+//
+//-------- History --------------------------------------------------------
+//
+// 2016/10/28: initial version
+//
+//
+// ************************************************************************
+
+#ifndef _DSEEPROMSTATIC_H_
+#define _DSEEPROMSTATIC_H_
+
+#include <inttypes.h>
+#include <string.h>
+#include <dsEepromLayout.h>
+#include <dsEepromCrc.h>
+
+#define EESTATIC_CRC            0x01
+#define EESTATIC_CHECKS         0x02
+//
+#define EESTATIC_MINIMAL        0
+#define EESTATIC_DEFAULT        (EESTATIC_CRC | EESTATIC_CHECKS)
+
+template< class Backend, unsigned int Size, unsigned char Magic, unsigned char Features = EESTATIC_DEFAULT >
+class dsEepromStatic {
+
+  protected:
+    unsigned char readByte( unsigned int pos )
+    {
+      return( static_cast<Backend*>(this)->read( pos ) );
+    }
+
+    void writeByte( unsigned int pos, unsigned char value )
+    {
+      if( static_cast<Backend*>(this)->read( pos ) != value )
+      {
+        static_cast<Backend*>(this)->write( pos, value );
+      }
+    }
+
+    bool fits( int pos, int len )
+    {
+      return( !(Features & EESTATIC_CHECKS) ||
+              (pos >= 0 && len >= 0 && (unsigned int) (pos + len) <= Size) );
+    }
+
+  public:
+    unsigned int getBlocksize( void )
+    {
+      return( Size );
+    }
+
+    unsigned char getMagic( void )
+    {
+      return( Magic );
+    }
+
+    bool storeRaw( const void* data, int len, int pos )
+    {
+      if( !fits( pos, len ) )
+      {
+        return( false );
+      }
+
+      for( int i = 0; i < len; i++ )
+      {
+        writeByte( pos + i, ((const unsigned char*) data)[i] );
+      }
+
+      return( true );
+    }
+
+    bool restoreRaw( void* data, int pos, int len )
+    {
+      if( !fits( pos, len ) )
+      {
+        return( false );
+      }
+
+      for( int i = 0; i < len; i++ )
+      {
+        ((unsigned char*) data)[i] = readByte( pos + i );
+      }
+
+      return( true );
+    }
+
+    bool storeBoolean( bool value, int pos )
+    {
+      return( storeRaw( &value, EEPROM_MAXLEN_BOOLEAN, pos ) );
+    }
+
+    bool restoreBoolean( bool* value, int pos )
+    {
+      unsigned char rdValue;
+
+      if( !restoreRaw( &rdValue, pos, EEPROM_MAXLEN_BOOLEAN ) )
+      {
+        return( false );
+      }
+
+      *value = rdValue != 0;
+
+      return( true );
+    }
+
+    //
+    // a string with leading length, at most maxLen characters
+    //
+    bool storeString( const char* data, int maxLen, int pos )
+    {
+      unsigned short len = strlen( data );
+
+      if( len > maxLen )
+      {
+        len = maxLen;
+      }
+
+      if( !fits( pos, EEPROM_LEADING_LENGTH + len ) )
+      {
+        return( false );
+      }
+
+      writeByte( pos, len & 0xff );
+      writeByte( pos + 1, (len >> 8) & 0xff );
+
+      return( storeRaw( data, len, pos + EEPROM_LEADING_LENGTH ) );
+    }
+
+    //
+    // data needs room for maxLen characters and the terminating '\0',
+    // returns the length or -1
+    //
+    int restoreString( char* data, int pos, int maxLen )
+    {
+      unsigned short len;
+
+      if( !fits( pos, EEPROM_LEADING_LENGTH ) )
+      {
+        return( -1 );
+      }
+
+      len = readByte( pos ) | (readByte( pos + 1 ) << 8);
+      if( len > maxLen )
+      {
+        len = maxLen;
+      }
+
+      if( !restoreRaw( data, pos + EEPROM_LEADING_LENGTH, len ) )
+      {
+        return( -1 );
+      }
+
+      data[len] = '\0';
+
+      return( len );
+    }
+
+    //
+    // checksum as dsEeprom::crc( EEPROM_STD_DATA_BEGIN, Size ) of an
+    // instance over the whole device builds it, the range ends
+    // EEPROM_STD_DATA_BEGIN bytes behind the image
+    //
+    unsigned long crc( void )
+    {
+      uint32_t crc = EEPROM_CRC_INIT;
+      unsigned char data;
+
+      for( unsigned int pos = EEPROM_STD_DATA_BEGIN; pos < Size + EEPROM_STD_DATA_BEGIN; pos++ )
+      {
+        data = readByte( pos );
+        crc = dsEepromCrcUpdate( crc, &data, 1 );
+      }
+
+      return( crc );
+    }
+
+    void wipe( void )
+    {
+      for( unsigned int pos = 0; pos < Size; pos++ )
+      {
+        writeByte( pos, 0 );
+      }
+
+      static_cast<Backend*>(this)->commit();
+    }
+
+    //
+    // header with magic, checksum (EESTATIC_CRC) and version 0
+    //
+    void validate( void )
+    {
+      unsigned long check = 0xffffffffUL;
+
+      writeByte( EEPROM_POS_MAGIC, Magic );
+      writeByte( EEPROM_POS_VERSION, 0 );
+      writeByte( EEPROM_POS_VERSION + 1, 0 );
+
+      if( Features & EESTATIC_CRC )
+      {
+        check = crc();
+      }
+
+      for( int i = 0; i < EEPROM_MAXLEN_CRC32; i++ )
+      {
+        writeByte( EEPROM_POS_CRC32 + i, (check >> (8 * i)) & 0xff );
+      }
+
+      static_cast<Backend*>(this)->commit();
+    }
+
+    bool isValid( void )
+    {
+      unsigned long check = 0;
+
+      if( readByte( EEPROM_POS_MAGIC ) != Magic ||
+          (readByte( EEPROM_POS_VERSION + 1 ) & ((EEPROM_VERSION_MIGRATING | EEPROM_VERSION_FINISHING) >> 8)) )
+      {
+        return( false );
+      }
+
+      if( Features & EESTATIC_CRC )
+      {
+        for( int i = 0; i < EEPROM_MAXLEN_CRC32; i++ )
+        {
+          check |= (unsigned long) readByte( EEPROM_POS_CRC32 + i ) << (8 * i);
+        }
+
+        return( check == crc() );
+      }
+
+      return( true );
+    }
+};
+
+//
+// ************************************************************************
+// backends
+// ************************************************************************
+//
+
+#ifdef ARDUINO
+#include <EEPROM.h>
+
+//
+// the EEPROM class of the core - AVR, ESP8266 and ESP32
+//
+template< unsigned int Size, unsigned char Magic, unsigned char Features = EESTATIC_DEFAULT >
+class dsEepromStaticOnchip : public dsEepromStatic< dsEepromStaticOnchip< Size, Magic, Features >, Size, Magic, Features > {
+
+  public:
+    //
+    // ESP8266 and ESP32 read the flash sector into RAM here, not in a
+    // constructor: the EEPROM object of the core may not be constructed
+    // yet when a global instance is
+    //
+    void begin( void )
+    {
+#if defined(ESP8266) || defined(ESP32)
+      EEPROM.begin( Size );
+#endif // ESP8266 || ESP32
+    }
+
+    unsigned char read( unsigned int address )
+    {
+      return( EEPROM.read( address ) );
+    }
+
+    void write( unsigned int address, unsigned char value )
+    {
+      EEPROM.write( address, value );
+    }
+
+    void commit( void )
+    {
+#if defined(ESP8266) || defined(ESP32)
+      EEPROM.commit();
+#endif // ESP8266 || ESP32
+    }
+};
+#endif // ARDUINO
+
+#ifdef __AVR__
+#include <avr/io.h>
+
+//
+// ATmega8 and older parts name the write enable bits EEWE and EEMWE
+//
+#if defined(EEPE)
+#define EESTATIC_EEPE           EEPE
+#define EESTATIC_EEMPE          EEMPE
+#else
+#define EESTATIC_EEPE           EEWE
+#define EESTATIC_EEMPE          EEMWE
+#endif // EEPE
+
+//
+// the EEPROM registers of an AVR
+//
+template< unsigned int Size, unsigned char Magic, unsigned char Features = EESTATIC_DEFAULT >
+class dsEepromStaticAvr : public dsEepromStatic< dsEepromStaticAvr< Size, Magic, Features >, Size, Magic, Features > {
+
+  public:
+    //
+    // the registers need no preparation
+    //
+    void begin( void )
+    {
+    }
+
+    unsigned char read( unsigned int address )
+    {
+      while( EECR & (1 << EESTATIC_EEPE) )
+      {
+      }
+
+      EEAR = address;
+      EECR |= (1 << EERE);
+
+      return( EEDR );
+    }
+
+    //
+    // EEPE has to follow EEMPE within four cycles, so no interrupt
+    // in between
+    //
+    void write( unsigned int address, unsigned char value )
+    {
+      unsigned char sreg;
+
+      while( EECR & (1 << EESTATIC_EEPE) )
+      {
+      }
+
+      EEAR = address;
+      EEDR = value;
+
+      sreg = SREG;
+      __asm__ __volatile__ ( "cli" ::: "memory" );
+      EECR |= (1 << EESTATIC_EEMPE);
+      EECR |= (1 << EESTATIC_EEPE);
+      SREG = sreg;
+    }
+
+    void commit( void )
+    {
+    }
+};
+#endif // __AVR__
+
+#endif // _DSEEPROMSTATIC_H_
@@ -0,0 +1,109 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   Access trace of a device.
+//   Please refer to dsEepromTrace.h for a description.
+//
+// ************************************************************************
+//
+//
+//-------- History --------------------------------------------------------
+//
+// 2016/10/28: initial version
+//
+//
+// ************************************************************************
+//
+
+#include <Arduino.h>
+#include <dsEepromTrace.h>
+
+static void printTrace( char event, unsigned int address )
+{
+  Serial.print( event );
+
+  if( event == EE_TRACE_WRITE )
+  {
+    Serial.print( ' ' );
+    Serial.print( address );
+  }
+
+  Serial.println();
+}
+
+dsEepromTrace::dsEepromTrace( dsEepromDevice& newTarget, dsEepromTraceHook newHook )
+{
+  target = &newTarget;
+  setHook( newHook );
+}
+
+void dsEepromTrace::setHook( dsEepromTraceHook newHook )
+{
+  hook = newHook != NULL ? newHook : printTrace;
+}
+
+int dsEepromTrace::begin( unsigned int size )
+{
+  return( target->begin( size ) );
+}
+
+unsigned int dsEepromTrace::capacity( void )
+{
+  return( target->capacity() );
+}
+
+unsigned char dsEepromTrace::read( int address )
+{
+  return( target->read( address ) );
+}
+
+void dsEepromTrace::write( int address, unsigned char value )
+{
+  hook( EE_TRACE_WRITE, address );
+  target->write( address, value );
+}
+
+int dsEepromTrace::readBlock( int address, unsigned char* data, int len )
+{
+  return( target->readBlock( address, data, len ) );
+}
+
+int dsEepromTrace::commit( void )
+{
+  hook( EE_TRACE_COMMIT, 0 );
+
+  return( target->commit() );
+}
+
+bool dsEepromTrace::commitsWhole( void )
+{
+  return( target->commitsWhole() );
+}
+
+bool dsEepromTrace::concurrentReads( void )
+{
+  return( target->concurrentReads() );
+}
+
+const unsigned char* dsEepromTrace::memory( int address, int len )
+{
+  return( target->memory( address, len ) );
+}
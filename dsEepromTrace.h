@@ -0,0 +1,88 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   Access trace of a device for the layout optimizer (dseetool
+//   layout). dsEepromTrace sits between an instance and its device
+//   and reports every byte written and every commit to a hook:
+//
+//     dsEepromOnchip onchip;
+//     dsEepromTrace trace( onchip );
+//     dsEeprom eeprom( trace, 512, 0x7e );
+//
+//   The default hook prints one line per event on Serial, a capture
+//   of these lines is the input of dseetool layout:
+//
+//     w <address>    a byte written (device address)
+//     c              commit
+//
+//   The trace shows what reaches the device, so writes of error
+//   correction, journal and checksum are part of it. The host build
+//   of extras/powersim prints on stdout, tracesim there feeds a
+//   recorded trace to dseetool layout.
+//
+// ************************************************************************
+//
+//
+//-------- History --------------------------------------------------------
+//
+// 2016/10/28: initial version
+//
+//
+// ************************************************************************
+
+#ifndef _DSEEPROMTRACE_H_
+#define _DSEEPROMTRACE_H_
+
+#include <dsEeprom.h>
+
+#define EE_TRACE_WRITE     'w'
+#define EE_TRACE_COMMIT    'c'
+
+//
+// event and device address (0 for a commit)
+//
+typedef void (*dsEepromTraceHook)( char event, unsigned int address );
+
+class dsEepromTrace : public dsEepromDevice {
+
+  private:
+    dsEepromDevice *target;
+    dsEepromTraceHook hook;
+
+  public:
+    //
+    // hook NULL: print on Serial
+    //
+    dsEepromTrace( dsEepromDevice& target, dsEepromTraceHook hook = NULL );
+    void setHook( dsEepromTraceHook newHook );
+
+    int begin( unsigned int size );
+    unsigned int capacity( void );
+    unsigned char read( int address );
+    void write( int address, unsigned char value );
+    int readBlock( int address, unsigned char* data, int len );
+    int commit( void );
+    bool commitsWhole( void );
+    bool concurrentReads( void );
+    const unsigned char* memory( int address, int len );
+};
+
+#endif // _DSEEPROMTRACE_H_
@@ -0,0 +1,536 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   Serial export and import of a dsEeprom image.
+//   Please refer to dsEepromTransfer.h for the frames.
+//
+// ************************************************************************
+//
+//
+//-------- History --------------------------------------------------------
+//
+// 2016/10/28: initial version
+//
+//
+// ************************************************************************
+//
+
+#include <Arduino.h>
+#include <dsEeprom.h>
+
+//
+// handleFrame() wants more frames
+//
+#define EEXFER_CONTINUE         1
+//
+// where the data frames of an import go
+//
+#define EEXFER_TO_NOWHERE       0    // neither stage nor journal
+#define EEXFER_TO_STAGE         1    // the bytes that differ to the stage
+#define EEXFER_TO_JOURNAL       2    // the whole image to the journal
+//
+// the image in a journal that takes it as one run
+//
+#define EEXFER_JOURNAL_IMAGE   (EEPATCH_HEADER_SIZE + EEPATCH_RUN_HEADER)
+
+//
+// read len bytes, give up after timeout ms without a byte
+//
+static int readTimed( Stream& port, unsigned char* data, int len, unsigned long timeout )
+{
+  unsigned long lastByte = millis();
+  int done = 0;
+  int value;
+
+  while( done < len )
+  {
+    if( (value = port.read()) >= 0 )
+    {
+      data[done++] = value;
+      lastByte = millis();
+    }
+    else if( millis() - lastByte >= timeout )
+    {
+      return( E_DEVICE_TIMEOUT );
+    }
+    else
+    {
+      yield();
+    }
+  }
+
+  return( E_SUCCESS );
+}
+
+static uint32_t frameCheck( const unsigned char* frame, int len )
+{
+  return( dsEepromCrcUpdate( EEPROM_CRC_INIT, &frame[EEXFER_POS_TYPE],
+                             EEXFER_HEADER_SIZE - EEXFER_POS_TYPE + len ) );
+}
+
+static void sendFrame( Stream& port, unsigned char type, unsigned int offset,
+                       const unsigned char* data, int len )
+{
+  unsigned char frame[EEXFER_MAX_FRAME];
+  uint32_t check;
+
+  frame[EEXFER_POS_SOF] = EEXFER_SOF;
+  frame[EEXFER_POS_TYPE] = type;
+  frame[EEXFER_POS_OFFSET] = offset & 0xff;
+  frame[EEXFER_POS_OFFSET + 1] = (offset >> 8) & 0xff;
+  frame[EEXFER_POS_LENGTH] = len;
+  memcpy( &frame[EEXFER_HEADER_SIZE], data, len );
+
+  check = frameCheck( frame, len );
+  for( int i = 0; i < EEXFER_CHECK_SIZE; i++ )
+  {
+    frame[EEXFER_HEADER_SIZE + len + i] = (check >> (8 * i)) & 0xff;
+  }
+
+  port.write( frame, EEXFER_HEADER_SIZE + len + EEXFER_CHECK_SIZE );
+}
+
+static void sendAnswer( Stream& port, unsigned char type, unsigned int offset, int result )
+{
+  unsigned char code = (unsigned char) result;
+
+  sendFrame( port, type, offset, &code, 1 );
+}
+
+//
+// wait for the start of a frame and read it, returns the data length,
+// E_BAD_CRC for a damaged frame or E_DEVICE_TIMEOUT
+//
+static int receiveFrame( Stream& port, unsigned char* frame, unsigned long timeout )
+{
+  int len;
+  uint32_t check = 0;
+
+  do
+  {
+    if( readTimed( port, frame, 1, timeout ) != E_SUCCESS )
+    {
+      return( E_DEVICE_TIMEOUT );
+    }
+  } while( frame[EEXFER_POS_SOF] != EEXFER_SOF );
+
+  if( readTimed( port, &frame[EEXFER_POS_TYPE], EEXFER_HEADER_SIZE - EEXFER_POS_TYPE, timeout ) != E_SUCCESS )
+  {
+    return( E_DEVICE_TIMEOUT );
+  }
+
+  if( (len = frame[EEXFER_POS_LENGTH]) > EEXFER_MAX_DATA )
+  {
+    return( E_BAD_CRC );
+  }
+
+  if( readTimed( port, &frame[EEXFER_HEADER_SIZE], len + EEXFER_CHECK_SIZE, timeout ) != E_SUCCESS )
+  {
+    return( E_DEVICE_TIMEOUT );
+  }
+
+  for( int i = 0; i < EEXFER_CHECK_SIZE; i++ )
+  {
+    check |= (uint32_t) frame[EEXFER_HEADER_SIZE + len + i] << (8 * i);
+  }
+
+  if( check != frameCheck( frame, len ) )
+  {
+    return( E_BAD_CRC );
+  }
+
+  return( len );
+}
+
+//
+// checksum of the whole image, header included
+//
+uint32_t dsEeprom::imageChecksum( void )
+{
+  unsigned char buffer[EEPROM_READ_CHUNK];
+  uint32_t check = EEPROM_CRC_INIT;
+  int chunk;
+
+  EE_READ_BEGIN
+  check = EEPROM_CRC_INIT;
+
+  for( int pos = 0; pos < blockSize; pos += chunk )
+  {
+    chunk = blockSize - pos < EEPROM_READ_CHUNK ? blockSize - pos : EEPROM_READ_CHUNK;
+    readBlock( pos, buffer, chunk );
+    check = dsEepromCrcUpdate( check, buffer, chunk );
+  }
+
+  EE_READ_END;
+
+  return( check );
+}
+
+//
+// ************************************************************************
+// import through the journal
+// ************************************************************************
+//
+// an import that does not fit into the stage goes on in the journal of
+// setJournal(), if the journal holds the whole image
+//
+bool dsEeprom::journalTakesImage( void )
+{
+  return( journalLength >= EEPROM_JOURNAL_SIZE( EEPATCH_RUN_HEADER + (unsigned int) blockSize ) );
+}
+
+//
+// the image as it is now - with the staged bytes - to the journal, the
+// following frames are written there. The transaction is dropped.
+//
+void dsEeprom::journalImage( void )
+{
+  journalByte( EEPATCH_POS_MAGIC, 0 );
+
+  for( int i = 0; i < blockSize; i++ )
+  {
+    journalByte( EEXFER_JOURNAL_IMAGE + i, device->read( base + i ) );
+  }
+
+  if( device == &stage )
+  {
+    status &= ~EE_STATUS_MODIFIED;
+    status |= txnStatus & EE_STATUS_MODIFIED;
+    closeTxn();
+  }
+}
+
+//
+// checksum of the image in the journal, like imageChecksum()
+//
+uint32_t dsEeprom::journalChecksum( void )
+{
+  uint32_t check = EEPROM_CRC_INIT;
+  unsigned char value;
+
+  for( int pos = 0; pos < blockSize; pos++ )
+  {
+    value = journalDevice->read( journal + EEXFER_JOURNAL_IMAGE + pos );
+    check = dsEepromCrcUpdate( check, &value, 1 );
+  }
+
+  return( check );
+}
+
+//
+// write the image of the journal to the device. The journal is marked
+// done first, a power loss from then on is completed by setJournal()
+// on the next boot - which drops a journal that does not match its
+// checksum, so an image that does not match its own checksum is
+// refused with E_BAD_CRC.
+//
+int dsEeprom::finishJournal( void )
+{
+  unsigned char current[EEPROM_MAXLEN_CRC32];
+  unsigned long baseCrc = 0;
+  unsigned long targetCrc = 0;
+
+  readBlock( EEPROM_POS_CRC32, current, EEPROM_MAXLEN_CRC32 );
+  for( int i = 0; i < EEPROM_MAXLEN_CRC32; i++ )
+  {
+    baseCrc |= (unsigned long) current[i] << (8 * i);
+    targetCrc |= (unsigned long) journalDevice->read( journal + EEXFER_JOURNAL_IMAGE + EEPROM_POS_CRC32 + i ) << (8 * i);
+  }
+
+  //
+  // one run of the whole image, then the end run
+  //
+  journalHeader( baseCrc, targetCrc );
+  journalByte( EEPATCH_HEADER_SIZE, 0 );
+  journalByte( EEPATCH_HEADER_SIZE + 1, 0 );
+  journalByte( EEPATCH_HEADER_SIZE + 2, blockSize & 0xff );
+  journalByte( EEPATCH_HEADER_SIZE + 3, (blockSize >> 8) & 0xff );
+  for( int i = 0; i < EEPATCH_RUN_HEADER; i++ )
+  {
+    journalByte( EEXFER_JOURNAL_IMAGE + blockSize + i, 0 );
+  }
+
+  if( !journalMatches( targetCrc ) )
+  {
+    return( E_BAD_CRC );
+  }
+
+  if( journalDone( EEPATCH_RUN_HEADER + blockSize ) != E_SUCCESS ||
+      applyJournal( targetCrc ) != E_SUCCESS )
+  {
+    return( E_DEVICE_IO );
+  }
+
+  status |= EE_STATUS_COMMITED;
+
+  return( E_SUCCESS );
+}
+
+//
+// ************************************************************************
+// transfer
+// ************************************************************************
+//
+
+//
+// send the image from offset on
+//
+int dsEeprom::exportImage( Stream& port, unsigned int offset )
+{
+  unsigned char buffer[EEXFER_MAX_DATA];
+  uint32_t check;
+  int chunk;
+
+  if( status & EE_STATUS_INVALID_SIZE )
+  {
+    return( E_BAD_FRAME );
+  }
+
+  //
+  // no lock while sending: a store between two frames makes the
+  // checksum of the finish frame differ and the host asks again
+  //
+  for( int pos = offset; pos < blockSize; pos += chunk )
+  {
+    chunk = blockSize - pos < EEXFER_MAX_DATA ? blockSize - pos : EEXFER_MAX_DATA;
+    EE_READ_BEGIN
+    readBlock( pos, buffer, chunk );
+    EE_READ_END;
+    sendFrame( port, EEXFER_DATA, pos, buffer, chunk );
+  }
+
+  check = imageChecksum();
+  for( int i = 0; i < EEXFER_CHECK_SIZE; i++ )
+  {
+    buffer[i] = (check >> (8 * i)) & 0xff;
+  }
+
+  sendFrame( port, EEXFER_FINISH, blockSize, buffer, EEXFER_CHECK_SIZE );
+  port.flush();
+
+  return( E_SUCCESS );
+}
+
+//
+// one frame of a transfer, returns EEXFER_CONTINUE if more frames
+// are expected or the result of the transfer. route tells where the
+// data frames of an import go until the finish frame.
+//
+int dsEeprom::handleFrame( Stream& port, unsigned char* frame, int len, unsigned char& route )
+{
+  unsigned char current[EEXFER_MAX_DATA];
+  unsigned long baseCrc;
+  unsigned int offset;
+  uint32_t check = 0;
+  int retVal;
+
+  if( len < 0 )
+  {
+    sendFrame( port, EEXFER_NAK, 0, NULL, 0 );
+    return( EEXFER_CONTINUE );
+  }
+
+  offset = frame[EEXFER_POS_OFFSET] | (frame[EEXFER_POS_OFFSET + 1] << 8);
+
+  switch( frame[EEXFER_POS_TYPE] )
+  {
+    case EEXFER_EXPORT:
+      return( exportImage( port, offset ) );
+
+    case EEXFER_DATA:
+      if( offset + len > (unsigned int) blockSize )
+      {
+        sendAnswer( port, EEXFER_NAK, offset, E_BAD_FRAME );
+        return( EEXFER_CONTINUE );
+      }
+
+      //
+      // stage only what differs - saves cycles and time on an EEPROM.
+      // Without room in the stage the import goes on in the journal,
+      // without a journal for the whole image it ends, the image stays
+      // as it was.
+      //
+      {
+        EE_WRITE_GUARD;
+
+        if( route == EEXFER_TO_STAGE )
+        {
+          readBlock( offset, current, len );
+          for( int i = 0; i < len; i++ )
+          {
+            if( current[i] != frame[EEXFER_HEADER_SIZE + i] )
+            {
+              writeByte( offset + i, frame[EEXFER_HEADER_SIZE + i] );
+            }
+          }
+
+          if( stage.overflowed() && journalTakesImage() )
+          {
+            journalImage();
+            route = EEXFER_TO_JOURNAL;
+          }
+        }
+        else if( route == EEXFER_TO_NOWHERE && device != &stage && journalTakesImage() )
+        {
+          journalImage();
+          route = EEXFER_TO_JOURNAL;
+        }
+
+        if( route == EEXFER_TO_JOURNAL )
+        {
+          for( int i = 0; i < len; i++ )
+          {
+            journalByte( EEXFER_JOURNAL_IMAGE + offset + i, frame[EEXFER_HEADER_SIZE + i] );
+          }
+        }
+        else if( route == EEXFER_TO_NOWHERE || stage.overflowed() )
+        {
+          sendAnswer( port, EEXFER_NAK, offset, E_BAD_TXN );
+          return( E_BAD_TXN );
+        }
+      }
+
+      sendAnswer( port, EEXFER_ACK, offset + len, E_SUCCESS );
+      return( EEXFER_CONTINUE );
+
+    case EEXFER_FINISH:
+      for( int i = 0; i < EEXFER_CHECK_SIZE && i < len; i++ )
+      {
+        check |= (uint32_t) frame[EEXFER_HEADER_SIZE + i] << (8 * i);
+      }
+
+      //
+      // the staged image is checked before anything reaches the device,
+      // its stored checksum is taken as it is. The commit is done at the
+      // end of the block, before the ack.
+      //
+      {
+        EE_WRITE_GUARD;
+
+        if( len != EEXFER_CHECK_SIZE || offset != (unsigned int) blockSize ||
+            check != (route == EEXFER_TO_JOURNAL ? journalChecksum() : imageChecksum()) )
+        {
+          sendAnswer( port, EEXFER_NAK, offset, E_BAD_CRC );
+          return( E_BAD_CRC );
+        }
+
+        if( route == EEXFER_TO_JOURNAL && (retVal = finishJournal()) != E_SUCCESS )
+        {
+          sendAnswer( port, EEXFER_NAK, offset, retVal );
+          return( retVal );
+        }
+
+        if( route == EEXFER_TO_STAGE )
+        {
+          if( !stageFits() )
+          {
+            sendAnswer( port, EEXFER_NAK, offset, E_BAD_TXN );
+            return( E_BAD_TXN );
+          }
+
+          readBlock( EEPROM_POS_CRC32, current, EEPROM_MAXLEN_CRC32 );
+          check = (unsigned long) current[0] | ((unsigned long) current[1] << 8) |
+                  ((unsigned long) current[2] << 16) | ((unsigned long) current[3] << 24);
+
+          device = stage.getTarget();
+          readBlock( EEPROM_POS_CRC32, current, EEPROM_MAXLEN_CRC32 );
+          baseCrc = (unsigned long) current[0] | ((unsigned long) current[1] << 8) |
+                    ((unsigned long) current[2] << 16) | ((unsigned long) current[3] << 24);
+
+          if( writeStage( baseCrc, check ) != E_SUCCESS )
+          {
+            sendAnswer( port, EEXFER_NAK, offset, E_DEVICE_IO );
+            return( E_DEVICE_IO );
+          }
+        }
+      }
+
+      sendAnswer( port, EEXFER_ACK, offset, E_SUCCESS );
+      return( E_SUCCESS );
+
+    default:
+      sendAnswer( port, EEXFER_NAK, offset, E_BAD_FRAME );
+      return( EEXFER_CONTINUE );
+  }
+}
+
+//
+// receive an image until the host finishes, a transfer ends after
+// timeout ms without a frame. The image is staged in a transaction
+// (setStage()) and written only after the finish frame checked it, a
+// timeout or a bad checksum leave the image as it was.
+// The stage takes the bytes that differ plus EEPATCH_RUN_HEADER bytes
+// per run - up to the size of the image for a wiped device. If it is
+// missing or full, the import goes on in the journal of setJournal()
+// on its device, if that holds EEPROM_JOURNAL_SIZE( EEPATCH_RUN_HEADER
+// + size ) bytes: no RAM beyond a frame, but all of the image is
+// written to the journal once more. Without either, or during an open
+// transaction, it fails with E_BAD_TXN.
+//
+int dsEeprom::importImage( Stream& port, unsigned long timeout )
+{
+  unsigned char frame[EEXFER_MAX_FRAME];
+  int retVal = EEXFER_CONTINUE;
+  unsigned char route;
+  int len;
+
+  if( status & EE_STATUS_INVALID_SIZE )
+  {
+    return( E_BAD_FRAME );
+  }
+
+  route = begin() == E_SUCCESS ? EEXFER_TO_STAGE : EEXFER_TO_NOWHERE;
+
+  while( retVal == EEXFER_CONTINUE )
+  {
+    if( (len = receiveFrame( port, frame, timeout )) == E_DEVICE_TIMEOUT )
+    {
+      retVal = E_DEVICE_TIMEOUT;
+    }
+    else
+    {
+      retVal = handleFrame( port, frame, len, route );
+    }
+  }
+
+  //
+  // the transaction is still open if the import did not finish
+  //
+  if( route == EEXFER_TO_STAGE && device == &stage )
+  {
+    rollback();
+  }
+
+  return( retVal );
+}
+
+//
+// to be called from loop(): serves a request of the host if there is one
+//
+int dsEeprom::serveTransfer( Stream& port )
+{
+  if( port.available() <= 0 )
+  {
+    return( E_SUCCESS );
+  }
+
+  return( importImage( port, EEXFER_TIMEOUT ) );
+}
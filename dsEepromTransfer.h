@@ -0,0 +1,89 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   Frames of the serial transfer of an image, as used by
+//   dsEeprom::exportImage()/importImage() and by the host tool
+//   (extras/dseetool export/import). All numbers are little endian.
+//
+//   frame:
+//     EEXFER_SOF
+//     type          see below
+//     offset (2)    position in the image
+//     length        number of data bytes (max. EEXFER_MAX_DATA)
+//     data
+//     check (4)     dsEepromCrcUpdate() over type .. data
+//
+//   export: the host sends EEXFER_EXPORT with an offset, the device
+//     sends the image from there in EEXFER_DATA frames, followed by
+//     EEXFER_FINISH. The host asks again from the first offset it did
+//     not receive correctly.
+//   import: the host sends EEXFER_DATA frames, the device answers each
+//     with EEXFER_ACK (offset behind the data) or EEXFER_NAK (bad
+//     frame), the host resends from the last acknowledged offset. The
+//     device stages the bytes that differ in a transaction (RAM of
+//     dsEeprom::setStage()) and writes nothing before EEXFER_FINISH.
+//     A stage that is missing or too small hands the import over to
+//     the journal of dsEeprom::setJournal(), if that takes the whole
+//     image - see dsEeprom::importImage() for the cost of both ways.
+//     Without either the import ends with EEXFER_NAK and E_BAD_TXN.
+//   EEXFER_FINISH carries the image size as offset and the checksum of
+//   the whole image as data. After an import the device writes the
+//   staged bytes only if the staged image matches (through the journal,
+//   if there is one) and answers with EEXFER_ACK or EEXFER_NAK,
+//   the result code is the data byte of the answer. A frame that
+//   arrived damaged is answered by EEXFER_NAK without data.
+//
+//   The file does not depend on Arduino, the host tools use it, too.
+//
+// ************************************************************************
+//
+//
+//-------- History --------------------------------------------------------
+//
+// 2016/10/28: initial version
+//
+//
+// ************************************************************************
+
+#ifndef _DSEEPROMTRANSFER_H_
+#define _DSEEPROMTRANSFER_H_
+
+#define EEXFER_SOF                   0xa5
+//
+#define EEXFER_EXPORT                 'E'
+#define EEXFER_DATA                   'D'
+#define EEXFER_FINISH                 'F'
+#define EEXFER_ACK                    'A'
+#define EEXFER_NAK                    'N'
+//
+#define EEXFER_POS_SOF                  0
+#define EEXFER_POS_TYPE                 1
+#define EEXFER_POS_OFFSET               2
+#define EEXFER_POS_LENGTH               4
+#define EEXFER_HEADER_SIZE              5
+#define EEXFER_CHECK_SIZE               4
+//
+#define EEXFER_MAX_DATA                64
+#define EEXFER_MAX_FRAME      (EEXFER_HEADER_SIZE + EEXFER_MAX_DATA + EEXFER_CHECK_SIZE)
+//
+#define EEXFER_TIMEOUT               1000  // ms without a frame ends a transfer
+
+#endif // _DSEEPROMTRANSFER_H_
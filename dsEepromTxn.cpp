@@ -0,0 +1,994 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   Transactions of dsEeprom.
+//   Please refer to dsEepromTxn.h for a description.
+//
+// ************************************************************************
+//
+//
+//-------- History --------------------------------------------------------
+//
+// 2016/10/28: initial version
+//
+//
+// ************************************************************************
+//
+
+#include <Arduino.h>
+#include <dsEeprom.h>
+
+static unsigned int getRunWord( const unsigned char* data )
+{
+  return( data[0] | (data[1] << 8) );
+}
+
+static unsigned long getRunLong( const unsigned char* data )
+{
+  return( (unsigned long) data[0] | ((unsigned long) data[1] << 8) |
+          ((unsigned long) data[2] << 16) | ((unsigned long) data[3] << 24) );
+}
+
+static void putRunWord( unsigned char* data, unsigned int value )
+{
+  data[0] = value & 0xff;
+  data[1] = (value >> 8) & 0xff;
+}
+
+//
+// ************************************************************************
+// the stage
+// ************************************************************************
+//
+
+dsEepromStage::dsEepromStage()
+{
+  target = NULL;
+  base = 0;
+  runs = NULL;
+  size = 0;
+  used = 0;
+  overflow = false;
+}
+
+void dsEepromStage::setBuffer( unsigned char* buffer, unsigned int bufferSize )
+{
+  runs = buffer;
+  size = buffer != NULL ? bufferSize : 0;
+}
+
+bool dsEepromStage::hasBuffer( void )
+{
+  return( runs != NULL );
+}
+
+void dsEepromStage::open( dsEepromDevice* device, unsigned int newBase )
+{
+  target = device;
+  base = newBase;
+  used = 0;
+  overflow = false;
+}
+
+dsEepromDevice* dsEepromStage::getTarget( void )
+{
+  return( target );
+}
+
+const unsigned char* dsEepromStage::getRuns( void )
+{
+  return( runs );
+}
+
+unsigned int dsEepromStage::getUsed( void )
+{
+  return( used );
+}
+
+bool dsEepromStage::overflowed( void )
+{
+  return( overflow );
+}
+
+//
+// insert len bytes at position at of the runs
+//
+bool dsEepromStage::makeRoom( unsigned int at, unsigned int len )
+{
+  if( used + len > size )
+  {
+    overflow = true;
+    return( false );
+  }
+
+  memmove( &runs[at + len], &runs[at], used - at );
+  used += len;
+
+  return( true );
+}
+
+int dsEepromStage::begin( unsigned int size )
+{
+  return( target->begin( size ) );
+}
+
+unsigned int dsEepromStage::capacity( void )
+{
+  return( target->capacity() );
+}
+
+unsigned char dsEepromStage::read( int address )
+{
+  int pos = address - base;
+  unsigned int offset;
+  unsigned int len;
+
+  for( unsigned int at = 0; pos >= 0 && at < used; at += EEPATCH_RUN_HEADER + len )
+  {
+    offset = getRunWord( &runs[at] );
+    len = getRunWord( &runs[at + 2] );
+
+    if( (unsigned int) pos < offset )
+    {
+      break;
+    }
+
+    if( (unsigned int) pos < offset + len )
+    {
+      return( runs[at + EEPATCH_RUN_HEADER + pos - offset] );
+    }
+  }
+
+  return( target->read( address ) );
+}
+
+void dsEepromStage::write( int address, unsigned char value )
+{
+  if( !overflow )
+  {
+    put( address, value, false );
+  }
+}
+
+//
+// runs stay ascending and never touch each other: a byte next to a run
+// extends it, a run that reaches the next one is merged with it. Only
+// bytes that change are staged, unless force is set.
+//
+void dsEepromStage::put( int address, unsigned char value, bool force )
+{
+  int pos = address - base;
+  unsigned int offset = 0;
+  unsigned int len = 0;
+  unsigned int at;
+  unsigned int next;
+
+  if( pos < 0 )
+  {
+    return;
+  }
+
+  for( at = 0; at < used; at += EEPATCH_RUN_HEADER + len )
+  {
+    offset = getRunWord( &runs[at] );
+    len = getRunWord( &runs[at + 2] );
+
+    if( (unsigned int) pos >= offset && (unsigned int) pos < offset + len )
+    {
+      runs[at + EEPATCH_RUN_HEADER + pos - offset] = value;
+      return;
+    }
+
+    if( (unsigned int) pos <= offset + len )
+    {
+      break;
+    }
+  }
+
+  if( !force && target->read( address ) == value )
+  {
+    return;
+  }
+
+  if( at < used && (unsigned int) pos == offset + len )
+  {
+    if( makeRoom( at + EEPATCH_RUN_HEADER + len, 1 ) )
+    {
+      runs[at + EEPATCH_RUN_HEADER + len] = value;
+      len++;
+
+      next = at + EEPATCH_RUN_HEADER + len;
+      if( next < used && getRunWord( &runs[next] ) == offset + len )
+      {
+        len += getRunWord( &runs[next + 2] );
+        memmove( &runs[next], &runs[next + EEPATCH_RUN_HEADER], used - next - EEPATCH_RUN_HEADER );
+        used -= EEPATCH_RUN_HEADER;
+      }
+
+      putRunWord( &runs[at + 2], len );
+    }
+  }
+  else if( at < used && (unsigned int) pos + 1 == offset )
+  {
+    if( makeRoom( at + EEPATCH_RUN_HEADER, 1 ) )
+    {
+      runs[at + EEPATCH_RUN_HEADER] = value;
+      putRunWord( &runs[at], pos );
+      putRunWord( &runs[at + 2], len + 1 );
+    }
+  }
+  else
+  {
+    if( makeRoom( at, EEPATCH_RUN_HEADER + 1 ) )
+    {
+      putRunWord( &runs[at], pos );
+      putRunWord( &runs[at + 2], 1 );
+      runs[at + EEPATCH_RUN_HEADER] = value;
+    }
+  }
+}
+
+//
+// true if the byte at address is staged
+//
+bool dsEepromStage::staged( int address )
+{
+  int pos = address - base;
+  unsigned int offset;
+  unsigned int len;
+
+  for( unsigned int at = 0; pos >= 0 && at < used; at += EEPATCH_RUN_HEADER + len )
+  {
+    offset = getRunWord( &runs[at] );
+    len = getRunWord( &runs[at + 2] );
+
+    if( (unsigned int) pos < offset )
+    {
+      break;
+    }
+
+    if( (unsigned int) pos < offset + len )
+    {
+      return( true );
+    }
+  }
+
+  return( false );
+}
+
+//
+// stage the len bytes at address with their current value, so that
+// writes there need no more room. Nothing changes if they don't fit.
+//
+bool dsEepromStage::reserve( int address, int len )
+{
+  unsigned int missing = 0;
+
+  for( int i = 0; i < len; i++ )
+  {
+    if( !staged( address + i ) )
+    {
+      missing++;
+    }
+  }
+
+  if( missing == 0 )
+  {
+    return( true );
+  }
+
+  if( overflow || used + missing + EEPATCH_RUN_HEADER > size )
+  {
+    return( false );
+  }
+
+  for( int i = 0; i < len; i++ )
+  {
+    if( !staged( address + i ) )
+    {
+      put( address + i, target->read( address + i ), true );
+    }
+  }
+
+  return( true );
+}
+
+int dsEepromStage::readBlock( int address, unsigned char* data, int len )
+{
+  int pos = address - base;
+  int offset;
+  int runLen;
+  int from;
+  int to;
+
+  target->readBlock( address, data, len );
+
+  for( unsigned int at = 0; at < used; at += EEPATCH_RUN_HEADER + runLen )
+  {
+    offset = getRunWord( &runs[at] );
+    runLen = getRunWord( &runs[at + 2] );
+
+    if( offset >= pos + len )
+    {
+      break;
+    }
+
+    from = offset > pos ? offset : pos;
+    to = offset + runLen < pos + len ? offset + runLen : pos + len;
+    if( from < to )
+    {
+      memcpy( &data[from - pos], &runs[at + EEPATCH_RUN_HEADER + from - offset], to - from );
+    }
+  }
+
+  return( len );
+}
+
+//
+// nothing reaches the device before dsEeprom::commit()
+//
+int dsEepromStage::commit( void )
+{
+  return( E_SUCCESS );
+}
+
+bool dsEepromStage::commitsWhole( void )
+{
+  return( target->commitsWhole() );
+}
+
+bool dsEepromStage::concurrentReads( void )
+{
+  return( target->concurrentReads() );
+}
+
+//
+// ************************************************************************
+// transactions
+// ************************************************************************
+//
+
+//
+// open a transaction: the following changes are staged in the RAM of
+// setStage() until commit() or rollback(). A store takes its length and
+// a run header of the stage, a store that does not fit fails with
+// E_BAD_TXN and the transaction goes on without it. With DSEEPROM_THREADSAFE no lock is held
+// while the changes are staged: each store is a change of its own, so
+// readers see the staged values and wait for a single store only,
+// stores of other threads join the open transaction. commit() holds
+// the lock while it writes the runs.
+//
+int dsEeprom::begin( void )
+{
+  EE_WRITE_GUARD;
+
+  if( (status & EE_STATUS_INVALID_SIZE) || device == &stage || !stage.hasBuffer() )
+  {
+    return( E_BAD_TXN );
+  }
+
+  txnStatus = status;
+  stage.open( device, base );
+  device = &stage;
+
+  //
+  // room for the header commit() writes
+  //
+  if( (readByte( EEPROM_POS_MAGIC ) != magic && !stageRoom( EEPROM_POS_MAGIC, 1 )) ||
+      ((readByte( EEPROM_POS_VERSION ) != (schemaVersion & 0xff) ||
+        readByte( EEPROM_POS_VERSION + 1 ) != ((schemaVersion >> 8) & 0xff)) &&
+       !stageRoom( EEPROM_POS_VERSION, 2 )) )
+  {
+    closeTxn();
+    return( E_BAD_TXN );
+  }
+
+  return( E_SUCCESS );
+}
+
+//
+// true if a store of len bytes at pos fits into the stage of an open
+// transaction, so a store that does not fit is refused at once instead
+// of the commit. In an error corrected region the check bytes and the
+// rest of the blocks (repair) count, too.
+//
+bool dsEeprom::stageRoom( int pos, int len )
+{
+  int first;
+  int last;
+  int end;
+
+  if( pos < 0 )
+  {
+    len += pos;
+    pos = 0;
+  }
+
+  if( pos + len > blockSize )
+  {
+    len = blockSize - pos;
+  }
+
+  if( device != &stage || len <= 0 )
+  {
+    return( true );
+  }
+
+  if( !stage.reserve( base + pos, len ) )
+  {
+    return( false );
+  }
+
+  for( int i = 0; i < eccRegions; i++ )
+  {
+    if( pos < eccRegion[i].begin + eccRegion[i].length && eccRegion[i].begin < pos + len )
+    {
+      first = (pos > eccRegion[i].begin ? pos - eccRegion[i].begin : 0) / EEPROM_ECC_BLOCK;
+      last = (pos + len < eccRegion[i].begin + eccRegion[i].length ?
+              pos + len - 1 - eccRegion[i].begin : eccRegion[i].length - 1) / EEPROM_ECC_BLOCK;
+      end = eccRegion[i].begin + (last + 1) * EEPROM_ECC_BLOCK;
+      if( end > eccRegion[i].begin + eccRegion[i].length )
+      {
+        end = eccRegion[i].begin + eccRegion[i].length;
+      }
+
+      if( !stage.reserve( base + eccRegion[i].begin + first * EEPROM_ECC_BLOCK,
+                          end - eccRegion[i].begin - first * EEPROM_ECC_BLOCK ) ||
+          !stage.reserve( base + eccRegion[i].parity + first, last - first + 1 ) )
+      {
+        return( false );
+      }
+    }
+  }
+
+  return( true );
+}
+
+//
+// size bytes of RAM at buffer for the staged changes of transactions,
+// owned by the caller. Without it begin() fails, so an instance without
+// transactions spends no RAM on them. NULL: no transactions.
+//
+int dsEeprom::setStage( unsigned char* buffer, unsigned int size )
+{
+  EE_WRITE_GUARD;
+
+  if( device == &stage )
+  {
+    return( E_BAD_TXN );
+  }
+
+  stage.setBuffer( buffer, size );
+
+  return( E_SUCCESS );
+}
+
+void dsEeprom::closeTxn( void )
+{
+  device = stage.getTarget();
+}
+
+//
+// drop the staged changes
+//
+int dsEeprom::rollback( void )
+{
+  EE_WRITE_GUARD;
+
+  if( device != &stage )
+  {
+    return( E_BAD_TXN );
+  }
+
+  status &= ~EE_STATUS_MODIFIED;
+  status |= txnStatus & EE_STATUS_MODIFIED;
+  closeTxn();
+
+  return( E_SUCCESS );
+}
+
+//
+// write a byte of the journal if it differs
+//
+void dsEeprom::journalByte( unsigned int pos, unsigned char value )
+{
+  if( journalDevice->read( journal + pos ) != value )
+  {
+    journalDevice->write( journal + pos, value );
+  }
+}
+
+//
+// the header of a journal that is not done yet
+//
+void dsEeprom::journalHeader( unsigned long baseCrc, unsigned long targetCrc )
+{
+  unsigned char header[EEPATCH_HEADER_SIZE];
+
+  journalByte( EEPATCH_POS_MAGIC, 0 );
+
+  header[EEPATCH_POS_MAGIC + 1] = EEPATCH_MAGIC_1;
+  header[EEPATCH_POS_VERSION] = EEPATCH_VERSION;
+  header[EEPATCH_POS_FLAGS] = 0;
+  putRunWord( &header[EEPATCH_POS_SIZE], blockSize );
+  for( int i = 0; i < EEPROM_MAXLEN_CRC32; i++ )
+  {
+    header[EEPATCH_POS_BASE_CRC + i] = (baseCrc >> (8 * i)) & 0xff;
+    header[EEPATCH_POS_TARGET_CRC + i] = (targetCrc >> (8 * i)) & 0xff;
+  }
+
+  for( unsigned int i = EEPATCH_POS_MAGIC + 1; i < EEPATCH_HEADER_SIZE; i++ )
+  {
+    journalByte( i, header[i] );
+  }
+}
+
+//
+// the end run behind used bytes of runs, then the journal is marked
+// done. E_DEVICE_IO if the journal did not reach its device - the
+// transaction is not done then.
+//
+int dsEeprom::journalDone( unsigned int used )
+{
+  for( unsigned int i = 0; i < EEPATCH_RUN_HEADER; i++ )
+  {
+    journalByte( EEPATCH_HEADER_SIZE + used + i, 0 );
+  }
+
+  if( commitTo( journalDevice ) != E_SUCCESS )
+  {
+    return( E_DEVICE_IO );
+  }
+
+  //
+  // the transaction is done from here on
+  //
+  journalByte( EEPATCH_POS_MAGIC, EEPATCH_MAGIC_0 );
+
+  return( commitTo( journalDevice ) == E_SUCCESS ? E_SUCCESS : E_DEVICE_IO );
+}
+
+//
+// whole: the device erases the image on commit, so the journal gets
+// all of it as one run. E_DEVICE_IO if the journal did not reach its
+// device.
+//
+int dsEeprom::writeJournal( const unsigned char* runs, unsigned int used, bool whole,
+                             unsigned long baseCrc, unsigned long targetCrc )
+{
+  unsigned char header[EEPATCH_RUN_HEADER];
+
+  journalHeader( baseCrc, targetCrc );
+
+  if( whole )
+  {
+    putRunWord( header, 0 );
+    putRunWord( &header[2], blockSize );
+    for( unsigned int i = 0; i < EEPATCH_RUN_HEADER; i++ )
+    {
+      journalByte( EEPATCH_HEADER_SIZE + i, header[i] );
+    }
+
+    for( int i = 0; i < blockSize; i++ )
+    {
+      journalByte( EEPATCH_HEADER_SIZE + EEPATCH_RUN_HEADER + i, stage.read( base + i ) );
+    }
+    used = EEPATCH_RUN_HEADER + blockSize;
+  }
+  else
+  {
+    for( unsigned int i = 0; i < used; i++ )
+    {
+      journalByte( EEPATCH_HEADER_SIZE + i, runs[i] );
+    }
+  }
+
+  return( journalDone( used ) );
+}
+
+//
+// the staged bytes go to the device as they are - they include the
+// check bytes of error correction
+//
+void dsEeprom::writeRuns( const unsigned char* runs, unsigned int used, unsigned long checksum )
+{
+  unsigned int offset;
+  unsigned int len;
+
+  for( unsigned int at = 0; at < used; at += EEPATCH_RUN_HEADER + len )
+  {
+    offset = getRunWord( &runs[at] );
+    len = getRunWord( &runs[at + 2] );
+
+    for( unsigned int i = 0; i < len; i++ )
+    {
+      device->write( base + offset + i, runs[at + EEPATCH_RUN_HEADER + i] );
+    }
+  }
+
+  for( int i = 0; i < EEPROM_MAXLEN_CRC32; i++ )
+  {
+    updateByte( EEPROM_POS_CRC32 + i, (checksum >> (8 * i)) & 0xff );
+  }
+
+  this->crc32Old = checksum;
+  this->crc32New = checksum;
+  generation++;
+}
+
+//
+// write the staged changes and the checksum, which is updated from the
+// changed bytes alone. If there have been stores without validate()
+// before begin(), the stored checksum is out of date and the whole
+// image is read once. E_DEVICE_IO if the device or the journal failed
+// the write-out (see writeStage()).
+//
+int dsEeprom::commit( void )
+{
+  unsigned char stored[EEPROM_MAXLEN_CRC32];
+  const unsigned char* runs = stage.getRuns();
+  unsigned int used;
+  unsigned long baseCrc;
+  unsigned long targetCrc;
+  uint32_t delta = 0;
+  unsigned int previous = EEPROM_STD_DATA_BEGIN;
+  unsigned int offset;
+  unsigned int len;
+  unsigned int pos;
+  unsigned char diff;
+
+  EE_WRITE_GUARD;
+
+  if( device != &stage )
+  {
+    return( E_BAD_TXN );
+  }
+
+  //
+  // the header as validate() writes it
+  //
+  updateByte( EEPROM_POS_MAGIC, magic );
+  writeVersion( schemaVersion );
+
+  used = stage.getUsed();
+
+  if( !stageFits() )
+  {
+#ifdef USE_SIMPLE_LOG
+#ifdef DEBUG
+    if( DOLOG )
+    {
+      Logger.Log(LOGLEVEL_DEBUG, (const char*) "transaction does not fit, rolled back\n");
+    }
+#endif // DEBUG
+#endif // USE_SIMPLE_LOG
+    status &= ~EE_STATUS_MODIFIED;
+    status |= txnStatus & EE_STATUS_MODIFIED;
+    closeTxn();
+    return( E_BAD_TXN );
+  }
+
+  if( txnStatus & EE_STATUS_MODIFIED )
+  {
+    targetCrc = crc( EEPROM_STD_DATA_BEGIN, blockSize );
+    device = stage.getTarget();
+    readBlock( EEPROM_POS_CRC32, stored, EEPROM_MAXLEN_CRC32 );
+    baseCrc = getRunLong( stored );
+  }
+  else
+  {
+    device = stage.getTarget();
+    readBlock( EEPROM_POS_CRC32, stored, EEPROM_MAXLEN_CRC32 );
+    baseCrc = getRunLong( stored );
+
+    for( unsigned int at = 0; at < used; at += EEPATCH_RUN_HEADER + len )
+    {
+      offset = getRunWord( &runs[at] );
+      len = getRunWord( &runs[at + 2] );
+
+      for( unsigned int i = 0; i < len; i++ )
+      {
+        pos = offset + i;
+        if( pos < EEPROM_STD_DATA_BEGIN )
+        {
+          continue;
+        }
+
+        diff = readByte( pos ) ^ runs[at + EEPATCH_RUN_HEADER + i];
+        delta = dsEepromCrcShift( delta, pos - previous );
+        delta = dsEepromCrcRaw( delta, &diff, 1 );
+        previous = pos + 1;
+      }
+    }
+
+    //
+    // the checksum range is blockSize bytes from EEPROM_STD_DATA_BEGIN
+    //
+    delta = dsEepromCrcShift( delta, EEPROM_STD_DATA_BEGIN + blockSize - previous );
+    targetCrc = (baseCrc ^ delta) & 0xffffffffUL;
+  }
+
+  return( writeStage( baseCrc, targetCrc ) );
+}
+
+//
+// true if the staged runs fit into the stage and into the journal
+//
+bool dsEeprom::stageFits( void )
+{
+  unsigned int runBytes = stage.getUsed();
+
+  if( stage.getTarget()->commitsWhole() )
+  {
+    runBytes = EEPATCH_RUN_HEADER + blockSize;
+  }
+
+  return( !stage.overflowed() &&
+          (journalLength == 0 || EEPROM_JOURNAL_SIZE( runBytes ) <= journalLength) );
+}
+
+//
+// write the staged runs and the checksum targetCrc to the device of
+// the stage - over the journal, if there is one - and close the
+// transaction. E_DEVICE_IO if the journal failed (the image is as it
+// was) or the device commit failed (the journal stays for the next
+// boot).
+//
+int dsEeprom::writeStage( unsigned long baseCrc, unsigned long targetCrc )
+{
+  const unsigned char* runs = stage.getRuns();
+  unsigned int used = stage.getUsed();
+  bool journaled = journalLength > 0;
+
+  device = stage.getTarget();
+
+  if( journaled && writeJournal( runs, used, device->commitsWhole(), baseCrc, targetCrc ) != E_SUCCESS )
+  {
+    closeTxn();
+    return( E_DEVICE_IO );
+  }
+
+  writeRuns( runs, used, targetCrc );
+  if( commitTo( device ) != E_SUCCESS )
+  {
+    closeTxn();
+    return( E_DEVICE_IO );
+  }
+
+  if( journaled )
+  {
+    journalByte( EEPATCH_POS_MAGIC, 0 );
+    commitTo( journalDevice );
+  }
+
+  status &= ~EE_STATUS_MODIFIED;
+  status |= EE_STATUS_COMMITED;
+  closeTxn();
+
+  return( E_SUCCESS );
+}
+
+//
+// ************************************************************************
+// journal
+// ************************************************************************
+//
+
+unsigned int dsEeprom::journalWord( unsigned int pos )
+{
+  return( journalDevice->read( journal + pos ) | (journalDevice->read( journal + pos + 1 ) << 8) );
+}
+
+//
+// true if the runs of the journal are complete: the image they give
+// has the target checksum. A device that commits whole programs the
+// runs again with the magic byte, a power loss meanwhile leaves the
+// magic byte in front of runs that are not.
+//
+bool dsEeprom::journalMatches( unsigned long targetCrc )
+{
+  uint32_t check = EEPROM_CRC_INIT;
+  unsigned int at = EEPATCH_HEADER_SIZE;
+  unsigned int offset = 0;
+  unsigned int len = 0;
+  bool more = true;
+  unsigned char value;
+
+  for( int pos = EEPROM_STD_DATA_BEGIN; pos < EEPROM_STD_DATA_BEGIN + blockSize; pos++ )
+  {
+    //
+    // the next run that ends behind pos, len 0 is the end run
+    //
+    while( more && (unsigned int) pos >= offset + len )
+    {
+      at += len > 0 ? EEPATCH_RUN_HEADER + len : 0;
+
+      if( at + EEPATCH_RUN_HEADER > journalLength )
+      {
+        return( false );
+      }
+
+      offset = journalWord( at );
+      len = journalWord( at + 2 );
+      more = len > 0;
+
+      if( offset + len > (unsigned int) blockSize || at + EEPATCH_RUN_HEADER + len > journalLength )
+      {
+        return( false );
+      }
+    }
+
+    if( (unsigned int) pos >= offset && (unsigned int) pos < offset + len )
+    {
+      value = journalDevice->read( journal + at + EEPATCH_RUN_HEADER + pos - offset );
+    }
+    else
+    {
+      value = readByte( pos );
+    }
+
+    check = dsEepromCrcUpdate( check, &value, 1 );
+  }
+
+  return( (check & 0xffffffffUL) == (targetCrc & 0xffffffffUL) );
+}
+
+//
+// write the runs of a journal that is marked done again
+//
+int dsEeprom::replayJournal( void )
+{
+  unsigned char check[EEPROM_MAXLEN_CRC32];
+  unsigned long targetCrc;
+
+  if( journalDevice->read( journal + EEPATCH_POS_MAGIC ) != EEPATCH_MAGIC_0 ||
+      journalDevice->read( journal + EEPATCH_POS_MAGIC + 1 ) != EEPATCH_MAGIC_1 ||
+      journalDevice->read( journal + EEPATCH_POS_VERSION ) != EEPATCH_VERSION ||
+      journalWord( EEPATCH_POS_SIZE ) != (unsigned int) blockSize )
+  {
+    return( E_SUCCESS );
+  }
+
+  for( int i = 0; i < EEPROM_MAXLEN_CRC32; i++ )
+  {
+    check[i] = journalDevice->read( journal + EEPATCH_POS_TARGET_CRC + i );
+  }
+  targetCrc = getRunLong( check );
+
+  //
+  // an incomplete journal never reached the image
+  //
+  if( !journalMatches( targetCrc ) )
+  {
+#ifdef USE_SIMPLE_LOG
+#ifdef DEBUG
+    if( DOLOG )
+    {
+      Logger.Log(LOGLEVEL_DEBUG, (const char*) "incomplete journal dropped\n");
+    }
+#endif // DEBUG
+#endif // USE_SIMPLE_LOG
+    journalByte( EEPATCH_POS_MAGIC, 0 );
+    commitTo( journalDevice );
+    return( E_SUCCESS );
+  }
+
+#ifdef USE_SIMPLE_LOG
+#ifdef DEBUG
+  if( DOLOG )
+  {
+    Logger.Log(LOGLEVEL_DEBUG, (const char*) "transaction completed from the journal\n");
+  }
+#endif // DEBUG
+#endif // USE_SIMPLE_LOG
+
+  return( applyJournal( targetCrc ) );
+}
+
+//
+// write the runs of a journal that is done to the device, then clear
+// the journal. E_DEVICE_IO if the device commit failed, the journal
+// stays for the next boot then.
+//
+int dsEeprom::applyJournal( unsigned long targetCrc )
+{
+  unsigned int pos;
+  unsigned int offset;
+  unsigned int len;
+  unsigned char value;
+
+  for( pos = EEPATCH_HEADER_SIZE; pos + EEPATCH_RUN_HEADER <= journalLength; pos += EEPATCH_RUN_HEADER + len )
+  {
+    offset = journalWord( pos );
+    len = journalWord( pos + 2 );
+
+    if( len == 0 )
+    {
+      break;
+    }
+
+    for( unsigned int i = 0; i < len; i++ )
+    {
+      value = journalDevice->read( journal + pos + EEPATCH_RUN_HEADER + i );
+      if( device->read( base + offset + i ) != value )
+      {
+        device->write( base + offset + i, value );
+      }
+    }
+  }
+
+  writeRuns( NULL, 0, targetCrc );
+  if( commitTo( device ) != E_SUCCESS )
+  {
+    return( E_DEVICE_IO );
+  }
+
+  journalByte( EEPATCH_POS_MAGIC, 0 );
+  commitTo( journalDevice );
+  status &= ~EE_STATUS_MODIFIED;
+
+  return( E_SUCCESS );
+}
+
+//
+// use length bytes of the device at address (outside of the partition)
+// as journal of commit(). A transaction found there is completed.
+// A device that commits whole erases a journal in it together with the
+// image, use setJournal() with another device there.
+//
+int dsEeprom::setJournal( unsigned int address, unsigned int length )
+{
+  return( setJournal( *device, address, length ) );
+}
+
+//
+// the journal in length bytes of another device at address (another
+// flash sector, a file, an external EEPROM). If the device of the
+// image commits whole, the journal holds a copy of the whole image.
+//
+int dsEeprom::setJournal( dsEepromDevice& newJournal, unsigned int address, unsigned int length )
+{
+  bool whole;
+
+  EE_WRITE_GUARD;
+
+  if( (status & EE_STATUS_INVALID_SIZE) || device == &stage || &newJournal == &stage )
+  {
+    return( E_BAD_TXN );
+  }
+
+  whole = device->commitsWhole();
+
+  if( length < EEPROM_JOURNAL_SIZE( EEPATCH_RUN_HEADER + (whole ? (unsigned int) blockSize : 1) ) ||
+      (&newJournal == device &&
+       (whole || (address < base + blockSize && address + length > base))) ||
+      address + length > newJournal.capacity() ||
+      newJournal.begin( address + length ) != E_SUCCESS )
+  {
+    return( E_BAD_REGION );
+  }
+
+  journalDevice = &newJournal;
+  journal = address;
+  journalLength = length;
+
+  return( replayJournal() );
+}
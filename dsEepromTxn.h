@@ -0,0 +1,143 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   Transactions of dsEeprom (begin(), commit(), rollback()).
+//   While a transaction is open, the instance works on a dsEepromStage
+//   instead of its device. The stage passes reads to the device but
+//   keeps the changed bytes in RAM the caller provides (setStage()),
+//   as runs in the format of a patch
+//   (see dsEepromPatch.h). So everything a store does - error
+//   correction included - is staged and the instance reads its own
+//   staged changes.
+//   commit() writes the runs to the device once and updates the
+//   checksum incrementally from the changed bytes alone.
+//
+//   journal (optional, see setJournal()):
+//   a range of the device outside of the partition, or of another
+//   device, that receives the runs before they are written:
+//
+//     header         patch header, magic 'd' written last
+//     runs           offset, length and data as in a patch
+//     end            run with length 0
+//
+//   - the journal is written and committed with the first magic byte
+//     cleared, then the magic byte is written: from here on the
+//     transaction is done
+//   - the runs and the checksum are written to the image
+//   - the magic byte is cleared again
+//
+//   setJournal() finds a journal with magic and writes its runs again
+//   (redo), so a power loss leaves the old content or the new one. A
+//   journal whose runs don't give the target checksum was cut while it
+//   was written and is dropped.
+//   A device that commits whole (ESP8266, ESP32) erases the image
+//   before it programs it, a power loss in between loses all of it.
+//   There the journal must be on another device (another flash sector,
+//   a file) and holds a copy of the whole image; a journal in the same
+//   device is refused. Without it transactions on such a device are
+//   not safe against a power loss.
+//
+// ************************************************************************
+//
+//
+//-------- History --------------------------------------------------------
+//
+// 2016/10/28: initial version
+//
+//
+// ************************************************************************
+
+#ifndef _DSEEPROMTXN_H_
+#define _DSEEPROMTXN_H_
+
+#include <dsEepromDevice.h>
+#include <dsEepromPatch.h>
+
+//
+// the caller lends the RAM for the runs of transactions (setStage()),
+// an instance without transactions needs none. A run takes
+// EEPATCH_RUN_HEADER bytes plus its data, the size below holds a few
+// short fields.
+//
+#ifndef EEPROM_TXN_SIZE
+#if defined(__AVR__)
+#define EEPROM_TXN_SIZE            64
+#else
+#define EEPROM_TXN_SIZE           256
+#endif // __AVR__
+#endif // EEPROM_TXN_SIZE
+//
+// the journal needs room for the header, the runs and the end run
+//
+#define EEPROM_JOURNAL_SIZE( runBytes )  (EEPATCH_HEADER_SIZE + (runBytes) + EEPATCH_RUN_HEADER)
+
+class dsEepromStage : public dsEepromDevice {
+
+  private:
+    dsEepromDevice *target;
+    unsigned int base;
+    unsigned char *runs;
+    unsigned int size;
+    unsigned int used;
+    bool overflow;
+
+    bool makeRoom( unsigned int at, unsigned int len );
+    void put( int address, unsigned char value, bool force );
+    bool staged( int address );
+
+  public:
+    dsEepromStage();
+    //
+    // RAM for the runs, owned by the caller
+    //
+    void setBuffer( unsigned char* buffer, unsigned int bufferSize );
+    bool hasBuffer( void );
+    //
+    // start staging for the partition at base of device
+    //
+    void open( dsEepromDevice* device, unsigned int newBase );
+    dsEepromDevice* getTarget( void );
+    //
+    // runs staged so far (positions relative to the partition)
+    //
+    const unsigned char* getRuns( void );
+    unsigned int getUsed( void );
+    //
+    // true if a change did not fit into the RAM of the stage
+    //
+    bool overflowed( void );
+    //
+    // make room for writes to len bytes at address, false if they
+    // don't fit - the staged content stays the same either way
+    //
+    bool reserve( int address, int len );
+
+    int begin( unsigned int size );
+    unsigned int capacity( void );
+    unsigned char read( int address );
+    void write( int address, unsigned char value );
+    int readBlock( int address, unsigned char* data, int len );
+    int commit( void );
+    bool commitsWhole( void );
+    bool concurrentReads( void );
+};
+
+#endif // _DSEEPROMTXN_H_
@@ -0,0 +1,406 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   dseetool bench - throughput of the image code on the host.
+//
+//   bench ecc   read with error correction (clean blocks, blocks with
+//               a bit error) and writing of check bytes against plain
+//               reading, per byte of a protected region
+//   bench crc   checksum of a batch of images with every implementation
+//               compiled in (see dsEepromCrc.h), against the nibble table
+//   bench cipher  encryption and decryption of secret fields (see
+//               dsEepromCipher.h) byte by byte as the store and restore
+//               loops do, with cycles per byte on x86
+//   bench all   all of them
+//
+//   Each case runs until BENCH_MIN_SECONDS have passed and reports
+//   ns per byte, MB/s and the cost over its baseline (the plain copy
+//   or read). The numbers are those of the host - they compare the
+//   implementations, an MCU is slower by orders of magnitude.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include <dsEepromCrc.h>
+#include <dsEepromEcc.h>
+#include <dsEepromCipher.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAS_CYCLES
+#endif // __x86_64__ || __i386__
+
+#include "dseetool.h"
+
+#define BENCH_IMAGE_SIZE      4096
+#define BENCH_MIN_SECONDS     0.5
+#define BENCH_CRC_IMAGES      1024   // batch of 4 MB
+#define BENCH_SECRET_SIZE       44   // a passphrase in the standard layout
+
+//
+// time stamp counter cycles per byte of the last measure(), 0 if none
+//
+static double cyclesPerByte;
+
+static double now( void )
+{
+  struct timeval tv;
+
+  gettimeofday( &tv, NULL );
+
+  return( tv.tv_sec + tv.tv_usec / 1e6 );
+}
+
+//
+// run pass() until BENCH_MIN_SECONDS are over, returns ns per byte
+//
+static double measure( unsigned int bytes, void (*pass)( void ) )
+{
+  double start = now();
+  double elapsed;
+  unsigned long rounds = 0;
+#ifdef BENCH_HAS_CYCLES
+  unsigned long long cycles = __rdtsc();
+#endif // BENCH_HAS_CYCLES
+
+  do
+  {
+    pass();
+    rounds++;
+  } while( (elapsed = now() - start) < BENCH_MIN_SECONDS );
+
+#ifdef BENCH_HAS_CYCLES
+  cyclesPerByte = (double) (__rdtsc() - cycles) / ((double) rounds * bytes);
+#else
+  cyclesPerByte = 0;
+#endif // BENCH_HAS_CYCLES
+
+  return( elapsed * 1e9 / ((double) rounds * bytes) );
+}
+
+static void report( const char* name, double nsPerByte, double baseline )
+{
+  printf( "  %-24s %8.2f ns/byte %9.1f MB/s", name, nsPerByte, 1e3 / nsPerByte );
+
+  if( baseline > 0 )
+  {
+    printf( "  +%.2f ns/byte", nsPerByte - baseline );
+  }
+
+  printf( "\n" );
+}
+
+// ************************************************************************
+// ecc
+// ************************************************************************
+
+static unsigned char eccImage[BENCH_IMAGE_SIZE];
+static unsigned char eccParity[BENCH_IMAGE_SIZE / EEPROM_ECC_BLOCK];
+static unsigned char eccFlipped[BENCH_IMAGE_SIZE];
+static unsigned char eccOut[BENCH_IMAGE_SIZE];
+static volatile unsigned char eccSink;
+
+static void eccPlainRead( void )
+{
+  memcpy( eccOut, eccImage, BENCH_IMAGE_SIZE );
+  eccSink = eccOut[BENCH_IMAGE_SIZE - 1];
+}
+
+static void eccReadFrom( const unsigned char* image )
+{
+  unsigned char check;
+
+  for( int block = 0; block < BENCH_IMAGE_SIZE / EEPROM_ECC_BLOCK; block++ )
+  {
+    memcpy( &eccOut[block * EEPROM_ECC_BLOCK], &image[block * EEPROM_ECC_BLOCK], EEPROM_ECC_BLOCK );
+    check = eccParity[block];
+    dsEepromEccCorrect( &eccOut[block * EEPROM_ECC_BLOCK], &check );
+  }
+
+  eccSink = eccOut[BENCH_IMAGE_SIZE - 1];
+}
+
+static void eccCleanRead( void )
+{
+  eccReadFrom( eccImage );
+}
+
+static void eccFlippedRead( void )
+{
+  eccReadFrom( eccFlipped );
+}
+
+static void eccEncode( void )
+{
+  for( int block = 0; block < BENCH_IMAGE_SIZE / EEPROM_ECC_BLOCK; block++ )
+  {
+    eccParity[block] = dsEepromEccEncode( &eccImage[block * EEPROM_ECC_BLOCK] );
+  }
+}
+
+static int benchEcc( void )
+{
+  double baseline;
+
+  for( int i = 0; i < BENCH_IMAGE_SIZE; i++ )
+  {
+    eccImage[i] = rand();
+  }
+
+  eccEncode();
+
+  //
+  // one bit error in every block
+  //
+  memcpy( eccFlipped, eccImage, BENCH_IMAGE_SIZE );
+  for( int block = 0; block < BENCH_IMAGE_SIZE / EEPROM_ECC_BLOCK; block++ )
+  {
+    eccFlipped[block * EEPROM_ECC_BLOCK + rand() % EEPROM_ECC_BLOCK] ^= 1 << (rand() % 8);
+  }
+
+  printf( "ecc, SECDED(72,64), %d bytes:\n", BENCH_IMAGE_SIZE );
+
+  baseline = measure( BENCH_IMAGE_SIZE, eccPlainRead );
+  report( "plain read", baseline, 0 );
+  report( "read, clean", measure( BENCH_IMAGE_SIZE, eccCleanRead ), baseline );
+  report( "read, 1 error per block", measure( BENCH_IMAGE_SIZE, eccFlippedRead ), baseline );
+  report( "write check bytes", measure( BENCH_IMAGE_SIZE, eccEncode ), 0 );
+  printf( "  parity area %d bytes (%.1f %%)\n", BENCH_IMAGE_SIZE / EEPROM_ECC_BLOCK,
+          100.0 / EEPROM_ECC_BLOCK );
+
+  return( 0 );
+}
+
+// ************************************************************************
+// crc
+// ************************************************************************
+
+static unsigned char *crcBatch;
+static volatile uint32_t crcSink;
+
+static void crcImages( void )
+{
+  uint32_t crc = 0;
+
+  for( int i = 0; i < BENCH_CRC_IMAGES; i++ )
+  {
+    crc ^= dsEepromCrcUpdate( EEPROM_CRC_INIT, &crcBatch[i * BENCH_IMAGE_SIZE], BENCH_IMAGE_SIZE );
+  }
+
+  crcSink = crc;
+}
+
+static int benchCrc( void )
+{
+  static const char* const names[EEPROM_CRC_METHODS] = { "nibble table", "byte table", "slicing by 8" };
+  unsigned int bytes = BENCH_CRC_IMAGES * BENCH_IMAGE_SIZE;
+  int method = dsEepromCrcMethod();
+  uint32_t check[EEPROM_CRC_METHODS];
+  double nsPerByte[EEPROM_CRC_METHODS];
+  int retVal = 0;
+
+  if( (crcBatch = (unsigned char*) malloc( bytes )) == NULL )
+  {
+    fprintf( stderr, "out of memory\n" );
+    return( 1 );
+  }
+
+  for( unsigned int i = 0; i < bytes; i++ )
+  {
+    crcBatch[i] = rand();
+  }
+
+  printf( "crc, %d images of %d bytes, default %s:\n", BENCH_CRC_IMAGES, BENCH_IMAGE_SIZE, names[method] );
+
+  for( int m = 0; m < EEPROM_CRC_METHODS; m++ )
+  {
+    if( !dsEepromCrcSelect( m ) )
+    {
+      continue;
+    }
+
+    crcImages();
+    check[m] = crcSink;
+    nsPerByte[m] = measure( bytes, crcImages );
+    report( names[m], nsPerByte[m], 0 );
+
+    if( m > EEPROM_CRC_NIBBLE )
+    {
+      printf( "  %-24s %8.1f x\n", "speedup", nsPerByte[EEPROM_CRC_NIBBLE] / nsPerByte[m] );
+
+      if( check[m] != check[EEPROM_CRC_NIBBLE] )
+      {
+        fprintf( stderr, "%s: checksum differs\n", names[m] );
+        retVal = 1;
+      }
+    }
+  }
+
+  dsEepromCrcSelect( method );
+  free( crcBatch );
+
+  return( retVal );
+}
+
+// ************************************************************************
+// cipher
+// ************************************************************************
+
+static const uint8_t cipherKey[EEPROM_CIPHER_KEY_SIZE] = {
+  0x80, 0x81, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x8b, 0x8c, 0x8d, 0x8e, 0x8f,
+  0x90, 0x91, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0x9b, 0x9c, 0x9d, 0x9e, 0x9f
+};
+static uint8_t cipherNonce[EEPROM_CIPHER_NONCE_SIZE];
+static unsigned char cipherImage[BENCH_IMAGE_SIZE];
+static unsigned char cipherOut[BENCH_IMAGE_SIZE];
+static unsigned int cipherLength;
+static volatile uint8_t cipherSink;
+
+static void cipherCopy( void )
+{
+  memcpy( cipherOut, cipherImage, cipherLength );
+  cipherSink = cipherOut[cipherLength - 1];
+}
+
+static void cipherEncrypt( void )
+{
+  dsEepromCipher cipher;
+  uint8_t length[2] = { (uint8_t) (cipherLength & 0xff), (uint8_t) (cipherLength >> 8) };
+  uint8_t tag[EEPROM_CIPHER_TAG_SIZE];
+
+  cipherNonce[4]++;
+  dsEepromCipherInit( &cipher, cipherKey, cipherNonce, length, sizeof(length) );
+
+  for( unsigned int i = 0; i < cipherLength; i++ )
+  {
+    cipherOut[i] = dsEepromCipherEncrypt( &cipher, cipherImage[i] );
+  }
+
+  dsEepromCipherTag( &cipher, tag );
+  cipherSink = tag[0];
+}
+
+static void cipherDecrypt( void )
+{
+  dsEepromCipher cipher;
+  uint8_t length[2] = { (uint8_t) (cipherLength & 0xff), (uint8_t) (cipherLength >> 8) };
+  uint8_t tag[EEPROM_CIPHER_TAG_SIZE];
+
+  dsEepromCipherInit( &cipher, cipherKey, cipherNonce, length, sizeof(length) );
+
+  for( unsigned int i = 0; i < cipherLength; i++ )
+  {
+    cipherOut[i] = dsEepromCipherDecrypt( &cipher, cipherImage[i] );
+  }
+
+  dsEepromCipherTag( &cipher, tag );
+  cipherSink = tag[0] ^ cipherOut[cipherLength - 1];
+}
+
+static void cipherReport( const char* name, double nsPerByte, double baseline )
+{
+  report( name, nsPerByte, baseline );
+
+  if( cyclesPerByte > 0 )
+  {
+    printf( "  %-24s %8.1f cycles/byte (time stamp counter)\n", "", cyclesPerByte );
+  }
+}
+
+static int benchCipher( void )
+{
+  static const unsigned int lengths[] = { BENCH_SECRET_SIZE, BENCH_IMAGE_SIZE };
+  double baseline;
+
+  for( int i = 0; i < BENCH_IMAGE_SIZE; i++ )
+  {
+    cipherImage[i] = rand();
+  }
+
+  for( unsigned int l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++ )
+  {
+    cipherLength = lengths[l];
+
+    printf( "cipher, ChaCha20-Poly1305, %u bytes per field:\n", cipherLength );
+
+    baseline = measure( cipherLength, cipherCopy );
+    report( "plain copy", baseline, 0 );
+    cipherReport( "encrypt and tag", measure( cipherLength, cipherEncrypt ), baseline );
+    cipherReport( "decrypt and check", measure( cipherLength, cipherDecrypt ), baseline );
+  }
+
+  return( 0 );
+}
+
+struct benchmark {
+  const char *name;
+  int (*run)( void );
+};
+
+static const benchmark benchmarks[] = {
+  { "ecc", benchEcc },
+  { "crc", benchCrc },
+  { "cipher", benchCipher },
+};
+
+#define NUM_BENCHMARKS (sizeof(benchmarks) / sizeof(benchmarks[0]))
+
+int cmdBench( int argc, char* argv[] )
+{
+  int retVal = 0;
+  bool found;
+
+  for( int i = 0; i < argc; i++ )
+  {
+    found = false;
+
+    for( unsigned int b = 0; b < NUM_BENCHMARKS; b++ )
+    {
+      if( strcmp( argv[i], benchmarks[b].name ) == 0 || strcmp( argv[i], "all" ) == 0 )
+      {
+        retVal |= benchmarks[b].run();
+        found = true;
+      }
+    }
+
+    if( !found )
+    {
+      fprintf( stderr, "unknown benchmark %s\n", argv[i] );
+      return( 2 );
+    }
+  }
+
+  if( argc == 0 )
+  {
+    fprintf( stderr, "usage: dseetool bench all|" );
+    for( unsigned int b = 0; b < NUM_BENCHMARKS; b++ )
+    {
+      fprintf( stderr, "%s%s", b ? "|" : "", benchmarks[b].name );
+    }
+    fprintf( stderr, " ...\n" );
+    return( 2 );
+  }
+
+  return( retVal );
+}
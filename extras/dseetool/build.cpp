@@ -0,0 +1,591 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   dseetool build - create complete images from a config file.
+//
+//   The config file has one "key = value" per line, lines starting
+//   with '#' are comments:
+//
+//     size           = 512          block size of the image
+//     magic          = 0x7e
+//     version        = 1            schema version
+//     fill           = 0x00         content of unused bytes
+//     device_size    = 1024         see below
+//     device_fill    = 0xff
+//     ssid           = MyNet        the standard fields
+//     passphrase     = secret
+//     server_ip      = 192.168.1.10
+//     server_port    = 8080         stored as a long
+//     nodename       = node-${id}
+//     admin_password = admin
+//
+//   and fields of the extended data area, the position is a number
+//   or ext+n (relative to EEPROM_EXT_DATA_BEGIN):
+//
+//     string@ext+0,16 = text        like storeString(), max. 16 bytes
+//     bytes@ext+18    = 01 02 ff    like storeBytes() (hex)
+//     raw@300         = deadbeef    like storeRaw(), no leading length
+//     boolean@ext+30  = 1           like storeBoolean()
+//     long@ext+33     = 123456      prefixed, little endian
+//     short@ext+39    = 42          prefixed, little endian
+//
+//   Check bytes for a region protected by error correction (see
+//   dsEeprom::addEccRegion()) are written by
+//
+//     ecc@ext+0,200   = 450         region begin,length = check bytes
+//
+//   A batch is built from the config and a device list. Each line of
+//   the list is the id of a device, optionally followed by overrides,
+//   separated by ';':
+//
+//     0001;ssid=Line 1;nodename=sensor-1
+//
+//   The image of a device is written to <outdir>/<id>.bin, ${id} in a
+//   value is replaced by the id. The devices are built in parallel.
+//   The checksum of the library covers EEPROM_STD_DATA_BEGIN bytes
+//   behind the image. A partition (initPartition()) reads them as 0,
+//   which is the default. An instance over the whole device (init(),
+//   dsEeprom( size, magic )) reads them from the device: device_size
+//   is the size of the device and device_fill its content behind the
+//   image (0xff for an erased chip, default). Behind the end of the
+//   device they read 0 - on an AVR the address wraps to the header of
+//   the image instead, and no checksum matches there, so leave
+//   EEPROM_STD_DATA_BEGIN bytes of its EEPROM behind such an image.
+//   inspect, verify, diff and patch take device_fill as -f.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+#include <dsEepromEcc.h>
+
+#include "dseetool.h"
+
+typedef std::vector< std::pair<std::string, std::string> > configEntries;
+
+static std::string trim( const std::string& text )
+{
+  size_t first = 0;
+  size_t last = text.size();
+
+  while( first < last && isspace( (unsigned char) text[first] ) )
+  {
+    first++;
+  }
+
+  while( last > first && isspace( (unsigned char) text[last - 1] ) )
+  {
+    last--;
+  }
+
+  return( text.substr( first, last - first ) );
+}
+
+static bool splitEntry( const std::string& line, configEntries& entries )
+{
+  size_t equal = line.find( '=' );
+
+  if( equal == std::string::npos )
+  {
+    return( false );
+  }
+
+  entries.push_back( std::make_pair( trim( line.substr( 0, equal ) ),
+                                     trim( line.substr( equal + 1 ) ) ) );
+
+  return( true );
+}
+
+static int readConfig( const char* path, configEntries& entries )
+{
+  FILE *fp;
+  char line[1024];
+  int lineNo = 0;
+  std::string text;
+
+  if( (fp = fopen( path, "r" )) == NULL )
+  {
+    perror( path );
+    return( -1 );
+  }
+
+  while( fgets( line, sizeof(line), fp ) != NULL )
+  {
+    lineNo++;
+    text = line;
+
+    if( trim( text ).empty() || trim( text )[0] == '#' )
+    {
+      continue;
+    }
+
+    if( !splitEntry( text, entries ) )
+    {
+      fprintf( stderr, "%s:%d: key = value expected\n", path, lineNo );
+      fclose( fp );
+      return( -1 );
+    }
+  }
+
+  fclose( fp );
+
+  return( 0 );
+}
+
+static std::string expand( const std::string& value, const std::string& id )
+{
+  std::string result = value;
+  size_t pos;
+
+  while( (pos = result.find( "${id}" )) != std::string::npos )
+  {
+    result.replace( pos, 5, id );
+  }
+
+  return( result );
+}
+
+static bool parseHex( const std::string& text, std::string& data )
+{
+  int digits = 0;
+  unsigned char value = 0;
+
+  data.clear();
+
+  for( size_t i = 0; i < text.size(); i++ )
+  {
+    if( isspace( (unsigned char) text[i] ) )
+    {
+      continue;
+    }
+
+    if( !isxdigit( (unsigned char) text[i] ) )
+    {
+      return( false );
+    }
+
+    value = (value << 4) | (isdigit( (unsigned char) text[i] ) ? text[i] - '0' :
+                            (tolower( (unsigned char) text[i] ) - 'a' + 10));
+
+    if( ++digits % 2 == 0 )
+    {
+      data.push_back( value );
+      value = 0;
+    }
+  }
+
+  return( digits % 2 == 0 );
+}
+
+//
+// position of an extended field: a number or ext+n
+//
+static bool parsePosition( const std::string& text, unsigned long& pos )
+{
+  if( text.compare( 0, 4, "ext+" ) == 0 )
+  {
+    if( !parseNumber( text.substr( 4 ), pos ) )
+    {
+      return( false );
+    }
+    pos += EEPROM_EXT_DATA_BEGIN;
+    return( true );
+  }
+
+  return( parseNumber( text, pos ) );
+}
+
+//
+// a field with leading length like storeBytes() of the library
+//
+static bool putField( imageBuffer& image, unsigned long pos, const std::string& data )
+{
+  if( pos < EEPROM_STD_DATA_BEGIN ||
+      pos + EEPROM_LEADING_LENGTH + data.size() > image.size() )
+  {
+    return( false );
+  }
+
+  image[pos] = data.size() & 0xff;
+  image[pos + 1] = (data.size() >> 8) & 0xff;
+  memcpy( &image[pos + EEPROM_LEADING_LENGTH], data.data(), data.size() );
+
+  return( true );
+}
+
+//
+// like storeString(): blanks trimmed, cut to maxLen
+//
+static bool putString( imageBuffer& image, unsigned long pos, const std::string& text,
+                       unsigned long maxLen )
+{
+  return( putField( image, pos, trim( text ).substr( 0, maxLen ) ) );
+}
+
+static std::string littleEndian( unsigned long value, int len )
+{
+  std::string data;
+
+  for( int i = 0; i < len; i++ )
+  {
+    data.push_back( (value >> (8 * i)) & 0xff );
+  }
+
+  return( data );
+}
+
+struct standardField {
+  const char *key;
+  unsigned int pos;
+  unsigned int maxLen;
+};
+
+static const standardField standardFields[] = {
+  { "ssid",           EEPROM_POS_WLAN_SSID,       EEPROM_MAXLEN_WLAN_SSID },
+  { "passphrase",     EEPROM_POS_WLAN_PASSPHRASE, EEPROM_MAXLEN_WLAN_PASSPHRASE },
+  { "server_ip",      EEPROM_POS_SERVER_IP,       EEPROM_MAXLEN_SERVER_IP },
+  { "nodename",       EEPROM_POS_NODENAME,        EEPROM_MAXLEN_NODENAME },
+  { "admin_password", EEPROM_POS_ADMIN_PASSWORD,  EEPROM_MAXLEN_ADMIN_PASSWORD },
+};
+
+#define NUM_STANDARD_FIELDS (sizeof(standardFields) / sizeof(standardFields[0]))
+
+//
+// build the image of one device, errors are reported with the name
+//
+static int buildImage( const configEntries& entries, const std::string& id,
+                       const std::string& name, imageBuffer& image )
+{
+  unsigned long size = 512;
+  unsigned long magic = EEPROM_MAGIC_BYTE;
+  unsigned long version = 0;
+  unsigned long fill = 0;
+  unsigned long deviceSize = 0;
+  unsigned long deviceFill = 0xff;
+  unsigned long number;
+  unsigned long pos;
+  unsigned long maxLen;
+  std::string key;
+  std::string type;
+  std::string value;
+  std::string data;
+  std::vector<unsigned long> eccRegions;
+  uint32_t crc;
+  bool ok;
+  size_t at;
+  size_t comma;
+
+  //
+  // the header keys first - the size is needed before any field
+  //
+  for( size_t i = 0; i < entries.size(); i++ )
+  {
+    key = entries[i].first;
+    value = expand( entries[i].second, id );
+    ok = true;
+
+    if( key == "size" )
+    {
+      ok = parseNumber( value, size ) && size > EEPROM_STD_DATA_BEGIN && size <= 0xffff;
+    }
+    else if( key == "magic" )
+    {
+      ok = parseNumber( value, magic ) && magic > 0 && magic <= 0xff;
+    }
+    else if( key == "version" )
+    {
+      ok = parseNumber( value, version ) && version <= EEPROM_VERSION_MASK;
+    }
+    else if( key == "fill" )
+    {
+      ok = parseNumber( value, fill ) && fill <= 0xff;
+    }
+    else if( key == "device_size" )
+    {
+      ok = parseNumber( value, deviceSize );
+    }
+    else if( key == "device_fill" )
+    {
+      ok = parseNumber( value, deviceFill ) && deviceFill <= 0xff;
+    }
+
+    if( !ok )
+    {
+      fprintf( stderr, "%s: bad value for %s: %s\n", name.c_str(), key.c_str(), value.c_str() );
+      return( -1 );
+    }
+  }
+
+  //
+  // behind the image the device, behind the device 0 - not a mix
+  //
+  if( deviceSize == 0 || deviceSize == size )
+  {
+    deviceFill = 0;
+  }
+  else if( deviceSize < size + EEPROM_STD_DATA_BEGIN )
+  {
+    fprintf( stderr, "%s: device_size must be size or at least size + %d\n", name.c_str(),
+             EEPROM_STD_DATA_BEGIN );
+    return( -1 );
+  }
+
+  image.assign( size, fill );
+
+  for( size_t i = 0; i < entries.size(); i++ )
+  {
+    key = entries[i].first;
+    value = expand( entries[i].second, id );
+    ok = true;
+
+    if( key == "size" || key == "magic" || key == "version" || key == "fill" ||
+        key == "device_size" || key == "device_fill" )
+    {
+      continue;
+    }
+
+    if( key == "server_port" )
+    {
+      ok = parseNumber( value, number ) &&
+           putField( image, EEPROM_POS_SERVER_PORT, littleEndian( number, EEPROM_MAXLEN_SERVER_PORT ) );
+    }
+    else if( (at = key.find( '@' )) != std::string::npos )
+    {
+      type = key.substr( 0, at );
+      maxLen = size;
+
+      if( (comma = key.find( ',', at )) != std::string::npos )
+      {
+        ok = parseNumber( key.substr( comma + 1 ), maxLen );
+      }
+      else
+      {
+        comma = key.size();
+      }
+
+      if( !ok || !parsePosition( key.substr( at + 1, comma - at - 1 ), pos ) ||
+          pos < EEPROM_STD_DATA_BEGIN )
+      {
+        ok = false;
+      }
+      else if( type == "ecc" )
+      {
+        //
+        // done when all fields are in place
+        //
+        ok = comma < key.size() && parseNumber( value, number ) &&
+             pos + maxLen <= size && number + EEPROM_ECC_PARITY_LEN( maxLen ) <= size;
+        eccRegions.push_back( pos );
+        eccRegions.push_back( maxLen );
+        eccRegions.push_back( number );
+      }
+      else if( type == "string" )
+      {
+        ok = putString( image, pos, value, maxLen );
+      }
+      else if( type == "bytes" )
+      {
+        ok = parseHex( value, data ) && data.size() <= maxLen && putField( image, pos, data );
+      }
+      else if( type == "raw" )
+      {
+        ok = parseHex( value, data ) && pos + data.size() <= size;
+        if( ok )
+        {
+          memcpy( &image[pos], data.data(), data.size() );
+        }
+      }
+      else if( type == "boolean" )
+      {
+        ok = parseNumber( value, number ) && number <= 1 &&
+             putField( image, pos, littleEndian( number, EEPROM_MAXLEN_BOOLEAN ) );
+      }
+      else if( type == "long" )
+      {
+        ok = parseNumber( value, number ) &&
+             putField( image, pos, littleEndian( number, EEPROM_MAXLEN_LONG ) );
+      }
+      else if( type == "short" )
+      {
+        ok = parseNumber( value, number ) && number <= 0xffff &&
+             putField( image, pos, littleEndian( number, EEPROM_MAXLEN_SHORT ) );
+      }
+      else
+      {
+        ok = false;
+      }
+    }
+    else
+    {
+      ok = false;
+
+      for( unsigned int f = 0; f < NUM_STANDARD_FIELDS; f++ )
+      {
+        if( key == standardFields[f].key )
+        {
+          ok = putString( image, standardFields[f].pos, value, standardFields[f].maxLen );
+          break;
+        }
+      }
+    }
+
+    if( !ok )
+    {
+      fprintf( stderr, "%s: bad entry %s = %s\n", name.c_str(), key.c_str(), value.c_str() );
+      return( -1 );
+    }
+  }
+
+  for( size_t i = 0; i < eccRegions.size(); i += 3 )
+  {
+    unsigned char block[EEPROM_ECC_BLOCK];
+
+    for( unsigned long offset = 0; offset < eccRegions[i + 1]; offset += EEPROM_ECC_BLOCK )
+    {
+      memset( block, 0, sizeof(block) );
+      memcpy( block, &image[eccRegions[i] + offset],
+              eccRegions[i + 1] - offset < EEPROM_ECC_BLOCK ? eccRegions[i + 1] - offset : EEPROM_ECC_BLOCK );
+      image[eccRegions[i + 2] + offset / EEPROM_ECC_BLOCK] = dsEepromEccEncode( block );
+    }
+  }
+
+  //
+  // header like validate() writes it
+  //
+  image[EEPROM_POS_MAGIC] = magic;
+  image[EEPROM_POS_VERSION] = version & 0xff;
+  image[EEPROM_POS_VERSION + 1] = (version >> 8) & 0xff;
+
+  crc = imageCrc( image, deviceFill );
+  for( int i = 0; i < EEPROM_MAXLEN_CRC32; i++ )
+  {
+    image[EEPROM_POS_CRC32 + i] = (crc >> (8 * i)) & 0xff;
+  }
+
+  return( 0 );
+}
+
+//
+// one device of the batch: id;key=value;...
+//
+static int buildDevice( const configEntries& config, const std::string& line,
+                        const std::string& outdir )
+{
+  configEntries entries = config;
+  imageBuffer image;
+  std::string id;
+  std::string path;
+  size_t start;
+  size_t end;
+
+  end = line.find( ';' );
+  id = trim( line.substr( 0, end ) );
+
+  while( end != std::string::npos )
+  {
+    start = end + 1;
+    end = line.find( ';', start );
+
+    if( !trim( line.substr( start, end - start ) ).empty() &&
+        !splitEntry( line.substr( start, end - start ), entries ) )
+    {
+      fprintf( stderr, "%s: key=value expected\n", id.c_str() );
+      return( -1 );
+    }
+  }
+
+  path = outdir + "/" + id + ".bin";
+
+  if( buildImage( entries, id, id, image ) != 0 || writeFile( path.c_str(), image ) != 0 )
+  {
+    return( -1 );
+  }
+
+  return( 0 );
+}
+
+int cmdBuild( int argc, char* argv[] )
+{
+  configEntries config;
+  imageBuffer image;
+  std::vector<std::string> devices;
+  std::string outdir;
+  unsigned int jobs;
+  unsigned int failed;
+  FILE *fp;
+  char line[1024];
+
+  if( !parseJobs( argc, argv, jobs ) )
+  {
+    return( 2 );
+  }
+
+  if( argc < 2 || argc > 3 )
+  {
+    fprintf( stderr, "usage: dseetool build config out.bin\n"
+                     "       dseetool build [-j jobs] config devices outdir\n" );
+    return( 2 );
+  }
+
+  if( readConfig( argv[0], config ) != 0 )
+  {
+    return( 1 );
+  }
+
+  if( argc == 2 )
+  {
+    if( buildImage( config, "", argv[0], image ) != 0 || writeFile( argv[1], image ) != 0 )
+    {
+      return( 1 );
+    }
+    return( 0 );
+  }
+
+  if( (fp = fopen( argv[1], "r" )) == NULL )
+  {
+    perror( argv[1] );
+    return( 1 );
+  }
+
+  while( fgets( line, sizeof(line), fp ) != NULL )
+  {
+    std::string text = trim( line );
+
+    if( !text.empty() && text[0] != '#' )
+    {
+      devices.push_back( text );
+    }
+  }
+
+  fclose( fp );
+
+  outdir = argv[2];
+
+  failed = runParallel( jobs, devices.size(), [&]( unsigned int item )
+  {
+    return( buildDevice( config, devices[item], outdir ) );
+  } );
+
+  printf( "%u images built, %u failed\n", (unsigned int) devices.size() - failed, failed );
+
+  return( failed ? 1 : 0 );
+}
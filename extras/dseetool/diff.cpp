@@ -0,0 +1,229 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   dseetool diff / patch - differential updates of dsEeprom images.
+//   Please refer to dsEepromPatch.h for the format of a patch.
+//
+//   diff writes the bytes that differ in the data area. Two runs are
+//   merged if the gap between them is not larger than the header of a
+//   run, so the patch is as small as possible.
+//   patch applies a patch on the host exactly like applyPatch() of the
+//   library does, e.g. to check a patch before it is sent.
+//   Both take -f for images built with a device_fill (see build.cpp).
+//
+// ************************************************************************
+//
+//
+//-------- History --------------------------------------------------------
+//
+// 2016/10/28: initial version
+//
+//
+// ************************************************************************
+//
+
+#include <stdio.h>
+
+#include "dseetool.h"
+
+static void putShort( imageBuffer& out, unsigned int value )
+{
+  out.push_back( value & 0xff );
+  out.push_back( (value >> 8) & 0xff );
+}
+
+static void putLong( imageBuffer& out, uint32_t value )
+{
+  putShort( out, value & 0xffff );
+  putShort( out, value >> 16 );
+}
+
+static uint32_t getLong( const imageBuffer& in, unsigned int pos )
+{
+  return( in[pos] | (in[pos + 1] << 8) | (in[pos + 2] << 16) | ((uint32_t) in[pos + 3] << 24) );
+}
+
+int cmdDiff( int argc, char* argv[] )
+{
+  imageBuffer oldImage;
+  imageBuffer newImage;
+  imageBuffer patch;
+  unsigned int pos;
+  unsigned int start;
+  unsigned int end;
+  unsigned int next;
+  unsigned int runs = 0;
+  unsigned char fill;
+
+  if( !parseFill( argc, argv, fill ) || argc != 3 )
+  {
+    fprintf( stderr, "usage: dseetool diff [-f fill] old.bin new.bin patch.bin\n" );
+    return( 2 );
+  }
+
+  if( readFile( argv[0], oldImage ) != 0 || readFile( argv[1], newImage ) != 0 )
+  {
+    return( 1 );
+  }
+
+  if( oldImage.size() != newImage.size() || oldImage.size() <= EEPROM_STD_DATA_BEGIN ||
+      oldImage.size() > 0xffff )
+  {
+    fprintf( stderr, "images must have the same size (%d..65535 bytes)\n", EEPROM_STD_DATA_BEGIN + 1 );
+    return( 1 );
+  }
+
+  if( storedCrc( oldImage ) != imageCrc( oldImage, fill ) )
+  {
+    fprintf( stderr, "warning: %s has no valid checksum, the patch will not apply\n", argv[0] );
+  }
+
+  patch.push_back( EEPATCH_MAGIC_0 );
+  patch.push_back( EEPATCH_MAGIC_1 );
+  patch.push_back( EEPATCH_VERSION );
+  patch.push_back( 0 );
+  putShort( patch, oldImage.size() );
+  putLong( patch, storedCrc( oldImage ) );
+  putLong( patch, imageCrc( newImage, fill ) );
+
+  for( pos = EEPROM_STD_DATA_BEGIN; pos < newImage.size(); pos = end )
+  {
+    if( oldImage[pos] == newImage[pos] )
+    {
+      end = pos + 1;
+      continue;
+    }
+
+    start = pos;
+    end = pos + 1;
+
+    for( next = end; next < newImage.size() && next - end <= EEPATCH_RUN_HEADER &&
+         end - start < 0xffff; next++ )
+    {
+      if( oldImage[next] != newImage[next] )
+      {
+        end = next + 1;
+      }
+    }
+
+    putShort( patch, start );
+    putShort( patch, end - start );
+    patch.insert( patch.end(), newImage.begin() + start, newImage.begin() + end );
+    runs++;
+  }
+
+  if( writeFile( argv[2], patch ) != 0 )
+  {
+    return( 1 );
+  }
+
+  printf( "%u runs, %u bytes patch for a %u bytes image\n",
+          runs, (unsigned int) patch.size(), (unsigned int) newImage.size() );
+
+  return( 0 );
+}
+
+int cmdPatch( int argc, char* argv[] )
+{
+  imageBuffer image;
+  imageBuffer patch;
+  unsigned int pos;
+  unsigned int offset;
+  unsigned int len;
+  unsigned int previous = EEPROM_STD_DATA_BEGIN;
+  uint32_t delta = 0;
+  uint32_t target;
+  unsigned char fill;
+
+  if( !parseFill( argc, argv, fill ) || argc != 3 )
+  {
+    fprintf( stderr, "usage: dseetool patch [-f fill] image.bin patch.bin out.bin\n" );
+    return( 2 );
+  }
+
+  if( readFile( argv[0], image ) != 0 || readFile( argv[1], patch ) != 0 )
+  {
+    return( 1 );
+  }
+
+  if( patch.size() < EEPATCH_HEADER_SIZE ||
+      patch[EEPATCH_POS_MAGIC] != EEPATCH_MAGIC_0 ||
+      patch[EEPATCH_POS_MAGIC + 1] != EEPATCH_MAGIC_1 ||
+      patch[EEPATCH_POS_VERSION] != EEPATCH_VERSION ||
+      (patch[EEPATCH_POS_SIZE] | (patch[EEPATCH_POS_SIZE + 1] << 8)) != (int) image.size() )
+  {
+    fprintf( stderr, "%s is no patch for this image\n", argv[1] );
+    return( 1 );
+  }
+
+  if( storedCrc( image ) != getLong( patch, EEPATCH_POS_BASE_CRC ) )
+  {
+    fprintf( stderr, "base checksum does not match\n" );
+    return( 1 );
+  }
+
+  target = getLong( patch, EEPATCH_POS_TARGET_CRC );
+
+  for( pos = EEPATCH_HEADER_SIZE; pos < patch.size(); pos += EEPATCH_RUN_HEADER + len )
+  {
+    if( pos + EEPATCH_RUN_HEADER > patch.size() )
+    {
+      fprintf( stderr, "truncated patch\n" );
+      return( 1 );
+    }
+
+    offset = patch[pos] | (patch[pos + 1] << 8);
+    len = patch[pos + 2] | (patch[pos + 3] << 8);
+
+    if( offset < previous || offset + len > image.size() ||
+        pos + EEPATCH_RUN_HEADER + len > patch.size() )
+    {
+      fprintf( stderr, "bad run at offset %u of the patch\n", pos );
+      return( 1 );
+    }
+
+    delta = dsEepromCrcShift( delta, offset - previous );
+    for( unsigned int i = 0; i < len; i++ )
+    {
+      unsigned char diff = image[offset + i] ^ patch[pos + EEPATCH_RUN_HEADER + i];
+
+      delta = dsEepromCrcRaw( delta, &diff, 1 );
+      image[offset + i] = patch[pos + EEPATCH_RUN_HEADER + i];
+    }
+
+    previous = offset + len;
+  }
+
+  delta = dsEepromCrcShift( delta, EEPROM_STD_DATA_BEGIN + image.size() - previous );
+
+  if( (storedCrc( image ) ^ delta) != target || imageCrc( image, fill ) != target )
+  {
+    fprintf( stderr, "target checksum does not match\n" );
+    return( 1 );
+  }
+
+  for( int i = 0; i < 4; i++ )
+  {
+    image[EEPROM_POS_CRC32 + i] = (target >> (8 * i)) & 0xff;
+  }
+
+  return( writeFile( argv[2], image ) != 0 ? 1 : 0 );
+}
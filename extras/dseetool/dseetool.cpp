@@ -0,0 +1,284 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   dseetool - host side tools for dsEeprom images.
+//
+//   usage: dseetool <command> [args]
+//
+// ************************************************************************
+//
+//
+//-------- History --------------------------------------------------------
+//
+// 2016/10/28: initial version
+//
+//
+// ************************************************************************
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <thread>
+
+#include "dseetool.h"
+
+struct dseetoolCommand {
+  const char *name;
+  const char *args;
+  int (*run)( int argc, char* argv[] );
+};
+
+static const dseetoolCommand commands[] = {
+  { "build",   "[-j jobs] config out.bin | config devices outdir", cmdBuild },
+  { "inspect", "[-m magic] [-f fill] image.bin", cmdInspect },
+  { "verify",  "[-j jobs] [-m magic] [-f fill] image.bin ...", cmdVerify },
+  { "diff",    "[-f fill] old.bin new.bin patch.bin", cmdDiff },
+  { "patch",   "[-f fill] image.bin patch.bin out.bin", cmdPatch },
+  { "export",  "[-b baud] tty image.bin", cmdExport },
+  { "import",  "[-b baud] [-w window] tty image.bin", cmdImport },
+  { "bench",   "all|ecc|crc|cipher ...", cmdBench },
+  { "layout",  "[-b base] [-p page] [-t us] [-f fields] trace.txt", cmdLayout },
+};
+
+#define NUM_COMMANDS (sizeof(commands) / sizeof(commands[0]))
+
+int readFile( const char* path, imageBuffer& data )
+{
+  FILE *fp;
+  unsigned char buffer[4096];
+  size_t len;
+
+  if( (fp = fopen( path, "rb" )) == NULL )
+  {
+    perror( path );
+    return( -1 );
+  }
+
+  data.clear();
+  while( (len = fread( buffer, 1, sizeof(buffer), fp )) > 0 )
+  {
+    data.insert( data.end(), buffer, buffer + len );
+  }
+
+  fclose( fp );
+
+  return( 0 );
+}
+
+int writeFile( const char* path, const imageBuffer& data )
+{
+  FILE *fp;
+
+  if( (fp = fopen( path, "wb" )) == NULL )
+  {
+    perror( path );
+    return( -1 );
+  }
+
+  if( fwrite( data.data(), 1, data.size(), fp ) != data.size() )
+  {
+    perror( path );
+    fclose( fp );
+    return( -1 );
+  }
+
+  return( fclose( fp ) == 0 ? 0 : -1 );
+}
+
+//
+// the library checksums blockSize bytes from EEPROM_STD_DATA_BEGIN, i.e. the
+// last EEPROM_STD_DATA_BEGIN bytes of the range are past the image. They read
+// 0 in a partition (initPartition()), an instance over the whole device
+// (init(), dsEeprom( size, magic )) reads them from the device - fill, e.g.
+// 0xff behind the image on an erased chip
+//
+uint32_t imageCrc( const imageBuffer& image, unsigned char fill )
+{
+  uint32_t crc = EEPROM_CRC_INIT;
+
+  if( image.size() > EEPROM_STD_DATA_BEGIN )
+  {
+    crc = dsEepromCrcUpdate( crc, &image[EEPROM_STD_DATA_BEGIN], image.size() - EEPROM_STD_DATA_BEGIN );
+  }
+
+  if( fill == 0 )
+  {
+    return( dsEepromCrcZeros( crc, EEPROM_STD_DATA_BEGIN ) );
+  }
+
+  for( int i = 0; i < EEPROM_STD_DATA_BEGIN; i++ )
+  {
+    crc = dsEepromCrcUpdate( crc, &fill, 1 );
+  }
+
+  return( crc );
+}
+
+uint32_t storedCrc( const imageBuffer& image )
+{
+  uint32_t crc = 0;
+
+  for( int i = 0; i < 4 && EEPROM_POS_CRC32 + i < (int) image.size(); i++ )
+  {
+    crc |= (uint32_t) image[EEPROM_POS_CRC32 + i] << (8 * i);
+  }
+
+  return( crc );
+}
+
+bool parseNumber( const std::string& text, unsigned long& value )
+{
+  char *end;
+
+  if( text.empty() )
+  {
+    return( false );
+  }
+
+  value = strtoul( text.c_str(), &end, 0 );
+
+  return( *end == '\0' );
+}
+
+bool parseJobs( int& argc, char**& argv, unsigned int& jobs )
+{
+  unsigned long value;
+
+  jobs = 0;
+
+  if( argc >= 2 && strcmp( argv[0], "-j" ) == 0 )
+  {
+    if( !parseNumber( argv[1], value ) )
+    {
+      fprintf( stderr, "bad number of jobs: %s\n", argv[1] );
+      return( false );
+    }
+    jobs = value;
+    argc -= 2;
+    argv += 2;
+  }
+
+  return( true );
+}
+
+bool parseFill( int& argc, char**& argv, unsigned char& fill )
+{
+  unsigned long value;
+
+  fill = 0;
+
+  if( argc >= 2 && strcmp( argv[0], "-f" ) == 0 )
+  {
+    if( !parseNumber( argv[1], value ) || value > 0xff )
+    {
+      fprintf( stderr, "bad fill: %s\n", argv[1] );
+      return( false );
+    }
+    fill = value;
+    argc -= 2;
+    argv += 2;
+  }
+
+  return( true );
+}
+
+unsigned int runParallel( unsigned int jobs, unsigned int count,
+                          const std::function<int(unsigned int)>& work )
+{
+  std::atomic<unsigned int> next( 0 );
+  std::atomic<unsigned int> failed( 0 );
+  std::vector<std::thread> threads;
+
+  if( jobs == 0 )
+  {
+    jobs = std::thread::hardware_concurrency();
+  }
+
+  if( jobs == 0 )
+  {
+    jobs = 1;
+  }
+
+  if( jobs > count )
+  {
+    jobs = count;
+  }
+
+  //
+  // the items are fetched one by one, so a slow item does not hold
+  // back a whole share of the batch
+  //
+  for( unsigned int i = 0; i < jobs; i++ )
+  {
+    threads.push_back( std::thread( [&]()
+    {
+      unsigned int item;
+
+      while( (item = next++) < count )
+      {
+        if( work( item ) != 0 )
+        {
+          failed++;
+        }
+      }
+    } ) );
+  }
+
+  for( unsigned int i = 0; i < threads.size(); i++ )
+  {
+    threads[i].join();
+  }
+
+  return( failed );
+}
+
+static void usage( void )
+{
+  fprintf( stderr, "usage:\n" );
+  for( unsigned int i = 0; i < NUM_COMMANDS; i++ )
+  {
+    fprintf( stderr, "  dseetool %s %s\n", commands[i].name, commands[i].args );
+  }
+}
+
+int main( int argc, char* argv[] )
+{
+  if( argc < 2 )
+  {
+    usage();
+    return( 2 );
+  }
+
+  for( unsigned int i = 0; i < NUM_COMMANDS; i++ )
+  {
+    if( strcmp( argv[1], commands[i].name ) == 0 )
+    {
+      return( commands[i].run( argc - 2, argv + 2 ) );
+    }
+  }
+
+  usage();
+
+  return( 2 );
+}
@@ -0,0 +1,86 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   dseetool - host side tools for dsEeprom images.
+//   Every command lives in a file of its own and registers itself in
+//   the command table of dseetool.cpp.
+//
+// ************************************************************************
+//
+//
+//-------- History --------------------------------------------------------
+//
+// 2016/10/28: initial version
+//
+//
+// ************************************************************************
+
+#ifndef _DSEETOOL_H_
+#define _DSEETOOL_H_
+
+#include <string>
+#include <vector>
+#include <functional>
+
+#include <dsEepromLayout.h>
+#include <dsEepromCrc.h>
+#include <dsEepromPatch.h>
+
+typedef std::vector<unsigned char> imageBuffer;
+
+int readFile( const char* path, imageBuffer& data );
+int writeFile( const char* path, const imageBuffer& data );
+//
+// the checksum as the library computes it, fill is the content of the
+// bytes it reads behind the image (see imageCrc())
+//
+uint32_t imageCrc( const imageBuffer& image, unsigned char fill = 0 );
+uint32_t storedCrc( const imageBuffer& image );
+//
+// number and range parsing, returns false on garbage
+//
+bool parseNumber( const std::string& text, unsigned long& value );
+//
+// -j <jobs> option: 0 means one job per core
+//
+bool parseJobs( int& argc, char**& argv, unsigned int& jobs );
+//
+// -f <fill> option: the bytes behind the image, 0 if not given
+//
+bool parseFill( int& argc, char**& argv, unsigned char& fill );
+//
+// run work( 0 .. count-1 ) on jobs threads, returns the number of
+// items that failed (work() returned non zero)
+//
+unsigned int runParallel( unsigned int jobs, unsigned int count,
+                          const std::function<int(unsigned int)>& work );
+
+int cmdDiff( int argc, char* argv[] );
+int cmdPatch( int argc, char* argv[] );
+int cmdBuild( int argc, char* argv[] );
+int cmdInspect( int argc, char* argv[] );
+int cmdVerify( int argc, char* argv[] );
+int cmdExport( int argc, char* argv[] );
+int cmdImport( int argc, char* argv[] );
+int cmdBench( int argc, char* argv[] );
+int cmdLayout( int argc, char* argv[] );
+
+#endif // _DSEETOOL_H_
@@ -0,0 +1,250 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   dseetool inspect / verify - decode and check dumps of images.
+//
+//   inspect prints the header and the standard fields of an image,
+//   verify checks a batch of images in parallel and lists the bad
+//   ones. An image is fine if the magic matches (any magic but 0x00 and
+//   0xff unless -m is given), no migration is pending and the stored
+//   checksum is the checksum of the content.
+//   The checksum covers EEPROM_STD_DATA_BEGIN bytes behind the image
+//   (see imageCrc() in dseetool.cpp). They are 0 unless -f is given -
+//   an image of an instance over the whole device is checked with the
+//   device_fill it was built with (see build.cpp).
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "dseetool.h"
+
+#define IMAGE_OK               0
+#define IMAGE_TOO_SHORT        1
+#define IMAGE_BAD_MAGIC        2
+#define IMAGE_MIGRATING        3
+#define IMAGE_BAD_CRC          4
+
+static const char *imageErrors[] = {
+  "ok",
+  "too short",
+  "bad magic",
+  "migration pending",
+  "bad checksum",
+};
+
+static unsigned int imageVersion( const imageBuffer& image )
+{
+  return( image[EEPROM_POS_VERSION] | (image[EEPROM_POS_VERSION + 1] << 8) );
+}
+
+static int checkImage( const imageBuffer& image, int magic, unsigned char fill )
+{
+  unsigned int version;
+
+  if( image.size() <= EEPROM_STD_DATA_BEGIN )
+  {
+    return( IMAGE_TOO_SHORT );
+  }
+
+  if( magic >= 0 ? image[EEPROM_POS_MAGIC] != magic :
+      (image[EEPROM_POS_MAGIC] == 0x00 || image[EEPROM_POS_MAGIC] == 0xff) )
+  {
+    return( IMAGE_BAD_MAGIC );
+  }
+
+  version = imageVersion( image );
+  if( version != EEPROM_VERSION_NONE &&
+      (version & (EEPROM_VERSION_MIGRATING | EEPROM_VERSION_FINISHING)) )
+  {
+    return( IMAGE_MIGRATING );
+  }
+
+  if( storedCrc( image ) != imageCrc( image, fill ) )
+  {
+    return( IMAGE_BAD_CRC );
+  }
+
+  return( IMAGE_OK );
+}
+
+static bool parseMagic( int& argc, char**& argv, int& magic )
+{
+  unsigned long value;
+
+  magic = -1;
+
+  if( argc >= 2 && strcmp( argv[0], "-m" ) == 0 )
+  {
+    if( !parseNumber( argv[1], value ) || value == 0 || value > 0xff )
+    {
+      fprintf( stderr, "bad magic: %s\n", argv[1] );
+      return( false );
+    }
+    magic = value;
+    argc -= 2;
+    argv += 2;
+  }
+
+  return( true );
+}
+
+//
+// field with leading length, printable or as hex
+//
+static void printField( const imageBuffer& image, const char* name,
+                        unsigned int pos, unsigned int maxLen )
+{
+  unsigned int len;
+  bool printable = true;
+
+  len = image[pos] | (image[pos + 1] << 8);
+
+  printf( "  %-16s", name );
+
+  if( len > maxLen || pos + EEPROM_LEADING_LENGTH + len > image.size() )
+  {
+    printf( "<bad length %u>\n", len );
+    return;
+  }
+
+  for( unsigned int i = 0; i < len; i++ )
+  {
+    printable = printable && isprint( image[pos + EEPROM_LEADING_LENGTH + i] );
+  }
+
+  if( printable )
+  {
+    printf( "\"%.*s\"\n", (int) len, (const char*) &image[pos + EEPROM_LEADING_LENGTH] );
+    return;
+  }
+
+  for( unsigned int i = 0; i < len; i++ )
+  {
+    printf( "%02x ", image[pos + EEPROM_LEADING_LENGTH + i] );
+  }
+  printf( "\n" );
+}
+
+int cmdInspect( int argc, char* argv[] )
+{
+  imageBuffer image;
+  unsigned int version;
+  unsigned long port = 0;
+  unsigned char fill;
+  int result;
+  int magic;
+
+  if( !parseMagic( argc, argv, magic ) || !parseFill( argc, argv, fill ) || argc != 1 )
+  {
+    fprintf( stderr, "usage: dseetool inspect [-m magic] [-f fill] image.bin\n" );
+    return( 2 );
+  }
+
+  if( readFile( argv[0], image ) != 0 )
+  {
+    return( 1 );
+  }
+
+  result = checkImage( image, magic, fill );
+
+  if( result == IMAGE_TOO_SHORT )
+  {
+    printf( "%s: %s\n", argv[0], imageErrors[result] );
+    return( 1 );
+  }
+
+  version = imageVersion( image );
+
+  printf( "%s: %u bytes, %s\n", argv[0], (unsigned int) image.size(), imageErrors[result] );
+  printf( "  magic           0x%02x\n", image[EEPROM_POS_MAGIC] );
+  printf( "  checksum        0x%08lx (content 0x%08lx)\n",
+          (unsigned long) storedCrc( image ), (unsigned long) imageCrc( image, fill ) );
+
+  if( version == EEPROM_VERSION_NONE )
+  {
+    printf( "  version         none\n" );
+  }
+  else
+  {
+    printf( "  version         %u%s%s\n", version & EEPROM_VERSION_MASK,
+            (version & EEPROM_VERSION_MIGRATING) ? " (migrating)" : "",
+            (version & EEPROM_VERSION_FINISHING) ? " (finishing)" : "" );
+  }
+
+  if( image.size() >= EEPROM_STD_DATA_END )
+  {
+    printField( image, "ssid", EEPROM_POS_WLAN_SSID, EEPROM_MAXLEN_WLAN_SSID );
+    printField( image, "passphrase", EEPROM_POS_WLAN_PASSPHRASE, EEPROM_MAXLEN_WLAN_PASSPHRASE );
+    printField( image, "server_ip", EEPROM_POS_SERVER_IP, EEPROM_MAXLEN_SERVER_IP );
+
+    for( int i = 0; i < EEPROM_MAXLEN_SERVER_PORT; i++ )
+    {
+      port |= (unsigned long) image[EEPROM_POS_SERVER_PORT + EEPROM_LEADING_LENGTH + i] << (8 * i);
+    }
+    printf( "  server_port     %lu\n", port );
+
+    printField( image, "nodename", EEPROM_POS_NODENAME, EEPROM_MAXLEN_NODENAME );
+    printField( image, "admin_password", EEPROM_POS_ADMIN_PASSWORD, EEPROM_MAXLEN_ADMIN_PASSWORD );
+    printf( "  extended data   %u bytes at %u\n",
+            (unsigned int) image.size() - EEPROM_EXT_DATA_BEGIN, EEPROM_EXT_DATA_BEGIN );
+  }
+
+  return( result == IMAGE_OK ? 0 : 1 );
+}
+
+int cmdVerify( int argc, char* argv[] )
+{
+  unsigned int jobs;
+  unsigned int failed;
+  unsigned char fill;
+  int magic;
+
+  if( !parseJobs( argc, argv, jobs ) || !parseMagic( argc, argv, magic ) ||
+      !parseFill( argc, argv, fill ) || argc < 1 )
+  {
+    fprintf( stderr, "usage: dseetool verify [-j jobs] [-m magic] [-f fill] image.bin ...\n" );
+    return( 2 );
+  }
+
+  failed = runParallel( jobs, argc, [&]( unsigned int item )
+  {
+    imageBuffer image;
+    int result;
+
+    if( readFile( argv[item], image ) != 0 )
+    {
+      return( 1 );
+    }
+
+    if( (result = checkImage( image, magic, fill )) != IMAGE_OK )
+    {
+      printf( "%s: %s\n", argv[item], imageErrors[result] );
+    }
+
+    return( result );
+  } );
+
+  printf( "%d images, %u bad\n", argc, failed );
+
+  return( failed ? 1 : 0 );
+}
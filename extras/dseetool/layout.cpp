@@ -0,0 +1,600 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   dseetool layout - propose an order of the fields that dirties as
+//   few pages as possible per commit, from an access trace recorded
+//   with dsEepromTrace (see dsEepromTrace.h).
+//
+//   The writes between two commits are one update. The cost of a
+//   layout is the number of pages the updates of the trace touch, a
+//   page costs -t us (default 5000, a 24Cxx page write). For a flash
+//   with sectors pass the sector size as page size and the erase time.
+//
+//   The standard fields are known, fields of the extended data area
+//   are declared in a file (-f) with one "name = position,length" per
+//   line, the length includes the leading length. ",raw" behind the
+//   length marks a field without one. Position is a number or ext+n
+//   (relative to EEPROM_EXT_DATA_BEGIN):
+//
+//     boot_count = ext+0,6
+//     state      = ext+6,3
+//
+//   The header stays in place. The fields are packed in the proposed
+//   order from EEPROM_STD_DATA_BEGIN on, the order is improved move by
+//   move as long as the cost drops. Output are the positions as
+//   #defines and the moves for migrate() (dsEepromFieldMove). Moves
+//   that would overwrite a field not moved yet are ordered behind it,
+//   a cycle goes through free space behind all fields.
+//
+//   -b is the base of the partition in the trace (device addresses).
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include <algorithm>
+
+#include "dseetool.h"
+
+#define LAYOUT_PAGE_SIZE       32
+#define LAYOUT_PAGE_US       5000
+
+struct layoutField {
+  std::string name;
+  std::string macro;
+  unsigned int pos;
+  unsigned int len;
+  bool prefixed;
+  unsigned long updates;
+};
+
+//
+// a write of an update: field and offset in it, or a fixed address
+// (header, undeclared) with field -1
+//
+struct layoutWrite {
+  int field;
+  unsigned int offset;
+};
+
+struct layoutTrace {
+  std::vector<layoutField> fields;
+  std::vector< std::vector<layoutWrite> > updates;
+  unsigned long writes;
+  unsigned long undeclared;
+  unsigned int pageSize;
+  unsigned int end;
+  std::vector<unsigned long> stamp;
+  unsigned long round;
+};
+
+static void addField( layoutTrace& trace, const char* name, const char* macro,
+                      unsigned int pos, unsigned int len, bool prefixed )
+{
+  layoutField field;
+
+  field.name = name;
+  field.macro = macro;
+  field.pos = pos;
+  field.len = len;
+  field.prefixed = prefixed;
+  field.updates = 0;
+
+  trace.fields.push_back( field );
+}
+
+static void standardFields( layoutTrace& trace )
+{
+  addField( trace, "ssid", "EEPROM_POS_WLAN_SSID", EEPROM_POS_WLAN_SSID,
+            EEPROM_MAXLEN_WLAN_SSID + EEPROM_LEADING_LENGTH, true );
+  addField( trace, "passphrase", "EEPROM_POS_WLAN_PASSPHRASE", EEPROM_POS_WLAN_PASSPHRASE,
+            EEPROM_MAXLEN_WLAN_PASSPHRASE + EEPROM_LEADING_LENGTH, true );
+  addField( trace, "server_ip", "EEPROM_POS_SERVER_IP", EEPROM_POS_SERVER_IP,
+            EEPROM_MAXLEN_SERVER_IP + EEPROM_LEADING_LENGTH, true );
+  addField( trace, "server_port", "EEPROM_POS_SERVER_PORT", EEPROM_POS_SERVER_PORT,
+            EEPROM_MAXLEN_SERVER_PORT + EEPROM_LEADING_LENGTH, true );
+  addField( trace, "nodename", "EEPROM_POS_NODENAME", EEPROM_POS_NODENAME,
+            EEPROM_MAXLEN_NODENAME + EEPROM_LEADING_LENGTH, true );
+  addField( trace, "admin_password", "EEPROM_POS_ADMIN_PASSWORD", EEPROM_POS_ADMIN_PASSWORD,
+            EEPROM_MAXLEN_ADMIN_PASSWORD + EEPROM_LEADING_LENGTH, true );
+}
+
+static int readFields( const char* path, layoutTrace& trace )
+{
+  FILE *fp;
+  char line[256];
+  char name[64];
+  char where[64];
+  char raw[8];
+  unsigned long pos;
+  unsigned long len;
+  std::string macro;
+  int lineNo = 0;
+  int fields;
+
+  if( (fp = fopen( path, "r" )) == NULL )
+  {
+    perror( path );
+    return( -1 );
+  }
+
+  while( fgets( line, sizeof(line), fp ) != NULL )
+  {
+    lineNo++;
+
+    if( (fields = sscanf( line, " %63[A-Za-z0-9_] = %63[^,] , %lu , %7s", name, where, &len, raw )) < 1 )
+    {
+      continue;
+    }
+
+    if( fields >= 3 && strncmp( where, "ext+", 4 ) == 0 && parseNumber( where + 4, pos ) )
+    {
+      pos += EEPROM_EXT_DATA_BEGIN;
+    }
+    else if( fields >= 3 && !parseNumber( where, pos ) )
+    {
+      fields = 0;
+    }
+
+    if( fields < 3 || len == 0 || pos < EEPROM_STD_DATA_BEGIN ||
+        (fields == 4 && strcmp( raw, "raw" ) != 0) )
+    {
+      fprintf( stderr, "%s:%d: expected name = position,length[,raw]\n", path, lineNo );
+      fclose( fp );
+      return( -1 );
+    }
+
+    macro = "EEPROM_POS_";
+    for( int i = 0; name[i] != '\0'; i++ )
+    {
+      macro += toupper( (unsigned char) name[i] );
+    }
+
+    addField( trace, name, macro.c_str(), pos, len, fields < 4 );
+  }
+
+  fclose( fp );
+
+  return( 0 );
+}
+
+static int fieldAt( const layoutTrace& trace, unsigned int address )
+{
+  for( unsigned int f = 0; f < trace.fields.size(); f++ )
+  {
+    if( address >= trace.fields[f].pos && address < trace.fields[f].pos + trace.fields[f].len )
+    {
+      return( f );
+    }
+  }
+
+  return( -1 );
+}
+
+//
+// one update per commit, a write counts once per update
+//
+static int readTrace( const char* path, unsigned int base, layoutTrace& trace )
+{
+  FILE *fp;
+  char line[64];
+  unsigned long address;
+  std::vector<layoutWrite> update;
+  std::vector<bool> touched;
+  layoutWrite write;
+  char *end;
+
+  if( (fp = fopen( path, "r" )) == NULL )
+  {
+    perror( path );
+    return( -1 );
+  }
+
+  trace.writes = 0;
+  trace.undeclared = 0;
+
+  while( fgets( line, sizeof(line), fp ) != NULL )
+  {
+    if( line[0] == 'c' )
+    {
+      if( !update.empty() )
+      {
+        trace.updates.push_back( update );
+        update.clear();
+        touched.assign( trace.fields.size(), false );
+      }
+      continue;
+    }
+
+    if( line[0] != 'w' ||
+        (address = strtoul( line + 1, &end, 0 )) < base || end == line + 1 )
+    {
+      continue;
+    }
+
+    address -= base;
+    trace.writes++;
+    touched.resize( trace.fields.size(), false );
+
+    if( (write.field = fieldAt( trace, address )) >= 0 )
+    {
+      write.offset = address - trace.fields[write.field].pos;
+      if( !touched[write.field] )
+      {
+        touched[write.field] = true;
+        trace.fields[write.field].updates++;
+      }
+    }
+    else
+    {
+      write.offset = address;
+      if( address >= EEPROM_STD_DATA_BEGIN )
+      {
+        trace.undeclared++;
+      }
+    }
+
+    update.push_back( write );
+  }
+
+  if( !update.empty() )
+  {
+    trace.updates.push_back( update );
+  }
+
+  fclose( fp );
+
+  return( 0 );
+}
+
+//
+// page writes of all updates with the fields at pos[]
+//
+static unsigned long layoutCost( layoutTrace& trace, const std::vector<unsigned int>& pos )
+{
+  unsigned long cost = 0;
+  unsigned int address;
+  unsigned int page;
+
+  for( unsigned int u = 0; u < trace.updates.size(); u++ )
+  {
+    trace.round++;
+
+    for( unsigned int w = 0; w < trace.updates[u].size(); w++ )
+    {
+      const layoutWrite& write = trace.updates[u][w];
+
+      address = write.field >= 0 ? pos[write.field] + write.offset : write.offset;
+      page = address / trace.pageSize;
+
+      if( page >= trace.stamp.size() )
+      {
+        trace.stamp.resize( page + 1, 0 );
+      }
+
+      if( trace.stamp[page] != trace.round )
+      {
+        trace.stamp[page] = trace.round;
+        cost++;
+      }
+    }
+  }
+
+  return( cost );
+}
+
+static void packFields( const layoutTrace& trace, const std::vector<int>& order,
+                        std::vector<unsigned int>& pos )
+{
+  unsigned int next = EEPROM_STD_DATA_BEGIN;
+
+  pos.resize( trace.fields.size() );
+
+  for( unsigned int i = 0; i < order.size(); i++ )
+  {
+    pos[order[i]] = next;
+    next += trace.fields[order[i]].len;
+  }
+}
+
+static unsigned long orderCost( layoutTrace& trace, const std::vector<int>& order )
+{
+  std::vector<unsigned int> pos;
+
+  packFields( trace, order, pos );
+
+  return( layoutCost( trace, pos ) );
+}
+
+//
+// start with the fields by number of updates, then move single fields
+// as long as that makes it cheaper
+//
+static unsigned long optimize( layoutTrace& trace, std::vector<int>& order )
+{
+  std::vector<int> candidate;
+  unsigned long best;
+  unsigned long cost;
+  bool improved = true;
+
+  order.clear();
+  for( unsigned int f = 0; f < trace.fields.size(); f++ )
+  {
+    order.push_back( f );
+  }
+
+  std::stable_sort( order.begin(), order.end(), [&]( int a, int b )
+  {
+    return( trace.fields[a].updates > trace.fields[b].updates );
+  } );
+
+  best = orderCost( trace, order );
+
+  while( improved )
+  {
+    improved = false;
+
+    for( unsigned int from = 0; from < order.size(); from++ )
+    {
+      for( unsigned int to = 0; to < order.size(); to++ )
+      {
+        if( to == from )
+        {
+          continue;
+        }
+
+        candidate = order;
+        candidate.erase( candidate.begin() + from );
+        candidate.insert( candidate.begin() + to, order[from] );
+
+        if( (cost = orderCost( trace, candidate )) < best )
+        {
+          best = cost;
+          order = candidate;
+          improved = true;
+        }
+      }
+    }
+  }
+
+  return( best );
+}
+
+static bool overlaps( unsigned int a, unsigned int aLen, unsigned int b, unsigned int bLen )
+{
+  return( a < b + bLen && b < a + aLen );
+}
+
+struct layoutMove {
+  int field;
+  unsigned int from;
+  unsigned int to;
+};
+
+//
+// moves in an order that reads every field before it is overwritten,
+// cycles are broken through scratch space behind all fields
+//
+static void planMoves( const layoutTrace& trace, const std::vector<unsigned int>& pos,
+                       std::vector<layoutMove>& plan, unsigned int& scratchEnd )
+{
+  std::vector<layoutMove> pending;
+  layoutMove move;
+  unsigned int scratch = trace.end;
+  unsigned int len;
+  bool blocked;
+  bool progress;
+
+  for( unsigned int f = 0; f < trace.fields.size(); f++ )
+  {
+    if( pos[f] != trace.fields[f].pos )
+    {
+      move.field = f;
+      move.from = trace.fields[f].pos;
+      move.to = pos[f];
+      pending.push_back( move );
+    }
+  }
+
+  scratchEnd = scratch;
+
+  while( !pending.empty() )
+  {
+    progress = false;
+
+    for( unsigned int i = 0; i < pending.size(); i++ )
+    {
+      len = trace.fields[pending[i].field].len;
+      blocked = false;
+
+      for( unsigned int j = 0; j < pending.size() && !blocked; j++ )
+      {
+        blocked = j != i && overlaps( pending[i].to, len, pending[j].from,
+                                      trace.fields[pending[j].field].len );
+      }
+
+      if( !blocked )
+      {
+        plan.push_back( pending[i] );
+        pending.erase( pending.begin() + i );
+        progress = true;
+        break;
+      }
+    }
+
+    //
+    // every field goes to scratch space at most once, a field there
+    // blocks no one
+    //
+    for( unsigned int i = 0; i < pending.size() && !progress; i++ )
+    {
+      if( pending[i].from < trace.end )
+      {
+        move = pending[i];
+        move.to = scratch;
+        plan.push_back( move );
+        pending[i].from = scratch;
+        scratch += trace.fields[move.field].len;
+        scratchEnd = scratch;
+        progress = true;
+      }
+    }
+  }
+}
+
+static void printCost( const char* name, const layoutTrace& trace, unsigned long cost, unsigned long pageUs )
+{
+  printf( "  %-18s %12.2f %12lu %12.1f\n", name,
+          trace.updates.empty() ? 0.0 : (double) cost / trace.updates.size(),
+          cost, cost * pageUs / 1000.0 );
+}
+
+int cmdLayout( int argc, char* argv[] )
+{
+  layoutTrace trace;
+  std::vector<unsigned int> current;
+  std::vector<unsigned int> proposed;
+  std::vector<int> order;
+  std::vector<layoutMove> plan;
+  const char *fieldFile = NULL;
+  unsigned long base = 0;
+  unsigned long pageSize = LAYOUT_PAGE_SIZE;
+  unsigned long pageUs = LAYOUT_PAGE_US;
+  unsigned long value;
+  unsigned long currentCost;
+  unsigned long proposedCost;
+  unsigned int scratchEnd;
+  bool ok = true;
+
+  while( argc >= 2 && argv[0][0] == '-' && ok )
+  {
+    ok = parseNumber( argv[1], value );
+
+    switch( argv[0][1] )
+    {
+      case 'b': base = value; break;
+      case 'p': pageSize = value; ok = ok && value > 0; break;
+      case 't': pageUs = value; break;
+      case 'f': fieldFile = argv[1]; ok = true; break;
+      default:  ok = false; break;
+    }
+
+    argc -= 2;
+    argv += 2;
+  }
+
+  if( !ok || argc != 1 )
+  {
+    fprintf( stderr, "usage: dseetool layout [-b base] [-p page] [-t us] [-f fields] trace.txt\n" );
+    return( 2 );
+  }
+
+  standardFields( trace );
+
+  if( (fieldFile != NULL && readFields( fieldFile, trace ) != 0) ||
+      readTrace( argv[0], base, trace ) != 0 )
+  {
+    return( 1 );
+  }
+
+  trace.pageSize = pageSize;
+  trace.round = 0;
+  trace.end = 0;
+
+  for( unsigned int f = 0; f < trace.fields.size(); f++ )
+  {
+    current.push_back( trace.fields[f].pos );
+    trace.end = std::max( trace.end, trace.fields[f].pos + trace.fields[f].len );
+
+    for( unsigned int g = 0; g < f; g++ )
+    {
+      if( overlaps( trace.fields[f].pos, trace.fields[f].len, trace.fields[g].pos, trace.fields[g].len ) )
+      {
+        fprintf( stderr, "fields %s and %s overlap\n", trace.fields[g].name.c_str(), trace.fields[f].name.c_str() );
+        return( 1 );
+      }
+    }
+  }
+
+  currentCost = layoutCost( trace, current );
+  proposedCost = optimize( trace, order );
+  packFields( trace, order, proposed );
+
+  //
+  // not worth a migration
+  //
+  if( proposedCost >= currentCost )
+  {
+    proposed = current;
+    proposedCost = currentCost;
+  }
+
+  printf( "%s: %lu writes, %u commits, page %lu bytes, %lu us per page\n",
+          argv[0], trace.writes, (unsigned int) trace.updates.size(), pageSize, pageUs );
+  if( trace.undeclared > 0 )
+  {
+    printf( "  %lu writes outside of the fields stay in place, declare them with -f\n", trace.undeclared );
+  }
+  printf( "  %-18s %12s %12s %12s\n", "", "pages/commit", "page writes", "commit ms" );
+  printCost( "current layout", trace, currentCost, pageUs );
+  printCost( "proposed layout", trace, proposedCost, pageUs );
+
+  printf( "\n  %-18s %8s %8s %8s %8s\n", "field", "updates", "length", "current", "proposed" );
+  for( unsigned int f = 0; f < trace.fields.size(); f++ )
+  {
+    printf( "  %-18s %8lu %8u %8u %8u\n", trace.fields[f].name.c_str(), trace.fields[f].updates,
+            trace.fields[f].len, trace.fields[f].pos, proposed[f] );
+  }
+
+  if( proposedCost == currentCost )
+  {
+    printf( "\nthe current layout is the best found\n" );
+    return( 0 );
+  }
+
+  printf( "\n// layout proposed by dseetool layout\n" );
+  for( unsigned int i = 0; i < order.size(); i++ )
+  {
+    printf( "#define %-32s %u\n", trace.fields[order[i]].macro.c_str(), proposed[order[i]] );
+  }
+
+  planMoves( trace, proposed, plan, scratchEnd );
+
+  printf( "\n// migration to the proposed layout (see dsEeprom::migrate())\n" );
+  if( scratchEnd > trace.end )
+  {
+    printf( "// needs the partition up to %u, bytes %u..%u are scratch\n",
+            scratchEnd, trace.end, scratchEnd - 1 );
+  }
+  printf( "static const dsEepromFieldMove layoutMoves[] = {\n" );
+  for( unsigned int i = 0; i < plan.size(); i++ )
+  {
+    const layoutField& field = trace.fields[plan[i].field];
+
+    printf( "  { %4u, %4u, %3u, %3u, %-16s },  // %s\n", plan[i].from, plan[i].to, field.len, field.len,
+            field.prefixed ? "EE_MOVE_PREFIXED" : "0", field.name.c_str() );
+  }
+  printf( "};\n" );
+
+  return( 0 );
+}
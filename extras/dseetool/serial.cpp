@@ -0,0 +1,507 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   dseetool export / import - transfer an image over a serial line.
+//   Please refer to dsEepromTransfer.h for the frames, the device
+//   side is dsEeprom::serveTransfer().
+//
+//   export receives the image, damaged or missing frames are asked
+//   for again from their offset on.
+//   import sends the image with up to <window> frames on their way
+//   (go back n), the device writes the bytes that differ. A window of
+//   1 is safe for devices with a small receive buffer (AVR), larger
+//   windows keep the line busy.
+//   A failed import prints the result code the device answered with,
+//   e.g. E_BAD_TXN (-11) if neither its stage nor its journal takes
+//   the image. extras/powersim/xfersim runs both commands against the
+//   device side.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/time.h>
+
+#include <dsEepromTransfer.h>
+
+#include "dseetool.h"
+
+#define SERIAL_RETRIES         5
+#define SERIAL_DEFAULT_BAUD    115200
+#define SERIAL_DEFAULT_WINDOW  4
+
+struct baudRate {
+  unsigned long rate;
+  speed_t speed;
+};
+
+static const baudRate baudRates[] = {
+  { 9600, B9600 }, { 19200, B19200 }, { 38400, B38400 }, { 57600, B57600 },
+  { 115200, B115200 }, { 230400, B230400 }, { 460800, B460800 },
+  { 921600, B921600 }, { 1000000, B1000000 }, { 2000000, B2000000 },
+};
+
+#define NUM_BAUD_RATES (sizeof(baudRates) / sizeof(baudRates[0]))
+
+//
+// raw mode, no flow control
+//
+static int openSerial( const char* path, unsigned long baud )
+{
+  struct termios tio;
+  int fd;
+  unsigned int i;
+
+  for( i = 0; i < NUM_BAUD_RATES && baudRates[i].rate != baud; i++ )
+  {
+  }
+
+  if( i == NUM_BAUD_RATES )
+  {
+    fprintf( stderr, "unsupported baud rate %lu\n", baud );
+    return( -1 );
+  }
+
+  if( (fd = open( path, O_RDWR | O_NOCTTY )) < 0 )
+  {
+    perror( path );
+    return( -1 );
+  }
+
+  if( tcgetattr( fd, &tio ) == 0 )
+  {
+    cfmakeraw( &tio );
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cflag &= ~CRTSCTS;
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    cfsetispeed( &tio, baudRates[i].speed );
+    cfsetospeed( &tio, baudRates[i].speed );
+    tcsetattr( fd, TCSANOW, &tio );
+    tcflush( fd, TCIOFLUSH );
+  }
+
+  return( fd );
+}
+
+static int writeAll( int fd, const unsigned char* data, int len )
+{
+  int done = 0;
+  int count;
+
+  while( done < len )
+  {
+    if( (count = write( fd, data + done, len - done )) < 0 )
+    {
+      return( -1 );
+    }
+    done += count;
+  }
+
+  return( 0 );
+}
+
+static int readTimed( int fd, unsigned char* data, int len, int timeout )
+{
+  struct pollfd pfd;
+  int done = 0;
+  int count;
+
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+
+  while( done < len )
+  {
+    if( poll( &pfd, 1, timeout ) <= 0 )
+    {
+      return( -1 );
+    }
+
+    if( (count = read( fd, data + done, len - done )) <= 0 )
+    {
+      return( -1 );
+    }
+    done += count;
+  }
+
+  return( 0 );
+}
+
+static uint32_t frameCheck( const unsigned char* frame, int len )
+{
+  return( dsEepromCrcUpdate( EEPROM_CRC_INIT, &frame[EEXFER_POS_TYPE],
+                             EEXFER_HEADER_SIZE - EEXFER_POS_TYPE + len ) );
+}
+
+static int sendFrame( int fd, unsigned char type, unsigned int offset,
+                      const unsigned char* data, int len )
+{
+  unsigned char frame[EEXFER_MAX_FRAME];
+  uint32_t check;
+
+  frame[EEXFER_POS_SOF] = EEXFER_SOF;
+  frame[EEXFER_POS_TYPE] = type;
+  frame[EEXFER_POS_OFFSET] = offset & 0xff;
+  frame[EEXFER_POS_OFFSET + 1] = (offset >> 8) & 0xff;
+  frame[EEXFER_POS_LENGTH] = len;
+  memcpy( &frame[EEXFER_HEADER_SIZE], data, len );
+
+  check = frameCheck( frame, len );
+  for( int i = 0; i < EEXFER_CHECK_SIZE; i++ )
+  {
+    frame[EEXFER_HEADER_SIZE + len + i] = (check >> (8 * i)) & 0xff;
+  }
+
+  return( writeAll( fd, frame, EEXFER_HEADER_SIZE + len + EEXFER_CHECK_SIZE ) );
+}
+
+//
+// returns the data length, -1 on timeout and -2 for a damaged frame
+//
+static int receiveFrame( int fd, unsigned char* frame, int timeout )
+{
+  uint32_t check = 0;
+  int len;
+
+  do
+  {
+    if( readTimed( fd, frame, 1, timeout ) != 0 )
+    {
+      return( -1 );
+    }
+  } while( frame[EEXFER_POS_SOF] != EEXFER_SOF );
+
+  if( readTimed( fd, &frame[EEXFER_POS_TYPE], EEXFER_HEADER_SIZE - EEXFER_POS_TYPE, timeout ) != 0 )
+  {
+    return( -1 );
+  }
+
+  if( (len = frame[EEXFER_POS_LENGTH]) > EEXFER_MAX_DATA )
+  {
+    return( -2 );
+  }
+
+  if( readTimed( fd, &frame[EEXFER_HEADER_SIZE], len + EEXFER_CHECK_SIZE, timeout ) != 0 )
+  {
+    return( -1 );
+  }
+
+  for( int i = 0; i < EEXFER_CHECK_SIZE; i++ )
+  {
+    check |= (uint32_t) frame[EEXFER_HEADER_SIZE + len + i] << (8 * i);
+  }
+
+  return( check == frameCheck( frame, len ) ? len : -2 );
+}
+
+static unsigned int frameOffset( const unsigned char* frame )
+{
+  return( frame[EEXFER_POS_OFFSET] | (frame[EEXFER_POS_OFFSET + 1] << 8) );
+}
+
+static uint32_t frameLong( const unsigned char* frame )
+{
+  const unsigned char *data = &frame[EEXFER_HEADER_SIZE];
+
+  return( data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t) data[3] << 24) );
+}
+
+static double now( void )
+{
+  struct timeval tv;
+
+  gettimeofday( &tv, NULL );
+
+  return( tv.tv_sec + tv.tv_usec / 1e6 );
+}
+
+//
+// options common to both directions: -b baud -w window
+//
+static bool parseSerialOptions( int& argc, char**& argv, unsigned long& baud,
+                                unsigned long& window )
+{
+  baud = SERIAL_DEFAULT_BAUD;
+  window = SERIAL_DEFAULT_WINDOW;
+
+  while( argc >= 2 && argv[0][0] == '-' )
+  {
+    if( strcmp( argv[0], "-b" ) == 0 )
+    {
+      if( !parseNumber( argv[1], baud ) )
+      {
+        return( false );
+      }
+    }
+    else if( strcmp( argv[0], "-w" ) == 0 )
+    {
+      if( !parseNumber( argv[1], window ) || window == 0 )
+      {
+        return( false );
+      }
+    }
+    else
+    {
+      return( false );
+    }
+
+    argc -= 2;
+    argv += 2;
+  }
+
+  return( true );
+}
+
+int cmdExport( int argc, char* argv[] )
+{
+  unsigned char frame[EEXFER_MAX_FRAME];
+  imageBuffer image;
+  std::vector<bool> received;
+  unsigned long baud;
+  unsigned long window;
+  unsigned int offset = 0;
+  unsigned int size = 0;
+  unsigned int missing;
+  int retries = 0;
+  int len;
+  int fd;
+  double start;
+
+  if( !parseSerialOptions( argc, argv, baud, window ) || argc != 2 )
+  {
+    fprintf( stderr, "usage: dseetool export [-b baud] tty image.bin\n" );
+    return( 2 );
+  }
+
+  if( (fd = openSerial( argv[0], baud )) < 0 )
+  {
+    return( 1 );
+  }
+
+  start = now();
+
+  while( retries <= SERIAL_RETRIES )
+  {
+    sendFrame( fd, EEXFER_EXPORT, offset, NULL, 0 );
+
+    //
+    // take what arrives, the finish frame tells the size
+    //
+    while( (len = receiveFrame( fd, frame, EEXFER_TIMEOUT )) != -1 )
+    {
+      if( len < 0 )
+      {
+        continue;
+      }
+
+      if( frame[EEXFER_POS_TYPE] == EEXFER_FINISH )
+      {
+        size = frameOffset( frame );
+        break;
+      }
+
+      if( frame[EEXFER_POS_TYPE] == EEXFER_DATA )
+      {
+        unsigned int pos = frameOffset( frame );
+
+        if( image.size() < pos + len )
+        {
+          image.resize( pos + len );
+          received.resize( pos + len );
+        }
+
+        memcpy( &image[pos], &frame[EEXFER_HEADER_SIZE], len );
+        for( int i = 0; i < len; i++ )
+        {
+          received[pos + i] = true;
+        }
+      }
+    }
+
+    if( len == -1 )
+    {
+      retries++;
+      continue;
+    }
+
+    image.resize( size );
+    received.resize( size );
+
+    for( missing = 0; missing < size && received[missing]; missing++ )
+    {
+    }
+
+    if( missing == size )
+    {
+      if( dsEepromCrcUpdate( EEPROM_CRC_INIT, image.data(), size ) == frameLong( frame ) )
+      {
+        break;
+      }
+
+      //
+      // content changed while it was sent - start over
+      //
+      received.assign( size, false );
+      missing = 0;
+    }
+
+    //
+    // no retry is used up as long as it gets ahead
+    //
+    if( missing <= offset )
+    {
+      retries++;
+    }
+    offset = missing;
+  }
+
+  close( fd );
+
+  if( retries > SERIAL_RETRIES )
+  {
+    fprintf( stderr, "export failed\n" );
+    return( 1 );
+  }
+
+  printf( "%u bytes in %.2f s\n", size, now() - start );
+
+  return( writeFile( argv[1], image ) != 0 ? 1 : 0 );
+}
+
+int cmdImport( int argc, char* argv[] )
+{
+  unsigned char frame[EEXFER_MAX_FRAME];
+  unsigned char check[EEXFER_CHECK_SIZE];
+  imageBuffer image;
+  unsigned long baud;
+  unsigned long window;
+  unsigned int acked = 0;
+  unsigned int next = 0;
+  unsigned int chunk;
+  uint32_t crc;
+  int retries = 0;
+  int len;
+  int fd;
+  double start;
+
+  if( !parseSerialOptions( argc, argv, baud, window ) || argc != 2 )
+  {
+    fprintf( stderr, "usage: dseetool import [-b baud] [-w window] tty image.bin\n" );
+    return( 2 );
+  }
+
+  if( readFile( argv[1], image ) != 0 )
+  {
+    return( 1 );
+  }
+
+  if( image.empty() || image.size() > 0xffff )
+  {
+    fprintf( stderr, "%s: bad image size\n", argv[1] );
+    return( 1 );
+  }
+
+  if( (fd = openSerial( argv[0], baud )) < 0 )
+  {
+    return( 1 );
+  }
+
+  start = now();
+
+  while( acked < image.size() && retries <= SERIAL_RETRIES )
+  {
+    while( next < image.size() && next < acked + window * EEXFER_MAX_DATA )
+    {
+      chunk = image.size() - next < EEXFER_MAX_DATA ? image.size() - next : EEXFER_MAX_DATA;
+      sendFrame( fd, EEXFER_DATA, next, &image[next], chunk );
+      next += chunk;
+    }
+
+    len = receiveFrame( fd, frame, EEXFER_TIMEOUT );
+
+    //
+    // the device acknowledges every frame it got, so only the answer
+    // to the oldest frame on its way moves the window
+    //
+    if( len >= 0 && frame[EEXFER_POS_TYPE] == EEXFER_ACK )
+    {
+      chunk = image.size() - acked < EEXFER_MAX_DATA ? image.size() - acked : EEXFER_MAX_DATA;
+      if( frameOffset( frame ) == acked + chunk )
+      {
+        acked += chunk;
+        retries = 0;
+        continue;
+      }
+    }
+
+    //
+    // damaged, refused or lost: wait for the rest to arrive and go
+    // back to the last acknowledged offset
+    //
+    while( receiveFrame( fd, frame, 100 ) != -1 )
+    {
+    }
+
+    next = acked;
+    retries++;
+  }
+
+  crc = dsEepromCrcUpdate( EEPROM_CRC_INIT, image.data(), image.size() );
+  for( int i = 0; i < EEXFER_CHECK_SIZE; i++ )
+  {
+    check[i] = (crc >> (8 * i)) & 0xff;
+  }
+
+  len = -1;
+  while( acked == image.size() && retries <= SERIAL_RETRIES )
+  {
+    sendFrame( fd, EEXFER_FINISH, image.size(), check, EEXFER_CHECK_SIZE );
+
+    //
+    // the answer carries the result, a NAK without one means the
+    // finish frame arrived damaged
+    //
+    if( (len = receiveFrame( fd, frame, EEXFER_TIMEOUT )) >= 1 &&
+        (frame[EEXFER_POS_TYPE] == EEXFER_ACK || frame[EEXFER_POS_TYPE] == EEXFER_NAK) )
+    {
+      break;
+    }
+
+    retries++;
+  }
+
+  close( fd );
+
+  if( len < 1 || frame[EEXFER_POS_TYPE] != EEXFER_ACK )
+  {
+    fprintf( stderr, "import failed (%d)\n",
+             len >= 1 ? (signed char) frame[EEXFER_HEADER_SIZE] : -1 );
+    return( 1 );
+  }
+
+  printf( "%u bytes in %.2f s\n", (unsigned int) image.size(), now() - start );
+
+  return( 0 );
+}
@@ -0,0 +1,1091 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   chipsim - run the device drivers against models of the chips.
+//
+//   24Cxx: the model sits behind the bus*() members of dsEeprom24Cxx
+//   and behaves like the chip - a page write that runs over the end of
+//   its page wraps around to the start of the page, and for a write
+//   cycle after every page write the chip acknowledges nothing. The
+//   same stores go to the model and to a plain device in RAM, the
+//   images have to be equal, the driver may not run into a wrap, a
+//   busy chip or over the Wire buffer. Then single transfers fail:
+//   a write or a read that is not acknowledged has to end in
+//   EE_STATUS_DEVICE_ERROR.
+//
+//   NOR flash: the model sits behind the flash*() members of
+//   dsEepromNorFlash. Programming clears bits only, the driver may
+//   program erased bytes only. A series of updates is cut at every
+//   programmed byte and every erase: a cut program leaves any bits of
+//   the rest of its page, a cut erase sets any bits of the sector.
+//   After the reboot (replay of snapshot and log) the image has to be
+//   the one before or after the update or fail its checksum, and an
+//   update behind the cut has to survive the next reboot.
+//
+//   File: the model sits behind the file*() members of dsEepromFile
+//   and keeps the files in RAM. A cut store leaves a temporary file
+//   of any length with any last byte, a cut rename leaves the old
+//   file. The same updates as for the NOR flash are cut at every
+//   store and rename, the image after the reboot has to be the one
+//   before or after the update, and an update behind the cut has to
+//   survive the next reboot.
+//
+//   Secrets: storeSecret() on the 24Cxx model with the counter on
+//   the chip before the partition. A new instance has to read the
+//   text back only with the key, a short maxLen truncates it, and a
+//   flipped bit in the text, tag, counter or length has to end in
+//   E_BAD_SECRET.
+//
+//   usage: chipsim [-v]
+//
+//     -v   one line per check
+//
+//   Exit code 1 if a check failed.
+//
+// ************************************************************************
+//
+//
+//-------- History --------------------------------------------------------
+//
+// 2016/10/28: initial version
+//
+//
+// ************************************************************************
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <dsEeprom.h>
+#include <dsEeprom24Cxx.h>
+#include <dsEepromNorFlash.h>
+#include <dsEepromFile.h>
+
+#define CHIP_MAX_CAPACITY    EE24C256_CAPACITY
+#define CHIP_PARTITION_SIZE   512
+#define CHIP_MAGIC           0x7e
+#define CHIP_RAW_POS         (EEPROM_EXT_DATA_BEGIN + 3)
+#define CHIP_RAW_LEN          150
+#define CHIP_24CXX_CYCLE        3    // ms of a write cycle
+#define CHIP_NO_FAULT          -1
+#define CHIP_NOR_SECTORS        3    // the smallest ring for the partition
+#define CHIP_NOR_SIZE          (CHIP_NOR_SECTORS * EENOR_SECTOR_SIZE)
+#define CHIP_NOR_UPDATES      160    // enough for two garbage collections
+#define CHIP_FILE_PATH       "/var/lib/node/eeprom.img"
+
+static bool verbose = false;
+static int failed = 0;
+
+static void check( const char* chip, const char* name, bool ok )
+{
+  if( !ok )
+  {
+    failed++;
+  }
+
+  if( verbose || !ok )
+  {
+    printf( "  %-8s %-36s %s\n", chip, name, ok ? "ok" : "FAILED" );
+  }
+}
+
+//
+// ************************************************************************
+// reference: bytes in RAM, written at once
+// ************************************************************************
+//
+
+class ramDevice : public dsEepromDevice {
+
+  private:
+    unsigned int size;
+
+  public:
+    unsigned char cells[CHIP_MAX_CAPACITY];
+
+    ramDevice( unsigned int newSize )
+    {
+      size = newSize;
+      memset( cells, 0xff, sizeof(cells) );
+    }
+
+    int begin( unsigned int newSize )
+    {
+      return( newSize <= size ? E_SUCCESS : E_DEVICE_IO );
+    }
+
+    unsigned int capacity( void )
+    {
+      return( size );
+    }
+
+    unsigned char read( int address )
+    {
+      return( cells[address] );
+    }
+
+    void write( int address, unsigned char value )
+    {
+      cells[address] = value;
+    }
+};
+
+//
+// ************************************************************************
+// 24Cxx
+// ************************************************************************
+//
+
+class model24Cxx : public dsEeprom24Cxx {
+
+  private:
+    unsigned int pointer;
+    unsigned long cycleStart;
+    bool cycle;
+
+    bool busy( void )
+    {
+      if( cycle && millis() - cycleStart >= CHIP_24CXX_CYCLE )
+      {
+        cycle = false;
+      }
+
+      return( cycle );
+    }
+
+    unsigned int wordAddress( unsigned char device, const unsigned char* data )
+    {
+      if( addressBytes == 1 )
+      {
+        return( ((device & 0x07) << 8) | data[0] );
+      }
+
+      return( ((data[0] << 8) | data[1]) % deviceSize );
+    }
+
+  protected:
+    int busWrite( unsigned char device, const unsigned char* data, int len )
+    {
+      unsigned int start;
+
+      if( len > EE24CXX_WIRE_BUFFER )
+      {
+        overflows++;
+        len = EE24CXX_WIRE_BUFFER;
+      }
+
+      if( busy() )
+      {
+        early++;
+        return( E_DEVICE_IO );
+      }
+
+      pointer = wordAddress( device, data );
+
+      if( len == addressBytes )
+      {
+        return( E_SUCCESS );
+      }
+
+      if( failWrite >= 0 && failWrite-- == 0 )
+      {
+        return( E_DEVICE_IO );
+      }
+
+      //
+      // the chip counts up the low bits of the address only
+      //
+      start = pointer - pointer % pageSize;
+      for( int i = 0; i < len - addressBytes; i++ )
+      {
+        if( pointer % pageSize + i >= pageSize )
+        {
+          wraps++;
+        }
+        cells[start + (pointer % pageSize + i) % pageSize] = data[addressBytes + i];
+      }
+
+      cycle = true;
+      cycleStart = millis();
+      cycles++;
+
+      return( E_SUCCESS );
+    }
+
+    int busRead( unsigned char device, unsigned char* data, int len )
+    {
+      (void) device;
+
+      if( busy() )
+      {
+        early++;
+        return( 0 );
+      }
+
+      if( failRead >= 0 && failRead-- == 0 )
+      {
+        return( 0 );
+      }
+
+      for( int i = 0; i < len; i++ )
+      {
+        data[i] = cells[pointer];
+        pointer = (pointer + 1) % deviceSize;
+      }
+
+      return( len );
+    }
+
+    bool busProbe( unsigned char device )
+    {
+      (void) device;
+
+      return( !busy() );
+    }
+
+  public:
+    unsigned char cells[CHIP_MAX_CAPACITY];
+    unsigned long cycles;
+    unsigned long wraps;
+    unsigned long early;
+    unsigned long overflows;
+    long failWrite;              // data writes to go before one fails
+    long failRead;               // reads to go before one is not acknowledged
+
+    model24Cxx( unsigned int capacity, unsigned char pageSize )
+      : dsEeprom24Cxx( Wire, capacity, pageSize )
+    {
+      memset( cells, 0xff, sizeof(cells) );
+      pointer = 0;
+      cycle = false;
+      cycleStart = 0;
+      cycles = 0;
+      wraps = 0;
+      early = 0;
+      overflows = 0;
+      failWrite = CHIP_NO_FAULT;
+      failRead = CHIP_NO_FAULT;
+    }
+};
+
+//
+// ************************************************************************
+// NOR flash
+// ************************************************************************
+//
+
+//
+// thrown when the power fails
+//
+struct chipPowerCut {
+};
+
+class modelNor : public dsEepromNorFlash {
+
+  private:
+    unsigned char *cells;
+    long cutAt;
+    unsigned long seed;
+
+    unsigned char noise( void )
+    {
+      seed = seed * 1103515245UL + 12345UL;
+
+      return( (seed >> 16) & 0xff );
+    }
+
+  protected:
+    int flashRead( unsigned long address, unsigned char* data, int len )
+    {
+      memcpy( data, &cells[address], len );
+
+      return( E_SUCCESS );
+    }
+
+    int flashProgram( unsigned long address, const unsigned char* data, int len )
+    {
+      for( int i = 0; i < len; i++ )
+      {
+        if( events++ == cutAt )
+        {
+          //
+          // the rest of the page in program gets any of its bits
+          //
+          for( int j = i; j < len && (j == i || (address + j) % EENOR_PAGE_SIZE != 0); j++ )
+          {
+            cells[address + j] &= data[j] | noise();
+          }
+          throw chipPowerCut();
+        }
+
+        if( cells[address + i] != 0xff )
+        {
+          violations++;
+        }
+        cells[address + i] &= data[i];
+      }
+
+      return( E_SUCCESS );
+    }
+
+    int flashErase( unsigned long address )
+    {
+      if( events++ == cutAt )
+      {
+        for( int i = 0; i < EENOR_SECTOR_SIZE; i++ )
+        {
+          cells[address + i] |= noise();
+        }
+        throw chipPowerCut();
+      }
+
+      memset( &cells[address], 0xff, EENOR_SECTOR_SIZE );
+
+      return( E_SUCCESS );
+    }
+
+  public:
+    long events;
+    unsigned long violations;    // programs of bytes that were not erased
+
+    //
+    // the power fails at event number cut (-1: never)
+    //
+    modelNor( unsigned char* flash, long cut )
+      : dsEepromNorFlash( SPI, 0, 0, CHIP_NOR_SECTORS )
+    {
+      cells = flash;
+      cutAt = cut;
+      seed = cut;
+      events = 0;
+      violations = 0;
+    }
+};
+
+static unsigned char norFlash[CHIP_NOR_SIZE];
+static unsigned char norBefore[CHIP_NOR_SIZE];
+static unsigned char norImage[CHIP_NOR_UPDATES + 1][CHIP_PARTITION_SIZE];
+static long norStart[CHIP_NOR_UPDATES + 2];
+static unsigned char norAfter[CHIP_PARTITION_SIZE];
+
+static void norUpdate( dsEeprom& eeprom, int n )
+{
+  char name[EEPROM_MAXLEN_NODENAME + 1];
+  char raw[CHIP_RAW_LEN];
+
+  snprintf( name, sizeof(name), "node-%d%s", n, n % 3 == 0 ? "-with-a-longer-name" : "" );
+  eeprom.storeString( name, EEPROM_MAXLEN_NODENAME, EEPROM_POS_NODENAME );
+
+  if( n % 4 == 0 )
+  {
+    for( int i = 0; i < CHIP_RAW_LEN; i++ )
+    {
+      raw[i] = n + i;
+    }
+    eeprom.storeRaw( raw, CHIP_RAW_LEN, CHIP_RAW_POS );
+  }
+
+  eeprom.validate();
+}
+
+//
+// the check of any boot code: header and stored checksum
+//
+static bool norValid( dsEeprom& eeprom )
+{
+  unsigned char stored[EEPROM_MAXLEN_CRC32];
+  unsigned long storedCrc = 0;
+
+  eeprom.restoreRaw( (char*) stored, EEPROM_POS_CRC32, EEPROM_MAXLEN_CRC32, EEPROM_MAXLEN_CRC32 );
+  for( int i = 0; i < EEPROM_MAXLEN_CRC32; i++ )
+  {
+    storedCrc |= (unsigned long) stored[i] << (8 * i);
+  }
+
+  return( eeprom.isValid() &&
+          (storedCrc & 0xffffffffUL) == (eeprom.crc( EEPROM_STD_DATA_BEGIN, CHIP_PARTITION_SIZE ) & 0xffffffffUL) );
+}
+
+static bool norSame( const unsigned char* image, const unsigned char* expected )
+{
+  return( memcmp( &image[EEPROM_STD_DATA_BEGIN], &expected[EEPROM_STD_DATA_BEGIN],
+                  CHIP_PARTITION_SIZE - EEPROM_STD_DATA_BEGIN ) == 0 );
+}
+
+static void runNor( void )
+{
+  unsigned long outcomes[4] = { 0, 0, 0, 0 };   // old, new, detected, silent
+  unsigned long violations = 0;
+  unsigned long lost = 0;
+  unsigned long failedBoots = 0;
+  long events;
+  int update;
+
+  //
+  // reference: the updates without a cut, the image after each
+  //
+  memset( norFlash, 0xff, sizeof(norFlash) );
+  {
+    modelNor model( norFlash, CHIP_NO_FAULT );
+    dsEeprom eeprom;
+
+    eeprom.initPartition( model, 0, CHIP_PARTITION_SIZE, CHIP_MAGIC );
+    norUpdate( eeprom, 0 );
+    memcpy( norBefore, norFlash, sizeof(norBefore) );
+    memcpy( norImage[0], model.memory( 0, CHIP_PARTITION_SIZE ), CHIP_PARTITION_SIZE );
+
+    model.events = 0;
+    for( int n = 1; n <= CHIP_NOR_UPDATES; n++ )
+    {
+      norStart[n] = model.events;
+      norUpdate( eeprom, n );
+      memcpy( norImage[n], model.memory( 0, CHIP_PARTITION_SIZE ), CHIP_PARTITION_SIZE );
+    }
+    events = model.events;
+    norStart[CHIP_NOR_UPDATES + 1] = events;
+    violations += model.violations;
+  }
+
+  for( long cut = 0; cut < events; cut++ )
+  {
+    memcpy( norFlash, norBefore, sizeof(norFlash) );
+
+    {
+      modelNor model( norFlash, cut );
+      dsEeprom eeprom;
+
+      try
+      {
+        eeprom.initPartition( model, 0, CHIP_PARTITION_SIZE, CHIP_MAGIC );
+        for( int n = 1; n <= CHIP_NOR_UPDATES; n++ )
+        {
+          norUpdate( eeprom, n );
+        }
+      }
+      catch( chipPowerCut& )
+      {
+      }
+
+      violations += model.violations;
+    }
+
+    for( update = 1; norStart[update + 1] <= cut; update++ )
+    {
+    }
+
+    //
+    // reboot, then one more update on what the cut left
+    //
+    {
+      modelNor model( norFlash, CHIP_NO_FAULT );
+      dsEeprom eeprom;
+      const unsigned char *image;
+
+      eeprom.initPartition( model, 0, CHIP_PARTITION_SIZE, CHIP_MAGIC );
+      image = model.memory( 0, CHIP_PARTITION_SIZE );
+
+      if( image == NULL )
+      {
+        failedBoots++;
+        continue;
+      }
+
+      if( !norValid( eeprom ) )
+      {
+        outcomes[2]++;
+      }
+      else if( norSame( image, norImage[update] ) )
+      {
+        outcomes[1]++;
+      }
+      else if( norSame( image, norImage[update - 1] ) )
+      {
+        outcomes[0]++;
+      }
+      else
+      {
+        outcomes[3]++;
+      }
+
+      norUpdate( eeprom, CHIP_NOR_UPDATES + 1 );
+      memcpy( norAfter, image, CHIP_PARTITION_SIZE );
+      violations += model.violations;
+    }
+
+    {
+      modelNor model( norFlash, CHIP_NO_FAULT );
+      dsEeprom eeprom;
+      const unsigned char *image;
+
+      eeprom.initPartition( model, 0, CHIP_PARTITION_SIZE, CHIP_MAGIC );
+      image = model.memory( 0, CHIP_PARTITION_SIZE );
+
+      if( image == NULL || !norValid( eeprom ) || !norSame( image, norAfter ) )
+      {
+        lost++;
+      }
+    }
+  }
+
+  if( verbose )
+  {
+    printf( "  %-8s %ld cuts: old %lu, new %lu, detected %lu\n", "nor", events,
+            outcomes[0], outcomes[1], outcomes[2] );
+  }
+
+  check( "nor", "no silent corruption after a cut", outcomes[3] == 0 );
+  check( "nor", "every boot after a cut replays", failedBoots == 0 );
+  check( "nor", "programs of erased bytes only", violations == 0 );
+  check( "nor", "update after a cut survives a reboot", lost == 0 );
+}
+
+//
+// ************************************************************************
+// file device: files in RAM, a store and a rename may be cut
+// ************************************************************************
+//
+
+struct chipFile {
+  char path[EEFILE_MAX_PATH + sizeof(EEFILE_TEMP_SUFFIX)];
+  unsigned char data[CHIP_PARTITION_SIZE];
+  int len;                     // -1: no such file
+};
+
+#define CHIP_FILES 2
+
+class modelFile : public dsEepromFile {
+
+  private:
+    chipFile *files;
+    long cutAt;
+    unsigned long seed;
+
+    unsigned char noise( void )
+    {
+      seed = seed * 1103515245UL + 12345UL;
+
+      return( (seed >> 16) & 0xff );
+    }
+
+    chipFile* find( const char* path, bool create )
+    {
+      chipFile *unused = NULL;
+
+      for( int i = 0; i < CHIP_FILES; i++ )
+      {
+        if( files[i].len >= 0 && strcmp( files[i].path, path ) == 0 )
+        {
+          return( &files[i] );
+        }
+        if( files[i].len < 0 && unused == NULL )
+        {
+          unused = &files[i];
+        }
+      }
+
+      if( create && unused != NULL )
+      {
+        snprintf( unused->path, sizeof(unused->path), "%s", path );
+        unused->len = 0;
+        return( unused );
+      }
+
+      return( NULL );
+    }
+
+  protected:
+    unsigned char* fileMap( unsigned int size )
+    {
+      unsigned char *mapping = new unsigned char[size];
+      chipFile *file = find( imagePath, false );
+
+      memset( mapping, 0, size );
+      if( file != NULL )
+      {
+        memcpy( mapping, file->data, (unsigned int) file->len < size ? file->len : size );
+      }
+
+      return( mapping );
+    }
+
+    void fileUnmap( unsigned char* mapping, unsigned int size )
+    {
+      (void) size;
+      delete[] mapping;
+    }
+
+    int fileStore( const char* path, const unsigned char* data, unsigned int len )
+    {
+      chipFile *file = find( path, true );
+
+      if( file == NULL || len > sizeof(file->data) )
+      {
+        return( E_DEVICE_IO );
+      }
+
+      if( events++ == cutAt )
+      {
+        //
+        // any part of the file reached the disk, the last byte of it
+        // may be anything
+        //
+        file->len = noise() % (len + 1);
+        memcpy( file->data, data, file->len );
+        if( file->len > 0 )
+        {
+          file->data[file->len - 1] = noise();
+        }
+        throw chipPowerCut();
+      }
+
+      memcpy( file->data, data, len );
+      file->len = len;
+
+      return( E_SUCCESS );
+    }
+
+    int fileRename( const char* from, const char* to )
+    {
+      chipFile *source = find( from, false );
+      chipFile *target;
+
+      if( events++ == cutAt )
+      {
+        throw chipPowerCut();
+      }
+
+      if( source == NULL )
+      {
+        return( E_DEVICE_IO );
+      }
+
+      if( (target = find( to, false )) != NULL )
+      {
+        target->len = -1;
+      }
+      snprintf( source->path, sizeof(source->path), "%s", to );
+
+      return( E_SUCCESS );
+    }
+
+  public:
+    long events;
+
+    //
+    // the power fails at event number cut (-1: never)
+    //
+    modelFile( chipFile* disk, long cut )
+      : dsEepromFile( CHIP_FILE_PATH )
+    {
+      files = disk;
+      cutAt = cut;
+      seed = cut;
+      events = 0;
+    }
+
+    //
+    // the destructor of dsEepromFile would munmap() the mapping
+    //
+    ~modelFile()
+    {
+      if( image != NULL )
+      {
+        delete[] image;
+        image = NULL;
+      }
+    }
+};
+
+static chipFile fileDisk[CHIP_FILES];
+static chipFile fileBefore[CHIP_FILES];
+
+static void runFile( void )
+{
+  unsigned long outcomes[4] = { 0, 0, 0, 0 };   // old, new, detected, silent
+  unsigned long lost = 0;
+  unsigned long failedBoots = 0;
+  long events;
+  int update;
+
+  //
+  // reference: the updates without a cut, the image after each
+  //
+  for( int i = 0; i < CHIP_FILES; i++ )
+  {
+    fileDisk[i].len = -1;
+  }
+  {
+    modelFile model( fileDisk, CHIP_NO_FAULT );
+    dsEeprom eeprom;
+
+    eeprom.initPartition( model, 0, CHIP_PARTITION_SIZE, CHIP_MAGIC );
+    norUpdate( eeprom, 0 );
+    memcpy( fileBefore, fileDisk, sizeof(fileBefore) );
+    memcpy( norImage[0], model.memory( 0, CHIP_PARTITION_SIZE ), CHIP_PARTITION_SIZE );
+
+    model.events = 0;
+    for( int n = 1; n <= CHIP_NOR_UPDATES; n++ )
+    {
+      norStart[n] = model.events;
+      norUpdate( eeprom, n );
+      memcpy( norImage[n], model.memory( 0, CHIP_PARTITION_SIZE ), CHIP_PARTITION_SIZE );
+    }
+    events = model.events;
+    norStart[CHIP_NOR_UPDATES + 1] = events;
+  }
+
+  for( long cut = 0; cut < events; cut++ )
+  {
+    memcpy( fileDisk, fileBefore, sizeof(fileDisk) );
+
+    {
+      modelFile model( fileDisk, cut );
+      dsEeprom eeprom;
+
+      try
+      {
+        eeprom.initPartition( model, 0, CHIP_PARTITION_SIZE, CHIP_MAGIC );
+        for( int n = 1; n <= CHIP_NOR_UPDATES; n++ )
+        {
+          norUpdate( eeprom, n );
+        }
+      }
+      catch( chipPowerCut& )
+      {
+      }
+    }
+
+    for( update = 1; norStart[update + 1] <= cut; update++ )
+    {
+    }
+
+    //
+    // reboot, then one more update on what the cut left
+    //
+    {
+      modelFile model( fileDisk, CHIP_NO_FAULT );
+      dsEeprom eeprom;
+      const unsigned char *image;
+
+      eeprom.initPartition( model, 0, CHIP_PARTITION_SIZE, CHIP_MAGIC );
+      image = model.memory( 0, CHIP_PARTITION_SIZE );
+
+      if( image == NULL )
+      {
+        failedBoots++;
+        continue;
+      }
+
+      if( !norValid( eeprom ) )
+      {
+        outcomes[2]++;
+      }
+      else if( norSame( image, norImage[update] ) )
+      {
+        outcomes[1]++;
+      }
+      else if( norSame( image, norImage[update - 1] ) )
+      {
+        outcomes[0]++;
+      }
+      else
+      {
+        outcomes[3]++;
+      }
+
+      norUpdate( eeprom, CHIP_NOR_UPDATES + 1 );
+      memcpy( norAfter, image, CHIP_PARTITION_SIZE );
+    }
+
+    {
+      modelFile model( fileDisk, CHIP_NO_FAULT );
+      dsEeprom eeprom;
+      const unsigned char *image;
+
+      eeprom.initPartition( model, 0, CHIP_PARTITION_SIZE, CHIP_MAGIC );
+      image = model.memory( 0, CHIP_PARTITION_SIZE );
+
+      if( image == NULL || !norValid( eeprom ) || !norSame( image, norAfter ) )
+      {
+        lost++;
+      }
+    }
+  }
+
+  if( verbose )
+  {
+    printf( "  %-8s %ld cuts: old %lu, new %lu, detected %lu\n", "file", events,
+            outcomes[0], outcomes[1], outcomes[2] );
+  }
+
+  check( "file", "no silent corruption after a cut", outcomes[3] == 0 );
+  check( "file", "no torn image after a cut", outcomes[2] == 0 );
+  check( "file", "every boot after a cut maps", failedBoots == 0 );
+  check( "file", "update after a cut survives a reboot", lost == 0 );
+}
+
+struct chip24Cxx {
+  const char *name;
+  unsigned int capacity;
+  unsigned char pageSize;
+  unsigned int base;           // the partition crosses a block of a device address
+};
+
+static const chip24Cxx chips24Cxx[] = {
+  { "24c16",  EE24C16_CAPACITY,  EE24C16_PAGESIZE,  200 },
+  { "24c32",  EE24C32_CAPACITY,  EE24C32_PAGESIZE,  100 },
+  { "24c256", EE24C256_CAPACITY, EE24C256_PAGESIZE, 1000 },
+};
+
+#define CHIPS_24CXX  (int) (sizeof(chips24Cxx) / sizeof(chips24Cxx[0]))
+
+//
+// stores of one round, short and long ones across pages, a read
+// while bytes wait in the page buffer. False if a value read back
+// differs from the stored one.
+//
+static bool storeRound( dsEeprom& eeprom, int round )
+{
+  char raw[CHIP_RAW_LEN];
+  const char *ssid = round == 0 ? "home-network-with-a-long-name" : "other-net";
+  String value;
+
+  for( int i = 0; i < CHIP_RAW_LEN; i++ )
+  {
+    raw[i] = round * 7 + i;
+  }
+
+  eeprom.storeString( ssid, EEPROM_MAXLEN_WLAN_SSID, EEPROM_POS_WLAN_SSID );
+  eeprom.restoreString( value, EEPROM_POS_WLAN_SSID, EEPROM_MAXLEN_WLAN_SSID );
+  eeprom.storeString( round == 0 ? "passphrase-0123456789" : "pass", EEPROM_MAXLEN_WLAN_PASSPHRASE,
+                      EEPROM_POS_WLAN_PASSPHRASE );
+  eeprom.storeRaw( raw, CHIP_RAW_LEN, CHIP_RAW_POS );
+  eeprom.storeString( round == 0 ? "node-1" : "node-1-renamed", EEPROM_MAXLEN_NODENAME, EEPROM_POS_NODENAME );
+  eeprom.validate();
+
+  return( value == ssid );
+}
+
+static void run24Cxx( const chip24Cxx* chip )
+{
+  model24Cxx model( chip->capacity, chip->pageSize );
+  ramDevice reference( chip->capacity );
+  dsEeprom eeprom;
+  dsEeprom expected;
+  dsEeprom again;
+  char raw[CHIP_RAW_LEN];
+  unsigned char block[EEPROM_READ_CHUNK];
+  bool readBack = true;
+  bool zeroed = true;
+  int got;
+
+  eeprom.initPartition( model, chip->base, CHIP_PARTITION_SIZE, CHIP_MAGIC );
+  expected.initPartition( reference, chip->base, CHIP_PARTITION_SIZE, CHIP_MAGIC );
+
+  for( int round = 0; round < 2; round++ )
+  {
+    readBack = storeRound( eeprom, round ) && readBack;
+    storeRound( expected, round );
+  }
+
+  check( chip->name, "read back from the page buffer", readBack );
+  check( chip->name, "image equal to the reference",
+         memcmp( model.cells, reference.cells, chip->capacity ) == 0 );
+  check( chip->name, "no page write over a page end", model.wraps == 0 );
+  check( chip->name, "no transfer during a write cycle", model.early == 0 );
+  check( chip->name, "no transfer over the Wire buffer", model.overflows == 0 );
+  check( chip->name, "no device error", !(eeprom.getStatus() & EE_STATUS_DEVICE_ERROR) );
+
+  again.initPartition( model, chip->base, CHIP_PARTITION_SIZE, CHIP_MAGIC );
+  again.restoreRaw( raw, CHIP_RAW_POS, CHIP_RAW_LEN, CHIP_RAW_LEN );
+  check( chip->name, "valid for a new instance", again.isValid() && raw[1] == 8 );
+
+  if( verbose )
+  {
+    printf( "  %-8s %lu write cycles\n", chip->name, model.cycles );
+  }
+
+  //
+  // a write that is not acknowledged: the next commit fails
+  //
+  model.failWrite = 2;
+  storeRound( eeprom, 0 );
+  check( chip->name, "lost write sets the device error",
+         model.failWrite < 0 && (eeprom.getStatus() & EE_STATUS_DEVICE_ERROR) );
+
+  //
+  // a short read: the rest is 0, the count tells
+  //
+  memset( block, 0x55, sizeof(block) );
+  model.failRead = 0;
+  got = model.readBlock( chip->base, block, sizeof(block) );
+  for( int i = got; i < (int) sizeof(block); i++ )
+  {
+    zeroed = zeroed && block[i] == 0;
+  }
+  check( chip->name, "short read is counted and zeroed", got < (int) sizeof(block) && zeroed );
+  check( chip->name, "short read fails the next commit", model.commit() == E_DEVICE_IO );
+
+  model.failRead = 0;
+  again.crc( EEPROM_STD_DATA_BEGIN, CHIP_PARTITION_SIZE );
+  check( chip->name, "short read sets the device error",
+         (again.getStatus() & EE_STATUS_DEVICE_ERROR) != 0 );
+  model.commit();
+}
+
+//
+// ************************************************************************
+// secret fields on the 24Cxx, the counter on the chip before the
+// partition
+// ************************************************************************
+//
+
+#define CHIP_SECRET_POS      EEPROM_POS_WLAN_PASSPHRASE
+#define CHIP_SECRET_MAXLEN   EEPROM_SECRET_MAXLEN(EEPROM_MAXLEN_WLAN_PASSPHRASE)
+#define CHIP_SECRET_COUNTER  16
+#define CHIP_SECRET_TEXT     "passphrase-0123456789"
+
+static const unsigned char secretKey[EEPROM_CIPHER_KEY_SIZE] = {
+  0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+  0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f,
+};
+
+static void runSecret( void )
+{
+  const chip24Cxx *chip = &chips24Cxx[1];
+  model24Cxx model( chip->capacity, chip->pageSize );
+  unsigned char otherKey[EEPROM_CIPHER_KEY_SIZE];
+  unsigned int field = chip->base + CHIP_SECRET_POS;
+  dsEeprom eeprom;
+  dsEeprom again;
+  String value;
+  bool plain = false;
+  int len = strlen( CHIP_SECRET_TEXT );
+
+  eeprom.initPartition( model, chip->base, CHIP_PARTITION_SIZE, CHIP_MAGIC );
+  eeprom.setSecretKey( secretKey );
+  check( "secret", "no store without a counter",
+         eeprom.storeSecret( CHIP_SECRET_TEXT, CHIP_SECRET_MAXLEN, CHIP_SECRET_POS ) == E_BAD_SECRET );
+  check( "secret", "no counter in the partition",
+         eeprom.setSecretCounter( chip->base + 4 ) == E_BAD_REGION );
+  check( "secret", "counter before the partition",
+         eeprom.setSecretCounter( CHIP_SECRET_COUNTER ) == E_SUCCESS );
+
+  eeprom.storeSecret( "first", CHIP_SECRET_MAXLEN, CHIP_SECRET_POS );
+  eeprom.storeSecret( CHIP_SECRET_TEXT, CHIP_SECRET_MAXLEN, CHIP_SECRET_POS );
+  eeprom.validate();
+  check( "secret", "counter counts the stores",
+         model.cells[CHIP_SECRET_COUNTER] == 2 && model.cells[CHIP_SECRET_COUNTER + 1] == 0 );
+
+  for( unsigned int i = 0; i + len <= CHIP_PARTITION_SIZE; i++ )
+  {
+    plain = plain || memcmp( &model.cells[chip->base + i], CHIP_SECRET_TEXT, len ) == 0;
+  }
+  check( "secret", "no plain text on the chip", !plain );
+
+  //
+  // a new instance with the key reads it back, maxLen truncates after
+  // the check of the whole field as restoreString() does
+  //
+  again.initPartition( model, chip->base, CHIP_PARTITION_SIZE, CHIP_MAGIC );
+  check( "secret", "no restore without a key",
+         again.restoreSecret( value, CHIP_SECRET_POS, CHIP_SECRET_MAXLEN ) == E_BAD_SECRET &&
+         value.length() == 0 );
+  again.setSecretKey( secretKey );
+  check( "secret", "round trip",
+         again.restoreSecret( value, CHIP_SECRET_POS, CHIP_SECRET_MAXLEN ) == E_SUCCESS &&
+         value == CHIP_SECRET_TEXT );
+  check( "secret", "short maxLen truncates",
+         again.restoreSecret( value, CHIP_SECRET_POS, 10 ) == E_SUCCESS &&
+         value.length() == 10 && strncmp( value.c_str(), CHIP_SECRET_TEXT, 10 ) == 0 );
+
+  memcpy( otherKey, secretKey, sizeof(otherKey) );
+  otherKey[0] ^= 0x80;
+  again.setSecretKey( otherKey );
+  check( "secret", "other key fails",
+         again.restoreSecret( value, CHIP_SECRET_POS, CHIP_SECRET_MAXLEN ) == E_BAD_SECRET &&
+         value.length() == 0 );
+  again.setSecretKey( secretKey );
+
+  //
+  // one flipped bit in the text, the tag, the counter or the length
+  //
+  const unsigned int tampered[] = {
+    field + EEPROM_LEADING_LENGTH + EEPROM_CIPHER_COUNTER_SIZE + 3,
+    field + EEPROM_LEADING_LENGTH + EEPROM_CIPHER_COUNTER_SIZE + len + 5,
+    field + EEPROM_LEADING_LENGTH,
+    field,
+  };
+  const char *names[] = {
+    "tampered text fails", "tampered tag fails",
+    "tampered counter fails", "tampered length fails",
+  };
+
+  for( int i = 0; i < 4; i++ )
+  {
+    model.cells[tampered[i]] ^= 0x01;
+    check( "secret", names[i],
+           again.restoreSecret( value, CHIP_SECRET_POS, CHIP_SECRET_MAXLEN ) == E_BAD_SECRET &&
+           value.length() == 0 );
+    model.cells[tampered[i]] ^= 0x01;
+  }
+
+  check( "secret", "restored bits pass",
+         again.restoreSecret( value, CHIP_SECRET_POS, CHIP_SECRET_MAXLEN ) == E_SUCCESS &&
+         value == CHIP_SECRET_TEXT );
+}
+
+static void usage( const char* name )
+{
+  fprintf( stderr, "usage: %s [-v]\n", name );
+}
+
+int main( int argc, char* argv[] )
+{
+  int opt;
+
+  while( (opt = getopt( argc, argv, "v" )) != -1 )
+  {
+    switch( opt )
+    {
+      case 'v':
+        verbose = true;
+        break;
+      default:
+        usage( argv[0] );
+        return( 2 );
+    }
+  }
+
+  for( int i = 0; i < CHIPS_24CXX; i++ )
+  {
+    run24Cxx( &chips24Cxx[i] );
+  }
+
+  runSecret();
+  runNor();
+  runFile();
+
+  printf( "%d checks failed\n", failed );
+
+  return( failed > 0 ? 1 : 0 );
+}
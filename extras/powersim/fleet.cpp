@@ -0,0 +1,457 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   Devices of fleetsim and the pool that runs them.
+//
+//   A device is provisioned once and then receives its updates. Every
+//   update runs on a new instance like after a reboot, with a chance
+//   of a power loss at a random persistent write. The boot code after
+//   every update checks the image and provisions the device again if
+//   it fails, the cost of that boot after a power loss is the recovery
+//   time.
+//
+//   The random numbers of a device depend on the seed and the device
+//   number only, a run gives the same statistics on any number of
+//   threads.
+//
+// ************************************************************************
+//
+//
+//-------- History --------------------------------------------------------
+//
+// 2016/10/28: initial version
+//
+//
+// ************************************************************************
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include <mutex>
+#include <thread>
+
+#include "powersim.h"
+
+//
+// ************************************************************************
+// scripts
+// ************************************************************************
+//
+
+static void storeConfig( dsEeprom& eeprom, unsigned long value )
+{
+  char ssid[EEPROM_MAXLEN_WLAN_SSID + 1];
+  char passphrase[EEPROM_MAXLEN_WLAN_PASSPHRASE + 1];
+  char server[EEPROM_MAXLEN_SERVER_IP + 1];
+
+  snprintf( ssid, sizeof(ssid), "net-%04lx", value & 0xffff );
+  snprintf( passphrase, sizeof(passphrase), "%08lx-%.*s", value,
+            (int) (value % 24), "rollout-passphrase-2016-" );
+  snprintf( server, sizeof(server), "10.%lu.%lu.%lu", (value >> 8) & 0xff,
+            (value >> 16) & 0xff, (value >> 24) & 0xff );
+
+  eeprom.storeString( ssid, EEPROM_MAXLEN_WLAN_SSID, EEPROM_POS_WLAN_SSID );
+  eeprom.storeString( passphrase, EEPROM_MAXLEN_WLAN_PASSPHRASE, EEPROM_POS_WLAN_PASSPHRASE );
+  eeprom.storeString( server, EEPROM_MAXLEN_SERVER_IP, EEPROM_POS_SERVER_IP );
+}
+
+static void updateConfig( dsEeprom& eeprom, unsigned long value )
+{
+  storeConfig( eeprom, value );
+  eeprom.validate();
+}
+
+static void updateTxn( dsEeprom& eeprom, unsigned long value )
+{
+  unsigned char stage[EEPROM_TXN_SIZE];
+
+  eeprom.setStage( stage, sizeof(stage) );
+  eeprom.begin();
+  storeConfig( eeprom, value );
+  eeprom.commit();
+  eeprom.setStage( NULL, 0 );
+}
+
+static void updateCounter( dsEeprom& eeprom, unsigned long value )
+{
+  char counter[4];
+
+  for( int i = 0; i < 4; i++ )
+  {
+    counter[i] = (value >> (8 * i)) & 0xff;
+  }
+
+  eeprom.storeRaw( counter, sizeof(counter), EEPROM_EXT_DATA_BEGIN );
+  eeprom.validate();
+}
+
+const fleetScript fleetScripts[] = {
+  { "config",  "new network and server, validate()",     updateConfig },
+  { "txn",     "the same in a journaled transaction",     updateTxn },
+  { "counter", "a counter in the extended area, validate()", updateCounter },
+};
+
+const int fleetScriptCount = sizeof(fleetScripts) / sizeof(fleetScripts[0]);
+
+int fleetFindScript( const char* name )
+{
+  for( int i = 0; i < fleetScriptCount; i++ )
+  {
+    if( strcmp( fleetScripts[i].name, name ) == 0 )
+    {
+      return( i );
+    }
+  }
+
+  return( -1 );
+}
+
+//
+// factory settings, also after a failed boot
+//
+static void provision( dsEeprom& eeprom )
+{
+  eeprom.storeString( "factory", EEPROM_MAXLEN_WLAN_SSID, EEPROM_POS_WLAN_SSID );
+  eeprom.storeString( "factory-passphrase", EEPROM_MAXLEN_WLAN_PASSPHRASE, EEPROM_POS_WLAN_PASSPHRASE );
+  eeprom.storeString( "192.168.4.1", EEPROM_MAXLEN_SERVER_IP, EEPROM_POS_SERVER_IP );
+  eeprom.validate();
+}
+
+//
+// ************************************************************************
+// devices
+// ************************************************************************
+//
+
+//
+// splitmix64
+//
+static unsigned long long nextRandom( unsigned long long& state )
+{
+  unsigned long long z = (state += 0x9e3779b97f4a7c15ULL);
+
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+
+  return( z ^ (z >> 31) );
+}
+
+static void addCounters( fleetStats* stats, const simCounters* count, unsigned long& programmed )
+{
+  stats->programmed += count->programmed;
+  stats->pages += count->pages;
+  stats->erases += count->erases;
+  stats->commits += count->commits;
+  programmed += count->programmed;
+}
+
+static simOutcome classify( bool valid, const unsigned char* image,
+                            const unsigned char* before, const unsigned char* after )
+{
+  bool isBefore = true;
+  bool isAfter = true;
+
+  for( int pos = EEPROM_STD_DATA_BEGIN; pos < SIM_PARTITION_SIZE; pos++ )
+  {
+    isBefore = isBefore && image[pos] == before[pos];
+    isAfter = isAfter && image[pos] == after[pos];
+  }
+
+  if( !valid )
+  {
+    return( SIM_DETECTED );
+  }
+
+  return( isAfter ? SIM_NEW : (isBefore ? SIM_OLD : SIM_SILENT) );
+}
+
+void fleetRunDevice( const fleetConfig* config, unsigned long device, fleetStats stats[SIM_MODES] )
+{
+  unsigned long long random = config->seed ^ ((unsigned long long) device << 20);
+  simMode mode = (simMode) (config->mode >= 0 ? config->mode : (int) (device % SIM_MODES));
+  fleetStats *st = &stats[mode];
+  unsigned char image[SIM_CAPACITY];
+  unsigned char journalImage[SIM_CAPACITY];
+  unsigned char after[SIM_CAPACITY];
+  unsigned long programmed = 0;
+  unsigned long value;
+  unsigned long bootUs;
+  const fleetScript *script;
+  long cut;
+  bool valid;
+
+  {
+    simDevice fresh( mode );
+    dsEeprom eeprom;
+
+    eeprom.initPartition( fresh, 0, SIM_PARTITION_SIZE, SIM_MAGIC );
+    provision( eeprom );
+    memcpy( image, fresh.persistent(), SIM_CAPACITY );
+  }
+  memset( journalImage, 0xff, SIM_CAPACITY );
+
+  st->devices++;
+
+  for( unsigned int round = 0; round < config->rounds; round++ )
+  {
+    script = &fleetScripts[config->script >= 0 ? config->script :
+                           (int) (nextRandom( random ) % fleetScriptCount)];
+    value = (unsigned long) nextRandom( random );
+    cut = -1;
+    st->updates++;
+
+    //
+    // a run without power loss tells the number of writes and the
+    // content after the update
+    //
+    if( nextRandom( random ) % 100 < config->cutPercent )
+    {
+      simDevice probe( mode, image );
+      simDevice probeJournal( mode, journalImage );
+
+      {
+        dsEeprom eeprom;
+
+        simAttach( eeprom, probe, probeJournal );
+        script->update( eeprom, value );
+      }
+
+      memcpy( after, probe.persistent(), SIM_CAPACITY );
+
+      if( probe.getEvents() > 0 )
+      {
+        cut = nextRandom( random ) % probe.getEvents();
+        st->cuts++;
+      }
+    }
+
+    simDevice target( mode, image );
+    simDevice targetJournal( mode, journalImage );
+
+    target.setCut( cut );
+
+    try
+    {
+      dsEeprom eeprom;
+
+      simAttach( eeprom, target, targetJournal );
+      script->update( eeprom, value );
+    }
+    catch( simPowerCut& )
+    {
+    }
+
+    addCounters( st, &target.count, programmed );
+
+    //
+    // boot, provision again if the image fails
+    //
+    simDevice rebooted( mode, target.persistent() );
+    simDevice rebootedJournal( mode, targetJournal.persistent() );
+    dsEeprom eeprom;
+
+    simAttach( eeprom, rebooted, rebootedJournal );
+    valid = simImageValid( eeprom );
+
+    if( cut >= 0 )
+    {
+      st->outcomes[classify( valid, rebooted.persistent(), image, after )]++;
+    }
+
+    if( !valid )
+    {
+      st->failed++;
+      eeprom.wipe();
+      provision( eeprom );
+    }
+
+    if( cut >= 0 )
+    {
+      bootUs = rebooted.estimateUs();
+      st->recoveries++;
+      st->recoveryUs += bootUs;
+      if( bootUs > st->maxRecoveryUs )
+      {
+        st->maxRecoveryUs = bootUs;
+      }
+    }
+
+    addCounters( st, &rebooted.count, programmed );
+    memcpy( image, rebooted.persistent(), SIM_CAPACITY );
+    memcpy( journalImage, rebootedJournal.persistent(), SIM_CAPACITY );
+  }
+
+  if( programmed > st->maxProgrammed )
+  {
+    st->maxProgrammed = programmed;
+  }
+}
+
+void fleetAddStats( fleetStats* sum, const fleetStats* add )
+{
+  sum->devices += add->devices;
+  sum->updates += add->updates;
+  sum->cuts += add->cuts;
+  for( int i = 0; i < SIM_OUTCOMES; i++ )
+  {
+    sum->outcomes[i] += add->outcomes[i];
+  }
+  sum->programmed += add->programmed;
+  sum->pages += add->pages;
+  sum->erases += add->erases;
+  sum->commits += add->commits;
+  sum->failed += add->failed;
+  sum->recoveries += add->recoveries;
+  sum->recoveryUs += add->recoveryUs;
+
+  if( add->maxProgrammed > sum->maxProgrammed )
+  {
+    sum->maxProgrammed = add->maxProgrammed;
+  }
+
+  if( add->maxRecoveryUs > sum->maxRecoveryUs )
+  {
+    sum->maxRecoveryUs = add->maxRecoveryUs;
+  }
+}
+
+//
+// ************************************************************************
+// pool
+// ************************************************************************
+//
+
+//
+// devices next .. end-1 of a thread, the owner takes from the front,
+// the others steal from the back
+//
+struct fleetRange {
+  std::mutex lock;
+  unsigned long next;
+  unsigned long end;
+};
+
+//
+// the next device of thread self, false when there is no work left;
+// an empty thread takes the upper half of the next range with work
+//
+static bool takeDevice( std::vector<fleetRange>& ranges, unsigned int self,
+                        unsigned long* device, fleetWorker* worker )
+{
+  fleetRange *own = &ranges[self];
+  unsigned long first = 0;
+  unsigned long last = 0;
+
+  {
+    std::lock_guard<std::mutex> guard( own->lock );
+
+    if( own->next < own->end )
+    {
+      *device = own->next++;
+      return( true );
+    }
+  }
+
+  for( unsigned int i = 1; i < ranges.size() && first == last; i++ )
+  {
+    fleetRange *victim = &ranges[(self + i) % ranges.size()];
+    std::lock_guard<std::mutex> guard( victim->lock );
+
+    if( victim->next < victim->end )
+    {
+      first = victim->next + (victim->end - victim->next) / 2;
+      last = victim->end;
+      victim->end = first;
+    }
+  }
+
+  if( first == last )
+  {
+    return( false );
+  }
+
+  //
+  // own is empty, so no one steals from it meanwhile
+  //
+  {
+    std::lock_guard<std::mutex> guard( own->lock );
+
+    own->next = first + 1;
+    own->end = last;
+  }
+
+  *device = first;
+  worker->steals++;
+
+  return( true );
+}
+
+void fleetRun( const fleetConfig* config, std::vector<fleetWorker>& workers )
+{
+  unsigned int jobs = config->jobs;
+  std::vector<std::thread> threads;
+
+  if( jobs == 0 )
+  {
+    jobs = std::thread::hardware_concurrency();
+  }
+
+  if( jobs == 0 )
+  {
+    jobs = 1;
+  }
+
+  if( jobs > config->devices )
+  {
+    jobs = config->devices > 0 ? config->devices : 1;
+  }
+
+  std::vector<fleetRange> ranges( jobs );
+
+  workers.assign( jobs, fleetWorker() );
+
+  for( unsigned int i = 0; i < jobs; i++ )
+  {
+    ranges[i].next = config->devices * i / jobs;
+    ranges[i].end = config->devices * (i + 1) / jobs;
+  }
+
+  for( unsigned int i = 0; i < jobs; i++ )
+  {
+    threads.push_back( std::thread( [&, i]()
+    {
+      fleetWorker *worker = &workers[i];
+      unsigned long device;
+
+      while( takeDevice( ranges, i, &device, worker ) )
+      {
+        fleetRunDevice( config, device, worker->stats );
+        worker->devices++;
+      }
+    } ) );
+  }
+
+  for( unsigned int i = 0; i < threads.size(); i++ )
+  {
+    threads[i].join();
+  }
+}
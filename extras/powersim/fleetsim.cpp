@@ -0,0 +1,201 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   fleetsim - simulate a rollout to a fleet of devices, each with its
+//   own image and dsEeprom instance, with random power losses, on all
+//   cores.
+//
+//   usage: fleetsim [-n devices] [-r updates] [-p percent] [-m mode]
+//                   [-s script] [-S seed] [-j jobs]
+//
+//     -n   devices (default 10000)
+//     -r   updates per device (default 20)
+//     -p   chance of a power loss per update in percent (default 10)
+//     -m   eeprom, paged or sector (default: the devices run all)
+//     -s   config, txn or counter (default: random per update)
+//     -S   seed of the random numbers (default 1)
+//     -j   threads (default: one per core)
+//
+//   Exit code 1 if an update ended silent (undetected corruption).
+//
+// ************************************************************************
+//
+//
+//-------- History --------------------------------------------------------
+//
+// 2016/10/28: initial version
+//
+//
+// ************************************************************************
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <chrono>
+
+#include "powersim.h"
+
+static void usage( const char* name )
+{
+  fprintf( stderr, "usage: %s [-n devices] [-r updates] [-p percent] [-m mode] [-s script] [-S seed] [-j jobs]\n", name );
+  fprintf( stderr, "  modes:    " );
+  for( int i = 0; i < SIM_MODES; i++ )
+  {
+    fprintf( stderr, "%s ", simTimings[i].name );
+  }
+  fprintf( stderr, "\n  scripts:\n" );
+  for( int i = 0; i < fleetScriptCount; i++ )
+  {
+    fprintf( stderr, "    %-8s %s\n", fleetScripts[i].name, fleetScripts[i].text );
+  }
+}
+
+static bool parseValue( const char* text, unsigned long& value )
+{
+  char *end;
+
+  value = strtoul( text, &end, 0 );
+
+  return( *text != '\0' && *end == '\0' );
+}
+
+static void printStats( const char* name, const fleetStats* st )
+{
+  printf( "%-7s %7lu %8lu %6lu %6lu %6lu %8lu %6lu %10lu %8lu %9lu %6lu %8.1f %8.1f\n",
+          name, st->devices, st->updates, st->cuts,
+          st->outcomes[SIM_OLD], st->outcomes[SIM_NEW], st->outcomes[SIM_DETECTED], st->outcomes[SIM_SILENT],
+          st->programmed, st->commits, st->maxProgrammed, st->failed,
+          st->recoveries > 0 ? st->recoveryUs / st->recoveries / 1000.0 : 0.0,
+          st->maxRecoveryUs / 1000.0 );
+}
+
+int main( int argc, char* argv[] )
+{
+  fleetConfig config;
+  std::vector<fleetWorker> workers;
+  fleetStats total[SIM_MODES];
+  fleetStats all;
+  unsigned long value;
+  unsigned long minDevices = 0;
+  unsigned long maxDevices = 0;
+  unsigned long steals = 0;
+  double seconds;
+  bool ok = true;
+  int opt;
+
+  config.devices = 10000;
+  config.rounds = 20;
+  config.cutPercent = 10;
+  config.mode = -1;
+  config.script = -1;
+  config.seed = 1;
+  config.jobs = 0;
+
+  while( (opt = getopt( argc, argv, "n:r:p:m:s:S:j:" )) != -1 && ok )
+  {
+    switch( opt )
+    {
+      case 'n':
+        ok = parseValue( optarg, config.devices );
+        break;
+      case 'r':
+        ok = parseValue( optarg, value );
+        config.rounds = value;
+        break;
+      case 'p':
+        ok = parseValue( optarg, value ) && value <= 100;
+        config.cutPercent = value;
+        break;
+      case 'm':
+        ok = (config.mode = simFindMode( optarg )) >= 0;
+        break;
+      case 's':
+        ok = (config.script = fleetFindScript( optarg )) >= 0;
+        break;
+      case 'S':
+        ok = parseValue( optarg, config.seed );
+        break;
+      case 'j':
+        ok = parseValue( optarg, value );
+        config.jobs = value;
+        break;
+      default:
+        ok = false;
+        break;
+    }
+  }
+
+  if( !ok || optind != argc )
+  {
+    usage( argv[0] );
+    return( 2 );
+  }
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  fleetRun( &config, workers );
+  seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+
+  all = fleetStats();
+  for( int m = 0; m < SIM_MODES; m++ )
+  {
+    total[m] = fleetStats();
+  }
+
+  for( unsigned int i = 0; i < workers.size(); i++ )
+  {
+    for( int m = 0; m < SIM_MODES; m++ )
+    {
+      fleetAddStats( &total[m], &workers[i].stats[m] );
+    }
+
+    if( i == 0 || workers[i].devices < minDevices ) minDevices = workers[i].devices;
+    if( workers[i].devices > maxDevices )           maxDevices = workers[i].devices;
+    steals += workers[i].steals;
+  }
+
+  printf( "%lu devices, %u updates each, power loss in %u%% of the updates, seed %lu\n\n",
+          config.devices, config.rounds, config.cutPercent, config.seed );
+
+  printf( "%-7s %7s %8s %6s %6s %6s %8s %6s %10s %8s %9s %6s %8s %8s\n",
+          "mode", "devices", "updates", "cuts", "old", "new", "detected", "silent",
+          "progr", "commits", "max progr", "failed", "avg ms", "max ms" );
+
+  for( int m = 0; m < SIM_MODES; m++ )
+  {
+    if( total[m].devices > 0 )
+    {
+      printStats( simTimings[m].name, &total[m] );
+      fleetAddStats( &all, &total[m] );
+    }
+  }
+
+  printStats( "all", &all );
+
+  printf( "\nprogr: bytes programmed by updates and boots, max progr: of one device\n" );
+  printf( "failed: boots that provisioned the device again, ms: boot after a power loss\n" );
+  printf( "\n%u threads, %.2f s, %.0f devices/s, %lu .. %lu devices per thread, %lu steals\n",
+          (unsigned int) workers.size(), seconds, seconds > 0 ? config.devices / seconds : 0.0,
+          minDevices, maxDevices, steals );
+
+  return( all.outcomes[SIM_SILENT] > 0 ? 1 : 0 );
+}
@@ -0,0 +1,103 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   The part of the Arduino core the library uses, to build it on a
+//   host for the simulators in extras/. Not a complete core.
+//
+// ************************************************************************
+//
+//
+//-------- History --------------------------------------------------------
+//
+// 2016/10/28: initial version
+//
+//
+// ************************************************************************
+
+#ifndef _POWERSIM_ARDUINO_H_
+#define _POWERSIM_ARDUINO_H_
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <string.h>
+#include <string>
+
+#define PROGMEM
+#define pgm_read_byte(addr)   (*(const uint8_t*)(addr))
+#define pgm_read_dword(addr)  (*(const uint32_t*)(addr))
+
+typedef uint8_t byte;
+
+class String {
+
+  private:
+    std::string text;
+
+  public:
+    String( const char* value = "" ) : text( value ) {}
+    String& operator=( const char* value ) { text = value; return( *this ); }
+    String& operator+=( char c ) { text += c; return( *this ); }
+    bool operator==( const char* value ) const { return( text == value ); }
+    unsigned int length( void ) const { return( text.size() ); }
+    const char* c_str( void ) const { return( text.c_str() ); }
+    void trim( void );
+};
+
+class Stream {
+
+  public:
+    virtual ~Stream() {}
+    virtual int available( void ) = 0;
+    virtual int read( void ) = 0;
+    virtual size_t write( uint8_t value ) = 0;
+    virtual size_t write( const uint8_t* data, size_t len );
+    virtual void flush( void ) {}
+};
+
+//
+// Serial: print() and println() go to stdout, nothing comes in
+//
+class HardwareSerial : public Stream {
+
+  public:
+    int available( void ) { return( 0 ); }
+    int read( void ) { return( -1 ); }
+    size_t write( uint8_t value );
+    size_t print( char c ) { return( write( c ) ); }
+    size_t print( unsigned int value );
+    size_t println( void ) { return( write( '\n' ) ); }
+    void flush( void );
+};
+
+extern HardwareSerial Serial;
+
+#define LOW       0
+#define HIGH      1
+#define OUTPUT    1
+
+unsigned long millis( void );
+unsigned long micros( void );
+void delay( unsigned long ms );
+void yield( void );
+void pinMode( uint8_t pin, uint8_t mode );
+void digitalWrite( uint8_t pin, uint8_t value );
+
+#endif // _POWERSIM_ARDUINO_H_
@@ -0,0 +1,55 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   EEPROM class for host builds - RAM only, the simulators use a
+//   device of their own (see powersim.h).
+//
+// ************************************************************************
+//
+//
+//-------- History --------------------------------------------------------
+//
+// 2016/10/28: initial version
+//
+//
+// ************************************************************************
+
+#ifndef _POWERSIM_EEPROM_H_
+#define _POWERSIM_EEPROM_H_
+
+#include <inttypes.h>
+
+#define EEPROM_HOST_SIZE   4096
+
+class EEPROMClass {
+
+  private:
+    uint8_t data[EEPROM_HOST_SIZE];
+
+  public:
+    void begin( void ) {}
+    uint8_t read( int address ) { return( data[address] ); }
+    void write( int address, uint8_t value ) { data[address] = value; }
+};
+
+extern EEPROMClass EEPROM;
+
+#endif // _POWERSIM_EEPROM_H_
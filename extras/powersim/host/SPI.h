@@ -0,0 +1,60 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   SPIClass for host builds - a bus without devices, the models in
+//   chipsim overwrite the flash access of the drivers.
+//
+// ************************************************************************
+//
+//
+//-------- History --------------------------------------------------------
+//
+// 2016/10/28: initial version
+//
+//
+// ************************************************************************
+
+#ifndef _POWERSIM_SPI_H_
+#define _POWERSIM_SPI_H_
+
+#include <inttypes.h>
+
+#define MSBFIRST    1
+#define SPI_MODE0   0
+
+class SPISettings {
+
+  public:
+    SPISettings( uint32_t, uint8_t, uint8_t ) {}
+};
+
+class SPIClass {
+
+  public:
+    void begin( void ) {}
+    void beginTransaction( SPISettings ) {}
+    void endTransaction( void ) {}
+    uint8_t transfer( uint8_t ) { return( 0xff ); }
+};
+
+extern SPIClass SPI;
+
+#endif // _POWERSIM_SPI_H_
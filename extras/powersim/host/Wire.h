@@ -0,0 +1,56 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   TwoWire class for host builds - a bus without devices, the models
+//   in chipsim overwrite the bus access of the drivers.
+//
+// ************************************************************************
+//
+//
+//-------- History --------------------------------------------------------
+//
+// 2016/10/28: initial version
+//
+//
+// ************************************************************************
+
+#ifndef _POWERSIM_WIRE_H_
+#define _POWERSIM_WIRE_H_
+
+#include <inttypes.h>
+#include <stddef.h>
+
+#define BUFFER_LENGTH   32
+
+class TwoWire {
+
+  public:
+    void begin( void ) {}
+    void beginTransmission( uint8_t ) {}
+    size_t write( const uint8_t*, size_t len ) { return( len ); }
+    uint8_t endTransmission( void ) { return( 2 ); }   // address not acknowledged
+    uint8_t requestFrom( uint8_t, uint8_t ) { return( 0 ); }
+    int read( void ) { return( -1 ); }
+};
+
+extern TwoWire Wire;
+
+#endif // _POWERSIM_WIRE_H_
@@ -0,0 +1,117 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   Host implementation of the core functions in Arduino.h.
+//
+// ************************************************************************
+//
+//
+//-------- History --------------------------------------------------------
+//
+// 2016/10/28: initial version
+//
+//
+// ************************************************************************
+//
+
+#include <stdio.h>
+
+#include <chrono>
+#include <thread>
+
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <Wire.h>
+#include <SPI.h>
+
+EEPROMClass EEPROM;
+TwoWire Wire;
+SPIClass SPI;
+HardwareSerial Serial;
+
+static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+void String::trim( void )
+{
+  size_t first = text.find_first_not_of( " \t\r\n" );
+  size_t last = text.find_last_not_of( " \t\r\n" );
+
+  text = first == std::string::npos ? "" : text.substr( first, last - first + 1 );
+}
+
+size_t Stream::write( const uint8_t* data, size_t len )
+{
+  size_t done = 0;
+
+  while( done < len && write( data[done] ) == 1 )
+  {
+    done++;
+  }
+
+  return( done );
+}
+
+size_t HardwareSerial::write( uint8_t value )
+{
+  return( putchar( value ) == EOF ? 0 : 1 );
+}
+
+size_t HardwareSerial::print( unsigned int value )
+{
+  int len = printf( "%u", value );
+
+  return( len > 0 ? len : 0 );
+}
+
+void HardwareSerial::flush( void )
+{
+  fflush( stdout );
+}
+
+unsigned long millis( void )
+{
+  return( std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start ).count() );
+}
+
+unsigned long micros( void )
+{
+  return( std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start ).count() );
+}
+
+void delay( unsigned long ms )
+{
+  std::this_thread::sleep_for( std::chrono::milliseconds( ms ) );
+}
+
+void yield( void )
+{
+  std::this_thread::yield();
+}
+
+void pinMode( uint8_t, uint8_t )
+{
+}
+
+void digitalWrite( uint8_t, uint8_t )
+{
+}
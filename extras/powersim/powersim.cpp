@@ -0,0 +1,179 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   powersim - cut the power at every persistent write of the update
+//   sequences, reboot and report recovery and boot cost per storage
+//   mode.
+//
+//   usage: powersim [-m mode] [-s scenario] [-v]
+//
+//     -m   eeprom, paged or sector (default: all)
+//     -s   store, txn, patch or migrate (default: all)
+//     -v   one line per cut
+//
+//   Exit code 1 if a run ended silent (undetected corruption).
+//
+// ************************************************************************
+//
+//
+//-------- History --------------------------------------------------------
+//
+// 2016/10/28: initial version
+//
+//
+// ************************************************************************
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "powersim.h"
+
+static void usage( const char* name )
+{
+  fprintf( stderr, "usage: %s [-m mode] [-s scenario] [-v]\n", name );
+  fprintf( stderr, "  modes:    " );
+  for( int i = 0; i < SIM_MODES; i++ )
+  {
+    fprintf( stderr, "%s ", simTimings[i].name );
+  }
+  fprintf( stderr, "\n  scenarios:\n" );
+  for( int i = 0; i < simScenarioCount; i++ )
+  {
+    fprintf( stderr, "    %-8s %s\n", simScenarios[i].name, simScenarios[i].text );
+  }
+}
+
+//
+// all cuts of one scenario in one mode, returns the silent runs
+//
+static long simulate( const simScenario* scenario, simMode mode, bool verbose )
+{
+  static simReference ref;
+  simRun run;
+  long outcomes[SIM_OUTCOMES];
+  unsigned long maxReads = 0, maxProgrammed = 0, maxCommits = 0, maxUs = 0;
+  double sumUs = 0;
+  long cuts;
+
+  simPrepare( scenario, mode, &ref );
+  memset( outcomes, 0, sizeof(outcomes) );
+
+  //
+  // cut == events is the run without a power loss
+  //
+  for( cuts = 0; cuts <= ref.events; cuts++ )
+  {
+    simCutAndBoot( &ref, cuts, &run );
+    outcomes[run.outcome]++;
+
+    if( run.boot.reads > maxReads )           maxReads = run.boot.reads;
+    if( run.boot.programmed > maxProgrammed ) maxProgrammed = run.boot.programmed;
+    if( run.boot.commits > maxCommits )       maxCommits = run.boot.commits;
+    if( run.bootUs > maxUs )                  maxUs = run.bootUs;
+    sumUs += run.bootUs;
+
+    if( verbose )
+    {
+      printf( "  %-7s %-8s cut %5ld  %-8s read %5lu  programmed %5lu  commits %lu  %8.1f ms\n",
+              simTimings[mode].name, scenario->name, cuts, simOutcomeNames[run.outcome],
+              run.boot.reads, run.boot.programmed, run.boot.commits, run.bootUs / 1000.0 );
+    }
+  }
+
+  printf( "%-7s %-8s %6ld %6ld %6ld %8ld %6ld %7lu %7lu %4lu %9.1f %9.1f\n",
+          simTimings[mode].name, scenario->name, cuts,
+          outcomes[SIM_OLD], outcomes[SIM_NEW], outcomes[SIM_DETECTED], outcomes[SIM_SILENT],
+          maxReads, maxProgrammed, maxCommits, maxUs / 1000.0, sumUs / cuts / 1000.0 );
+
+  return( outcomes[SIM_SILENT] );
+}
+
+int main( int argc, char* argv[] )
+{
+  const simScenario *scenario = NULL;
+  int mode = -1;
+  bool verbose = false;
+  long silent = 0;
+  int opt;
+
+  while( (opt = getopt( argc, argv, "m:s:v" )) != -1 )
+  {
+    switch( opt )
+    {
+      case 'm':
+        if( (mode = simFindMode( optarg )) < 0 )
+        {
+          usage( argv[0] );
+          return( 2 );
+        }
+        break;
+      case 's':
+        if( (scenario = simFindScenario( optarg )) == NULL )
+        {
+          usage( argv[0] );
+          return( 2 );
+        }
+        break;
+      case 'v':
+        verbose = true;
+        break;
+      default:
+        usage( argv[0] );
+        return( 2 );
+    }
+  }
+
+  printf( "assumed timing:\n" );
+  for( int i = 0; i < SIM_MODES; i++ )
+  {
+    printf( "  %-7s page %3u byte, %5lu us/byte, %5lu us/page, %6lu us/erase\n",
+            simTimings[i].name, simTimings[i].pageSize, simTimings[i].byteUs,
+            simTimings[i].pageUs, simTimings[i].eraseUs );
+  }
+
+  printf( "\n%-7s %-8s %6s %6s %6s %8s %6s %7s %7s %4s %9s %9s\n",
+          "mode", "scenario", "cuts", "old", "new", "detected", "silent",
+          "reads", "progr", "cmts", "max ms", "avg ms" );
+
+  for( int m = 0; m < SIM_MODES; m++ )
+  {
+    if( mode >= 0 && m != mode )
+    {
+      continue;
+    }
+
+    for( int s = 0; s < simScenarioCount; s++ )
+    {
+      if( scenario != NULL && scenario != &simScenarios[s] )
+      {
+        continue;
+      }
+
+      silent += simulate( &simScenarios[s], (simMode) m, verbose );
+    }
+  }
+
+  printf( "\nreads, progr, cmts: maximum of the boot code over all cuts\n" );
+
+  return( silent > 0 ? 1 : 0 );
+}
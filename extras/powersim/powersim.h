@@ -0,0 +1,281 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   powersim - power loss simulator for dsEeprom on a host.
+//
+//   The library runs on a simulated device (simDevice) that counts
+//   every byte that reaches the persistent storage. A run of an update
+//   sequence (scenario) is cut at one of these events, everything not
+//   persistent is lost. Then the device "reboots": a new instance runs
+//   the boot code of the scenario and the result is compared with the
+//   content before and after the update:
+//
+//     old       valid, content before the update
+//     new       valid, content after the update
+//     detected  isValid() or the checksum fails - the firmware notices
+//     silent    valid, but neither old nor new content
+//
+//   The cost of the boot code (bytes read and programmed, commits) is
+//   converted to a time by the timing of the storage mode.
+//
+//   fleetsim runs the same device for a fleet: every device has its
+//   own image and instance and receives a series of updates with
+//   random power losses, the devices run on a work stealing pool.
+//
+// ************************************************************************
+//
+//
+//-------- History --------------------------------------------------------
+//
+// 2016/10/28: initial version
+//
+//
+// ************************************************************************
+
+#ifndef _POWERSIM_H_
+#define _POWERSIM_H_
+
+#include <vector>
+
+#include <dsEeprom.h>
+
+#define SIM_CAPACITY           1024
+#define SIM_PARTITION_SIZE      512
+#define SIM_JOURNAL             640  // journal of the transaction scenario
+#define SIM_JOURNAL_SIZE        320
+//
+// in sector mode the journal is on a device of its own and holds the
+// whole image
+//
+#define SIM_SECTOR_JOURNAL_SIZE  EEPROM_JOURNAL_SIZE( EEPATCH_RUN_HEADER + SIM_PARTITION_SIZE )
+#define SIM_MAGIC              0x7e
+#define SIM_PATCH_MAX          1024
+
+//
+// storage modes
+//
+enum simMode {
+  SIM_EEPROM,     // byte writes are persistent at once (AVR, 24Cxx byte write)
+  SIM_PAGED,      // writes are buffered, commit programs the changed bytes
+  SIM_SECTOR,     // writes are buffered, commit erases and programs all (ESP8266)
+  SIM_MODES
+};
+
+//
+// assumed timing of a mode, us
+//
+struct simTiming {
+  const char *name;
+  unsigned int pageSize;
+  unsigned long byteUs;
+  unsigned long pageUs;
+  unsigned long eraseUs;
+};
+
+extern const simTiming simTimings[SIM_MODES];
+
+struct simCounters {
+  unsigned long reads;
+  unsigned long programmed;
+  unsigned long pages;
+  unsigned long erases;
+  unsigned long commits;
+};
+
+//
+// thrown when the power fails
+//
+struct simPowerCut {
+};
+
+class simDevice : public dsEepromDevice {
+
+  private:
+    simMode mode;
+    unsigned char flash[SIM_CAPACITY];
+    unsigned char ram[SIM_CAPACITY];
+    bool dirty[SIM_CAPACITY];
+    unsigned int used;
+    long cutAt;
+    long events;
+    simDevice *supply;
+
+    void event( void );
+    simCounters* counts( void );
+
+  public:
+    simCounters count;
+
+    simDevice( simMode newMode, const unsigned char* image = NULL );
+    //
+    // the power fails before event number at (-1: never)
+    //
+    void setCut( long at );
+    //
+    // the device shares the power supply of another one (another
+    // sector of the same flash): its writes and counters count as those
+    // of that device and fail with its cut
+    //
+    void setSupply( simDevice* other );
+    long getEvents( void );
+    const unsigned char* persistent( void );
+    void resetCounters( void );
+    unsigned long estimateUs( void );
+
+    int begin( unsigned int size );
+    unsigned int capacity( void );
+    unsigned char read( int address );
+    void write( int address, unsigned char value );
+    int commit( void );
+    bool commitsWhole( void );
+    bool concurrentReads( void );
+};
+
+enum simOutcome {
+  SIM_OLD,
+  SIM_NEW,
+  SIM_DETECTED,
+  SIM_SILENT,
+  SIM_OUTCOMES
+};
+
+extern const char* const simOutcomeNames[SIM_OUTCOMES];
+
+//
+// an update sequence and the boot code that goes with it
+//
+struct simScenario {
+  const char *name;
+  const char *text;
+  void (*setup)( dsEeprom& eeprom );
+  void (*update)( dsEeprom& eeprom, const unsigned char* patch, unsigned int patchLen );
+  void (*boot)( dsEeprom& eeprom );
+};
+
+extern const simScenario simScenarios[];
+extern const int simScenarioCount;
+
+//
+// content before and after a scenario, built by simPrepare()
+//
+struct simReference {
+  const simScenario *scenario;
+  simMode mode;
+  unsigned char before[SIM_CAPACITY];
+  unsigned char after[SIM_CAPACITY];
+  unsigned char patch[SIM_PATCH_MAX];
+  unsigned int patchLen;
+  long events;
+};
+
+//
+// result of one cut
+//
+struct simRun {
+  simOutcome outcome;
+  simCounters boot;
+  unsigned long bootUs;
+};
+
+const simScenario* simFindScenario( const char* name );
+int simFindMode( const char* name );
+void simPrepare( const simScenario* scenario, simMode mode, simReference* ref );
+//
+// the header is valid and the stored checksum matches
+//
+bool simImageValid( dsEeprom& eeprom );
+//
+// the partition of device and the journal: in device, or in journal if
+// device commits whole
+//
+void simAttach( dsEeprom& eeprom, simDevice& device, simDevice& journal );
+void simCutAndBoot( const simReference* ref, long cut, simRun* run );
+
+//
+// ************************************************************************
+// fleet (fleetsim)
+// ************************************************************************
+//
+
+//
+// what a fleet run does
+//
+struct fleetConfig {
+  unsigned long devices;
+  unsigned int rounds;          // updates per device
+  unsigned int cutPercent;      // chance of a power loss per update
+  int mode;                     // -1: device n runs mode n % SIM_MODES
+  int script;                   // -1: random per update
+  unsigned long seed;
+  unsigned int jobs;            // 0: one per core
+};
+
+//
+// statistics of a mode, summed over the devices
+//
+struct fleetStats {
+  unsigned long devices;
+  unsigned long updates;
+  unsigned long cuts;
+  unsigned long outcomes[SIM_OUTCOMES];
+  unsigned long programmed;     // bytes written by the updates
+  unsigned long pages;
+  unsigned long erases;
+  unsigned long commits;
+  unsigned long maxProgrammed;  // of one device
+  unsigned long failed;         // boots that failed the validation
+  unsigned long recoveries;     // boots after a power loss
+  double recoveryUs;
+  unsigned long maxRecoveryUs;
+};
+
+//
+// work of one thread of the pool
+//
+struct fleetWorker {
+  unsigned long devices;
+  unsigned long steals;
+  fleetStats stats[SIM_MODES];
+};
+
+//
+// an update the fleet receives, value makes the content of a device
+// and update
+//
+struct fleetScript {
+  const char *name;
+  const char *text;
+  void (*update)( dsEeprom& eeprom, unsigned long value );
+};
+
+extern const fleetScript fleetScripts[];
+extern const int fleetScriptCount;
+
+int fleetFindScript( const char* name );
+void fleetAddStats( fleetStats* sum, const fleetStats* add );
+void fleetRunDevice( const fleetConfig* config, unsigned long device, fleetStats stats[SIM_MODES] );
+//
+// fleetRunDevice() for all devices on a work stealing pool, one
+// fleetWorker per thread
+//
+void fleetRun( const fleetConfig* config, std::vector<fleetWorker>& workers );
+
+#endif // _POWERSIM_H_
@@ -0,0 +1,358 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   Update sequences of powersim and the run of one power cut.
+//
+// ************************************************************************
+//
+//
+//-------- History --------------------------------------------------------
+//
+// 2016/10/28: initial version
+//
+//
+// ************************************************************************
+//
+
+#include <string.h>
+
+#include "powersim.h"
+
+const char* const simOutcomeNames[SIM_OUTCOMES] = { "old", "new", "detected", "silent" };
+
+//
+// ************************************************************************
+// scenarios
+// ************************************************************************
+//
+
+static void storeOld( dsEeprom& eeprom )
+{
+  eeprom.storeString( "home-net", EEPROM_MAXLEN_WLAN_SSID, EEPROM_POS_WLAN_SSID );
+  eeprom.storeString( "old-secret-passphrase", EEPROM_MAXLEN_WLAN_PASSPHRASE, EEPROM_POS_WLAN_PASSPHRASE );
+  eeprom.storeString( "192.168.1.10", EEPROM_MAXLEN_SERVER_IP, EEPROM_POS_SERVER_IP );
+  eeprom.storeString( "node-1", EEPROM_MAXLEN_NODENAME, EEPROM_POS_NODENAME );
+}
+
+static void storeNew( dsEeprom& eeprom )
+{
+  eeprom.storeString( "office-network-5g", EEPROM_MAXLEN_WLAN_SSID, EEPROM_POS_WLAN_SSID );
+  eeprom.storeString( "new-much-longer-passphrase-2016", EEPROM_MAXLEN_WLAN_PASSPHRASE, EEPROM_POS_WLAN_PASSPHRASE );
+  eeprom.storeString( "10.0.0.42", EEPROM_MAXLEN_SERVER_IP, EEPROM_POS_SERVER_IP );
+}
+
+static void setupPlain( dsEeprom& eeprom )
+{
+  storeOld( eeprom );
+  eeprom.validate();
+}
+
+static void bootPlain( dsEeprom& eeprom )
+{
+  (void) eeprom;
+}
+
+static void updateStore( dsEeprom& eeprom, const unsigned char* patch, unsigned int patchLen )
+{
+  (void) patch;
+  (void) patchLen;
+
+  storeNew( eeprom );
+  eeprom.validate();
+}
+
+static void updateTxn( dsEeprom& eeprom, const unsigned char* patch, unsigned int patchLen )
+{
+  unsigned char stage[EEPROM_TXN_SIZE];
+
+  (void) patch;
+  (void) patchLen;
+
+  eeprom.setStage( stage, sizeof(stage) );
+  eeprom.begin();
+  storeNew( eeprom );
+  eeprom.commit();
+  eeprom.setStage( NULL, 0 );
+}
+
+static void updatePatch( dsEeprom& eeprom, const unsigned char* patch, unsigned int patchLen )
+{
+  eeprom.applyPatch( patch, patchLen );
+}
+
+//
+// schema 1 -> 2: node name and SSID move to the extended area, the
+// node name grows
+//
+static const dsEepromFieldMove moves1to2[] = {
+  { EEPROM_POS_NODENAME, 300, EEPROM_MAXLEN_NODENAME + EEPROM_LEADING_LENGTH, 50, EE_MOVE_PREFIXED },
+  { EEPROM_POS_WLAN_SSID, 250, EEPROM_MAXLEN_WLAN_SSID + EEPROM_LEADING_LENGTH,
+    EEPROM_MAXLEN_WLAN_SSID + EEPROM_LEADING_LENGTH, EE_MOVE_PREFIXED },
+};
+
+static const dsEepromMigration migrations[] = {
+  { 1, 2, moves1to2, sizeof(moves1to2) / sizeof(moves1to2[0]) },
+};
+
+static void setupMigrate( dsEeprom& eeprom )
+{
+  eeprom.setSchemaVersion( 1 );
+  setupPlain( eeprom );
+}
+
+static void bootMigrate( dsEeprom& eeprom )
+{
+  eeprom.setSchemaVersion( 2 );
+  eeprom.migrate( migrations, sizeof(migrations) / sizeof(migrations[0]) );
+}
+
+static void updateMigrate( dsEeprom& eeprom, const unsigned char* patch, unsigned int patchLen )
+{
+  (void) patch;
+  (void) patchLen;
+
+  bootMigrate( eeprom );
+}
+
+const simScenario simScenarios[] = {
+  { "store",   "three storeString() and validate()",       setupPlain,   updateStore,   bootPlain },
+  { "txn",     "the same stores in a journaled transaction", setupPlain, updateTxn,     bootPlain },
+  { "patch",   "the same change by applyPatch()",           setupPlain,   updatePatch,   bootPlain },
+  { "migrate", "migrate() schema 1 to 2, again at boot",    setupMigrate, updateMigrate, bootMigrate },
+};
+
+const int simScenarioCount = sizeof(simScenarios) / sizeof(simScenarios[0]);
+
+const simScenario* simFindScenario( const char* name )
+{
+  for( int i = 0; i < simScenarioCount; i++ )
+  {
+    if( strcmp( simScenarios[i].name, name ) == 0 )
+    {
+      return( &simScenarios[i] );
+    }
+  }
+
+  return( NULL );
+}
+
+int simFindMode( const char* name )
+{
+  for( int i = 0; i < SIM_MODES; i++ )
+  {
+    if( strcmp( simTimings[i].name, name ) == 0 )
+    {
+      return( i );
+    }
+  }
+
+  return( -1 );
+}
+
+//
+// ************************************************************************
+// runs
+// ************************************************************************
+//
+
+//
+// patch from before to the content after updateStore(), one run per
+// range of changed bytes
+//
+static unsigned int makePatch( const unsigned char* before, const unsigned char* after,
+                               unsigned char* patch )
+{
+  unsigned int len = EEPATCH_HEADER_SIZE;
+  unsigned int start;
+
+  patch[EEPATCH_POS_MAGIC] = EEPATCH_MAGIC_0;
+  patch[EEPATCH_POS_MAGIC + 1] = EEPATCH_MAGIC_1;
+  patch[EEPATCH_POS_VERSION] = EEPATCH_VERSION;
+  patch[EEPATCH_POS_FLAGS] = 0;
+  patch[EEPATCH_POS_SIZE] = SIM_PARTITION_SIZE & 0xff;
+  patch[EEPATCH_POS_SIZE + 1] = (SIM_PARTITION_SIZE >> 8) & 0xff;
+  memcpy( &patch[EEPATCH_POS_BASE_CRC], &before[EEPROM_POS_CRC32], EEPROM_MAXLEN_CRC32 );
+  memcpy( &patch[EEPATCH_POS_TARGET_CRC], &after[EEPROM_POS_CRC32], EEPROM_MAXLEN_CRC32 );
+
+  for( unsigned int pos = EEPROM_STD_DATA_BEGIN; pos < SIM_PARTITION_SIZE; )
+  {
+    if( before[pos] == after[pos] )
+    {
+      pos++;
+      continue;
+    }
+
+    for( start = pos; pos < SIM_PARTITION_SIZE && before[pos] != after[pos]; pos++ )
+    {
+    }
+
+    if( len + EEPATCH_RUN_HEADER + (pos - start) > SIM_PATCH_MAX )
+    {
+      break;
+    }
+
+    patch[len] = start & 0xff;
+    patch[len + 1] = (start >> 8) & 0xff;
+    patch[len + 2] = (pos - start) & 0xff;
+    patch[len + 3] = ((pos - start) >> 8) & 0xff;
+    memcpy( &patch[len + EEPATCH_RUN_HEADER], &after[start], pos - start );
+    len += EEPATCH_RUN_HEADER + (pos - start);
+  }
+
+  return( len );
+}
+
+void simAttach( dsEeprom& eeprom, simDevice& device, simDevice& journal )
+{
+  eeprom.initPartition( device, 0, SIM_PARTITION_SIZE, SIM_MAGIC );
+
+  if( device.commitsWhole() )
+  {
+    journal.setSupply( &device );
+    eeprom.setJournal( journal, 0, SIM_SECTOR_JOURNAL_SIZE );
+  }
+  else
+  {
+    eeprom.setJournal( SIM_JOURNAL, SIM_JOURNAL_SIZE );
+  }
+}
+
+void simPrepare( const simScenario* scenario, simMode mode, simReference* ref )
+{
+  simDevice device( mode );
+
+  ref->scenario = scenario;
+  ref->mode = mode;
+
+  {
+    dsEeprom eeprom;
+
+    eeprom.initPartition( device, 0, SIM_PARTITION_SIZE, SIM_MAGIC );
+    scenario->setup( eeprom );
+  }
+  memcpy( ref->before, device.persistent(), SIM_CAPACITY );
+
+  //
+  // the patch scenario needs the result of the store scenario
+  //
+  {
+    simDevice target( mode, ref->before );
+    dsEeprom eeprom;
+
+    eeprom.initPartition( target, 0, SIM_PARTITION_SIZE, SIM_MAGIC );
+    updateStore( eeprom, NULL, 0 );
+    ref->patchLen = makePatch( ref->before, target.persistent(), ref->patch );
+  }
+
+  {
+    simDevice clean( mode, ref->before );
+    simDevice journal( mode );
+    dsEeprom eeprom;
+
+    simAttach( eeprom, clean, journal );
+    scenario->update( eeprom, ref->patch, ref->patchLen );
+    memcpy( ref->after, clean.persistent(), SIM_CAPACITY );
+    ref->events = clean.getEvents();
+  }
+}
+
+//
+// the check of any boot code: header and stored checksum
+//
+bool simImageValid( dsEeprom& eeprom )
+{
+  unsigned char stored[EEPROM_MAXLEN_CRC32];
+  unsigned long storedCrc = 0;
+
+  eeprom.restoreRaw( (char*) stored, EEPROM_POS_CRC32, EEPROM_MAXLEN_CRC32, EEPROM_MAXLEN_CRC32 );
+  for( int i = 0; i < EEPROM_MAXLEN_CRC32; i++ )
+  {
+    storedCrc |= (unsigned long) stored[i] << (8 * i);
+  }
+
+  return( eeprom.isValid() &&
+          (storedCrc & 0xffffffffUL) == (eeprom.crc( EEPROM_STD_DATA_BEGIN, SIM_PARTITION_SIZE ) & 0xffffffffUL) );
+}
+
+void simCutAndBoot( const simReference* ref, long cut, simRun* run )
+{
+  simDevice device( ref->mode, ref->before );
+  simDevice journal( ref->mode );
+  bool valid;
+  bool isBefore = true;
+  bool isAfter = true;
+
+  device.setCut( cut );
+
+  try
+  {
+    dsEeprom eeprom;
+
+    simAttach( eeprom, device, journal );
+    ref->scenario->update( eeprom, ref->patch, ref->patchLen );
+  }
+  catch( simPowerCut& )
+  {
+  }
+
+  //
+  // reboot with what is persistent
+  //
+  simDevice rebooted( ref->mode, device.persistent() );
+  simDevice rebootedJournal( ref->mode, journal.persistent() );
+  dsEeprom eeprom;
+
+  simAttach( eeprom, rebooted, rebootedJournal );
+  ref->scenario->boot( eeprom );
+
+  valid = simImageValid( eeprom );
+
+  //
+  // the check above is part of any boot code
+  //
+  run->boot = rebooted.count;
+  run->bootUs = rebooted.estimateUs();
+
+  for( int pos = EEPROM_STD_DATA_BEGIN; pos < SIM_PARTITION_SIZE; pos++ )
+  {
+    unsigned char value = rebooted.read( pos );
+
+    isBefore = isBefore && value == ref->before[pos];
+    isAfter = isAfter && value == ref->after[pos];
+  }
+
+  if( !valid )
+  {
+    run->outcome = SIM_DETECTED;
+  }
+  else if( isAfter )
+  {
+    run->outcome = SIM_NEW;
+  }
+  else if( isBefore )
+  {
+    run->outcome = SIM_OLD;
+  }
+  else
+  {
+    run->outcome = SIM_SILENT;
+  }
+}
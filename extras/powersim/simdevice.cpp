@@ -0,0 +1,232 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   Simulated storage device of powersim.
+//   Every change of the persistent content is an event, the power
+//   fails before a given event. Reads are not events.
+//
+// ************************************************************************
+//
+//
+//-------- History --------------------------------------------------------
+//
+// 2016/10/28: initial version
+//
+//
+// ************************************************************************
+//
+
+#include <string.h>
+
+#include "powersim.h"
+
+//
+// typical datasheet values:
+//   AVR onchip EEPROM  3.4 ms per byte
+//   24Cxx              5 ms per page write (32 byte pages)
+//   ESP8266 flash      45 ms sector erase, 0.7 ms per 256 byte page
+//
+const simTiming simTimings[SIM_MODES] = {
+  { "eeprom", 1,   3400,    0,     0 },
+  { "paged",  32,     0, 5000,     0 },
+  { "sector", 256,    0,  700, 45000 },
+};
+
+simDevice::simDevice( simMode newMode, const unsigned char* image )
+{
+  mode = newMode;
+
+  if( image != NULL )
+  {
+    memcpy( flash, image, SIM_CAPACITY );
+  }
+  else
+  {
+    memset( flash, 0xff, SIM_CAPACITY );
+  }
+
+  memcpy( ram, flash, SIM_CAPACITY );
+  memset( dirty, 0, sizeof(dirty) );
+  used = SIM_CAPACITY;
+  cutAt = -1;
+  events = 0;
+  supply = NULL;
+  resetCounters();
+}
+
+void simDevice::setCut( long at )
+{
+  cutAt = at;
+}
+
+void simDevice::setSupply( simDevice* other )
+{
+  supply = other;
+}
+
+long simDevice::getEvents( void )
+{
+  return( events );
+}
+
+const unsigned char* simDevice::persistent( void )
+{
+  return( flash );
+}
+
+void simDevice::resetCounters( void )
+{
+  memset( &count, 0, sizeof(count) );
+}
+
+unsigned long simDevice::estimateUs( void )
+{
+  const simTiming *timing = &simTimings[mode];
+
+  return( count.programmed * timing->byteUs + count.pages * timing->pageUs +
+          count.erases * timing->eraseUs );
+}
+
+void simDevice::event( void )
+{
+  if( supply != NULL )
+  {
+    supply->event();
+    return;
+  }
+
+  if( events == cutAt )
+  {
+    throw simPowerCut();
+  }
+
+  events++;
+}
+
+simCounters* simDevice::counts( void )
+{
+  return( supply != NULL ? &supply->count : &count );
+}
+
+int simDevice::begin( unsigned int size )
+{
+  if( size > SIM_CAPACITY )
+  {
+    return( E_DEVICE_IO );
+  }
+
+  used = size;
+
+  return( E_SUCCESS );
+}
+
+unsigned int simDevice::capacity( void )
+{
+  return( SIM_CAPACITY );
+}
+
+unsigned char simDevice::read( int address )
+{
+  counts()->reads++;
+
+  return( mode == SIM_EEPROM ? flash[address] : ram[address] );
+}
+
+void simDevice::write( int address, unsigned char value )
+{
+  if( mode == SIM_EEPROM )
+  {
+    event();
+    flash[address] = value;
+    counts()->programmed++;
+    counts()->pages++;
+  }
+  else
+  {
+    ram[address] = value;
+    dirty[address] = true;
+  }
+}
+
+//
+// paged: the changed bytes in ascending order, sector: erase, then
+// the content up to the size of begin() like the ESP8266 core
+//
+int simDevice::commit( void )
+{
+  unsigned int pageSize = simTimings[mode].pageSize;
+  int lastPage = -1;
+  bool changed = false;
+
+  if( mode == SIM_EEPROM )
+  {
+    counts()->commits++;
+    return( E_SUCCESS );
+  }
+
+  for( int i = 0; i < SIM_CAPACITY && !changed; i++ )
+  {
+    changed = dirty[i];
+  }
+
+  if( !changed )
+  {
+    return( E_SUCCESS );
+  }
+
+  counts()->commits++;
+
+  if( mode == SIM_SECTOR )
+  {
+    event();
+    memset( flash, 0xff, SIM_CAPACITY );
+    counts()->erases++;
+  }
+
+  for( int i = 0; i < SIM_CAPACITY; i++ )
+  {
+    if( (mode == SIM_SECTOR && i < (int) used) || dirty[i] )
+    {
+      event();
+      flash[i] = ram[i];
+      dirty[i] = false;
+      counts()->programmed++;
+
+      if( (int) (i / pageSize) != lastPage )
+      {
+        lastPage = i / pageSize;
+        counts()->pages++;
+      }
+    }
+  }
+
+  return( E_SUCCESS );
+}
+
+bool simDevice::commitsWhole( void )
+{
+  return( mode == SIM_SECTOR );
+}
+
+bool simDevice::concurrentReads( void )
+{
+  return( true );
+}
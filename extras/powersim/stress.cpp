@@ -0,0 +1,325 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   stress - readers and writers on one instance in thread safe mode
+//   (DSEEPROM_THREADSAFE), built with pthreads.
+//
+//   Writer threads store fields, validate(), run transactions and
+//   write into an error corrected region. Reader threads restore the
+//   fields, check isValid() and compare every value with the pattern
+//   the writers use: a value is a run of one character, its length
+//   follows from the character. A torn read (length and data of
+//   different stores, or bytes of two stores) breaks the pattern.
+//
+//   usage: stress [-r readers] [-w writers] [-t seconds] [-b]
+//
+//     -r   reader threads (default 4)
+//     -w   writer threads (default 2)
+//     -t   run time in seconds (default 5)
+//     -b   device behind a bus: readers take the lock
+//
+//   Exit code 1 if a read was torn.
+//
+// ************************************************************************
+//
+//
+//-------- History --------------------------------------------------------
+//
+// 2016/10/28: initial version
+//
+//
+// ************************************************************************
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <dsEeprom.h>
+
+#ifndef DSEEPROM_THREADSAFE
+#error "stress needs DSEEPROM_THREADSAFE"
+#endif // DSEEPROM_THREADSAFE
+
+#define STRESS_CAPACITY       1024
+#define STRESS_SIZE            512
+#define STRESS_MAGIC          0x7e
+#define STRESS_JOURNAL         640
+#define STRESS_JOURNAL_SIZE    320
+#define STRESS_ECC_POS         (EEPROM_EXT_DATA_BEGIN)
+#define STRESS_ECC_LEN          64
+#define STRESS_ECC_PARITY      (STRESS_ECC_POS + STRESS_ECC_LEN)
+#define STRESS_FIELD_MAX        32
+
+//
+// memory like the RAM copy of an ESP32, every byte is accessed as a
+// whole so a reader sees torn values but no undefined behaviour
+//
+class stressDevice : public dsEepromDevice {
+
+  private:
+    std::atomic<unsigned char> memory[STRESS_CAPACITY];
+    bool bus;
+
+  public:
+    std::atomic<unsigned long> commits;
+
+    stressDevice( bool behindBus )
+    {
+      for( int i = 0; i < STRESS_CAPACITY; i++ )
+      {
+        memory[i].store( 0xff, std::memory_order_relaxed );
+      }
+      bus = behindBus;
+      commits = 0;
+    }
+
+    int begin( unsigned int size )
+    {
+      return( size <= STRESS_CAPACITY ? E_SUCCESS : E_DEVICE_IO );
+    }
+
+    unsigned int capacity( void )
+    {
+      return( STRESS_CAPACITY );
+    }
+
+    unsigned char read( int address )
+    {
+      return( memory[address].load( std::memory_order_relaxed ) );
+    }
+
+    void write( int address, unsigned char value )
+    {
+      memory[address].store( value, std::memory_order_relaxed );
+    }
+
+    int commit( void )
+    {
+      commits++;
+      return( E_SUCCESS );
+    }
+
+    bool concurrentReads( void )
+    {
+      return( !bus );
+    }
+};
+
+struct stressField {
+  int pos;
+  int maxLen;
+};
+
+static const stressField fields[] = {
+  { EEPROM_POS_WLAN_SSID,       EEPROM_MAXLEN_WLAN_SSID },
+  { EEPROM_POS_WLAN_PASSPHRASE, EEPROM_MAXLEN_WLAN_PASSPHRASE },
+  { EEPROM_POS_NODENAME,        EEPROM_MAXLEN_NODENAME },
+  { STRESS_ECC_POS,             STRESS_FIELD_MAX },
+};
+
+#define STRESS_FIELDS  (int) (sizeof(fields) / sizeof(fields[0]))
+
+static std::atomic<bool> running( true );
+static std::atomic<unsigned long> writes( 0 );
+static std::atomic<unsigned long> reads( 0 );
+static std::atomic<unsigned long> torn( 0 );
+static std::atomic<unsigned long> maxReadUs( 0 );
+
+//
+// value number n: 4 .. 29 times one letter
+//
+static String pattern( unsigned long n )
+{
+  String value;
+
+  for( unsigned int i = 0; i < 4 + n % 26; i++ )
+  {
+    value += (char) ('A' + n % 26);
+  }
+
+  return( value );
+}
+
+static bool isPattern( String& value )
+{
+  const char *text = value.c_str();
+  unsigned int len = value.length();
+
+  if( len < 4 || text[0] < 'A' || text[0] > 'Z' || len != 4 + (unsigned int) (text[0] - 'A') )
+  {
+    return( false );
+  }
+
+  for( unsigned int i = 1; i < len; i++ )
+  {
+    if( text[i] != text[0] )
+    {
+      return( false );
+    }
+  }
+
+  return( true );
+}
+
+static void writer( dsEeprom* eeprom, unsigned int seed )
+{
+  unsigned long n = seed;
+  const stressField *field;
+
+  while( running )
+  {
+    n = n * 1103515245UL + 12345UL;
+    field = &fields[(n >> 8) % STRESS_FIELDS];
+
+    switch( (n >> 16) % 8 )
+    {
+      case 0:
+        //
+        // two fields in one transaction
+        //
+        eeprom->begin();
+        eeprom->storeString( pattern( n >> 4 ), fields[0].maxLen, fields[0].pos );
+        eeprom->storeString( pattern( n >> 5 ), fields[1].maxLen, fields[1].pos );
+        eeprom->commit();
+        break;
+      case 1:
+        eeprom->validate();
+        break;
+      default:
+        eeprom->storeString( pattern( n >> 4 ), field->maxLen, field->pos );
+        break;
+    }
+
+    writes++;
+  }
+}
+
+static void reader( dsEeprom* eeprom, unsigned int seed )
+{
+  unsigned long n = seed;
+  unsigned long us;
+  unsigned long known;
+  const stressField *field;
+  String value;
+
+  while( running )
+  {
+    n = n * 1103515245UL + 12345UL;
+    field = &fields[(n >> 8) % STRESS_FIELDS];
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    if( (n >> 16) % 4 == 0 )
+    {
+      eeprom->isValid();
+    }
+    else if( eeprom->restoreString( value, field->pos, field->maxLen ) < 0 || !isPattern( value ) )
+    {
+      torn++;
+      fprintf( stderr, "torn read at %d: '%s'\n", field->pos, value.c_str() );
+    }
+
+    us = std::chrono::duration_cast<std::chrono::microseconds>(
+           std::chrono::steady_clock::now() - start ).count();
+
+    known = maxReadUs;
+    while( us > known && !maxReadUs.compare_exchange_weak( known, us ) )
+    {
+    }
+
+    reads++;
+  }
+}
+
+static void usage( const char* name )
+{
+  fprintf( stderr, "usage: %s [-r readers] [-w writers] [-t seconds] [-b]\n", name );
+}
+
+int main( int argc, char* argv[] )
+{
+  unsigned int readers = 4;
+  unsigned int writers = 2;
+  unsigned int seconds = 5;
+  bool bus = false;
+  std::vector<std::thread> threads;
+  int opt;
+
+  while( (opt = getopt( argc, argv, "r:w:t:b" )) != -1 )
+  {
+    switch( opt )
+    {
+      case 'r': readers = atoi( optarg ); break;
+      case 'w': writers = atoi( optarg ); break;
+      case 't': seconds = atoi( optarg ); break;
+      case 'b': bus = true; break;
+      default:
+        usage( argv[0] );
+        return( 2 );
+    }
+  }
+
+  stressDevice device( bus );
+  dsEeprom eeprom;
+  unsigned char stage[EEPROM_TXN_SIZE];
+
+  eeprom.initPartition( device, 0, STRESS_SIZE, STRESS_MAGIC );
+  eeprom.setJournal( STRESS_JOURNAL, STRESS_JOURNAL_SIZE );
+  eeprom.setStage( stage, sizeof(stage) );
+  eeprom.addEccRegion( STRESS_ECC_POS, STRESS_ECC_LEN, STRESS_ECC_PARITY );
+
+  for( int i = 0; i < STRESS_FIELDS; i++ )
+  {
+    eeprom.storeString( pattern( i ), fields[i].maxLen, fields[i].pos );
+  }
+  eeprom.validate();
+
+  for( unsigned int i = 0; i < writers; i++ )
+  {
+    threads.push_back( std::thread( writer, &eeprom, 1 + i ) );
+  }
+
+  for( unsigned int i = 0; i < readers; i++ )
+  {
+    threads.push_back( std::thread( reader, &eeprom, 100 + i ) );
+  }
+
+  sleep( seconds );
+  running = false;
+
+  for( unsigned int i = 0; i < threads.size(); i++ )
+  {
+    threads[i].join();
+  }
+
+  printf( "%u writers, %u readers, %u s, %s device\n", writers, readers, seconds,
+          bus ? "bus" : "memory" );
+  printf( "  writes %lu, commits %lu, reads %lu, torn reads %lu, longest read %.3f ms\n",
+          writes.load(), device.commits.load(), reads.load(), torn.load(), maxReadUs / 1000.0 );
+
+  return( torn > 0 ? 1 : 0 );
+}
@@ -0,0 +1,379 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   tracesim - record an access trace with dsEepromTrace and feed it
+//   to dseetool layout.
+//
+//   A dsEeprom over bytes in RAM behind dsEepromTrace stores the node
+//   name and the admin password together in every update, the SSID
+//   now and then. With the header each update dirties three pages, a
+//   layout that puts the two fields next to the header only two.
+//   The update runs twice: with a hook that writes the trace to a
+//   file and with the default hook, whose lines on Serial (stdout of
+//   the host) go to a second file. Checked are that both traces are
+//   equal and hold every write and commit that reached the device,
+//   and that dseetool layout reads the same counts from the trace and
+//   proposes a layout with fewer pages per commit.
+//
+//   usage: tracesim [-t dseetool] [-v]
+//
+//     -t   path of dseetool (default: ../dseetool/dseetool)
+//     -v   one line per check
+//
+//   Exit code 1 if a check failed.
+//
+// ************************************************************************
+//
+//
+//-------- History --------------------------------------------------------
+//
+// 2016/10/28: initial version
+//
+//
+// ************************************************************************
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+
+#include <dsEeprom.h>
+#include <dsEepromTrace.h>
+
+#define TRACE_BASE            100    // device address of the partition
+#define TRACE_PARTITION_SIZE  512
+#define TRACE_CAPACITY       1024
+#define TRACE_MAGIC          0x7e
+#define TRACE_PAGE_SIZE        32
+#define TRACE_UPDATES          40
+
+static bool verbose = false;
+static int failed = 0;
+static const char *tool = "../dseetool/dseetool";
+static char workDir[] = "/tmp/tracesimXXXXXX";
+static FILE *traceFile = NULL;
+
+static void check( const char* name, bool ok )
+{
+  if( !ok )
+  {
+    failed++;
+  }
+
+  if( verbose || !ok )
+  {
+    printf( "  %-48s %s\n", name, ok ? "ok" : "FAILED" );
+  }
+}
+
+class ramDevice : public dsEepromDevice {
+
+  public:
+    unsigned char cells[TRACE_CAPACITY];
+    unsigned long writes;
+    unsigned long commits;
+
+    ramDevice()
+    {
+      memset( cells, 0xff, sizeof(cells) );
+      writes = 0;
+      commits = 0;
+    }
+
+    int begin( unsigned int size )
+    {
+      return( size <= TRACE_CAPACITY ? E_SUCCESS : E_DEVICE_IO );
+    }
+
+    unsigned int capacity( void )
+    {
+      return( TRACE_CAPACITY );
+    }
+
+    unsigned char read( int address )
+    {
+      return( cells[address] );
+    }
+
+    void write( int address, unsigned char value )
+    {
+      writes++;
+      cells[address] = value;
+    }
+
+    int commit( void )
+    {
+      commits++;
+
+      return( E_SUCCESS );
+    }
+};
+
+//
+// the lines of the default hook into traceFile
+//
+static void fileTrace( char event, unsigned int address )
+{
+  if( event == EE_TRACE_WRITE )
+  {
+    fprintf( traceFile, "%c %u\n", event, address );
+  }
+  else
+  {
+    fprintf( traceFile, "%c\n", event );
+  }
+}
+
+static std::string workPath( const char* name )
+{
+  return( std::string( workDir ) + "/" + name );
+}
+
+static void runUpdates( dsEeprom& eeprom )
+{
+  char text[EEPROM_MAXLEN_ADMIN_PASSWORD];
+
+  for( int i = 0; i < TRACE_UPDATES; i++ )
+  {
+    snprintf( text, sizeof(text), "node-%d", i );
+    eeprom.storeString( text, EEPROM_MAXLEN_NODENAME, EEPROM_POS_NODENAME );
+    snprintf( text, sizeof(text), "secret-%d", i );
+    eeprom.storeString( text, EEPROM_MAXLEN_ADMIN_PASSWORD, EEPROM_POS_ADMIN_PASSWORD );
+    if( i % 8 == 0 )
+    {
+      snprintf( text, sizeof(text), "net-%d", i );
+      eeprom.storeString( text, EEPROM_MAXLEN_WLAN_SSID, EEPROM_POS_WLAN_SSID );
+    }
+    eeprom.validate();
+  }
+}
+
+//
+// the update over a trace with hook, the device counts what reached it
+//
+static void record( ramDevice& device, dsEepromTraceHook hook )
+{
+  dsEepromTrace trace( device, hook );
+  dsEeprom eeprom;
+
+  eeprom.initPartition( trace, TRACE_BASE, TRACE_PARTITION_SIZE, TRACE_MAGIC );
+  runUpdates( eeprom );
+}
+
+static bool countTrace( const char* path, unsigned long& writes, unsigned long& commits )
+{
+  FILE *fp;
+  char line[64];
+
+  if( (fp = fopen( path, "r" )) == NULL )
+  {
+    return( false );
+  }
+
+  writes = 0;
+  commits = 0;
+
+  while( fgets( line, sizeof(line), fp ) != NULL )
+  {
+    writes += line[0] == EE_TRACE_WRITE ? 1 : 0;
+    commits += line[0] == EE_TRACE_COMMIT ? 1 : 0;
+  }
+
+  fclose( fp );
+
+  return( true );
+}
+
+static bool sameFile( const char* a, const char* b )
+{
+  FILE *fa = fopen( a, "r" );
+  FILE *fb = fopen( b, "r" );
+  bool same = fa != NULL && fb != NULL;
+  int c;
+
+  while( same && (c = fgetc( fa )) == fgetc( fb ) && c != EOF )
+  {
+  }
+
+  same = same && feof( fa ) && feof( fb );
+
+  if( fa != NULL )
+  {
+    fclose( fa );
+  }
+  if( fb != NULL )
+  {
+    fclose( fb );
+  }
+
+  return( same );
+}
+
+//
+// dseetool layout on the trace, false if it fails. The pages per
+// commit of the current and the proposed layout and the counts of
+// its first line.
+//
+static bool runLayout( const char* path, double& current, double& proposed,
+                       unsigned long& writes, unsigned long& commits, bool& defines )
+{
+  std::string command;
+  char line[256];
+  FILE *fp;
+
+  command = std::string( tool ) + " layout -b " + std::to_string( TRACE_BASE ) +
+            " -p " + std::to_string( TRACE_PAGE_SIZE ) + " " + path;
+
+  if( (fp = popen( command.c_str(), "r" )) == NULL )
+  {
+    return( false );
+  }
+
+  current = -1;
+  proposed = -1;
+  writes = 0;
+  commits = 0;
+  defines = false;
+
+  while( fgets( line, sizeof(line), fp ) != NULL )
+  {
+    if( verbose )
+    {
+      printf( "    %s", line );
+    }
+
+    if( strncmp( line, path, strlen( path ) ) == 0 )
+    {
+      sscanf( line + strlen( path ), ": %lu writes, %lu commits", &writes, &commits );
+    }
+    sscanf( line, " current layout %lf", &current );
+    sscanf( line, " proposed layout %lf", &proposed );
+    defines = defines || strncmp( line, "#define EEPROM_POS_", 19 ) == 0;
+  }
+
+  return( pclose( fp ) == 0 );
+}
+
+int main( int argc, char* argv[] )
+{
+  ramDevice hooked;
+  ramDevice printed;
+  std::string hookPath;
+  std::string serialPath;
+  unsigned long writes = 0;
+  unsigned long commits = 0;
+  unsigned long layoutWrites;
+  unsigned long layoutCommits;
+  double current;
+  double proposed;
+  bool defines = false;
+  bool ok;
+  int out;
+  int opt;
+
+  while( (opt = getopt( argc, argv, "t:v" )) != -1 )
+  {
+    switch( opt )
+    {
+      case 't':
+        tool = optarg;
+        break;
+      case 'v':
+        verbose = true;
+        break;
+      default:
+        fprintf( stderr, "usage: %s [-t dseetool] [-v]\n", argv[0] );
+        return( 2 );
+    }
+  }
+
+  if( access( tool, X_OK ) != 0 )
+  {
+    fprintf( stderr, "%s not found, build extras/dseetool first\n", tool );
+    return( 2 );
+  }
+
+  if( mkdtemp( workDir ) == NULL )
+  {
+    perror( workDir );
+    return( 2 );
+  }
+
+  hookPath = workPath( "hook.txt" );
+  serialPath = workPath( "serial.txt" );
+
+  //
+  // with a hook into a file
+  //
+  if( (traceFile = fopen( hookPath.c_str(), "w" )) == NULL )
+  {
+    perror( hookPath.c_str() );
+    return( 2 );
+  }
+  record( hooked, fileTrace );
+  fclose( traceFile );
+
+  //
+  // with the default hook, stdout into a file meanwhile
+  //
+  fflush( stdout );
+  out = dup( 1 );
+  ok = freopen( serialPath.c_str(), "w", stdout ) != NULL;
+  if( ok )
+  {
+    record( printed, NULL );
+    fflush( stdout );
+  }
+  dup2( out, 1 );
+  close( out );
+  clearerr( stdout );
+
+  check( "default hook prints on Serial", ok );
+  check( "default hook prints the lines of the hook",
+         sameFile( hookPath.c_str(), serialPath.c_str() ) );
+  check( "both devices got the same writes",
+         memcmp( hooked.cells, printed.cells, sizeof(hooked.cells) ) == 0 );
+
+  check( "trace is readable", countTrace( hookPath.c_str(), writes, commits ) );
+  check( "trace holds every write", writes == hooked.writes && writes > 0 );
+  check( "trace holds every commit", commits == hooked.commits && commits >= TRACE_UPDATES );
+
+  //
+  // the trace as input of dseetool layout
+  //
+  check( "dseetool layout ends with success",
+         runLayout( serialPath.c_str(), current, proposed, layoutWrites, layoutCommits, defines ) );
+  check( "dseetool layout reads every write", layoutWrites == writes );
+  check( "dseetool layout reads every commit", layoutCommits == commits );
+  check( "proposed layout dirties fewer pages", proposed >= 0 && proposed < current );
+  check( "proposed layout as #defines", defines );
+
+  unlink( hookPath.c_str() );
+  unlink( serialPath.c_str() );
+  rmdir( workDir );
+
+  printf( "%d checks failed\n", failed );
+
+  return( failed > 0 ? 1 : 0 );
+}
@@ -0,0 +1,400 @@
+//
+// ************************************************************************
+// dsEeprom
+// (C) 2016 Dirk Schanz aka dreamshader
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//   xfersim - run the device side of the serial transfer against
+//   dseetool export/import over a pseudo terminal.
+//
+//   The device is a dsEeprom over bytes in RAM that calls
+//   serveTransfer() in its loop, dseetool runs as a child process on
+//   the other end of the pty. Checked are an export, an import into a
+//   stage that holds the changes, an import onto a wiped device whose
+//   stage is too small - through the journal of setJournal() - and
+//   without a journal, where the device has to stay as it was, and
+//   an image that does not match its own checksum.
+//
+//   usage: xfersim [-t dseetool] [-v]
+//
+//     -t   path of dseetool (default: ../dseetool/dseetool)
+//     -v   one line per check
+//
+//   Exit code 1 if a check failed.
+//
+// ************************************************************************
+//
+//
+//-------- History --------------------------------------------------------
+//
+// 2016/10/28: initial version
+//
+//
+// ************************************************************************
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/wait.h>
+
+#include <dsEeprom.h>
+
+#define XFER_PARTITION_SIZE   512
+#define XFER_CAPACITY        1024
+#define XFER_MAGIC           0x7e
+#define XFER_JOURNAL_SIZE    EEPROM_JOURNAL_SIZE( EEPATCH_RUN_HEADER + XFER_PARTITION_SIZE )
+#define XFER_SMALL_STAGE       64    // a few fields, not an image
+
+static bool verbose = false;
+static int failed = 0;
+static const char *tool = "../dseetool/dseetool";
+static char workDir[] = "/tmp/xfersimXXXXXX";
+
+static void check( const char* name, bool ok )
+{
+  if( !ok )
+  {
+    failed++;
+  }
+
+  if( verbose || !ok )
+  {
+    printf( "  %-48s %s\n", name, ok ? "ok" : "FAILED" );
+  }
+}
+
+class ramDevice : public dsEepromDevice {
+
+  public:
+    unsigned char cells[XFER_CAPACITY];
+
+    ramDevice()
+    {
+      memset( cells, 0xff, sizeof(cells) );
+    }
+
+    int begin( unsigned int size )
+    {
+      return( size <= XFER_CAPACITY ? E_SUCCESS : E_DEVICE_IO );
+    }
+
+    unsigned int capacity( void )
+    {
+      return( XFER_CAPACITY );
+    }
+
+    unsigned char read( int address )
+    {
+      return( cells[address] );
+    }
+
+    void write( int address, unsigned char value )
+    {
+      cells[address] = value;
+    }
+};
+
+//
+// the serial port of the device: the master side of the pty
+//
+class ptyStream : public Stream {
+
+  private:
+    int fd;
+
+  public:
+    ptyStream( int master )
+    {
+      fd = master;
+    }
+
+    int available( void )
+    {
+      struct pollfd pfd;
+
+      pfd.fd = fd;
+      pfd.events = POLLIN;
+
+      return( poll( &pfd, 1, 0 ) > 0 && (pfd.revents & POLLIN) ? 1 : 0 );
+    }
+
+    int read( void )
+    {
+      unsigned char value;
+
+      return( ::read( fd, &value, 1 ) == 1 ? value : -1 );
+    }
+
+    size_t write( uint8_t value )
+    {
+      return( ::write( fd, &value, 1 ) == 1 ? 1 : 0 );
+    }
+};
+
+//
+// run dseetool <command> <tty> <file> while the device serves the
+// transfer, returns the exit code of dseetool
+//
+static int runTool( dsEeprom& eeprom, const char* command, const char* file )
+{
+  struct termios tio;
+  char path[256];
+  int master;
+  int slave;
+  int status = -1;
+  pid_t pid;
+
+  if( (master = posix_openpt( O_RDWR | O_NOCTTY )) < 0 ||
+      grantpt( master ) != 0 || unlockpt( master ) != 0 ||
+      (slave = open( ptsname( master ), O_RDWR | O_NOCTTY )) < 0 )
+  {
+    perror( "pty" );
+    exit( 2 );
+  }
+
+  //
+  // raw from the start, the device side does not answer an echo
+  //
+  tcgetattr( slave, &tio );
+  cfmakeraw( &tio );
+  tcsetattr( slave, TCSANOW, &tio );
+  fcntl( master, F_SETFL, O_NONBLOCK );
+
+  snprintf( path, sizeof(path), "%s/%s", workDir, file );
+
+  if( (pid = fork()) == 0 )
+  {
+    int out = open( "/dev/null", O_WRONLY );
+
+    if( !verbose )
+    {
+      dup2( out, 1 );
+      dup2( out, 2 );
+    }
+    execl( tool, tool, command, ptsname( master ), path, (char*) NULL );
+    _exit( 127 );
+  }
+
+  {
+    ptyStream port( master );
+
+    while( waitpid( pid, &status, WNOHANG ) == 0 )
+    {
+      eeprom.serveTransfer( port );
+    }
+  }
+
+  close( slave );
+  close( master );
+
+  return( WIFEXITED( status ) ? WEXITSTATUS( status ) : -1 );
+}
+
+static void writeImage( const char* file, const unsigned char* data )
+{
+  char path[256];
+  FILE *fp;
+
+  snprintf( path, sizeof(path), "%s/%s", workDir, file );
+
+  if( (fp = fopen( path, "wb" )) == NULL ||
+      fwrite( data, 1, XFER_PARTITION_SIZE, fp ) != XFER_PARTITION_SIZE )
+  {
+    perror( path );
+    exit( 2 );
+  }
+
+  fclose( fp );
+}
+
+static bool sameImage( const char* file, const unsigned char* data )
+{
+  unsigned char image[XFER_PARTITION_SIZE + 1];
+  char path[256];
+  FILE *fp;
+  size_t len;
+
+  snprintf( path, sizeof(path), "%s/%s", workDir, file );
+
+  if( (fp = fopen( path, "rb" )) == NULL )
+  {
+    return( false );
+  }
+
+  len = fread( image, 1, sizeof(image), fp );
+  fclose( fp );
+
+  return( len == XFER_PARTITION_SIZE && memcmp( image, data, len ) == 0 );
+}
+
+//
+// an image with fields in all of the partition
+//
+static void fillImage( dsEeprom& eeprom, int n )
+{
+  char name[EEPROM_MAXLEN_NODENAME + 1];
+  char raw[XFER_PARTITION_SIZE - EEPROM_EXT_DATA_BEGIN];
+
+  snprintf( name, sizeof(name), "node-%d", n );
+  eeprom.storeString( name, EEPROM_MAXLEN_NODENAME, EEPROM_POS_NODENAME );
+
+  for( int i = 0; i < (int) sizeof(raw); i++ )
+  {
+    raw[i] = n * 7 + i;
+  }
+  eeprom.storeRaw( raw, sizeof(raw), EEPROM_EXT_DATA_BEGIN );
+
+  eeprom.validate();
+}
+
+int main( int argc, char* argv[] )
+{
+  unsigned char stageRam[XFER_PARTITION_SIZE];
+  unsigned char wiped[XFER_PARTITION_SIZE];
+  unsigned char source[XFER_PARTITION_SIZE];
+  int opt;
+
+  while( (opt = getopt( argc, argv, "t:v" )) != -1 )
+  {
+    switch( opt )
+    {
+      case 't':
+        tool = optarg;
+        break;
+      case 'v':
+        verbose = true;
+        break;
+      default:
+        fprintf( stderr, "usage: %s [-t dseetool] [-v]\n", argv[0] );
+        return( 2 );
+    }
+  }
+
+  if( access( tool, X_OK ) != 0 )
+  {
+    fprintf( stderr, "%s not found, build extras/dseetool first\n", tool );
+    return( 2 );
+  }
+
+  if( mkdtemp( workDir ) == NULL )
+  {
+    perror( workDir );
+    return( 2 );
+  }
+
+  memset( wiped, 0xff, sizeof(wiped) );
+
+  //
+  // export: the file is the image
+  //
+  {
+    ramDevice device;
+    dsEeprom eeprom;
+
+    eeprom.initPartition( device, 0, XFER_PARTITION_SIZE, XFER_MAGIC );
+    fillImage( eeprom, 1 );
+    memcpy( source, device.cells, sizeof(source) );
+
+    check( "export ends with success", runTool( eeprom, "export", "export.bin" ) == 0 );
+    check( "export is the image", sameImage( "export.bin", device.cells ) );
+    writeImage( "source.bin", source );
+  }
+
+  //
+  // import of a few changes into a stage
+  //
+  {
+    ramDevice device;
+    dsEeprom eeprom;
+
+    eeprom.initPartition( device, 0, XFER_PARTITION_SIZE, XFER_MAGIC );
+    fillImage( eeprom, 1 );
+    eeprom.storeString( (char*) "changed", EEPROM_MAXLEN_NODENAME, EEPROM_POS_NODENAME );
+    eeprom.validate();
+    eeprom.setStage( stageRam, XFER_SMALL_STAGE );
+
+    check( "import into the stage ends with success", runTool( eeprom, "import", "source.bin" ) == 0 );
+    check( "import into the stage is the image", memcmp( device.cells, source, sizeof(source) ) == 0 );
+  }
+
+  //
+  // restore onto a wiped device, the stage too small for it
+  //
+  {
+    ramDevice device;
+    ramDevice journal;
+    dsEeprom eeprom;
+
+    eeprom.initPartition( device, 0, XFER_PARTITION_SIZE, XFER_MAGIC );
+    eeprom.setStage( stageRam, XFER_SMALL_STAGE );
+    memcpy( device.cells, wiped, sizeof(wiped) );
+
+    check( "restore without a journal fails", runTool( eeprom, "import", "source.bin" ) != 0 );
+    check( "restore without a journal leaves the device",
+           memcmp( device.cells, wiped, sizeof(wiped) ) == 0 );
+
+    eeprom.setJournal( journal, 0, XFER_JOURNAL_SIZE );
+    check( "restore through the journal ends with success", runTool( eeprom, "import", "source.bin" ) == 0 );
+    check( "restore through the journal is the image", memcmp( device.cells, source, sizeof(source) ) == 0 );
+    check( "journal is cleared", journal.cells[EEPATCH_POS_MAGIC] != EEPATCH_MAGIC_0 );
+    check( "restored image is valid", eeprom.isValid() );
+  }
+
+  //
+  // no stage at all, journal only
+  //
+  {
+    ramDevice device;
+    ramDevice journal;
+    dsEeprom eeprom;
+
+    eeprom.initPartition( device, 0, XFER_PARTITION_SIZE, XFER_MAGIC );
+    eeprom.setJournal( journal, 0, XFER_JOURNAL_SIZE );
+    fillImage( eeprom, 2 );
+    memcpy( wiped, device.cells, sizeof(wiped) );
+
+    check( "import without a stage ends with success", runTool( eeprom, "import", "source.bin" ) == 0 );
+    check( "import without a stage is the image", memcmp( device.cells, source, sizeof(source) ) == 0 );
+
+    //
+    // an image whose checksum does not match could not be completed
+    // from the journal after a power loss
+    //
+    memcpy( wiped, device.cells, sizeof(wiped) );
+    source[EEPROM_EXT_DATA_BEGIN] ^= 0x01;
+    writeImage( "damaged.bin", source );
+    check( "import of a damaged image fails", runTool( eeprom, "import", "damaged.bin" ) != 0 );
+    check( "import of a damaged image leaves the device",
+           memcmp( device.cells, wiped, sizeof(wiped) ) == 0 );
+  }
+
+  unlink( (std::string( workDir ) + "/export.bin").c_str() );
+  unlink( (std::string( workDir ) + "/source.bin").c_str() );
+  unlink( (std::string( workDir ) + "/damaged.bin").c_str() );
+  rmdir( workDir );
+
+  printf( "%d checks failed\n", failed );
+
+  return( failed > 0 ? 1 : 0 );
+}